@@ -9,12 +9,6 @@
 #define DOUBLE_GAP_SCORING (0)
 
 
-typedef struct {
-  unsigned char x:7;
-  unsigned char y:1;
-}
-DPMove_T;
-
 typedef struct {
   LPOScore_T score;
   short gap_x, gap_y;
@@ -83,7 +77,7 @@ static void get_seq_left_and_final (LPOSequence_T *lposeq_x,
 
   
 static void trace_back_lpo_alignment (int len_x, int len_y,
-				      DPMove_T **move,
+				      LPOMoveRow_T *move,
 				      LPOLetterLink_T **x_left,
 				      LPOLetterRef_T best_x, LPOLetterRef_T best_y,
 				      LPOLetterRef_T **x_to_y,
@@ -100,8 +94,7 @@ static void trace_back_lpo_alignment (int len_x, int len_y,
   
   while (best_x >= 0 && best_y >= 0) {
 
-    xmove = move[best_y][best_x].x;
-    ymove = move[best_y][best_x].y;
+    get_lpo_move (&move[best_y], best_x, &xmove, &ymove);
     
     if (xmove>0 && ymove>0) { /* ALIGNED! MAP best_x <--> best_y */
       x_al[best_x]=best_y;
@@ -164,7 +157,7 @@ LPOScore_T align_lpo (LPOSequence_T *lposeq_x,
   LPOScore_T best_score = -999999;
   int *is_final_node_x;
   LPOLetterLink_T **x_left = NULL, *xl;
-  DPMove_T **move = NULL, *my_move;
+  LPOMoveRow_T *move = NULL;
   
   DPScore_T *curr_score = NULL, *prev_score = NULL, *init_col_score = NULL, *my_score, *swap;
   
@@ -196,9 +189,9 @@ LPOScore_T align_lpo (LPOSequence_T *lposeq_x,
   
   get_seq_left_and_final (lposeq_x, &x_left, &is_final_node_x);
   
-  CALLOC (move, len_y, DPMove_T *);
+  CALLOC (move, len_y, LPOMoveRow_T);
   for (i=0; i<len_y; i++) {
-    CALLOC (move[i], len_x, DPMove_T);
+    init_lpo_move_row (&move[i], 0, len_x-1);
   }
   
   CALLOC (init_col_score, len_y+1, DPScore_T);
@@ -290,31 +283,27 @@ LPOScore_T align_lpo (LPOSequence_T *lposeq_x,
       match_score += m->score[(int)seq_x[j].letter][(int)seq_y[i].letter];
       
       my_score = &curr_score[j];
-      my_move = &move[i][j];
       
       if (match_score > insert_y_score && match_score > insert_x_score) {
 	/* XY-MATCH */
 	my_score->score = match_score;
 	my_score->gap_x = 0;
 	my_score->gap_y = 0;
-	my_move->x = match_x;
-	my_move->y = match_y;
+	SET_LPO_MOVE (&move[i], j, match_x, match_y);
       }
       else if (insert_x_score > insert_y_score) {
 	/* X-INSERTION */
 	my_score->score = insert_x_score;
 	my_score->gap_x = next_gap_array[insert_x_gap];
 	my_score->gap_y = next_perp_gap_array[insert_x_gap];
-	my_move->x = insert_x_x;
-	my_move->y = 0;
+	SET_LPO_MOVE (&move[i], j, insert_x_x, 0);
       }
       else {
 	/* Y-INSERTION */
 	my_score->score = insert_y_score;
 	my_score->gap_x = next_perp_gap_array[insert_y_gap];
 	my_score->gap_y = next_gap_array[insert_y_gap];
-	my_move->x = 0;
-	my_move->y = insert_y_y;
+	SET_LPO_MOVE (&move[i], j, 0, insert_y_y);
       }
 
       /* RECORD BEST START FOR TRACEBACK */
@@ -362,9 +351,7 @@ LPOScore_T align_lpo (LPOSequence_T *lposeq_x,
   }
   FREE (x_left);
   
-  for (i=0; i<len_y; i++) {
-    FREE (move[i]);
-  }
+  free_lpo_move_rows (len_y, move, TRUE);
   FREE (move);
   
   return best_score;
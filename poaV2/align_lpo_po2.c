@@ -1,4 +1,6 @@
 
+#include <stdint.h>
+
 #include "default.h"
 #include "poa.h"
 #include "seq_util.h"
@@ -9,12 +11,6 @@
 #define DOUBLE_GAP_SCORING (0)
 
 
-typedef struct {
-  unsigned char x;
-  unsigned char y;
-}
-DPMove_T;
-
 typedef struct {
   LPOScore_T score;
   short gap_x, gap_y;
@@ -26,6 +22,122 @@ DPScore_T;
 #define LPO_INITIAL_NODE 1
 #define LPO_FINAL_NODE 2
 
+/** SCORE OF AN UNREACHABLE CELL */
+#define DP_MIN_SCORE (-999999)
+
+/** RUNNING TOTAL OF DP CELLS FILLED BY align_lpo_po(), PER THREAD SO THAT
+    -polish WORKERS CAN ALIGN AT THE SAME TIME */
+static __thread double Dp_cells_computed=0.;
+
+/** number of DP matrix cells align_lpo_po() has filled so far in the
+    calling thread */
+double get_lpo_dp_cell_count(void)
+{
+  return Dp_cells_computed;
+}
+
+/** adds ncell DP cells, filled by another thread, to the calling
+    thread's count */
+void add_lpo_dp_cell_count(double ncell)
+{
+  Dp_cells_computed += ncell;
+}
+
+
+/** KERNEL FORCED IN THE CALLING THREAD BY set_lpo_kernel() */
+static __thread int Lpo_kernel=lpo_kernel_auto;
+
+/** makes align_lpo_po() in the calling thread use kernel (one of the
+    lpo_kernel_ codes) wherever it applies, falling back on the kernel it
+    would otherwise choose; returns the previous setting.  Meant for
+    testing kernels against each other (see kernel_diff.c) */
+int set_lpo_kernel(int kernel)
+{
+  int previous = Lpo_kernel;
+
+  Lpo_kernel = kernel;
+  return previous;
+}
+
+
+/** MATCH SCORE OF x LETTER i AGAINST y LETTER j, LOOKED UP CELL BY CELL
+    FOR lpo_kernel_scalar */
+static LPOScore_T score_lpo_letters (int i, int j, LPOLetter_T seq_x[],
+				     LPOLetter_T seq_y[], ResidueScoreMatrix_T *m)
+{
+  return m->score[(int) seq_x[i].letter][(int) seq_y[j].letter];
+}
+
+
+/** NUMBER OF DISTINCT RESIDUE CODES HANDLED BY THE PACKED (DNA) KERNEL */
+#define PACKED_KERNEL_NSYMBOL 4
+
+/** if lposeq_x and lposeq_y together use at most PACKED_KERNEL_NSYMBOL
+    distinct residue codes, and all their pairwise scores fit in 16 bits,
+    saves the codes in symbol[] and the 2-bit slot of each x letter in
+    x_slot[], and returns TRUE.  The match score of a whole y row can then
+    be packed into one 64-bit word (see pack_row_scores()). */
+static int select_packed_kernel (int len_x, LPOLetter_T *seq_x,
+				 int len_y, LPOLetter_T *seq_y,
+				 ResidueScoreMatrix_T *m,
+				 int symbol[], unsigned char x_slot[])
+{
+  int i, j, nsymbol = 0;
+  int slot[MATRIX_SYMBOL_MAX];
+
+  for (i=0; i<MATRIX_SYMBOL_MAX; i++) {
+    slot[i] = -1;
+  }
+  for (i=0; i<len_x+len_y; i++) {
+    j = (i<len_x) ? seq_x[i].letter : seq_y[i-len_x].letter;
+    if (j<0 || j>=MATRIX_SYMBOL_MAX) {
+      return FALSE;
+    }
+    if (slot[j] < 0) {
+      if (nsymbol == PACKED_KERNEL_NSYMBOL) {
+	return FALSE;  /* TOO MANY DISTINCT RESIDUES, e.g. PROTEIN */
+      }
+      slot[j] = nsymbol;
+      symbol[nsymbol++] = j;
+    }
+  }
+  for (i=0; i<nsymbol; i++) {
+    for (j=0; j<nsymbol; j++) {
+      if (m->score[symbol[i]][symbol[j]] != (int16_t) m->score[symbol[i]][symbol[j]]) {
+	return FALSE;
+      }
+    }
+  }
+  for (i=nsymbol; i<PACKED_KERNEL_NSYMBOL; i++) {
+    symbol[i] = symbol[0];  /* UNUSED SLOTS: NEVER LOOKED UP */
+  }
+  for (i=0; i<len_x; i++) {
+    x_slot[i] = slot[(int) seq_x[i].letter];
+  }
+  return TRUE;
+}
+
+/** packs the scores of residue y_letter against the four kernel symbols
+    into 16-bit fields of one word, so the inner DP loop scores a cell
+    with a shift instead of a matrix lookup */
+static uint64_t pack_row_scores (ResidueScoreMatrix_T *m, int symbol[], int y_letter)
+{
+  int i;
+  uint64_t packed = 0;
+
+  for (i=0; i<PACKED_KERNEL_NSYMBOL; i++) {
+    packed |= ((uint64_t) (uint16_t) m->score[symbol[i]][y_letter]) << (16*i);
+  }
+  return packed;
+}
+
+#define PACKED_ROW_SCORE(PACKED,SLOT) ((LPOScore_T) (int16_t) ((PACKED) >> ((SLOT)<<4)))
+
+/** TRUE IF COLUMN J (>=0) OF A SCORE ROW WAS COMPUTED AND KEPT, i.e. LIES
+    INSIDE THE ROW'S ANCHOR BAND AND SURVIVED THE X-DROP RULE; COLUMN -1
+    LIVES IN init_col_score[] INSTEAD */
+#define DP_CELL_KEPT(J,LO,HI) ((J) >= (LO) && (J) <= (HI))
+
 static void get_lpo_stats (LPOSequence_T *lposeq,
 			   int *n_nodes_ptr, int *n_edges_ptr, int **node_type_ptr,
 			   int **refs_from_right_ptr, int *max_rows_alloced_ptr,
@@ -64,6 +176,17 @@ static void get_lpo_stats (LPOSequence_T *lposeq,
     }
   }
 
+  /* A WINDOW VIEW (see align_lpo_po_window()) CARRIES NO SOURCE SEQS: */
+  /* ITS NODES WITHOUT A RIGHT-LINK IN THE WINDOW END IT INSTEAD. ITS */
+  /* NODES WITHOUT A LEFT-LINK ARE ALREADY LINKED TO -1. */
+  if (lposeq->nsource_seq == 0) {
+    for (i=0; i<len; i++) {
+      if (refs_from_right[i] == 0) {
+	node_type[i] = (node_type[i] | LPO_FINAL_NODE);
+      }
+    }
+  }
+
   /* ALL 'INITIAL' NODES (1st in some seq) MUST BE LEFT-LINKED TO -1. */
   /* THIS ALLOWS FREE ALIGNMENT TO ANY 'BRANCH' IN GLOBAL ALIGNMENT. */
   for (i=0; i<len; i++) {
@@ -105,8 +228,10 @@ static void get_lpo_stats (LPOSequence_T *lposeq,
 }
 
 
+/** traces the alignment back from (best_x,best_y) through the
+    compressed moves of rows move[0..len_y-1] */
 static void trace_back_lpo_alignment (int len_x, int len_y,
-				      DPMove_T **move,
+				      LPOMoveRow_T *move,
 				      LPOLetterLink_T **x_left,
 				      LPOLetterLink_T **y_left,
 				      LPOLetterRef_T best_x, LPOLetterRef_T best_y,
@@ -124,8 +249,7 @@ static void trace_back_lpo_alignment (int len_x, int len_y,
 
   while (best_x >= 0 && best_y >= 0) {
 
-    xmove = move[best_y][best_x].x;
-    ymove = move[best_y][best_x].y;
+    get_lpo_move (&move[best_y], best_x, &xmove, &ymove);
 
     if (xmove>0 && ymove>0) { /* ALIGNED! MAP best_x <--> best_y */
       x_al[best_x]=best_y;
@@ -168,21 +292,59 @@ static void trace_back_lpo_alignment (int len_x, int len_y,
 }
 
 
-/** (align_lpo_po:)
-    performs partial order alignment:
-    lposeq_x and lposeq_y are partial orders;
-    returns the alignment in x_to_y[] and y_to_x[], and also
-    returns the alignment score as the return value.
-*/
+/** allocates the gap length transitions of the DP in *p_next_gap (gap
+    grown along its own axis) and *p_next_perp_gap (gap in the other
+    axis), and sets the initial state M+1 of m's gap penalties for
+    global or local alignment */
+static void init_gap_arrays (ResidueScoreMatrix_T *m, int use_global_alignment,
+			     int **p_next_gap, int **p_next_perp_gap)
+{
+  int i, max_gap_length = m->max_gap_length;
+  LPOScore_T *gap_penalty_x = m->gap_penalty_x, *gap_penalty_y = m->gap_penalty_y;
+  int *next_gap_array, *next_perp_gap_array;
 
-LPOScore_T align_lpo_po (LPOSequence_T *lposeq_x,
-			 LPOSequence_T *lposeq_y,
-			 ResidueScoreMatrix_T *m,
-			 LPOLetterRef_T **x_to_y,
-			 LPOLetterRef_T **y_to_x,
-			 LPOScore_T (*scoring_function)
-			 (int, int, LPOLetter_T *, LPOLetter_T *, ResidueScoreMatrix_T *),
-			 int use_global_alignment)
+  CALLOC (next_gap_array, max_gap_length + 2, int);
+  CALLOC (next_perp_gap_array, max_gap_length + 2, int);
+
+  for (i=0; i<max_gap_length+1; i++) {
+    /* GAP LENGTH EXTENSION RULE: */
+    /* 0->1, 1->2, 2->3, ..., M-1->M; but M->M. */
+    next_gap_array[i] = (i<max_gap_length) ? i+1 : i;
+    /* PERPENDICULAR GAP (i.e. X FOR A GROWING Y-GAP) IS KEPT AT 0 IF DOUBLE-GAP-SCORING (old scoring) IS USED. */
+    next_perp_gap_array[i] = (DOUBLE_GAP_SCORING ? 0 : next_gap_array[i]);
+  }
+
+  /* GAP LENGTH = M+1 IS USED FOR INITIAL STATE. */
+  /* THIS MUST BE TREATED DIFFERENTLY FOR GLOBAL v. LOCAL ALIGNMENT: */
+  if (0 == use_global_alignment) {   /* FREE EXTENSION OF INITIAL GAP (FOR LOCAL ALIGNMENT) */
+    gap_penalty_x[max_gap_length+1] = gap_penalty_y[max_gap_length+1] = 0;
+    next_gap_array[max_gap_length+1] = next_perp_gap_array[max_gap_length+1] = max_gap_length+1;
+  }
+  else {   /* TREAT INITIAL GAP LIKE ANY OTHER (FOR GLOBAL ALIGNMENT) */
+    gap_penalty_x[max_gap_length+1] = gap_penalty_x[0];
+    gap_penalty_y[max_gap_length+1] = gap_penalty_y[0];
+    next_gap_array[max_gap_length+1] = next_gap_array[0];
+    next_perp_gap_array[max_gap_length+1] = next_perp_gap_array[0];
+  }
+
+  (*p_next_gap) = next_gap_array;
+  (*p_next_perp_gap) = next_perp_gap_array;
+}
+
+
+/** fills the DP matrix of lposeq_x against lposeq_y and traces back the
+    best alignment (see align_lpo_po()); if band_lo is not NULL, row i
+    only computes columns band_lo[i]..band_hi[i] */
+static LPOScore_T fill_lpo_po_alignment (LPOSequence_T *lposeq_x,
+					 LPOSequence_T *lposeq_y,
+					 ResidueScoreMatrix_T *m,
+					 LPOLetterRef_T **x_to_y,
+					 LPOLetterRef_T **y_to_x,
+					 LPOScore_T (*scoring_function)
+					 (int, int, LPOLetter_T *, LPOLetter_T *, ResidueScoreMatrix_T *),
+					 int use_global_alignment,
+					 const int band_lo[],
+					 const int band_hi[])
 {
   LPOLetter_T *seq_x = lposeq_x->letter;
   LPOLetter_T *seq_y = lposeq_y->letter;
@@ -195,12 +357,12 @@ LPOScore_T align_lpo_po (LPOSequence_T *lposeq_x,
 
   int i, j, xcount, ycount, prev_gap;
   int best_x = -1, best_y = -1;
-  LPOScore_T min_score = -999999, best_score = -999999;
+  LPOScore_T min_score = DP_MIN_SCORE, best_score = DP_MIN_SCORE;
   int possible_end_square;
   LPOLetterLink_T **x_left = NULL, **y_left = NULL, *xl, *yl;
-  DPMove_T **move = NULL, *my_move;
+  LPOMoveRow_T *move = NULL;
 
-  DPScore_T *curr_score = NULL, *prev_score = NULL, *init_col_score = NULL, *my_score;
+  DPScore_T *curr_score = NULL, *prev_score = NULL, *init_col_score = NULL, *my_score, *from_score;
   DPScore_T **score_rows = NULL;
 
   int max_gap_length;
@@ -208,9 +370,16 @@ LPOScore_T align_lpo_po (LPOSequence_T *lposeq_x,
   int *next_gap_array, *next_perp_gap_array;
 
   LPOScore_T try_score, insert_x_score, insert_y_score, match_score;
+  LPOScore_T row_profile[MATRIX_SYMBOL_MAX];
+  int use_packed_kernel = FALSE, packed_symbol[PACKED_KERNEL_NSYMBOL];
+  unsigned char *x_slot = NULL;
+  uint64_t packed_row = 0;
   int insert_x_x, insert_x_gap;
   int insert_y_y, insert_y_gap;
   int match_x, match_y;
+  int use_drop, drop_lo, drop_hi, live_lo, live_hi, *row_lo = NULL, *row_hi = NULL;
+  int col_lo, col_hi, *row_alloc_lo = NULL;
+  LPOScore_T drop_cutoff;
 
   get_lpo_stats (lposeq_x, &len_x, &n_edges_x, &node_type_x, &refs_from_right_x, &max_rows_alloced_x, &x_left);
   get_lpo_stats (lposeq_y, &len_y, &n_edges_y, &node_type_y, &refs_from_right_y, &max_rows_alloced_y, &y_left);
@@ -224,37 +393,26 @@ LPOScore_T align_lpo_po (LPOSequence_T *lposeq_x,
   max_gap_length = m->max_gap_length;
   gap_penalty_x = m->gap_penalty_x;
   gap_penalty_y = m->gap_penalty_y;
-  CALLOC (next_gap_array, max_gap_length + 2, int);
-  CALLOC (next_perp_gap_array, max_gap_length + 2, int);
-
-  for (i=0; i<max_gap_length+1; i++) {
-    /* GAP LENGTH EXTENSION RULE: */
-    /* 0->1, 1->2, 2->3, ..., M-1->M; but M->M. */
-    next_gap_array[i] = (i<max_gap_length) ? i+1 : i;
-    /* PERPENDICULAR GAP (i.e. X FOR A GROWING Y-GAP) IS KEPT AT 0 IF DOUBLE-GAP-SCORING (old scoring) IS USED. */
-    next_perp_gap_array[i] = (DOUBLE_GAP_SCORING ? 0 : next_gap_array[i]);
-  }
-
-  /* GAP LENGTH = M+1 IS USED FOR INITIAL STATE. */
-  /* THIS MUST BE TREATED DIFFERENTLY FOR GLOBAL v. LOCAL ALIGNMENT: */
-  if (0 == use_global_alignment) {   /* FREE EXTENSION OF INITIAL GAP (FOR LOCAL ALIGNMENT) */
-    gap_penalty_x[max_gap_length+1] = gap_penalty_y[max_gap_length+1] = 0;
-    next_gap_array[max_gap_length+1] = next_perp_gap_array[max_gap_length+1] = max_gap_length+1;
-  }
-  else {   /* TREAT INITIAL GAP LIKE ANY OTHER (FOR GLOBAL ALIGNMENT) */
-    gap_penalty_x[max_gap_length+1] = gap_penalty_x[0];
-    gap_penalty_y[max_gap_length+1] = gap_penalty_y[0];
-    next_gap_array[max_gap_length+1] = next_gap_array[0];
-    next_perp_gap_array[max_gap_length+1] = next_perp_gap_array[0];
+  init_gap_arrays (m, use_global_alignment, &next_gap_array, &next_perp_gap_array);
+
+
+  /* SELECT MATCH-SCORE KERNEL: */
+  if (scoring_function == NULL) {
+    CALLOC (x_slot, len_x, unsigned char);
+    use_packed_kernel = (Lpo_kernel != lpo_kernel_profile)
+      && select_packed_kernel (len_x, seq_x, len_y, seq_y, m,
+			       packed_symbol, x_slot);
+    if (!use_packed_kernel) { /* PROFILE KERNEL INDEXES BY RESIDUE CODE */
+      for (j=0; j<len_x; j++) {
+	x_slot[j] = seq_x[j].letter;
+      }
+    }
   }
 
 
   /* ALLOCATE MEMORY FOR 'MOVE' AND 'SCORE' MATRICES: */
 
-  CALLOC (move, len_y, DPMove_T *);
-  for (i=0; i<len_y; i++) {
-    CALLOC (move[i], len_x, DPMove_T);
-  }
+  CALLOC (move, len_y, LPOMoveRow_T);
 
   CALLOC (init_col_score, len_y+1, DPScore_T);
   init_col_score = &(init_col_score[1]);
@@ -265,6 +423,18 @@ LPOScore_T align_lpo_po (LPOSequence_T *lposeq_x,
   score_rows[-1] = &(score_rows[-1][1]);
   curr_score = score_rows[-1];
 
+  /* COLUMNS KEPT IN EACH 'SCORE' ROW (ALL OF THEM UNLESS BANDS OR X-DROP */
+  /* PRUNE), AND THE FIRST COLUMN ALLOCATED FOR ITS 'SCORE' AND 'MOVE' ROWS: */
+  CALLOC (row_lo, len_y+1, int);
+  CALLOC (row_hi, len_y+1, int);
+  CALLOC (row_alloc_lo, len_y+1, int);
+  row_lo = &(row_lo[1]);
+  row_hi = &(row_hi[1]);
+  row_alloc_lo = &(row_alloc_lo[1]);
+  row_lo[-1] = 0;
+  row_hi[-1] = len_x-1;
+  row_alloc_lo[-1] = -1;
+
 
   /* FILL INITIAL ROW (-1). */
   /* GAP LENGTH = M+1 IS USED FOR INITIAL STATE. */
@@ -308,16 +478,73 @@ LPOScore_T align_lpo_po (LPOSequence_T *lposeq_x,
   /* OUTER LOOP (i-th position in LPO y): */
   for (i=0; i<len_y; i++) {
 
-    /* ALLOCATE MEMORY FOR 'SCORE' ROW i: */
-    CALLOC (score_rows[i], len_x+1, DPScore_T);
-    score_rows[i] = &(score_rows[i][1]);
+    /* X-DROP: ONCE THE BEST SCORE CLEARS THE CUTOFF, ONLY EXTEND THE */
+    /* COLUMNS KEPT BY THE y-PREDECESSOR ROWS (AND WHAT FOLLOWS THEM). */
+    /* A ROOT ROW OF y (NO REAL PREDECESSOR) HAS NO SUCH COLUMNS, SO */
+    /* IT STAYS OPEN OVER ALL OF x. */
+    use_drop = (0 == use_global_alignment && m->drop_score > 0
+		&& best_score > m->drop_score);
+    if (use_drop) {
+      drop_lo = len_x;
+      drop_hi = -1;
+      ycount = 0; /* REAL PREDECESSORS */
+      for (yl = y_left[i]; yl != NULL; yl = yl->more) if (yl->ipos >= 0) {
+	ycount++;
+	if (row_lo[yl->ipos] < drop_lo) {
+	  drop_lo = row_lo[yl->ipos];
+	}
+	if (row_hi[yl->ipos] > drop_hi) {
+	  drop_hi = row_hi[yl->ipos];
+	}
+      }
+      if (ycount == 0) { /* ROOT OF y: OPEN ROW */
+	drop_lo = 0;
+	drop_hi = len_x-1;
+      }
+    }
+    else {
+      drop_lo = 0;
+      drop_hi = len_x-1;
+    }
+    live_lo = len_x;
+    live_hi = -1;
+
+    /* ANCHOR BANDS LIMIT THE ROW TO THE GAP AROUND ITS ANCHORS: */
+    col_lo = drop_lo;
+    col_hi = len_x-1;
+    if (band_lo) {
+      if (band_lo[i] > col_lo) {
+	col_lo = band_lo[i];
+      }
+      col_hi = band_hi[i];
+    }
+
+    /* ALLOCATE MEMORY FOR 'SCORE' AND 'MOVE' ROW i (COLUMNS col_lo..col_hi): */
+    CALLOC (score_rows[i], (col_hi >= col_lo) ? col_hi-col_lo+1 : 1, DPScore_T);
+    score_rows[i] = &(score_rows[i][-col_lo]);
+    init_lpo_move_row (&move[i], col_lo, col_hi);
+    row_alloc_lo[i] = col_lo;
     n_score_rows_alloced++;
 
     curr_score = score_rows[i];
-    curr_score[-1] = init_col_score[i];
+
+    /* SCORES OF y-RESIDUE i AGAINST EVERY x-RESIDUE: */
+    if (use_packed_kernel) {
+      packed_row = pack_row_scores (m, packed_symbol, seq_y[i].letter);
+    }
+    else if (scoring_function == NULL) {
+      for (j=0; j<m->nsymbol; j++) {
+	row_profile[j] = m->score[j][(int) seq_y[i].letter];
+      }
+    }
 
     /* INNER LOOP (j-th position in LPO x): */
-    for (j=0; j<len_x; j++) {
+    for (j=col_lo; j<=col_hi; j++) {
+
+      /* PAST THE PREDECESSOR ROWS, CONTINUE ONLY WHILE CELLS STAY ALIVE */
+      if (use_drop && j > drop_hi && j > live_hi+1) {
+	break;
+      }
 
       match_score = (use_global_alignment) ? min_score : 0;
       match_x = match_y = 0;
@@ -336,19 +563,31 @@ LPOScore_T align_lpo_po (LPOSequence_T *lposeq_x,
 	prev_score = score_rows[yl->ipos];
 
 	/* IMPROVE Y-INSERTION?: trace back to (i'=yl->ipos, j) */
-	prev_gap = prev_score[j].gap_y;
-	try_score = prev_score[j].score + yl->score - gap_penalty_y[prev_gap];
-	if (try_score > insert_y_score) {
-	  insert_y_score = try_score;
-	  insert_y_y = ycount;
-	  insert_y_gap = prev_gap;
+	if (DP_CELL_KEPT (j, row_lo[yl->ipos], row_hi[yl->ipos])) {
+	  prev_gap = prev_score[j].gap_y;
+	  try_score = prev_score[j].score + yl->score - gap_penalty_y[prev_gap];
+	  if (try_score > insert_y_score) {
+	    insert_y_score = try_score;
+	    insert_y_y = ycount;
+	    insert_y_gap = prev_gap;
+	  }
 	}
 
 	/* LOOP OVER x-predecessors (INSIDE y-predecessor LOOP): */
 	for (xcount = 1, xl = x_left[j]; xl != NULL; xcount++, xl = xl->more) {
 
+	  if (xl->ipos < 0) {
+	    from_score = &init_col_score[yl->ipos];
+	  }
+	  else if (DP_CELL_KEPT (xl->ipos, row_lo[yl->ipos], row_hi[yl->ipos])) {
+	    from_score = &prev_score[xl->ipos];
+	  }
+	  else {
+	    continue;
+	  }
+
 	  /* IMPROVE XY-MATCH?: trace back to (i'=yl->ipos, j'=xl->ipos) */
-	  try_score = prev_score[xl->ipos].score + xl->score + yl->score;
+	  try_score = from_score->score + xl->score + yl->score;
 	  if (try_score > match_score) {
 	    match_score = try_score;
 	    match_x = xcount;
@@ -360,9 +599,19 @@ LPOScore_T align_lpo_po (LPOSequence_T *lposeq_x,
       /* LOOP OVER x-predecessors (OUTSIDE y-predecessor LOOP): */
       for (xcount = 1, xl = x_left[j]; xl != NULL; xcount++, xl = xl->more) {
 
+	if (xl->ipos < 0) {
+	  from_score = &init_col_score[i];
+	}
+	else if (DP_CELL_KEPT (xl->ipos, col_lo, j)) {
+	  from_score = &curr_score[xl->ipos];
+	}
+	else {
+	  continue;
+	}
+
 	/* IMPROVE X-INSERTION?: trace back to (i, j'=xl->ipos) */
-	prev_gap = curr_score[xl->ipos].gap_x;
-	try_score = curr_score[xl->ipos].score + xl->score - gap_penalty_x[prev_gap];
+	prev_gap = from_score->gap_x;
+	try_score = from_score->score + xl->score - gap_penalty_x[prev_gap];
 	if (try_score > insert_x_score) {
 	  insert_x_score = try_score;
 	  insert_x_x = xcount;
@@ -374,36 +623,35 @@ LPOScore_T align_lpo_po (LPOSequence_T *lposeq_x,
       if (scoring_function != NULL) {
 	match_score += scoring_function (j, i, seq_x, seq_y, m);
       }
+      else if (use_packed_kernel) {
+	match_score += PACKED_ROW_SCORE (packed_row, x_slot[j]);
+      }
       else {
-	match_score += m->score[seq_x[i].letter][seq_y[j].letter];
+	match_score += row_profile[x_slot[j]];
       }
 
       my_score = &curr_score[j];
-      my_move = &move[i][j];
 
       if (match_score > insert_y_score && match_score > insert_x_score) {
 	/* XY-MATCH */
 	my_score->score = match_score;
 	my_score->gap_x = 0;
 	my_score->gap_y = 0;
-	my_move->x = match_x;
-	my_move->y = match_y;
+	SET_LPO_MOVE (&move[i], j, match_x, match_y);
       }
       else if (insert_x_score > insert_y_score) {
 	/* X-INSERTION */
 	my_score->score = insert_x_score;
 	my_score->gap_x = next_gap_array[insert_x_gap];
 	my_score->gap_y = next_perp_gap_array[insert_x_gap];
-	my_move->x = insert_x_x;
-	my_move->y = 0;
+	SET_LPO_MOVE (&move[i], j, insert_x_x, 0);
       }
       else {
 	/* Y-INSERTION */
 	my_score->score = insert_y_score;
 	my_score->gap_x = next_perp_gap_array[insert_y_gap];
 	my_score->gap_y = next_gap_array[insert_y_gap];
-	my_move->x = 0;
-	my_move->y = insert_y_y;
+	SET_LPO_MOVE (&move[i], j, 0, insert_y_y);
       }
 
       /* RECORD BEST ALIGNMENT END FOR TRACEBACK: */
@@ -415,18 +663,36 @@ LPOScore_T align_lpo_po (LPOSequence_T *lposeq_x,
 	  best_y = i;
 	}
       }
+
+      /* X-DROP: KEEP THIS CELL IF IT IS STILL CLOSE ENOUGH TO THE BEST */
+      drop_cutoff = best_score - m->drop_score;
+      if (use_drop && m->use_zdrop) {
+	drop_cutoff -= m->gap_penalty_set[0][1] * abs ((i - best_y) - (j - best_x));
+      }
+      if (!use_drop || my_score->score >= drop_cutoff) {
+	if (j < live_lo) {
+	  live_lo = j;
+	}
+	live_hi = j;
+      }
+    }
+
+    row_lo[i] = live_lo;
+    row_hi[i] = live_hi;
+    if (j > col_lo) {
+      Dp_cells_computed += j - col_lo;
     }
 
     /* UPDATE # OF REFS TO 'SCORE' ROWS; FREE MEMORY WHEN POSSIBLE: */
     for (yl = y_left[i]; yl != NULL; yl = yl->more) if ((j = yl->ipos) >= 0) {
       if ((--refs_from_right_y[j]) == 0) {
-	score_rows[j] = &(score_rows[j][-1]);
+	score_rows[j] = &(score_rows[j][row_alloc_lo[j]]);
 	FREE (score_rows[j]);
 	n_score_rows_alloced--;
       }
     }
     if (refs_from_right_y[i] == 0) {
-      score_rows[i] = &(score_rows[i][-1]);
+      score_rows[i] = &(score_rows[i][row_alloc_lo[i]]);
       FREE (score_rows[i]);
       n_score_rows_alloced--;
     }
@@ -455,6 +721,7 @@ LPOScore_T align_lpo_po (LPOSequence_T *lposeq_x,
 
   FREE (next_gap_array);
   FREE (next_perp_gap_array);
+  FREE (x_slot);
 
   score_rows[-1] = &(score_rows[-1][-1]);
   FREE (score_rows[-1]);
@@ -464,6 +731,11 @@ LPOScore_T align_lpo_po (LPOSequence_T *lposeq_x,
   init_col_score = &(init_col_score[-1]);
   FREE (init_col_score);
 
+  row_lo = &(row_lo[-1]);
+  FREE (row_lo);
+  row_hi = &(row_hi[-1]);
+  FREE (row_hi);
+
   for (i=0; i<len_x; i++) {
     if (x_left[i] != &seq_x[i].left) {
       FREE (x_left[i]);
@@ -478,10 +750,1349 @@ LPOScore_T align_lpo_po (LPOSequence_T *lposeq_x,
   }
   FREE (y_left);
 
+  free_lpo_move_rows (len_y, move, TRUE);
+  FREE (move);
+
+  row_alloc_lo = &(row_alloc_lo[-1]);
+  FREE (row_alloc_lo);
+
+  return best_score;
+}
+
+
+/** A IF THE 0/1 FLAG C IS SET, ELSE B, AS A BIT MASK RATHER THAN A BRANCH,
+    SO THAT A LOOP OVER THE COLUMNS OF fill_lpo_po_affine() OR THE LANES OF
+    fill_lpo_po_batch() CAN BE COMPILED INTO VECTOR INSTRUCTIONS (ALSO
+    WHEN IT ASSIGNS B BACK TO ITSELF) */
+#define LANE_SELECT(C,A,B) (((A) & -(C)) | ((B) & ~-(C)))
+
+
+/** A GAP PENALTY FUNCTION THAT IS AFFINE IN ONE OR TWO PIECES: OPENING
+    COSTS open, EXTENDING A GAP SHORTER THAN trunc COSTS extend1, AND
+    LONGER ONES extend2.  GAP STATE 0 FOLLOWS A MATCH, 1..trunc COUNT THE
+    GAP LENGTH (SATURATING AT trunc), AND trunc+1 IS THE FREE INITIAL GAP
+    OF LOCAL ALIGNMENT */
+typedef struct {
+  LPOScore_T open, extend1, extend2;
+  LPOScore_T trunc;
+}
+DPAffineGap_T;
+
+/** PENALTY TO EXTEND A GAP FROM STATE G, WITHOUT A TABLE LOOKUP */
+#define AFFINE_GAP_PENALTY(GAP,G) \
+  LANE_SELECT ((G) == 0, (GAP)->open, \
+	       LANE_SELECT ((G) < (GAP)->trunc, (GAP)->extend1, \
+			    LANE_SELECT ((G) == (GAP)->trunc, (GAP)->extend2, 0)))
+
+/** STATE AFTER EXTENDING A GAP FROM STATE G */
+#define AFFINE_GAP_NEXT(GAP,G) ((G) + ((G) < (GAP)->trunc))
+
+
+/** if m's gap penalties (see finish_score_matrix()) are the same for x
+    and y and at most two-piece affine, i.e. all gap lengths from some
+    trunc on cost the same to extend, and all shorter ones (but the
+    opening) too, saves them in *gap and returns TRUE.  Collapsing every
+    gap length >= trunc into one state then leaves the DP of
+    fill_lpo_po_alignment() unchanged.  Decaying penalties (GAP-DECAY-LENGTH
+    with distinct extension penalties) do not qualify. */
+static int get_affine_gap_shape (ResidueScoreMatrix_T *m, DPAffineGap_T *gap)
+{
+  int i, max_gap_length = m->max_gap_length;
+  LPOScore_T *gap_penalty_x = m->gap_penalty_x, *gap_penalty_y = m->gap_penalty_y;
+
+  if (DOUBLE_GAP_SCORING || max_gap_length < 1) {
+    return FALSE;
+  }
+  for (i=0; i<=max_gap_length; i++) {
+    if (gap_penalty_x[i] != gap_penalty_y[i]) {
+      return FALSE;
+    }
+  }
+  gap->open = gap_penalty_x[0];
+  gap->extend1 = gap_penalty_x[1];
+  gap->extend2 = gap_penalty_x[max_gap_length];
+  for (i=1; i<max_gap_length && gap_penalty_x[i] == gap->extend1; i++);
+  gap->trunc = i;  /* FIRST LENGTH PAST THE extend1 PIECE */
+  for (; i<=max_gap_length; i++) {
+    if (gap_penalty_x[i] != gap->extend2) {
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+
+/** NUMBER OF COLUMNS fill_lpo_po_affine() SCORES TOGETHER: ITS ROWS ARE
+    PADDED TO A MULTIPLE OF THIS, SO EACH BLOCK IS A FIXED-LENGTH LOOP */
+#define AFFINE_BLOCK_COLUMNS 16
+
+/** WIDTH OF THE TILES fill_lpo_po_affine() SPLITS LONG GRAPHS INTO, SO THE
+    ROWS IT WORKS ON (ABOUT 40 BYTES PER COLUMN) STAY IN A 256 KB L2
+    CACHE; A MULTIPLE OF AFFINE_BLOCK_COLUMNS */
+#ifndef AFFINE_TILE_COLUMNS
+#define AFFINE_TILE_COLUMNS 4096
+#endif
+
+/** TILE WIDTH IN THE CALLING THREAD, SET BY set_lpo_tile_columns() */
+static __thread int Lpo_tile_columns=AFFINE_TILE_COLUMNS;
+
+/** makes fill_lpo_po_affine() in the calling thread split x into tiles
+    of ncolumns columns (rounded up to a multiple of AFFINE_BLOCK_COLUMNS;
+    0 restores AFFINE_TILE_COLUMNS); returns the previous setting.  Meant
+    for testing the tiling on short graphs (see kernel_diff.c) */
+int set_lpo_tile_columns(int ncolumns)
+{
+  int previous = Lpo_tile_columns;
+
+  if (ncolumns <= 0) {
+    ncolumns = AFFINE_TILE_COLUMNS;
+  }
+  Lpo_tile_columns = (ncolumns + AFFINE_BLOCK_COLUMNS-1) / AFFINE_BLOCK_COLUMNS * AFFINE_BLOCK_COLUMNS;
+  return previous;
+}
+
+/** fills the DP matrix of lposeq_x against lposeq_y like
+    fill_lpo_po_alignment() without bands, X-drop or a scoring function,
+    for gap penalties of the shape found by get_affine_gap_shape(), and
+    with the same moves, scores and tie-breaks.  The penalty of a cell's
+    gap state is a fixed function (AFFINE_GAP_PENALTY) stored with the
+    cell, rather than an index into m->gap_penalty_x.
+
+    Long graphs are split into tiles of AFFINE_TILE_COLUMNS columns (see
+    set_lpo_tile_columns()), and
+    each tile is filled for all rows before the next: letters are in
+    topological order, so every x-predecessor is in the same tile or an
+    earlier one.  The cells of earlier tiles that a tile's x-predecessors
+    point at (and the initial column) are its halo: their values for all
+    rows are saved as boundary columns when they are computed, and copied
+    in front of each row's tile segment, so a predecessor is always read
+    as segment[local position], negative for the halo.
+
+    Within a tile each row is done in blocks of AFFINE_BLOCK_COLUMNS
+    columns: the y-insertion and match candidates, which only read earlier
+    rows, are first gathered into local arrays and compared without
+    branches, so the compiler can turn these loops into vector
+    instructions; the x-insertions, which chain along the row, and the
+    final choice of each cell are then made left to right.
+    x-predecessors are flattened into arrays: the first link of every
+    column, and the others (of letters with several) apart. */
+static LPOScore_T fill_lpo_po_affine (LPOSequence_T *lposeq_x,
+				      LPOSequence_T *lposeq_y,
+				      ResidueScoreMatrix_T *m,
+				      const DPAffineGap_T *gap,
+				      LPOLetterRef_T **x_to_y,
+				      LPOLetterRef_T **y_to_x,
+				      int use_global_alignment)
+{
+  LPOLetter_T *seq_x = lposeq_x->letter;
+  LPOLetter_T *seq_y = lposeq_y->letter;
+
+  int len_x, len_y;
+  int n_edges_x, n_edges_y;
+  int *node_type_x, *node_type_y;
+  int *refs_from_right_x, *refs_from_right_y, *refs = NULL;
+  int max_rows_alloced_x, max_rows_alloced_y;
+
+  int i, j, j0, k, l, c, b, ycount, best_x = -1, best_y = -1;
+  int nmulti = 0, nextra = 0, init_state, possible_end_square;
+  LPOScore_T min_score = DP_MIN_SCORE, best_score = DP_MIN_SCORE;
+  LPOScore_T try_score, insert_x_score, match_start, y_link_score;
+  LPOLetterLink_T **x_left = NULL, **y_left = NULL, *xl, *yl;
+  LPOMoveRow_T *move = NULL;
+
+  /* TILES: tile t HOLDS COLUMNS t*tile_width.., AND ITS HALO IS THE */
+  /* COLUMNS halo_col[halo_start[t]..halo_start[t+1]-1] (THE FIRST IS */
+  /* ALWAYS THE INITIAL COLUMN -1), AT LOCAL POSITIONS -1, -2, ... */
+  int tile_width, ntile, t, t0, t_len, t_pad, nhalo, seg_size;
+  int *halo_start = NULL, *halo_col = NULL, *halo_slot = NULL, nhalo_total = 0;
+
+  /* BOUNDARY COLUMNS: EVERY x LETTER IN SOME LATER TILE'S HALO KEEPS ITS */
+  /* SCORE, PENALTY AND GAP STATE FOR ROWS -1..len_y-1 */
+  int *boundary = NULL, nboundary = 0;
+  LPOScore_T *boundary_h = NULL, *boundary_p = NULL, *boundary_g = NULL;
+
+  /* THE INITIAL ROW AND COLUMN, WHOLE (INDEX -1: THE CORNER CELL) */
+  LPOScore_T *init_row_h = NULL, *init_row_p = NULL, *init_row_g = NULL;
+  LPOScore_T *init_col_h = NULL, *init_col_p = NULL, *init_col_g = NULL;
+
+  /* ROW r (-1..len_y-1) OF THE CURRENT TILE: SCORE, GAP PENALTY AND GAP */
+  /* STATE OF ITS CELLS, WITH THE HALO AT NEGATIVE INDICES */
+  LPOScore_T **h_row = NULL, **p_row = NULL, **g_row = NULL;
+  LPOScore_T *h, *p, *g, *prev_h, *prev_p, *prev_g;
+
+  /* FLATTENED x-PREDECESSORS, AS LOCAL POSITIONS IN THEIR COLUMN'S TILE: */
+  /* THE FIRST LINK OF EACH COLUMN, THEN THE EXTRA LINKS OF THE nmulti */
+  /* COLUMNS multi_col[] WITH SEVERAL */
+  int *pred_pos = NULL, *multi_col = NULL, *extra_start = NULL, *extra_pos = NULL;
+  LPOScore_T *pred_score = NULL, *extra_score = NULL;
+  int *x_code = NULL, insert_x_x, insert_x_gap;
+
+  /* CANDIDATES FOR THE CURRENT BLOCK OF COLUMNS: */
+  LPOScore_T from_h[AFFINE_BLOCK_COLUMNS], from_p[AFFINE_BLOCK_COLUMNS];
+  LPOScore_T from_g[AFFINE_BLOCK_COLUMNS], from_match[AFFINE_BLOCK_COLUMNS];
+  LPOScore_T link_score[AFFINE_BLOCK_COLUMNS];
+  LPOScore_T match_score[AFFINE_BLOCK_COLUMNS], insert_y_score[AFFINE_BLOCK_COLUMNS];
+  LPOScore_T insert_y_gap[AFFINE_BLOCK_COLUMNS];
+  int match_x[AFFINE_BLOCK_COLUMNS], match_y[AFFINE_BLOCK_COLUMNS];
+  int insert_y_y[AFFINE_BLOCK_COLUMNS], is_better;
+  int move_x[AFFINE_BLOCK_COLUMNS], move_y[AFFINE_BLOCK_COLUMNS], move_fits[AFFINE_BLOCK_COLUMNS];
+  unsigned char move_code[AFFINE_BLOCK_COLUMNS], *move_row;
+
+  LPOScore_T row_profile[MATRIX_SYMBOL_MAX];
+
+  get_lpo_stats (lposeq_x, &len_x, &n_edges_x, &node_type_x, &refs_from_right_x, &max_rows_alloced_x, &x_left);
+  get_lpo_stats (lposeq_y, &len_y, &n_edges_y, &node_type_y, &refs_from_right_y, &max_rows_alloced_y, &y_left);
+
+  /* GAP STATE OF THE INITIAL CELL: LOCAL GAPS FROM IT ARE FREE, GLOBAL */
+  /* ONES ARE OPENED LIKE ANY OTHER */
+  init_state = (use_global_alignment) ? 0 : gap->trunc+1;
+
+
+  /* SPLIT x INTO TILES, AND FIND THE HALO OF EACH: */
+
+  tile_width = (len_x > Lpo_tile_columns) ? Lpo_tile_columns : len_x;
+  if (tile_width < 1) {
+    tile_width = 1;
+  }
+  CALLOC (halo_slot, len_x+1, int);
+  halo_slot = &(halo_slot[1]);
+  CALLOC (boundary, len_x, int);
+  for (i=0; i<2; i++) {
+    ntile = (len_x + tile_width-1) / tile_width;
+    CALLOC (halo_start, ntile+1, int);
+    CALLOC (halo_col, n_edges_x+len_x+ntile, int);
+    for (j=-1; j<len_x; j++) {
+      halo_slot[j] = -1;
+    }
+    nhalo_total = nboundary = 0;
+    for (t=0; t<ntile; t++) {
+      halo_start[t] = nhalo_total;
+      halo_slot[-1] = 0;
+      halo_col[nhalo_total++] = -1;
+      for (j=t*tile_width; j<len_x && j<(t+1)*tile_width; j++) {
+	for (xl = x_left[j]; xl != NULL; xl = xl->more) {
+	  if (xl->ipos >= 0 && xl->ipos < t*tile_width && halo_slot[xl->ipos] < 0) {
+	    halo_slot[xl->ipos] = nhalo_total - halo_start[t];
+	    halo_col[nhalo_total++] = xl->ipos;
+	    if (!boundary[xl->ipos]) {
+	      boundary[xl->ipos] = 1;
+	      nboundary++;
+	    }
+	  }
+	}
+      }
+      for (c=halo_start[t]; c<nhalo_total; c++) { /* RESET FOR THE NEXT */
+	halo_slot[halo_col[c]] = -1;
+      }
+    }
+    halo_start[ntile] = nhalo_total;
+    if (ntile == 1 || nboundary <= len_x / 4) {
+      break;
+    }
+    /* TOO MANY LONG LINKS: SAVING THEIR COLUMNS WOULD COST MORE THAN */
+    /* TILING SAVES, SO FILL THE MATRIX AS ONE TILE */
+    tile_width = len_x;
+    FREE (halo_start);
+    FREE (halo_col);
+    memset (boundary, 0, len_x*sizeof(int));
+  }
+  for (j=nboundary=0; j<len_x; j++) { /* NUMBER THE BOUNDARY COLUMNS */
+    boundary[j] = (boundary[j]) ? nboundary++ : -1;
+  }
+  CALLOC (boundary_h, (size_t) nboundary*(len_y+1)+1, LPOScore_T);
+  CALLOC (boundary_p, (size_t) nboundary*(len_y+1)+1, LPOScore_T);
+  CALLOC (boundary_g, (size_t) nboundary*(len_y+1)+1, LPOScore_T);
+
+
+  /* FLATTEN THE x-PREDECESSORS INTO LOCAL POSITIONS: */
+
+#define LOCAL_PRED_POSITION(XP) (((XP) >= t0) ? (XP)-t0 : -1-halo_slot[XP])
+
+  t_pad = (tile_width + AFFINE_BLOCK_COLUMNS-1) / AFFINE_BLOCK_COLUMNS * AFFINE_BLOCK_COLUMNS;
+  CALLOC (pred_pos, ntile*t_pad, int);
+  CALLOC (pred_score, ntile*t_pad, LPOScore_T);
+  CALLOC (x_code, ntile*t_pad, int);
+  CALLOC (multi_col, len_x+1, int);
+  CALLOC (extra_start, len_x+1, int);
+  for (j=0; j<len_x; j++) {
+    for (xl = x_left[j]->more; xl != NULL; xl = xl->more) {
+      nextra++;
+    }
+  }
+  CALLOC (extra_pos, nextra+1, int);
+  CALLOC (extra_score, nextra+1, LPOScore_T);
+  for (t=nextra=0; t<ntile; t++) {
+    t0 = t*tile_width;
+    for (c=halo_start[t]; c<halo_start[t+1]; c++) {
+      halo_slot[halo_col[c]] = c - halo_start[t];
+    }
+    /* PADDING COLUMNS POINT AT THE INITIAL COLUMN AND SCORE AS SYMBOL 0; */
+    /* THEY ARE COMPUTED BUT NEVER KEPT */
+    for (l=0; l<t_pad; l++) {
+      pred_pos[t*t_pad+l] = -1;
+    }
+    for (j=t0; j<len_x && j<t0+tile_width; j++) {
+      pred_pos[t*t_pad+j-t0] = LOCAL_PRED_POSITION (x_left[j]->ipos);
+      pred_score[t*t_pad+j-t0] = x_left[j]->score;
+      x_code[t*t_pad+j-t0] = seq_x[j].letter;
+      if (x_left[j]->more) {
+	multi_col[nmulti] = j;
+	extra_start[nmulti++] = nextra;
+	for (xl = x_left[j]->more; xl != NULL; xl = xl->more) {
+	  extra_pos[nextra] = LOCAL_PRED_POSITION (xl->ipos);
+	  extra_score[nextra++] = xl->score;
+	}
+      }
+    }
+    for (c=halo_start[t]; c<halo_start[t+1]; c++) {
+      halo_slot[halo_col[c]] = -1;
+    }
+  }
+  extra_start[nmulti] = nextra;
+#undef LOCAL_PRED_POSITION
+
+
+  /* FILL INITIAL ROW (-1) AND INITIAL COLUMN (-1), WHOLE: */
+
+  CALLOC (init_row_h, len_x+1, LPOScore_T);
+  CALLOC (init_row_p, len_x+1, LPOScore_T);
+  CALLOC (init_row_g, len_x+1, LPOScore_T);
+  h = init_row_h = &(init_row_h[1]);
+  p = init_row_p = &(init_row_p[1]);
+  g = init_row_g = &(init_row_g[1]);
+  h[-1] = 0;
+  g[-1] = init_state;
+  p[-1] = AFFINE_GAP_PENALTY (gap, init_state);
+  for (j=0; j<len_x; j++) {
+    h[j] = min_score;
+    for (xl = x_left[j]; xl != NULL; xl = xl->more) {
+      try_score = h[xl->ipos] + xl->score - p[xl->ipos];
+      if (try_score > h[j]) {
+	h[j] = try_score;
+	g[j] = AFFINE_GAP_NEXT (gap, g[xl->ipos]);
+      }
+    }
+    p[j] = AFFINE_GAP_PENALTY (gap, g[j]);
+    if ((b = boundary[j]) >= 0) {
+      boundary_h[(size_t) b*(len_y+1)] = h[j];
+      boundary_p[(size_t) b*(len_y+1)] = p[j];
+      boundary_g[(size_t) b*(len_y+1)] = g[j];
+    }
+  }
+
+  CALLOC (init_col_h, len_y+1, LPOScore_T);
+  CALLOC (init_col_p, len_y+1, LPOScore_T);
+  CALLOC (init_col_g, len_y+1, LPOScore_T);
+  h = init_col_h = &(init_col_h[1]);
+  p = init_col_p = &(init_col_p[1]);
+  g = init_col_g = &(init_col_g[1]);
+  h[-1] = init_row_h[-1];
+  p[-1] = init_row_p[-1];
+  g[-1] = init_row_g[-1];
+  for (i=0; i<len_y; i++) { /* y-INSERTIONS ONLY */
+    h[i] = min_score;
+    for (yl = y_left[i]; yl != NULL; yl = yl->more) {
+      try_score = h[yl->ipos] + yl->score - p[yl->ipos];
+      if (try_score > h[i]) {
+	h[i] = try_score;
+	g[i] = AFFINE_GAP_NEXT (gap, g[yl->ipos]);
+      }
+    }
+    p[i] = AFFINE_GAP_PENALTY (gap, g[i]);
+  }
+
+
+  /** MAIN DYNAMIC PROGRAMMING LOOP **/
+
+  CALLOC (move, len_y, LPOMoveRow_T);
+  for (i=0; i<len_y; i++) { /* ROOM FOR THE LAST TILE'S PADDING */
+    init_lpo_move_row (&move[i], 0, (ntile-1)*tile_width + t_pad-1);
+  }
+  CALLOC (h_row, len_y+1, LPOScore_T *);
+  CALLOC (p_row, len_y+1, LPOScore_T *);
+  CALLOC (g_row, len_y+1, LPOScore_T *);
+  h_row = &(h_row[1]);
+  p_row = &(p_row[1]);
+  g_row = &(g_row[1]);
+  CALLOC (refs, len_y, int);
+
+  match_start = (use_global_alignment) ? min_score : 0;
+  for (t=0, k=0; t<ntile; t++) {
+    t0 = t*tile_width;
+    t_len = (len_x-t0 < tile_width) ? len_x-t0 : tile_width;
+    nhalo = halo_start[t+1] - halo_start[t];
+    seg_size = nhalo + t_pad;
+    memcpy (refs, refs_from_right_y, len_y*sizeof(int));
+
+    /* ROW i'S SEGMENT OF THIS TILE, STARTING WITH ITS HALO */
+    for (i=-1; i<len_y; i++) {
+
+      CALLOC (h_row[i], 3*seg_size, LPOScore_T);
+      h = h_row[i] = &(h_row[i][nhalo]);
+      p = p_row[i] = &(h[seg_size]);
+      g = g_row[i] = &(p[seg_size]);
+      h[-1] = init_col_h[i];
+      p[-1] = init_col_p[i];
+      g[-1] = init_col_g[i];
+      for (c=1; c<nhalo; c++) {
+	b = boundary[halo_col[halo_start[t]+c]];
+	h[-1-c] = boundary_h[(size_t) b*(len_y+1)+i+1];
+	p[-1-c] = boundary_p[(size_t) b*(len_y+1)+i+1];
+	g[-1-c] = boundary_g[(size_t) b*(len_y+1)+i+1];
+      }
+      if (i < 0) { /* THE INITIAL ROW IS ALREADY FILLED */
+	memcpy (h, init_row_h+t0, t_len*sizeof(LPOScore_T));
+	memcpy (p, init_row_p+t0, t_len*sizeof(LPOScore_T));
+	memcpy (g, init_row_g+t0, t_len*sizeof(LPOScore_T));
+	continue;
+      }
+
+      for (j=0; j<m->nsymbol; j++) { /* SCORES OF y-RESIDUE i */
+	row_profile[j] = m->score[j][(int) seq_y[i].letter];
+      }
+
+      for (j0=0, c=k; j0<t_len; j0+=AFFINE_BLOCK_COLUMNS) {
+
+	/* PASS 1: y-INSERTION AND MATCH CANDIDATES FROM EARLIER ROWS */
+	LOOPF (l,AFFINE_BLOCK_COLUMNS) {
+	  match_score[l] = match_start;
+	  match_x[l] = match_y[l] = 0;
+	  insert_y_score[l] = min_score;
+	  insert_y_y[l] = 0;
+	  insert_y_gap[l] = 0;
+	}
+	for (ycount = 1, yl = y_left[i]; yl != NULL; ycount++, yl = yl->more) {
+	  prev_h = h_row[yl->ipos];
+	  prev_p = p_row[yl->ipos];
+	  prev_g = g_row[yl->ipos];
+	  y_link_score = yl->score;
+
+	  LOOPF (l,AFFINE_BLOCK_COLUMNS) { /* GATHER THE CELLS THEY COME FROM */
+	    from_h[l] = prev_h[j0+l];
+	    from_p[l] = prev_p[j0+l];
+	    from_g[l] = prev_g[j0+l];
+	    from_match[l] = prev_h[pred_pos[t*t_pad+j0+l]];
+	    link_score[l] = pred_score[t*t_pad+j0+l];
+	  }
+	  LOOPF (l,AFFINE_BLOCK_COLUMNS) {
+	    /* IMPROVE Y-INSERTION?: trace back to (i'=yl->ipos, j) */
+	    try_score = from_h[l] + y_link_score - from_p[l];
+	    is_better = (try_score > insert_y_score[l]);
+	    insert_y_score[l] = LANE_SELECT (is_better, try_score, insert_y_score[l]);
+	    insert_y_y[l] = LANE_SELECT (is_better, ycount, insert_y_y[l]);
+	    insert_y_gap[l] = LANE_SELECT (is_better, from_g[l], insert_y_gap[l]);
+
+	    /* IMPROVE XY-MATCH?: FIRST x-PREDECESSOR */
+	    try_score = from_match[l] + link_score[l] + y_link_score;
+	    is_better = (try_score > match_score[l]);
+	    match_score[l] = LANE_SELECT (is_better, try_score, match_score[l]);
+	    match_x[l] = LANE_SELECT (is_better, 1, match_x[l]);
+	    match_y[l] = LANE_SELECT (is_better, ycount, match_y[l]);
+	  }
+
+	  /* ... AND ANY OTHER x-PREDECESSORS OF THE BLOCK'S COLUMNS */
+	  for (b=c; b<nmulti && multi_col[b] < t0+j0+AFFINE_BLOCK_COLUMNS; b++) {
+	    l = multi_col[b] - t0 - j0;
+	    for (j=extra_start[b]; j<extra_start[b+1]; j++) {
+	      try_score = prev_h[extra_pos[j]] + extra_score[j] + y_link_score;
+	      if (try_score > match_score[l]) {
+		match_score[l] = try_score;
+		match_x[l] = j-extra_start[b]+2;
+		match_y[l] = ycount;
+	      }
+	    }
+	  }
+	}
+	LOOPF (l,AFFINE_BLOCK_COLUMNS) {
+	  match_score[l] += row_profile[x_code[t*t_pad+j0+l]];
+	  move_x[l] = move_y[l] = 0;
+	}
+
+	/* PASS 2: x-INSERTIONS ALONG THE ROW, AND THE CHOICE OF EACH CELL */
+	for (l=0; l<AFFINE_BLOCK_COLUMNS && j0+l<t_len; l++) {
+	  j = j0+l;  /* LOCAL POSITION; THE LETTER IS t0+j */
+
+	  insert_x_score = h[pred_pos[t*t_pad+j]] + pred_score[t*t_pad+j] - p[pred_pos[t*t_pad+j]];
+	  insert_x_x = 1;
+	  insert_x_gap = g[pred_pos[t*t_pad+j]];
+	  if (insert_x_score <= min_score) { /* NO IMPROVEMENT ON THE START */
+	    insert_x_score = min_score;
+	    insert_x_x = insert_x_gap = 0;
+	  }
+	  if (c < nmulti && multi_col[c] == t0+j) {
+	    for (b=extra_start[c]; b<extra_start[c+1]; b++) {
+	      try_score = h[extra_pos[b]] + extra_score[b] - p[extra_pos[b]];
+	      if (try_score > insert_x_score) {
+		insert_x_score = try_score;
+		insert_x_x = b-extra_start[c]+2;
+		insert_x_gap = g[extra_pos[b]];
+	      }
+	    }
+	    c++;
+	  }
+
+	  if (match_score[l] > insert_y_score[l] && match_score[l] > insert_x_score) {
+	    /* XY-MATCH */
+	    h[j] = match_score[l];
+	    g[j] = 0;
+	    move_x[l] = match_x[l];
+	    move_y[l] = match_y[l];
+	  }
+	  else if (insert_x_score > insert_y_score[l]) {
+	    /* X-INSERTION */
+	    h[j] = insert_x_score;
+	    g[j] = AFFINE_GAP_NEXT (gap, insert_x_gap);
+	    move_x[l] = insert_x_x;
+	    move_y[l] = 0;
+	  }
+	  else {
+	    /* Y-INSERTION */
+	    h[j] = insert_y_score[l];
+	    g[j] = AFFINE_GAP_NEXT (gap, insert_y_gap[l]);
+	    move_x[l] = 0;
+	    move_y[l] = insert_y_y[l];
+	  }
+	  p[j] = AFFINE_GAP_PENALTY (gap, g[j]);
+	  if ((b = boundary[t0+j]) >= 0) { /* NEEDED BY A LATER TILE */
+	    boundary_h[(size_t) b*(len_y+1)+i+1] = h[j];
+	    boundary_p[(size_t) b*(len_y+1)+i+1] = p[j];
+	    boundary_g[(size_t) b*(len_y+1)+i+1] = g[j];
+	  }
+
+	  /* RECORD BEST ALIGNMENT END FOR TRACEBACK; THE TIE-BREAK (MINIMUM */
+	  /* x, THEN y) DOES NOT DEPEND ON THE ORDER CELLS ARE FILLED IN: */
+	  possible_end_square = ((0 == use_global_alignment) || ((node_type_x[t0+j] & LPO_FINAL_NODE) && (node_type_y[i] & LPO_FINAL_NODE)));
+	  if (possible_end_square && h[j] >= best_score) {
+	    if (h[j] > best_score || (t0+j == best_x && i < best_y) || t0+j < best_x) {
+	      best_score = h[j];
+	      best_x = t0+j;
+	      best_y = i;
+	    }
+	  }
+	}
+
+	/* CODE THE BLOCK'S MOVES AND PACK THEM TWO PER BYTE (t0+j0 IS */
+	/* EVEN); THE RARE ONES THAT DO NOT FIT GO TO THE SIDE TABLE */
+	is_better = 0;
+	LOOPF (l,AFFINE_BLOCK_COLUMNS) {
+	  move_fits[l] = LPO_MOVE_FITS (move_x[l], move_y[l]);
+	  move_code[l] = LANE_SELECT (move_fits[l], move_x[l] | (move_y[l] << 3), LPO_MOVE_SIDE);
+	  is_better |= !move_fits[l];
+	}
+	if (is_better) {
+	  LOOPF (l,AFFINE_BLOCK_COLUMNS) {
+	    if (!move_fits[l]) {
+	      add_lpo_move_side (&move[i], t0+j0+l, move_x[l], move_y[l]);
+	    }
+	  }
+	}
+	move_row = &(move[i].code[(t0+j0)/2]);
+	LOOPF (l,AFFINE_BLOCK_COLUMNS/2) {
+	  move_row[l] = move_code[2*l] | (move_code[2*l+1] << 4);
+	}
+      }
+      Dp_cells_computed += t_len;
+
+      /* UPDATE # OF REFS TO ROWS; FREE MEMORY WHEN POSSIBLE: */
+      for (yl = y_left[i]; yl != NULL; yl = yl->more) if ((j = yl->ipos) >= 0) {
+	if ((--refs[j]) == 0) {
+	  h_row[j] = &(h_row[j][-nhalo]);
+	  FREE (h_row[j]);
+	}
+      }
+      if (refs[i] == 0) {
+	h_row[i] = &(h_row[i][-nhalo]);
+	FREE (h_row[i]);
+      }
+    }
+    k = c;  /* FIRST MULTI-LINK COLUMN OF THE NEXT TILE */
+    h_row[-1] = &(h_row[-1][-nhalo]);
+    FREE (h_row[-1]);
+  }
+
+  IF_GUARD(best_x>=len_x || best_y>=len_y,1.1,(ERRTXT,"Bounds exceeded!\nbest_x,best_y:%d,%d\tlen:%d,%d\n",best_x,best_y,len_x,len_y),CRASH);
+
+  trace_back_lpo_alignment (len_x, len_y, move, x_left, y_left,
+			    best_x, best_y,
+			    x_to_y, y_to_x);
+
+
+  /* CLEAN UP AND RETURN: */
+
+  FREE (node_type_x);
+  FREE (node_type_y);
+  FREE (refs_from_right_x);
+  FREE (refs_from_right_y);
+  FREE (refs);
+
+  halo_slot = &(halo_slot[-1]);
+  FREE (halo_slot);
+  FREE (halo_start);
+  FREE (halo_col);
+  FREE (boundary);
+  FREE (boundary_h);
+  FREE (boundary_p);
+  FREE (boundary_g);
+
+  FREE (pred_pos);
+  FREE (pred_score);
+  FREE (x_code);
+  FREE (multi_col);
+  FREE (extra_start);
+  FREE (extra_pos);
+  FREE (extra_score);
+
+  init_row_h = &(init_row_h[-1]);
+  FREE (init_row_h);
+  init_row_p = &(init_row_p[-1]);
+  FREE (init_row_p);
+  init_row_g = &(init_row_g[-1]);
+  FREE (init_row_g);
+  init_col_h = &(init_col_h[-1]);
+  FREE (init_col_h);
+  init_col_p = &(init_col_p[-1]);
+  FREE (init_col_p);
+  init_col_g = &(init_col_g[-1]);
+  FREE (init_col_g);
+
+  h_row = &(h_row[-1]);
+  FREE (h_row);
+  p_row = &(p_row[-1]);
+  FREE (p_row);
+  g_row = &(g_row[-1]);
+  FREE (g_row);
+
+  for (i=0; i<len_x; i++) {
+    if (x_left[i] != &seq_x[i].left) {
+      FREE (x_left[i]);
+    }
+  }
+  FREE (x_left);
+
   for (i=0; i<len_y; i++) {
-    FREE (move[i]);
+    if (y_left[i] != &seq_y[i].left) {
+      FREE (y_left[i]);
+    }
   }
+  FREE (y_left);
+
+  free_lpo_move_rows (len_y, move, TRUE);
   FREE (move);
 
   return best_score;
 }
+
+
+/** (align_lpo_po:)
+    performs partial order alignment:
+    lposeq_x and lposeq_y are partial orders;
+    returns the alignment in x_to_y[] and y_to_x[], and also
+    returns the alignment score as the return value.
+    If scoring_function is NULL, residues are scored straight from the
+    matrix m, using a packed 4-symbol kernel for nucleotide inputs and a
+    per-row score profile otherwise.
+    For local alignment, a nonzero m->drop_score turns on X-drop: once
+    the best score exceeds drop_score, each row is only computed over the
+    columns still within drop_score of the best score (widened by the
+    gap extension cost off the best diagonal if m->use_zdrop is set);
+    rows left with no such column end their branch of the alignment.
+    If m->region_end > m->region_start, only the letters of lposeq_x
+    between those positions of its first source sequence are aligned
+    (see find_lpo_region() and align_lpo_po_window()).
+    If m->anchor_kmer_length is set and lposeq_y is a single sequence,
+    exact k-mer matches chained between y and the paths of x restrict
+    the DP to the gaps between anchors (see find_lpo_anchor_bands());
+    with no usable anchors, or a banded global alignment that cannot
+    connect, the full matrix is computed instead.
+    The full matrix is filled by fill_lpo_po_affine() when no scoring
+    function or X-drop is used and the gap penalties are one- or two-piece
+    affine (see get_affine_gap_shape()), with the same result.
+    set_lpo_kernel() can force one of these kernels, for testing.
+*/
+
+LPOScore_T align_lpo_po (LPOSequence_T *lposeq_x,
+			 LPOSequence_T *lposeq_y,
+			 ResidueScoreMatrix_T *m,
+			 LPOLetterRef_T **x_to_y,
+			 LPOLetterRef_T **y_to_x,
+			 LPOScore_T (*scoring_function)
+			 (int, int, LPOLetter_T *, LPOLetter_T *, ResidueScoreMatrix_T *),
+			 int use_global_alignment)
+{
+  int *band_lo = NULL, *band_hi = NULL, window_start, window_end;
+  LPOScore_T score;
+  DPAffineGap_T gap;
+
+  if (m->region_end > m->region_start) {
+    window_start = m->region_hint_start; /* WHERE THE LAST CALL FOUND IT */
+    window_end = m->region_hint_end;
+    if (find_lpo_region (lposeq_x, 0, m->region_start, m->region_end,
+			 &window_start, &window_end) > 0) {
+      m->region_hint_start = window_start;
+      m->region_hint_end = window_end;
+      if (window_start > 0 || window_end < lposeq_x->length) {
+	return align_lpo_po_window (lposeq_x, window_start, window_end, lposeq_y,
+				    m, x_to_y, y_to_x, scoring_function,
+				    use_global_alignment);
+      }
+    }
+  }
+
+  if (m->anchor_kmer_length > 0
+      && find_lpo_anchor_bands (lposeq_x, lposeq_y, m->anchor_kmer_length,
+				&band_lo, &band_hi) > 0) {
+    score = fill_lpo_po_alignment (lposeq_x, lposeq_y, m, x_to_y, y_to_x,
+				   scoring_function, use_global_alignment,
+				   band_lo, band_hi);
+    FREE (band_lo);
+    FREE (band_hi);
+    if (0 == use_global_alignment || score > DP_MIN_SCORE/2) {
+      return score;
+    }
+    if (x_to_y) { /* ANCHORS LEFT NO GLOBAL PATH: REDO WITHOUT THEM */
+      FREE (*x_to_y);
+    }
+    if (y_to_x) {
+      FREE (*y_to_x);
+    }
+  }
+
+  if (scoring_function == NULL && Lpo_kernel == lpo_kernel_scalar) {
+    scoring_function = score_lpo_letters;
+  }
+  if (scoring_function == NULL
+      && (Lpo_kernel == lpo_kernel_auto || Lpo_kernel == lpo_kernel_affine)
+      && (use_global_alignment || m->drop_score <= 0)
+      && get_affine_gap_shape (m, &gap)) {
+    return fill_lpo_po_affine (lposeq_x, lposeq_y, m, &gap, x_to_y, y_to_x,
+			       use_global_alignment);
+  }
+  return fill_lpo_po_alignment (lposeq_x, lposeq_y, m, x_to_y, y_to_x,
+				scoring_function, use_global_alignment,
+				NULL, NULL);
+}
+
+
+/** copies the links of the list from that lie in window_start..
+    window_end-1 to the list to, shifted to window indices */
+static void copy_window_links (LPOLetterLink_T *to, LPOLetterLink_T *from,
+			       int window_start, int window_end)
+{
+  LPOLetterLink_T *last = NULL;
+
+  to->ipos = INVALID_LETTER_POSITION;
+  to->more = NULL;
+  for (; from != NULL && from->ipos >= 0; from = from->more) {
+    if (from->ipos < window_start || from->ipos >= window_end) {
+      continue;
+    }
+    if (last == NULL) {
+      last = to;
+    }
+    else {
+      CALLOC (last->more, 1, LPOLetterLink_T);
+      last = last->more;
+    }
+    last->ipos = from->ipos - window_start;
+    last->score = from->score;
+  }
+}
+
+
+/** index of the letter of lposeq holding position ipos of source iseq,
+    searching from letter hint up (fusion only moves letters to higher
+    indices) and then from 0 up to hint; -1 if no letter holds it */
+static int find_source_letter (LPOSequence_T *lposeq, int iseq, int ipos,
+			       int hint)
+{
+  int i, n;
+  LPOLetterSource_T *src;
+
+  if (hint < 0 || hint >= lposeq->length) {
+    hint = 0;
+  }
+  for (n=0, i=hint; n<lposeq->length; n++, i = (i+1 < lposeq->length) ? i+1 : 0) {
+    for (src = &lposeq->letter[i].source; src != NULL && src->iseq >= 0; src = src->more) {
+      if (src->iseq == iseq) {
+	if (src->ipos == ipos) {
+	  return i;
+	}
+	break;
+      }
+    }
+  }
+  return -1;
+}
+
+
+/** finds the letters of lposeq that hold positions start..end-1 of its
+    source sequence iseq, and returns in *window_start and *window_end
+    the range of letter indices (topological ranks) from the first to the
+    last of them.  Every path of lposeq between those two letters lies
+    inside this range.  Returns the length of the range, or 0 if iseq
+    has no position there.
+    On entry *window_start and *window_end are where to start looking
+    (e.g. the range found in lposeq before its last fusion, or 0): the
+    letters of positions start and end-1 are searched for from there,
+    which costs little more than the letters added since.  Only if one
+    of them is missing (pruned) is every letter of lposeq scanned. */
+int find_lpo_region (LPOSequence_T *lposeq, int iseq, int start, int end,
+		     int *window_start, int *window_end)
+{
+  int i, first, last;
+  LPOLetterSource_T *src;
+
+  first = *window_start;
+  last = *window_end - 1;
+  *window_start = lposeq->length;
+  *window_end = 0;
+  if (iseq < 0 || iseq >= lposeq->nsource_seq) {
+    return 0;
+  }
+  if (end > lposeq->source_seq[iseq].length) {
+    end = lposeq->source_seq[iseq].length;
+  }
+  if (start >= end) {
+    return 0;
+  }
+  /* iseq IS ONE PATH, SO ITS LETTERS ARE IN POSITION ORDER */
+  first = find_source_letter (lposeq, iseq, start, first);
+  last = (first < 0) ? -1 : find_source_letter (lposeq, iseq, end-1, (last > first) ? last : first);
+  if (last >= first && first >= 0) {
+    *window_start = first;
+    *window_end = last + 1;
+    return *window_end - *window_start;
+  }
+  for (i=0; i<lposeq->length; i++) {
+    for (src = &lposeq->letter[i].source; src != NULL && src->iseq >= 0; src = src->more) {
+      if (src->iseq == iseq && src->ipos >= start && src->ipos < end) {
+	if (i < *window_start) {
+	  *window_start = i;
+	}
+	*window_end = i + 1;
+	break;
+      }
+    }
+  }
+  return (*window_end > *window_start) ? *window_end - *window_start : 0;
+}
+
+
+/** (align_lpo_po_window:)
+    aligns lposeq_y to the part of lposeq_x induced by its letters
+    window_start..window_end-1, as align_lpo_po() would align it to that
+    subgraph on its own: links into or out of the window are dropped,
+    the window's first letters may start a global alignment and its last
+    letters end one.  Only the window's letters are copied and scored, so
+    the cost follows the size of the window rather than of lposeq_x; for
+    a known anchor letter a, pass e.g. a-w..a+w+1.
+    x_to_y still covers all of lposeq_x (letters outside the window are
+    left unaligned) and y_to_x holds lposeq_x indices, so both can be
+    passed to fuse_lpo() as they are.  An empty window aligns to all of
+    lposeq_x.
+*/
+
+LPOScore_T align_lpo_po_window (LPOSequence_T *lposeq_x,
+				int window_start, int window_end,
+				LPOSequence_T *lposeq_y,
+				ResidueScoreMatrix_T *m,
+				LPOLetterRef_T **x_to_y,
+				LPOLetterRef_T **y_to_x,
+				LPOScore_T (*scoring_function)
+				(int, int, LPOLetter_T *, LPOLetter_T *, ResidueScoreMatrix_T *),
+				int use_global_alignment)
+{
+  int i, len;
+  LPOSequence_T window;
+  LPOLetterRef_T *window_x_to_y = NULL;
+  LPOLetter_T *letter;
+  LPOScore_T score;
+
+  if (window_start < 0) {
+    window_start = 0;
+  }
+  if (window_end > lposeq_x->length) {
+    window_end = lposeq_x->length;
+  }
+  len = window_end - window_start;
+  if (len <= 0) { /* NOTHING TO RESTRICT TO: USE THE WHOLE GRAPH */
+    return align_lpo_po (lposeq_x, lposeq_y, m, x_to_y, y_to_x,
+			 scoring_function, use_global_alignment);
+  }
+
+  memset (&window, 0, sizeof(window)); /* NO SOURCE SEQS: SEE get_lpo_stats() */
+  window.length = len;
+  strcpy (window.name, lposeq_x->name);
+  CALLOC (window.letter, len, LPOLetter_T);
+  for (i=0; i<len; i++) {
+    letter = lposeq_x->letter + window_start + i;
+    window.letter[i].letter = letter->letter;
+    window.letter[i].score = letter->score;
+    window.letter[i].align_ring = window.letter[i].ring_id = i;
+    window.letter[i].source.ipos = window.letter[i].source.iseq
+      = INVALID_LETTER_POSITION;
+    copy_window_links (&window.letter[i].left, &letter->left,
+		       window_start, window_end);
+    copy_window_links (&window.letter[i].right, &letter->right,
+		       window_start, window_end);
+  }
+
+  score = align_lpo_po (&window, lposeq_y, m, &window_x_to_y, y_to_x,
+			scoring_function, use_global_alignment);
+
+  if (y_to_x) { /* BACK TO lposeq_x INDICES */
+    for (i=0; i<lposeq_y->length; i++) {
+      if ((*y_to_x)[i] >= 0) {
+	(*y_to_x)[i] += window_start;
+      }
+    }
+  }
+  if (x_to_y) {
+    CALLOC (*x_to_y, lposeq_x->length, LPOLetterRef_T);
+    for (i=0; i<lposeq_x->length; i++) {
+      (*x_to_y)[i] = (i >= window_start && i < window_end)
+	? window_x_to_y[i - window_start] : INVALID_LETTER_POSITION;
+    }
+  }
+  FREE (window_x_to_y);
+  free_lpo_letters (len, window.letter, TRUE);
+  return score;
+}
+
+
+/** TRUE IF align_lpo_po_batch() CAN RUN x AGAINST lposeq_y IN A LANE:
+    lposeq_y MUST BE ONE LINEAR SEQUENCE, AND NEITHER X-DROP, k-MER
+    ANCHORING NOR A -region MAY APPLY (THEY PRUNE EACH PROBLEM'S MATRIX DIFFERENTLY) */
+static int fits_batch_lane (LPOSequence_T *lposeq_y, ResidueScoreMatrix_T *m,
+			    int use_global_alignment)
+{
+  int i;
+
+  if (m->anchor_kmer_length > 0 || m->region_end > m->region_start
+      || (0 == use_global_alignment && m->drop_score > 0)
+      || lposeq_y->nsource_seq != 1) {
+    return FALSE;
+  }
+  for (i=0; i<lposeq_y->length; i++) {
+    if (lposeq_y->letter[i].left.ipos != i-1 || lposeq_y->letter[i].left.more) {
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+
+/** fills the DP matrices of nlane (<= LPO_BATCH_LANES) problems at once,
+    lposeq_x[l] against the linear sequence lposeq_y[l], and traces back
+    each lane's best alignment exactly as fill_lpo_po_alignment() would.
+    Every DP array is lane-major (cell j of lane l at [j*LPO_BATCH_LANES+l]),
+    so each step is a fixed-length loop over the lanes: the scores of a
+    column's x-predecessors are first gathered into lane order, and the
+    match, insertion and move choices are then made without branches, so
+    the compiler can turn them into vector instructions.  A lane's
+    x-predecessors are padded with a dead column up to the most any lane
+    has at that column; rows and columns past a lane's own lengths are
+    computed but never read back. */
+static void fill_lpo_po_batch (int nlane,
+			       LPOSequence_T *lposeq_x[],
+			       LPOSequence_T *lposeq_y[],
+			       ResidueScoreMatrix_T *m,
+			       LPOLetterRef_T *x_to_y[],
+			       LPOLetterRef_T *y_to_x[],
+			       LPOScore_T score[],
+			       int use_global_alignment)
+{
+  int len_x[LPO_BATCH_LANES], len_y[LPO_BATCH_LANES];
+  int *node_type_x[LPO_BATCH_LANES], *node_type_y[LPO_BATCH_LANES];
+  int *refs_from_right, n_edges, max_rows_alloced;
+  LPOLetterLink_T **x_left[LPO_BATCH_LANES], **y_left[LPO_BATCH_LANES], *xl;
+  unsigned char *move_code = NULL;
+  LPOMoveRow_T *lane_move = NULL;
+
+  int i, j, k, l, c, pc, nx = 0, ny = 0, ncol, npred, dead_col;
+  int *pred_start = NULL, *pred_col = NULL, *x_code = NULL, *x_end = NULL;
+  LPOScore_T *pred_score = NULL;
+
+  /* TWO 'SCORE' ROWS, AND WITH EACH CELL THE COST OF EXTENDING ITS GAPS */
+  LPOScore_T *prev_score = NULL, *curr_score = NULL, *prev_pen_y = NULL, *curr_pen_x = NULL, *curr_pen_y = NULL;
+  int *prev_gap_x = NULL, *prev_gap_y = NULL, *curr_gap_x = NULL, *curr_gap_y = NULL;
+  LPOScore_T *swap_score;
+  int *swap_gap;
+
+  int max_gap_length = m->max_gap_length;
+  LPOScore_T *gap_penalty_x = m->gap_penalty_x, *gap_penalty_y = m->gap_penalty_y;
+  int *next_gap_array, *next_perp_gap_array;
+
+  LPOScore_T min_score = DP_MIN_SCORE, start_score, try_score;
+  LPOScore_T best_score[LPO_BATCH_LANES], init_score[LPO_BATCH_LANES], y_link[LPO_BATCH_LANES];
+  int best_x[LPO_BATCH_LANES], best_y[LPO_BATCH_LANES];
+  int init_gap_x[LPO_BATCH_LANES], init_gap_y[LPO_BATCH_LANES];
+  int y_code[LPO_BATCH_LANES], y_end[LPO_BATCH_LANES];
+  LPOScore_T from_prev[LPO_BATCH_LANES], from_curr[LPO_BATCH_LANES], link_score[LPO_BATCH_LANES];
+  int from_gap[LPO_BATCH_LANES];
+  LPOScore_T match_score[LPO_BATCH_LANES], insert_x_score[LPO_BATCH_LANES], insert_y_score[LPO_BATCH_LANES];
+  int match_x[LPO_BATCH_LANES], insert_x_x[LPO_BATCH_LANES], insert_x_gap[LPO_BATCH_LANES];
+  int insert_y_y[LPO_BATCH_LANES], insert_y_gap[LPO_BATCH_LANES];
+  LPOScore_T my_score[LPO_BATCH_LANES];
+  int my_gap_x[LPO_BATCH_LANES], my_gap_y[LPO_BATCH_LANES];
+  int move_x[LPO_BATCH_LANES], move_y[LPO_BATCH_LANES];
+  int is_match, is_insert_x, is_best, my_gap, next_gap, next_perp_gap;
+  int initial_next_gap, initial_next_perp_gap;
+
+  init_gap_arrays (m, use_global_alignment, &next_gap_array, &next_perp_gap_array);
+  initial_next_gap = next_gap_array[max_gap_length+1];
+  initial_next_perp_gap = next_perp_gap_array[max_gap_length+1];
+  start_score = (use_global_alignment) ? min_score : 0;
+
+  /* PER-LANE GRAPH STATS; UNUSED LANES GET AN EMPTY PROBLEM */
+  LOOPF (l,LPO_BATCH_LANES) {
+    len_x[l] = len_y[l] = 0;
+    if (l >= nlane) {
+      continue;
+    }
+    get_lpo_stats (lposeq_x[l], &len_x[l], &n_edges, &node_type_x[l], &refs_from_right, &max_rows_alloced, &x_left[l]);
+    FREE (refs_from_right);
+    get_lpo_stats (lposeq_y[l], &len_y[l], &n_edges, &node_type_y[l], &refs_from_right, &max_rows_alloced, &y_left[l]);
+    FREE (refs_from_right);
+    if (len_x[l] > nx) {
+      nx = len_x[l];
+    }
+    if (len_y[l] > ny) {
+      ny = len_y[l];
+    }
+    best_score[l] = min_score;
+    best_x[l] = best_y[l] = -1;
+    Dp_cells_computed += (double) len_x[l] * len_y[l];
+  }
+
+  /* COLUMN 0 HOLDS THE INITIAL COLUMN (-1), COLUMN j+1 x-RESIDUE j, AND */
+  /* COLUMN nx+1 IS DEAD: THE PREDECESSOR THAT PADS SHORTER LISTS. */
+  /* x_end[] MARKS THE CELLS WHERE AN ALIGNMENT MAY END (IF y ALLOWS). */
+  ncol = nx + 2;
+  dead_col = nx + 1;
+  CALLOC (pred_start, nx + 1, int);
+  CALLOC (x_code, nx * LPO_BATCH_LANES + 1, int);
+  CALLOC (x_end, nx * LPO_BATCH_LANES + 1, int);
+  for (j=0; j<nx; j++) {
+    npred = 0;
+    LOOPF (l,LPO_BATCH_LANES) {
+      if (j < len_x[l]) {
+	for (k = 0, xl = x_left[l][j]; xl != NULL; k++, xl = xl->more);
+	if (k > npred) {
+	  npred = k;
+	}
+	x_code[j*LPO_BATCH_LANES + l] = lposeq_x[l]->letter[j].letter;
+	x_end[j*LPO_BATCH_LANES + l] = (0 == use_global_alignment || (node_type_x[l][j] & LPO_FINAL_NODE));
+      }
+    }
+    pred_start[j+1] = pred_start[j] + npred;
+  }
+  CALLOC (pred_col, pred_start[nx] * LPO_BATCH_LANES + 1, int);
+  CALLOC (pred_score, pred_start[nx] * LPO_BATCH_LANES + 1, LPOScore_T);
+  for (j=0; j<nx; j++) {
+    LOOPF (l,LPO_BATCH_LANES) {
+      xl = (j < len_x[l]) ? x_left[l][j] : NULL;
+      for (k=pred_start[j]; k<pred_start[j+1]; k++) {
+	pred_col[k*LPO_BATCH_LANES + l] = (xl ? xl->ipos + 1 : dead_col) * LPO_BATCH_LANES + l;
+	pred_score[k*LPO_BATCH_LANES + l] = xl ? xl->score : 0;
+	if (xl) {
+	  xl = xl->more;
+	}
+      }
+    }
+  }
+
+  /* 'MOVE' MATRICES: ONE LANE-MAJOR BLOCK OF CODES, CELL (i,j) OF LANE */
+  /* l AT NIBBLE (i*nx+j)*LPO_BATCH_LANES+l; ROW i OF LANE l'S MATRIX IS */
+  /* lane_move[l*ny+i] */
+  CALLOC (move_code, ((size_t) ny * nx * LPO_BATCH_LANES + 1) / 2 + 1, unsigned char);
+  CALLOC (lane_move, ny * LPO_BATCH_LANES + 1, LPOMoveRow_T);
+  LOOPF (l,LPO_BATCH_LANES) {
+    for (i=0; i<ny; i++) {
+      lane_move[l*ny+i].code = move_code;
+      lane_move[l*ny+i].first = i * nx * LPO_BATCH_LANES + l;
+      lane_move[l*ny+i].stride = LPO_BATCH_LANES;
+    }
+  }
+  CALLOC (prev_score, ncol * LPO_BATCH_LANES, LPOScore_T);
+  CALLOC (curr_score, ncol * LPO_BATCH_LANES, LPOScore_T);
+  CALLOC (prev_pen_y, ncol * LPO_BATCH_LANES, LPOScore_T);
+  CALLOC (curr_pen_x, ncol * LPO_BATCH_LANES, LPOScore_T);
+  CALLOC (curr_pen_y, ncol * LPO_BATCH_LANES, LPOScore_T);
+  CALLOC (prev_gap_x, ncol * LPO_BATCH_LANES, int);
+  CALLOC (prev_gap_y, ncol * LPO_BATCH_LANES, int);
+  CALLOC (curr_gap_x, ncol * LPO_BATCH_LANES, int);
+  CALLOC (curr_gap_y, ncol * LPO_BATCH_LANES, int);
+  LOOPF (l,LPO_BATCH_LANES) { /* NOTHING CAN BE REACHED THROUGH THE DEAD COLUMN */
+    prev_score[dead_col*LPO_BATCH_LANES + l] = curr_score[dead_col*LPO_BATCH_LANES + l] = 2*DP_MIN_SCORE;
+  }
+
+
+  /* FILL INITIAL ROW (-1), INTO curr_score. */
+  /* GAP LENGTH = M+1 IS USED FOR INITIAL STATE. */
+
+  LOOPF (l,LPO_BATCH_LANES) {
+    curr_score[l] = init_score[l] = 0;
+    curr_gap_x[l] = curr_gap_y[l] = init_gap_x[l] = init_gap_y[l] = max_gap_length+1;
+    curr_pen_x[l] = gap_penalty_x[max_gap_length+1];
+    curr_pen_y[l] = gap_penalty_y[max_gap_length+1];
+  }
+  for (j=0; j<nx; j++) {
+    c = (j+1) * LPO_BATCH_LANES;
+    LOOPF (l,LPO_BATCH_LANES) {
+      curr_score[c+l] = min_score;
+      curr_gap_x[c+l] = curr_gap_y[c+l] = 0;
+      for (k=pred_start[j]; k<pred_start[j+1]; k++) {
+	pc = pred_col[k*LPO_BATCH_LANES + l];
+	try_score = curr_score[pc] + pred_score[k*LPO_BATCH_LANES + l] - curr_pen_x[pc];
+	if (try_score > curr_score[c+l]) {
+	  curr_score[c+l] = try_score;
+	  curr_gap_x[c+l] = next_gap_array[curr_gap_x[pc]];
+	  curr_gap_y[c+l] = next_perp_gap_array[curr_gap_x[pc]];
+	}
+      }
+      curr_pen_x[c+l] = gap_penalty_x[curr_gap_x[c+l]];
+      curr_pen_y[c+l] = gap_penalty_y[curr_gap_y[c+l]];
+    }
+  }
+
+
+  /** MAIN DYNAMIC PROGRAMMING LOOP **/
+
+
+  /* OUTER LOOP (i-th position in every lane's y): */
+  for (i=0; i<ny; i++) {
+
+    swap_score = prev_score; prev_score = curr_score; curr_score = swap_score;
+    swap_score = prev_pen_y; prev_pen_y = curr_pen_y; curr_pen_y = swap_score;
+    swap_gap = prev_gap_x; prev_gap_x = curr_gap_x; curr_gap_x = swap_gap;
+    swap_gap = prev_gap_y; prev_gap_y = curr_gap_y; curr_gap_y = swap_gap;
+
+    /* NEXT CELL OF THE INITIAL COLUMN, AND y-RESIDUE i OF EACH LANE: */
+    LOOPF (l,LPO_BATCH_LANES) {
+      if (i < len_y[l]) {
+	y_code[l] = lposeq_y[l]->letter[i].letter;
+	y_link[l] = lposeq_y[l]->letter[i].left.score;
+	y_end[l] = (0 == use_global_alignment || (node_type_y[l][i] & LPO_FINAL_NODE));
+      }
+      else {
+	y_code[l] = y_link[l] = y_end[l] = 0;
+      }
+
+      try_score = init_score[l] + y_link[l] - gap_penalty_y[init_gap_y[l]];
+      if (try_score > min_score) {
+	init_score[l] = try_score;
+	init_gap_x[l] = next_perp_gap_array[init_gap_y[l]];
+	init_gap_y[l] = next_gap_array[init_gap_y[l]];
+      }
+      else {
+	init_score[l] = min_score;
+	init_gap_x[l] = init_gap_y[l] = 0;
+      }
+      curr_score[l] = init_score[l];
+      curr_gap_x[l] = init_gap_x[l];
+      curr_gap_y[l] = init_gap_y[l];
+      curr_pen_x[l] = gap_penalty_x[init_gap_x[l]];
+      curr_pen_y[l] = gap_penalty_y[init_gap_y[l]];
+    }
+
+    /* INNER LOOP (j-th position in every lane's x): */
+    for (j=0; j<nx; j++) {
+      c = (j+1) * LPO_BATCH_LANES;
+
+      /* IMPROVE Y-INSERTION?: THE ONLY y-PREDECESSOR IS ROW i-1 */
+      LOOPF (l,LPO_BATCH_LANES) {
+	try_score = prev_score[c+l] + y_link[l] - prev_pen_y[c+l];
+	my_gap = prev_gap_y[c+l];
+	insert_y_y[l] = (try_score > min_score);
+	insert_y_score[l] = LANE_SELECT (insert_y_y[l], try_score, min_score);
+	insert_y_gap[l] = LANE_SELECT (insert_y_y[l], my_gap, 0);
+	match_score[l] = start_score;
+	match_x[l] = 0;
+	insert_x_score[l] = min_score;
+	insert_x_x[l] = insert_x_gap[l] = 0;
+      }
+
+      /* LOOP OVER x-predecessors, IN EVERY LANE: */
+      for (k=pred_start[j]; k<pred_start[j+1]; k++) {
+	LOOPF (l,LPO_BATCH_LANES) { /* GATHER THEIR CELLS INTO LANE ORDER */
+	  pc = pred_col[k*LPO_BATCH_LANES + l];
+	  from_prev[l] = prev_score[pc];
+	  from_curr[l] = curr_score[pc] - curr_pen_x[pc];
+	  from_gap[l] = curr_gap_x[pc];
+	  link_score[l] = pred_score[k*LPO_BATCH_LANES + l];
+	}
+	LOOPF (l,LPO_BATCH_LANES) {
+	  /* IMPROVE XY-MATCH?: trace back to (i-1, j'=xl->ipos) */
+	  try_score = from_prev[l] + link_score[l] + y_link[l];
+	  is_match = (try_score > match_score[l]);
+	  match_score[l] = LANE_SELECT (is_match, try_score, match_score[l]);
+	  match_x[l] = LANE_SELECT (is_match, k - pred_start[j] + 1, match_x[l]);
+
+	  /* IMPROVE X-INSERTION?: trace back to (i, j'=xl->ipos) */
+	  try_score = from_curr[l] + link_score[l];
+	  is_insert_x = (try_score > insert_x_score[l]);
+	  insert_x_score[l] = LANE_SELECT (is_insert_x, try_score, insert_x_score[l]);
+	  insert_x_x[l] = LANE_SELECT (is_insert_x, k - pred_start[j] + 1, insert_x_x[l]);
+	  insert_x_gap[l] = LANE_SELECT (is_insert_x, from_gap[l], insert_x_gap[l]);
+	}
+      }
+
+      LOOPF (l,LPO_BATCH_LANES) {
+	match_score[l] += m->score[x_code[j*LPO_BATCH_LANES + l]][y_code[l]];
+      }
+
+      LOOPF (l,LPO_BATCH_LANES) {
+	/* XY-MATCH, ELSE X-INSERTION, ELSE Y-INSERTION: */
+	is_match = (match_score[l] > insert_y_score[l]) & (match_score[l] > insert_x_score[l]);
+	is_insert_x = (1 - is_match) & (insert_x_score[l] > insert_y_score[l]);
+	my_score[l] = LANE_SELECT (is_match, match_score[l],
+				   LANE_SELECT (is_insert_x, insert_x_score[l], insert_y_score[l]));
+	my_gap = LANE_SELECT (is_insert_x, insert_x_gap[l], insert_y_gap[l]);
+	next_gap = LANE_SELECT (my_gap < max_gap_length, my_gap+1,
+				LANE_SELECT (my_gap == max_gap_length, my_gap, initial_next_gap));
+	next_perp_gap = LANE_SELECT (my_gap > max_gap_length, initial_next_perp_gap,
+				     DOUBLE_GAP_SCORING ? 0 : next_gap);
+	my_gap_x[l] = LANE_SELECT (is_match, 0, LANE_SELECT (is_insert_x, next_gap, next_perp_gap));
+	my_gap_y[l] = LANE_SELECT (is_match, 0, LANE_SELECT (is_insert_x, next_perp_gap, next_gap));
+	move_x[l] = LANE_SELECT (is_match, match_x[l], LANE_SELECT (is_insert_x, insert_x_x[l], 0));
+	move_y[l] = LANE_SELECT (is_match, match_x[l] > 0, LANE_SELECT (is_insert_x, 0, insert_y_y[l]));
+
+	/* RECORD BEST ALIGNMENT END; BREAK TIES BY MINIMUM (x,y), WHICH */
+	/* IN THIS ROW-BY-ROW ORDER MEANS THE FIRST CELL OF MINIMUM x: */
+	is_best = x_end[j*LPO_BATCH_LANES + l] & y_end[l]
+	  & ((my_score[l] > best_score[l]) | ((my_score[l] == best_score[l]) & (j < best_x[l])));
+	best_score[l] = LANE_SELECT (is_best, my_score[l], best_score[l]);
+	best_x[l] = LANE_SELECT (is_best, j, best_x[l]);
+	best_y[l] = LANE_SELECT (is_best, i, best_y[l]);
+      }
+
+      LOOPF (l,nlane) { /* PACK THE MOVES INTO EACH LANE'S CODES */
+	SET_LPO_MOVE (&lane_move[l*ny+i], j, move_x[l], move_y[l]);
+      }
+      LOOPF (l,LPO_BATCH_LANES) {
+	curr_score[c+l] = my_score[l];
+	curr_gap_x[c+l] = my_gap_x[l];
+	curr_gap_y[c+l] = my_gap_y[l];
+      }
+      LOOPF (l,LPO_BATCH_LANES) {
+	curr_pen_x[c+l] = gap_penalty_x[my_gap_x[l]];
+	curr_pen_y[c+l] = gap_penalty_y[my_gap_y[l]];
+      }
+    }
+  }
+
+  /* DYNAMIC PROGRAMING MATRICES COMPLETE, NOW TRACE BACK EACH LANE */
+  LOOPF (l,nlane) {
+    IF_GUARD(best_x[l]>=len_x[l] || best_y[l]>=len_y[l],1.1,(ERRTXT,"Bounds exceeded!\nbest_x,best_y:%d,%d\tlen:%d,%d\n",best_x[l],best_y[l],len_x[l],len_y[l]),CRASH);
+    trace_back_lpo_alignment (len_x[l], len_y[l], &lane_move[l*ny],
+			      x_left[l], y_left[l], best_x[l], best_y[l],
+			      x_to_y ? &x_to_y[l] : NULL, y_to_x ? &y_to_x[l] : NULL);
+    if (score) {
+      score[l] = best_score[l];
+    }
+
+    FREE (node_type_x[l]);
+    FREE (node_type_y[l]);
+    for (j=0; j<len_x[l]; j++) {
+      if (x_left[l][j] != &lposeq_x[l]->letter[j].left) {
+	FREE (x_left[l][j]);
+      }
+    }
+    FREE (x_left[l]);
+    for (j=0; j<len_y[l]; j++) {
+      if (y_left[l][j] != &lposeq_y[l]->letter[j].left) {
+	FREE (y_left[l][j]);
+      }
+    }
+    FREE (y_left[l]);
+  }
+
+  free_lpo_move_rows (ny * LPO_BATCH_LANES, lane_move, FALSE);
+  FREE (lane_move);
+  FREE (move_code);
+  FREE (next_gap_array);
+  FREE (next_perp_gap_array);
+  FREE (pred_start);
+  FREE (pred_col);
+  FREE (pred_score);
+  FREE (x_code);
+  FREE (x_end);
+  FREE (prev_score);
+  FREE (curr_score);
+  FREE (prev_pen_y);
+  FREE (curr_pen_x);
+  FREE (curr_pen_y);
+  FREE (prev_gap_x);
+  FREE (prev_gap_y);
+  FREE (curr_gap_x);
+  FREE (curr_gap_y);
+}
+
+
+/** (align_lpo_po_batch:)
+    aligns nprob independent problems, lposeq_x[p] against lposeq_y[p],
+    returning each alignment in x_to_y[p] and y_to_x[p] and its score in
+    score[p] (if score is not NULL), exactly as align_lpo_po() with the
+    built-in matrix scoring would.
+    Problems are packed LPO_BATCH_LANES at a time into the lanes of one
+    lane-major DP (see fill_lpo_po_batch()), so many small problems of
+    similar size, e.g. reads added to thousands of small clusters, share
+    one pass over the matrix and its memory instead of paying for a full
+    align_lpo_po() each.  A problem whose y is not a single sequence, or
+    that X-drop or k-mer anchoring would prune, is aligned on its own.
+*/
+
+void align_lpo_po_batch (int nprob,
+			 LPOSequence_T *lposeq_x[],
+			 LPOSequence_T *lposeq_y[],
+			 ResidueScoreMatrix_T *m,
+			 LPOLetterRef_T *x_to_y[],
+			 LPOLetterRef_T *y_to_x[],
+			 LPOScore_T score[],
+			 int use_global_alignment)
+{
+  int p, nlane = 0, lane_prob[LPO_BATCH_LANES];
+  LPOSequence_T *lane_x[LPO_BATCH_LANES], *lane_y[LPO_BATCH_LANES];
+  LPOLetterRef_T *lane_x_to_y[LPO_BATCH_LANES], *lane_y_to_x[LPO_BATCH_LANES];
+  LPOScore_T lane_score[LPO_BATCH_LANES], x;
+
+  for (p=0; p<=nprob; p++) {
+    if (p < nprob && !fits_batch_lane (lposeq_y[p], m, use_global_alignment)) {
+      x = align_lpo_po (lposeq_x[p], lposeq_y[p], m,
+			x_to_y ? &x_to_y[p] : NULL, y_to_x ? &y_to_x[p] : NULL,
+			NULL, use_global_alignment);
+      if (score) {
+	score[p] = x;
+      }
+      continue;
+    }
+    if (p < nprob) {
+      lane_prob[nlane] = p;
+      lane_x[nlane] = lposeq_x[p];
+      lane_y[nlane++] = lposeq_y[p];
+    }
+    if (nlane == LPO_BATCH_LANES || (p == nprob && nlane > 0)) {
+      fill_lpo_po_batch (nlane, lane_x, lane_y, m, lane_x_to_y, lane_y_to_x,
+			 lane_score, use_global_alignment);
+      for (nlane--; nlane >= 0; nlane--) { /* SCATTER LANES BACK TO PROBLEMS */
+	if (x_to_y) {
+	  x_to_y[lane_prob[nlane]] = lane_x_to_y[nlane];
+	}
+	else {
+	  FREE (lane_x_to_y[nlane]);
+	}
+	if (y_to_x) {
+	  y_to_x[lane_prob[nlane]] = lane_y_to_x[nlane];
+	}
+	else {
+	  FREE (lane_y_to_x[nlane]);
+	}
+	if (score) {
+	  score[lane_prob[nlane]] = lane_score[nlane];
+	}
+      }
+      nlane = 0;
+    }
+  }
+}
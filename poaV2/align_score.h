@@ -5,6 +5,12 @@
 #include <poa.h>
 #include <seq_util.h>
 
+/** set to 0 if you customize matrix_scoring_function(); by default the
+    aligner scores straight from the matrix with its packed kernels */
+#ifndef USE_BUILTIN_MATRIX_SCORING
+#define USE_BUILTIN_MATRIX_SCORING 1
+#endif
+
 /*********************************************************** align_score.c */
 LPOScore_T matrix_scoring_function(int i,
 				   int j,
@@ -0,0 +1,231 @@
+
+#include <stdint.h>
+
+#include "default.h"
+#include "poa.h"
+#include "seq_util.h"
+#include "lpo.h"
+
+
+/** MULTIPLIER OF THE POLYNOMIAL k-MER HASH (MOD 2^64) */
+#define ANCHOR_HASH_BASE 0x100000001b3ULL
+
+
+static int kmer_qsort_cmp(const void *void_a,const void *void_b)
+{
+  const LPOKmer_T *a=(const LPOKmer_T *)void_a,*b=(const LPOKmer_T *)void_b;
+  if (a->key!=b->key)
+    return (a->key<b->key) ? -1 : 1;
+  return a->end - b->end;
+}
+
+
+/** hashes every k-long window of code[0..n-1] that contains no negative
+    code, appending them to kmer[] (which must have room for n more);
+    returns the new count */
+int hash_kmer_windows(int n,int code[],int k,LPOKmer_T kmer[],int nkmer)
+{
+  int i,last_bad= -1;
+  uint64_t h=0,top=1;
+
+  LOOPF (i,k-1) /* ANCHOR_HASH_BASE^(k-1), FOR DROPPING THE OLDEST CODE */
+    top*=ANCHOR_HASH_BASE;
+  LOOPF (i,n) {
+    if (code[i]<0) { /* GAP IN THE PATH: RESTART THE WINDOW */
+      last_bad=i;
+      h=0;
+      continue;
+    }
+    if (i-k>last_bad) /* DROP code[i-k] FROM THE WINDOW */
+      h-=top*(uint64_t)(code[i-k]+1);
+    h=h*ANCHOR_HASH_BASE+(uint64_t)(code[i]+1);
+    if (i-k>=last_bad) {
+      kmer[nkmer].key=h;
+      kmer[nkmer].end=i;
+      nkmer++;
+    }
+  }
+  return nkmer;
+}
+
+
+/** TRUE IF lposeq IS ONE SEQUENCE: EACH LETTER LINKED ONLY TO THE NEXT */
+static int is_linear_lpo(LPOSequence_T *lposeq)
+{
+  int i;
+  LPOLetter_T *seq=lposeq->letter;
+
+  if (lposeq->nsource_seq!=1)
+    return FALSE;
+  LOOPF (i,lposeq->length)
+    if (seq[i].left.ipos!=i-1 || seq[i].left.more)
+      return FALSE;
+  return TRUE;
+}
+
+
+/** finds exact k-mer anchors between the single sequence lposeq_y and
+    the source-sequence paths of the partial order lposeq_x, and chains
+    the longest co-linear set of them.  Only k-mers occurring once in
+    lposeq_y, and ending on a single letter of lposeq_x, are used.
+    On success, saves in *p_band_lo, *p_band_hi the range of letters of
+    lposeq_x that each letter of lposeq_y may align to: between the
+    anchored letters on either side of it (each anchored letter is
+    itself the end of its range), and returns the number of anchored
+    letters.  Returns 0 (and allocates nothing) if lposeq_y is not a
+    single sequence, or no anchors were found.
+*/
+int find_lpo_anchor_bands(LPOSequence_T *lposeq_x,
+			  LPOSequence_T *lposeq_y,
+			  int kmer_length,
+			  int **p_band_lo,
+			  int **p_band_hi)
+{
+  int i,j,t,nx,ny,nxkmer=0,nykmer=0,npath=0,nanchor=0,nchain=0,npair=0;
+  int len_x=lposeq_x->length,len_y=lposeq_y->length,k=kmer_length;
+  int *path=NULL,*path_start=NULL,*code=NULL,*y_code=NULL;
+  int *anchor_x=NULL,*anchor_y=NULL,*chain_tail=NULL,*chain_prev=NULL;
+  int *pair_x=NULL,*pair_y=NULL,*band_lo=NULL,*band_hi=NULL;
+  LPOKmer_T *xkmer=NULL,*ykmer=NULL;
+  LPOLetter_T *seq_x=lposeq_x->letter,*seq_y=lposeq_y->letter;
+  LPOLetterSource_T *source;
+
+  if (k<=0 || len_y<k || len_x<k || !is_linear_lpo(lposeq_y))
+    return 0;
+
+  /* LAY OUT THE LETTER PATH OF EVERY SOURCE SEQUENCE OF x, END TO END, */
+  /* WITH A -1 SEPARATOR SO NO k-MER SPANS TWO SOURCES */
+  CALLOC(path_start,lposeq_x->nsource_seq+1,int);
+  LOOPF (i,lposeq_x->nsource_seq) {
+    path_start[i]=npath;
+    npath+=lposeq_x->source_seq[i].length+1;
+  }
+  path_start[lposeq_x->nsource_seq]=npath;
+  CALLOC(path,npath,int);
+  CALLOC(code,npath,int);
+  LOOP (i,npath)
+    path[i]= -1;
+  LOOPF (i,len_x)
+    for (source= &seq_x[i].source;source && source->iseq>=0;
+	 source=source->more)
+      if (source->ipos>=0 && source->ipos<lposeq_x->source_seq[source->iseq].length)
+	path[path_start[source->iseq]+source->ipos]=i;
+  LOOP (i,npath)
+    code[i]=(path[i]>=0) ? seq_x[path[i]].letter : -1;
+
+  /* k-MERS OF x PATHS, KEPT ONLY IF THEY ALL END ON THE SAME LETTER */
+  CALLOC(xkmer,npath,LPOKmer_T);
+  nxkmer=hash_kmer_windows(npath,code,k,xkmer,0);
+  qsort(xkmer,nxkmer,sizeof(LPOKmer_T),kmer_qsort_cmp);
+
+  /* k-MERS OF y, KEPT ONLY IF UNIQUE IN y */
+  CALLOC(y_code,len_y,int);
+  LOOPF (i,len_y)
+    y_code[i]=seq_y[i].letter;
+  CALLOC(ykmer,len_y,LPOKmer_T);
+  nykmer=hash_kmer_windows(len_y,y_code,k,ykmer,0);
+  qsort(ykmer,nykmer,sizeof(LPOKmer_T),kmer_qsort_cmp);
+
+  /* JOIN THE TWO SORTED LISTS ON UNIQUE KEYS, VERIFYING THE RESIDUES */
+  CALLOC(anchor_x,nykmer+1,int);
+  CALLOC(anchor_y,nykmer+1,int);
+  for (i=j=0;i<nxkmer && j<nykmer;) {
+    for (nx=i+1;nx<nxkmer && xkmer[nx].key==xkmer[i].key;nx++);
+    for (ny=j+1;ny<nykmer && ykmer[ny].key==ykmer[j].key;ny++);
+    if (xkmer[i].key<ykmer[j].key) {
+      i=nx;
+      continue;
+    }
+    if (xkmer[i].key>ykmer[j].key) {
+      j=ny;
+      continue;
+    }
+    for (t=i+1;t<nx && path[xkmer[t].end]==path[xkmer[i].end];t++);
+    if (t==nx && ny-j==1) { /* ONE LETTER IN x, ONCE IN y */
+      LOOPF (t,k) /* HASHES MATCH: CHECK THE RESIDUES THEMSELVES */
+	if (code[xkmer[i].end-t]!=y_code[ykmer[j].end-t])
+	  break;
+      if (t==k) {
+	anchor_x[nanchor]=xkmer[i].end; /* PATH OFFSET OF LAST RESIDUE */
+	anchor_y[nanchor++]=ykmer[j].end;
+      }
+    }
+    i=nx;
+    j=ny;
+  }
+
+  /* LONGEST CO-LINEAR CHAIN: ANCHORS SORTED BY y, INCREASING x LETTER */
+  CALLOC(chain_tail,nanchor+1,int);
+  CALLOC(chain_prev,nanchor+1,int);
+  if (nanchor>0) {
+    int *order=NULL,lo,hi,mid;
+    CALLOC(order,len_y,int);
+    LOOP (i,len_y)
+      order[i]= -1;
+    LOOPF (i,nanchor)
+      order[anchor_y[i]]=i;
+    LOOPF (j,len_y) if ((i=order[j])>=0) {
+      for (lo=0,hi=nchain;lo<hi;) { /* FIRST TAIL WITH x >= THIS x */
+	mid=(lo+hi)/2;
+	if (path[anchor_x[chain_tail[mid]]]<path[anchor_x[i]])
+	  lo=mid+1;
+	else
+	  hi=mid;
+      }
+      chain_prev[i]=(lo>0) ? chain_tail[lo-1] : -1;
+      chain_tail[lo]=i;
+      if (lo==nchain)
+	nchain++;
+    }
+    FREE(order);
+  }
+
+  /* EXPAND THE CHAIN INTO STRICTLY INCREASING (x,y) LETTER PAIRS */
+  if (nchain>0) {
+    int *chain=NULL;
+    CALLOC(chain,nchain,int);
+    for (i=chain_tail[nchain-1],j=nchain;j-->0;i=chain_prev[i])
+      chain[j]=i;
+    CALLOC(pair_x,nchain*k,int);
+    CALLOC(pair_y,nchain*k,int);
+    LOOPF (j,nchain) {
+      i=chain[j];
+      for (t=k;t-->0;) {
+	if (npair>0 && (anchor_y[i]-t<=pair_y[npair-1]
+			|| path[anchor_x[i]-t]<=pair_x[npair-1]))
+	  continue; /* OVERLAPS THE PREVIOUS ANCHOR */
+	pair_x[npair]=path[anchor_x[i]-t];
+	pair_y[npair++]=anchor_y[i]-t;
+      }
+    }
+    FREE(chain);
+  }
+
+  /* BAND OF EACH y LETTER: BETWEEN THE NEAREST ANCHORED PAIRS AROUND IT */
+  if (npair>0) {
+    CALLOC(band_lo,len_y,int);
+    CALLOC(band_hi,len_y,int);
+    for (i=j=0;i<len_y;i++) {
+      while (j<npair && pair_y[j]<i)
+	j++;
+      band_lo[i]=(j>0) ? pair_x[j-1] : 0;
+      band_hi[i]=(j<npair) ? pair_x[j] : len_x-1;
+    }
+    *p_band_lo=band_lo;
+    *p_band_hi=band_hi;
+  }
+
+  FREE(path_start);
+  FREE(path);
+  FREE(code);
+  FREE(y_code);
+  FREE(xkmer);
+  FREE(ykmer);
+  FREE(anchor_x);
+  FREE(anchor_y);
+  FREE(chain_tail);
+  FREE(chain_prev);
+  FREE(pair_x);
+  FREE(pair_y);
+  return npair;
+}
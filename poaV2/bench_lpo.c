@@ -0,0 +1,152 @@
+#include "default.h"
+#include "poa.h"
+#include "seq_util.h"
+#include "lpo.h"
+#include "msa_format.h"
+
+#include <time.h>
+
+
+/* BENCHMARK HARNESS FOR make bench: BUILDS THE PARTIAL ORDER OF ONE FASTA
+   FILE THE WAY buildup_lpo() DOES, BUT TIMES EACH STAGE ON ITS OWN, AND
+   PRINTS ONE JSON OBJECT WITH THE TIMES, DP CELL UPDATES PER SECOND, PEAK
+   RSS AND GRAPH SIZE.  run_bench.py DRIVES IT OVER SIMULATED DATA. */
+
+
+/** wall-clock seconds, for timing one stage */
+static double bench_seconds(void)
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC,&t);
+  return t.tv_sec+1e-9*t.tv_nsec;
+}
+
+
+/** times reading back the alignment that ifile holds, checking that all
+    nseq sequences come back */
+static double bench_read_msa(FILE *ifile,int nseq,ResidueScoreMatrix_T *m)
+{
+  double t;
+  LPOSequence_T *lpo;
+
+  rewind(ifile);
+  t=bench_seconds();
+  lpo=read_msa(ifile,UNKNOWN_MSA,dont_switch_case,m);
+  t=bench_seconds()-t;
+  if (!lpo || lpo->nsource_seq!=nseq) {
+    fprintf(stderr,"bench_lpo: read back %d of %d sequences\n",
+	    lpo ? lpo->nsource_seq : 0,nseq);
+    exit(1);
+  }
+  free_lpo_sequence(lpo,TRUE);
+  return t;
+}
+
+
+int main(int argc,char *argv[])
+{
+  int i,nseq=0,path_length=0,nedge=0,use_global_alignment=0,nresidue=0;
+  double t,t_read,t_init,t_align=0.,t_fuse=0.,t_hb,t_write_po,t_write_pir;
+  double t_read_po,t_read_pir,ncell;
+  char *name=NULL,*matrix_filename=NULL,*seq_filename=NULL;
+  ResidueScoreMatrix_T m;
+  LPOSequence_T *seq=NULL,*lpo;
+  LPOLetterRef_T *al1=NULL,*al2=NULL,*path;
+  LPOLetterLink_T *link;
+  FILE *ifile,*po_file,*pir_file;
+
+  for (i=1;i<argc;i++) {
+    ARGGET("-name",name); /* LABEL FOR THE JSON RECORD */
+    ARGMATCH("-do_global",use_global_alignment);
+    NEXTARG(matrix_filename);
+    NEXTARG(seq_filename);
+  }
+  if (!matrix_filename || !seq_filename) {
+    fprintf(stderr,"\nUsage: %s [-name NAME] [-do_global] MATRIXFILE FASTA\n"
+"Aligns the sequences in FASTA one by one, as poa does, and prints the\n"
+"time spent in each stage as one JSON object.\n\n",argv[0]);
+    exit(2);
+  }
+  if (read_score_matrix(matrix_filename,&m)<=0) {
+    fprintf(stderr,"%s: can't read matrix %s\n",argv[0],matrix_filename);
+    exit(1);
+  }
+
+  t=bench_seconds(); /* READER */
+  if ((ifile=fopen(seq_filename,"r"))) {
+    nseq=read_fasta(ifile,&seq,dont_switch_case,NULL);
+    fclose(ifile);
+  }
+  t_read=bench_seconds()-t;
+  if (nseq<=0) {
+    fprintf(stderr,"%s: no sequences in %s\n",argv[0],seq_filename);
+    exit(1);
+  }
+  LOOPF (i,nseq)
+    nresidue+=seq[i].length;
+
+  t=bench_seconds();
+  initialize_seqs_as_lpo(nseq,seq,&m);
+  t_init=bench_seconds()-t;
+
+  lpo=seq; /* ALIGN AND FUSE ONE BY ONE, TIMING EACH STEP */
+  for (i=1;i<nseq;i++) {
+    t=bench_seconds();
+    align_lpo_po(lpo,seq+i,&m,&al1,&al2,NULL,use_global_alignment);
+    t_align+=bench_seconds()-t;
+    t=bench_seconds();
+    fuse_lpo(lpo,seq+i,al1,al2);
+    t_fuse+=bench_seconds()-t;
+    free_lpo_letters(seq[i].length,seq[i].letter,TRUE);
+    seq[i].letter=NULL;
+    FREE(al1);
+    FREE(al2);
+  }
+  ncell=get_lpo_dp_cell_count();
+  LOOP (i,lpo->length)
+    for (link= &lpo->letter[i].left;link && link->ipos>=0;link=link->more)
+      nedge++;
+
+  t=bench_seconds();
+  path=heaviest_bundle(lpo->length,lpo->letter,lpo->nsource_seq,
+		       lpo->source_seq,&path_length);
+  t_hb=bench_seconds()-t;
+  FREE(path);
+
+  po_file=tmpfile(); /* WRITERS, THEN THE READERS ON WHAT THEY WROTE */
+  pir_file=tmpfile();
+  if (!po_file || !pir_file) {
+    fprintf(stderr,"%s: can't create temporary files\n",argv[0]);
+    exit(1);
+  }
+  t=bench_seconds();
+  write_lpo(po_file,lpo,&m);
+  fflush(po_file);
+  t_write_po=bench_seconds()-t;
+  t=bench_seconds();
+  write_lpo_bundle_as_fasta(pir_file,lpo,m.nsymbol,m.symbol,ALL_BUNDLES);
+  fflush(pir_file);
+  t_write_pir=bench_seconds()-t;
+  t_read_po=bench_read_msa(po_file,lpo->nsource_seq,&m);
+  t_read_pir=bench_read_msa(pir_file,lpo->nsource_seq,&m);
+  fclose(po_file);
+  fclose(pir_file);
+
+  printf("{\"name\": \"%s\", \"nseq\": %d, \"residues\": %d,"
+	 " \"nodes\": %d, \"edges\": %d, \"dp_cells\": %.0f,"
+	 " \"gcups\": %.4f, \"peak_rss_kb\": %ld,"
+	 " \"read_fasta_s\": %.6f, \"init_s\": %.6f, \"align_s\": %.6f,"
+	 " \"fuse_s\": %.6f, \"heaviest_bundle_s\": %.6f,"
+	 " \"write_po_s\": %.6f, \"write_pir_s\": %.6f,"
+	 " \"read_po_s\": %.6f, \"read_pir_s\": %.6f}\n",
+	 name ? name : seq_filename,nseq,nresidue,lpo->length,nedge,ncell,
+	 t_align>0. ? ncell/t_align*1e-9 : 0.,get_peak_rss_kb(),
+	 t_read,t_init,t_align,t_fuse,t_hb,t_write_po,t_write_pir,
+	 t_read_po,t_read_pir);
+
+  LOOPF (i,nseq)
+    free_lpo_sequence(seq+i,FALSE);
+  FREE(seq);
+  return 0;
+}
@@ -5,6 +5,8 @@
 #include "seq_util.h"
 #include "lpo.h"
 
+#include <pthread.h>
+
 
 /** if two align-rings are aligned to each other, make sure
     that the (single) aligned residue pair consists of identical
@@ -119,6 +121,8 @@ LPOSequence_T *buildup_lpo(LPOSequence_T *new_seq,
 
     free_lpo_letters(seq[i].length,seq[i].letter,TRUE);/*NO NEED TO KEEP*/
     seq[i].letter=NULL; /* MARK AS FREED... DON'T LEAVE DANGLING POINTER! */
+    if (seq[i].view) /* CAN BE RELOADED FROM ITS FASTA VIEW IF EVER NEEDED */
+      FREE(seq[i].sequence);
     FREE(al1); /* DUMP TEMPORARY MAPPING ARRAYS */
     FREE(al2);
   }
@@ -266,14 +270,6 @@ int find_seq_name (int nseq, LPOSequence_T **seq, char name[])
 }
 
 
-typedef struct {
-  double score;
-  int i;
-  int j;
-}
-SeqPairScore_T;
-
-
 /* SORT IN DESCENDING ORDER BY score (SO HIGH SIMILARITY SCORES MERGE FIRST). */
 /* FOR TIES, USE ITERATIVE MERGE ORDER (1-2, then 1-3, then 1-4, etc.) */
 int seqpair_score_qsort_cmp (const void *void_a, const void *void_b)
@@ -317,7 +313,7 @@ SeqPairScore_T *read_seqpair_scorefile (int nseq, LPOSequence_T **seq,
 
   CALLOC (adj_score, nseq, int);
 
-  max_nscore = nseq*nseq;
+  max_nscore = nseq+1; /* GROWN BELOW AS NEEDED (e.g. ALL PAIRS IF PROGRESSIVE) */
   CALLOC (score_list, max_nscore, SeqPairScore_T);
 
   if (ifile) { /* IF PAIR SCORE FILE (PROGRESSIVE ASSUMED) */
@@ -391,6 +387,485 @@ SeqPairScore_T *read_seqpair_scorefile (int nseq, LPOSequence_T **seq,
   return score_list;
 }
 
+/** NUMBER OF MINHASH VALUES KEPT PER SEQUENCE FOR buildup_sketch_order */
+#define BUILDUP_SKETCH_SIZE 64
+
+/** NUMBER OF HASH BUCKETS IN THE k-MER PROFILES OF buildup_centroid_order */
+#define BUILDUP_PROFILE_BUCKETS 4096
+
+/** k-MERS ARE MADE LONG ENOUGH TO SPAN ABOUT THIS MANY DISTINCT VALUES */
+#define BUILDUP_KMER_SPACE 1048576.
+
+
+/** ONE SEQUENCE INDEX AND THE KEY THAT sort_buildup_order() SORTS IT BY */
+typedef struct {
+  double key;
+  int index;
+} BuildupOrderKey_T;
+
+/** sorts BuildupOrderKey_T by decreasing key, then by index */
+static int buildup_order_qsort_cmp(const void *void_a,const void *void_b)
+{
+  const BuildupOrderKey_T *a=(const BuildupOrderKey_T *)void_a,
+    *b=(const BuildupOrderKey_T *)void_b;
+
+  if (a->key>b->key)
+    return -1;
+  else if (a->key<b->key)
+    return 1;
+  return a->index - b->index;
+}
+
+
+/** fills order[] with 0..n-1 sorted by decreasing key[], then by index */
+static void sort_buildup_order(int n,double key[],int order[])
+{
+  int i;
+  BuildupOrderKey_T *sorted=NULL;
+
+  CALLOC(sorted,n+1,BuildupOrderKey_T);
+  LOOP (i,n) {
+    sorted[i].key=key[i];
+    sorted[i].index=i;
+  }
+  qsort(sorted,n,sizeof(BuildupOrderKey_T),buildup_order_qsort_cmp);
+  LOOP (i,n)
+    order[i]=sorted[i].index;
+  FREE(sorted);
+}
+
+
+/** scrambles a k-mer hash, so that its low bits and its rank are uniform */
+static uint64_t mix_kmer_hash(uint64_t h)
+{
+  h^=h>>33;
+  h*=0xff51afd7ed558ccdULL;
+  h^=h>>33;
+  h*=0xc4ceb9fe1a85ec53ULL;
+  h^=h>>33;
+  return h;
+}
+
+
+static int uint64_qsort_cmp(const void *void_a,const void *void_b)
+{
+  const uint64_t *a=(const uint64_t *)void_a,*b=(const uint64_t *)void_b;
+  return (*a<*b) ? -1 : (*a>*b);
+}
+
+
+/** residue codes of seq: its letters if it is already a partial order,
+    otherwise its residues (read from its FASTA view if need be, without
+    keeping them); returns their number, and the codes in *p_code */
+static int buildup_seq_codes(LPOSequence_T *seq,char symbol_index[256],
+			     int **p_code)
+{
+  int i,*code=NULL,loaded=0;
+
+  CALLOC(code,seq->length+1,int);
+  if (seq->letter) {
+    LOOPF (i,seq->length)
+      code[i]=seq->letter[i].letter;
+  }
+  else {
+    if (!seq->sequence && seq->view) {
+      load_fasta_view(seq);
+      loaded=1;
+    }
+    LOOPF (i,seq->length)
+      code[i]=symbol_index[(unsigned char) seq->sequence[i]];
+    if (loaded) /* KEEP THE VIEW LAZY */
+      FREE(seq->sequence);
+  }
+  *p_code=code;
+  return seq->length;
+}
+
+
+/** mixed k-mer hashes of seq; returns their number, and the hashes in
+    *p_kmer */
+static int buildup_seq_kmers(LPOSequence_T *seq,char symbol_index[256],
+			     int k,LPOKmer_T **p_kmer)
+{
+  int i,n,nkmer,*code=NULL;
+  LPOKmer_T *kmer=NULL;
+
+  n=buildup_seq_codes(seq,symbol_index,&code);
+  CALLOC(kmer,n+1,LPOKmer_T);
+  nkmer=hash_kmer_windows(n,code,k,kmer,0);
+  LOOP (i,nkmer)
+    kmer[i].key=mix_kmer_hash(kmer[i].key);
+  FREE(code);
+  *p_kmer=kmer;
+  return nkmer;
+}
+
+
+/** k-mer length for ordering: long enough that the residue codes seen in
+    seq span about BUILDUP_KMER_SPACE distinct k-mers */
+static int buildup_kmer_length(LPOSequence_T *seq,char symbol_index[256])
+{
+  int i,k,n,ndistinct=0,*code=NULL;
+  char seen[256];
+  double space;
+
+  memset(seen,0,sizeof(seen));
+  n=buildup_seq_codes(seq,symbol_index,&code);
+  LOOP (i,n)
+    if (!seen[code[i]&255]) {
+      seen[code[i]&255]=1;
+      ndistinct++;
+    }
+  FREE(code);
+  if (ndistinct<2)
+    ndistinct=2;
+  for (k=1,space=ndistinct;space<BUILDUP_KMER_SPACE && k<32;k++)
+    space*=ndistinct;
+  return (k<3) ? 3 : k;
+}
+
+
+/** estimated Jaccard similarity of two bottom-S minhash sketches */
+static double sketch_similarity(int na,uint64_t a[],int nb,uint64_t b[])
+{
+  int i=0,j=0,nshared=0,nunion=0;
+
+  while (nunion<BUILDUP_SKETCH_SIZE && (i<na || j<nb)) {
+    if (j>=nb || (i<na && a[i]<b[j]))
+      i++;
+    else if (i>=na || b[j]<a[i])
+      j++;
+    else { /* IN BOTH SKETCHES */
+      i++;
+      j++;
+      nshared++;
+    }
+    nunion++;
+  }
+  return (nunion>0) ? nshared/(double)nunion : 0.;
+}
+
+
+/** chooses the order in which iterative buildup adds seq[0..nseq-1]:
+    buildup_length_order: longest first;
+    buildup_centroid_order: by decreasing cosine similarity of k-mer
+      profiles to their mean, so the most typical sequence comes first;
+    buildup_sketch_order: starting from the sequence with the highest
+      total minhash similarity to the others, each next sequence is the
+      one most similar to any sequence already added.
+    Returns order[], the input index of each sequence in adding order. */
+int *order_buildup_seqs(int nseq,LPOSequence_T **seq,
+			ResidueScoreMatrix_T *score_matrix,int buildup_order)
+{
+  int i,j,k=0,n,best,*order=NULL,*nsketch=NULL,*added=NULL;
+  char symbol_index[256];
+  double *key=NULL,*sim=NULL,norm,dot,x;
+  float *centroid=NULL,*profile=NULL;
+  uint64_t *sketch=NULL,*hash=NULL;
+  LPOKmer_T *kmer=NULL;
+
+  CALLOC(order,nseq,int);
+  CALLOC(key,nseq,double);
+  LOOP (i,nseq)
+    order[i]=i;
+  build_matrix_symbol_index(score_matrix,symbol_index);
+  LOOP (i,nseq) /* PARTIAL ORDERS READ FROM FILE MAY NOT BE TRANSLATED YET */
+    if (seq[i]->letter)
+      lpo_index_symbols(seq[i],score_matrix);
+  if (buildup_order!=buildup_length_order)
+    k=buildup_kmer_length(seq[0],symbol_index);
+
+  switch (buildup_order) {
+  case buildup_length_order:
+    LOOP (i,nseq)
+      key[i]=seq[i]->length;
+    break;
+
+  case buildup_centroid_order:
+    CALLOC(centroid,BUILDUP_PROFILE_BUCKETS,float);
+    CALLOC(profile,BUILDUP_PROFILE_BUCKETS,float);
+    LOOPF (i,nseq) { /* MEAN OF THE (LENGTH-NORMALIZED) PROFILES */
+      n=buildup_seq_kmers(seq[i],symbol_index,k,&kmer);
+      LOOP (j,n)
+	centroid[kmer[j].key%BUILDUP_PROFILE_BUCKETS]+=1./n;
+      FREE(kmer);
+    }
+    LOOPF (i,nseq) { /* COSINE OF EACH PROFILE TO THE CENTROID */
+      memset(profile,0,BUILDUP_PROFILE_BUCKETS*sizeof(float));
+      n=buildup_seq_kmers(seq[i],symbol_index,k,&kmer);
+      LOOP (j,n)
+	profile[kmer[j].key%BUILDUP_PROFILE_BUCKETS]+=1.;
+      FREE(kmer);
+      for (j=0,dot=norm=x=0.;j<BUILDUP_PROFILE_BUCKETS;j++) {
+	dot+=profile[j]*centroid[j];
+	norm+=profile[j]*profile[j];
+	x+=centroid[j]*centroid[j];
+      }
+      key[i]=(norm>0. && x>0.) ? dot/sqrt(norm*x) : 0.;
+    }
+    FREE(centroid);
+    FREE(profile);
+    break;
+
+  case buildup_sketch_order:
+    CALLOC(sketch,nseq*BUILDUP_SKETCH_SIZE,uint64_t);
+    CALLOC(nsketch,nseq,int);
+    LOOPF (i,nseq) { /* BOTTOM-S SKETCH: THE S SMALLEST DISTINCT HASHES */
+      n=buildup_seq_kmers(seq[i],symbol_index,k,&kmer);
+      CALLOC(hash,n+1,uint64_t);
+      LOOP (j,n)
+	hash[j]=kmer[j].key;
+      FREE(kmer);
+      qsort(hash,n,sizeof(uint64_t),uint64_qsort_cmp);
+      LOOPF (j,n)
+	if (nsketch[i]==0 || hash[j]!=sketch[i*BUILDUP_SKETCH_SIZE+nsketch[i]-1]) {
+	  sketch[i*BUILDUP_SKETCH_SIZE+nsketch[i]++]=hash[j];
+	  if (nsketch[i]==BUILDUP_SKETCH_SIZE)
+	    break;
+	}
+      FREE(hash);
+    }
+    CALLOC(sim,nseq,double);
+    CALLOC(added,nseq,int);
+    LOOPF (i,nseq) /* SEED: MOST SIMILAR TO ALL THE OTHERS */
+      LOOPF (j,i) {
+	x=sketch_similarity(nsketch[i],sketch+i*BUILDUP_SKETCH_SIZE,
+			    nsketch[j],sketch+j*BUILDUP_SKETCH_SIZE);
+	key[i]+=x;
+	key[j]+=x;
+      }
+    for (best=i=0;i<nseq;i++)
+      if (key[i]>key[best])
+	best=i;
+    LOOPF (n,nseq) { /* GREEDY: ADD THE BEST-CONNECTED REMAINING SEQ */
+      order[n]=best;
+      added[best]=1;
+      for (i=0,j= -1;i<nseq;i++) if (!added[i]) {
+	x=sketch_similarity(nsketch[i],sketch+i*BUILDUP_SKETCH_SIZE,
+			    nsketch[best],sketch+best*BUILDUP_SKETCH_SIZE);
+	if (n==0 || x>sim[i])
+	  sim[i]=x;
+	if (j<0 || sim[i]>sim[j])
+	  j=i;
+      }
+      best=j;
+    }
+    FREE(sketch);
+    FREE(nsketch);
+    FREE(sim);
+    FREE(added);
+    break;
+  }
+
+  if (buildup_order!=buildup_sketch_order) /* sketch ORDER IS ALREADY SET */
+    sort_buildup_order(nseq,key,order);
+  FREE(key);
+  return order;
+}
+
+
+/** k-MER LENGTH OF THE -auto_strand VOTE: RANDOM HITS STAY RARE EVEN
+    AGAINST MILLIONS OF k-MERS */
+#define STRAND_KMER_LENGTH 15
+
+
+/** 2-BIT NUCLEOTIDE CODE OF A RESIDUE CHARACTER (a,c,g,t/u IN EITHER
+    CASE, SO THAT 3-code IS THE COMPLEMENT), OR -1 */
+static int strand_base_code(char c)
+{
+  switch (c) {
+  case 'A': case 'a':                     return 0;
+  case 'C': case 'c':                     return 1;
+  case 'G': case 'g':                     return 2;
+  case 'T': case 't': case 'U': case 'u': return 3;
+  default: return -1;
+  }
+}
+
+
+/** nucleotide codes of seq for the strand vote: the residues of a plain
+    sequence, or each source path of a partial order laid end to end with
+    -1 separators.  Returns their number, and the codes in *p_code */
+static int strand_seq_codes(LPOSequence_T *seq,char symbol_index[256],
+			    int base_of[],int **p_code)
+{
+  int i,n=0,*code=NULL,*path_start=NULL;
+  LPOLetterSource_T *source;
+
+  if (!seq->letter) { /* NOT INITIALIZED: READ ITS RESIDUES */
+    n=buildup_seq_codes(seq,symbol_index,&code);
+    LOOP (i,n)
+      code[i]=base_of[code[i]];
+    *p_code=code;
+    return n;
+  }
+  CALLOC(path_start,seq->nsource_seq+1,int);
+  LOOPF (i,seq->nsource_seq) {
+    path_start[i]=n;
+    n+=seq->source_seq[i].length+1;
+  }
+  CALLOC(code,n+1,int);
+  LOOP (i,n)
+    code[i]= -1;
+  LOOPF (i,seq->length)
+    for (source= &seq->letter[i].source;source && source->iseq>=0;
+	 source=source->more)
+      if (source->ipos>=0 && source->ipos<seq->source_seq[source->iseq].length)
+	code[path_start[source->iseq]+source->ipos]=base_of[seq->letter[i].letter];
+  FREE(path_start);
+  *p_code=code;
+  return n;
+}
+
+
+/** inserts key into the open-addressing k-mer set table[size]
+    (size a power of two; 0 marks an empty slot) */
+static void strand_set_insert(uint64_t table[],int size,uint64_t key)
+{
+  int i;
+  for (i=key&(size-1);table[i] && table[i]!=key;i=(i+1)&(size-1));
+  table[i]=key;
+}
+
+
+/** TRUE IF key IS IN THE k-MER SET table[size] */
+static int strand_set_find(uint64_t table[],int size,uint64_t key)
+{
+  int i;
+  for (i=key&(size-1);table[i];i=(i+1)&(size-1))
+    if (table[i]==key)
+      return TRUE;
+  return FALSE;
+}
+
+
+/** non-zero set key of each k-mer of code[0..n-1]; returns their number */
+static int strand_kmer_keys(int n,int code[],LPOKmer_T kmer[])
+{
+  int i,nkmer;
+
+  nkmer=hash_kmer_windows(n,code,STRAND_KMER_LENGTH,kmer,0);
+  LOOP (i,nkmer) {
+    kmer[i].key=mix_kmer_hash(kmer[i].key);
+    if (kmer[i].key==0)
+      kmer[i].key=1;
+  }
+  return nkmer;
+}
+
+
+/** -auto_strand: orients each nucleotide sequence in seq[] the way it will
+    be added to the graph.  In input order, every single sequence votes
+    with its k-mers, forward and reverse complemented, against the k-mers
+    of the sequences before it (as oriented), and is reverse complemented
+    in place if the reverse strand gets more hits.  Partial orders with
+    more than one source only contribute their k-mers.  A FASTA view is
+    just flagged, so it stays lazy.  This costs one k-mer pass per
+    sequence instead of a second DP.  Returns the number of sequences
+    reverse complemented. */
+int orient_buildup_seqs(int nseq,LPOSequence_T **seq,
+			ResidueScoreMatrix_T *score_matrix)
+{
+  int i,j,n,nkmer,nfwd,nrev,nflip=0,size=1024,nset=0,c;
+  int base_of[MATRIX_SYMBOL_MAX],*code=NULL,*rev=NULL;
+  char symbol_index[256],comp_of[MATRIX_SYMBOL_MAX],comp_base,swap;
+  uint64_t *table=NULL,*old=NULL;
+  LPOKmer_T *kmer=NULL,*rev_kmer=NULL;
+
+  build_matrix_symbol_index(score_matrix,symbol_index);
+  LOOP (i,score_matrix->nsymbol) { /* MATRIX CODE -> BASE, AND COMPLEMENT */
+    base_of[i]=strand_base_code(score_matrix->symbol[i]);
+    comp_base=complementary_base(score_matrix->symbol[i]);
+    if (isupper(score_matrix->symbol[i]))
+      comp_base=toupper(comp_base);
+    comp_of[i]=symbol_index[(unsigned char)comp_base];
+  }
+  LOOP (i,nseq) /* PARTIAL ORDERS READ FROM FILE MAY NOT BE TRANSLATED YET */
+    if (seq[i]->letter)
+      lpo_index_symbols(seq[i],score_matrix);
+  CALLOC(table,size,uint64_t);
+
+  LOOPF (i,nseq) {
+    n=strand_seq_codes(seq[i],symbol_index,base_of,&code);
+    CALLOC(kmer,n+1,LPOKmer_T);
+    nkmer=strand_kmer_keys(n,code,kmer);
+    if (i>0 && seq[i]->nsource_seq<=1) { /* A SINGLE SEQUENCE: VOTE */
+      CALLOC(rev,n+1,int);
+      LOOP (j,n)
+	rev[n-1-j]=(code[j]>=0) ? 3-code[j] : -1;
+      CALLOC(rev_kmer,n+1,LPOKmer_T);
+      strand_kmer_keys(n,rev,rev_kmer);
+      for (j=nfwd=nrev=0;j<nkmer;j++) {
+	nfwd+=strand_set_find(table,size,kmer[j].key);
+	nrev+=strand_set_find(table,size,rev_kmer[j].key);
+      }
+      if (nrev>nfwd) { /* REVERSE COMPLEMENT IT */
+	if (seq[i]->letter) { /* FLIP THE CODES OF THE LINEAR LETTERS */
+	  for (j=0;j<seq[i]->length-1-j;j++) {
+	    swap=seq[i]->letter[j].letter;
+	    seq[i]->letter[j].letter=seq[i]->letter[seq[i]->length-1-j].letter;
+	    seq[i]->letter[seq[i]->length-1-j].letter=swap;
+	  }
+	  LOOP (j,seq[i]->length) {
+	    c=seq[i]->letter[j].letter;
+	    seq[i]->letter[j].letter=comp_of[c];
+	    if (seq[i]->sequence) /* INDEXED COPY KEPT BY lpo_init() */
+	      seq[i]->sequence[j]=comp_of[c];
+	  }
+	  if (seq[i]->ntrack>0) { /* REDO THE LINK WEIGHTS THE TRACKS GAVE */
+	    reverse_lpo_track_values(seq[i],0);
+	    LOOP (j,seq[i]->length)
+	      seq[i]->letter[j].left.weight=seq[i]->letter[j].right.weight=0;
+	    add_lpo_track_link_weights(seq[i]);
+	  }
+	}
+	else if (seq[i]->sequence) /* LOADED, BUT NOT INITIALIZED */
+	  reverse_complement(seq[i]->sequence);
+	else /* LAZY VIEW: FLIP IT WHEN IT IS LOADED */
+	  seq[i]->view_reverse_complement= !seq[i]->view_reverse_complement;
+	if (!seq[i]->letter) /* lpo_init() WILL WEIGH THE LINKS */
+	  reverse_lpo_track_values(seq[i],0);
+	FREE(kmer);
+	kmer=rev_kmer;
+	rev_kmer=NULL;
+	nflip++;
+      }
+      FREE(rev);
+      FREE(rev_kmer);
+    }
+    if (2*(nset+nkmer)>size) { /* KEEP THE SET AT MOST HALF FULL */
+      old=table;
+      for (j=size;2*(nset+nkmer)>size;size*=2);
+      CALLOC(table,size,uint64_t);
+      LOOP (c,j)
+	if (old[c])
+	  strand_set_insert(table,size,old[c]);
+      FREE(old);
+    }
+    LOOP (j,nkmer)
+      if (!strand_set_find(table,size,kmer[j].key)) {
+	strand_set_insert(table,size,kmer[j].key);
+	nset++;
+      }
+    FREE(kmer);
+    FREE(code);
+  }
+  FREE(table);
+  return nflip;
+}
+
+
+/** cluster c will be part of once the batch[0..nbatch-1] of clusters
+    has been merged into cluster_i */
+static int speculative_cluster(int c,int cluster_i,int nbatch,int batch[])
+{
+  int i;
+
+  LOOPF (i,nbatch)
+    if (batch[i]==c)
+      return cluster_i;
+  return c;
+}
 
 LPOSequence_T *buildup_progressive_lpo(int nseq,LPOSequence_T **all_seqs,
 				       ResidueScoreMatrix_T *score_matrix,
@@ -401,19 +876,40 @@ LPOSequence_T *buildup_progressive_lpo(int nseq,LPOSequence_T **all_seqs,
 				       (int,int,LPOLetter_T [],LPOLetter_T [],
 					ResidueScoreMatrix_T *),
                                        int use_global_alignment,
-				       int preserve_sequence_order)
+				       int preserve_sequence_order,
+				       int consensus_only,
+				       int buildup_order,
+				       LPOPrune_T *prune,
+				       LPOCheckpoint_T *checkpoint,
+				       LPOSpeculate_T *speculate)
 {
   int i,j,k,max_alloc=0,total_alloc,min_counts=0;
+  int iscore_start=0,nfusion=0,resumed=0,nfolded,nbatch,ibatch;
+  int *batch_cluster=NULL;
+  LPOSequence_T **batch_seq=NULL;
   SeqPairScore_T *score=NULL;
   LPOSequence_T *new_seq=NULL;
   FILE *ifile=NULL;
   int *seq_cluster=NULL,cluster_i,cluster_j,nscore=0,iscore;
   int *initial_nseq, *cluster_size, *seq_id_in_cluster;
-  int nseq_tot;
-
+  int nseq_tot,*seq_order=NULL;
+  LPOSequence_T **ordered_seqs=NULL;
+
+  /* ITERATIVE BUILDUP: ADD THE SEQUENCES IN THE CHOSEN ORDER */
+  if (buildup_order!=buildup_input_order && !do_progressive && !score_file
+      && nseq>1) {
+    seq_order=order_buildup_seqs(nseq,all_seqs,score_matrix,buildup_order);
+    CALLOC(ordered_seqs,nseq,LPOSequence_T *);
+    LOOP (i,nseq)
+      ordered_seqs[i]=all_seqs[seq_order[i]];
+    all_seqs=ordered_seqs; /* THE CALLER'S ARRAY IS LEFT AS IT WAS */
+  }
 
   /* INITIALIZE ALL UNINITIALIZED SEQS: */
   for (i=0;i<nseq;i++) {
+    if (i>0 && all_seqs[i]->letter == NULL && all_seqs[i]->view
+	&& !(do_progressive && !score_file))
+      continue; /* FASTA VIEW: BUILT LAZILY, RIGHT BEFORE IT IS FUSED */
     if (all_seqs[i]->letter == NULL) {
       initialize_seqs_as_lpo(1,all_seqs[i],score_matrix);
     }
@@ -437,11 +933,23 @@ LPOSequence_T *buildup_progressive_lpo(int nseq,LPOSequence_T **all_seqs,
   for (i=nseq_tot=0;i<nseq;i++) {
     seq_cluster[i] = i;  /* CREATE TRIVIAL MAPPING, EACH SEQ ITS OWN CLUSTER */
     seq_id_in_cluster[i] = 0;
-    cluster_size[i] = all_seqs[i]->nsource_seq;
+    cluster_size[i] = all_seqs[i]->letter ? all_seqs[i]->nsource_seq : 1;
     initial_nseq[i] = cluster_size[i];
     nseq_tot += cluster_size[i];
   }
 
+  if (checkpoint && checkpoint->filename && checkpoint->resume) {
+    resumed=load_buildup_checkpoint(checkpoint->filename,nseq,all_seqs,
+				    &nscore,&score,&iscore_start,&nfusion,
+				    seq_cluster,seq_id_in_cluster,cluster_size);
+    if (resumed<0) { /* UNUSABLE CHECKPOINT: DON'T SILENTLY START OVER */
+      new_seq=NULL;
+      goto free_and_exit;
+    }
+    if (resumed) /* PAIR SCORES WERE SAVED WITH THE CHECKPOINT */
+      goto merge_clusters;
+  }
+
   if (score_file) {
     ifile=fopen(score_file,"r");
     if (ifile==NULL) {
@@ -465,7 +973,8 @@ LPOSequence_T *buildup_progressive_lpo(int nseq,LPOSequence_T **all_seqs,
   if (ifile)
     fclose (ifile);
 
-  for (iscore=0;iscore<nscore;iscore++) {
+ merge_clusters:
+  for (iscore=iscore_start;iscore<nscore;iscore++) {
 
     /* NB: NEW CLUSTER ID WILL BE MINIMUM OF INPUT IDs,
        SO MASTER CLUSTER WILL ALWAYS BE CLUSTER 0. */
@@ -480,16 +989,38 @@ LPOSequence_T *buildup_progressive_lpo(int nseq,LPOSequence_T **all_seqs,
     else /* CLUSTERS ALREADY FUSED, SO SKIP THIS PAIR */
       continue;
 
-    new_seq = all_seqs[cluster_i];
-    total_alloc = new_seq->length * (sizeof(LPOLetter_T) + all_seqs[cluster_j]->length);
-    if (total_alloc>max_alloc) { /* DP RECTANGLE ARRAY SIZE */
-      max_alloc=total_alloc;
-      if (max_alloc>POA_MAX_ALLOC) {
-	WARN_MSG(TRAP,(ERRTXT,"Exceeded memory bound: %d\n Exiting!\n\n",max_alloc),"$Revision: 1.2.2.9 $");
-	break; /* JUST RETURN AND FINISH */
+    /* -speculate: THE NEXT MERGES INTO cluster_i ARE ALIGNED TO ONE
+       SNAPSHOT OF IT; A BATCH ENDS WHERE PRUNING OR A CHECKPOINT IS DUE */
+    nbatch=1;
+    if (speculate && speculate->nbatch>1) {
+      REALLOC(batch_cluster,speculate->nbatch,int);
+      REALLOC(batch_seq,speculate->nbatch,LPOSequence_T *);
+      batch_cluster[0]=cluster_j;
+      for (k=iscore+1;k<nscore && nbatch<speculate->nbatch;k++) {
+	if (prune && prune->every>0 && (nfusion+nbatch)%prune->every==0)
+	  break;
+	if (checkpoint && checkpoint->filename && checkpoint->every>0
+	    && (nfusion+nbatch)%checkpoint->every==0)
+	  break;
+	i=speculative_cluster(seq_cluster[score[k].i],cluster_i,nbatch,batch_cluster);
+	j=speculative_cluster(seq_cluster[score[k].j],cluster_i,nbatch,batch_cluster);
+	if ((i<j ? i : j)!=cluster_i || i==j) /* MUST MERGE A NEW CLUSTER INTO cluster_i */
+	  break;
+	batch_cluster[nbatch++]=(i<j) ? j : i;
       }
     }
 
+    new_seq = all_seqs[cluster_i];
+    LOOPF (ibatch,nbatch) {
+      total_alloc = new_seq->length * (sizeof(LPOLetter_T) + all_seqs[ibatch>0 ? batch_cluster[ibatch] : cluster_j]->length);
+      if (total_alloc>max_alloc) /* DP RECTANGLE ARRAY SIZE */
+	max_alloc=total_alloc;
+    }
+    if (max_alloc>POA_MAX_ALLOC) {
+      WARN_MSG(TRAP,(ERRTXT,"Exceeded memory bound: %d\n Exiting!\n\n",max_alloc),"$Revision: 1.2.2.9 $");
+      break; /* JUST RETURN AND FINISH */
+    }
+
 #ifdef USE_LOCAL_NEUTRALITY_CORRECTION /* NO LONGER USED */
     if (score_matrix->nfreq>0) { /* CALCULATE BALANCED SCORING ON EACH PO */
       balance_matrix_score(new_seq->length,new_seq->letter,score_matrix);
@@ -498,25 +1029,65 @@ LPOSequence_T *buildup_progressive_lpo(int nseq,LPOSequence_T **all_seqs,
     }
 #endif
 
-    buildup_pairwise_lpo(new_seq,all_seqs[cluster_j],score_matrix,
-			 use_aggressive_fusion,
-                         scoring_function,use_global_alignment);
+    nfolded=0; /* SOURCES ALREADY FOLDED INTO LINK WEIGHTS, IF ANY */
+    if (consensus_only && cluster_size[cluster_i]>initial_nseq[cluster_i])
+      nfolded=new_seq->nsource_seq;
+    if (nbatch>1) {
+      LOOPF (ibatch,nbatch)
+	batch_seq[ibatch]=all_seqs[batch_cluster[ibatch]];
+      buildup_speculative_lpo(new_seq,nbatch,batch_seq,score_matrix,
+			      use_aggressive_fusion,scoring_function,
+			      use_global_alignment,speculate->nthread);
+    }
+    else
+      buildup_pairwise_lpo(new_seq,all_seqs[cluster_j],score_matrix,
+			   use_aggressive_fusion,
+			   scoring_function,use_global_alignment);
+    if (consensus_only) /* KEEP ONLY LINK WEIGHTS, NOT PER-SEQUENCE PATHS */
+      fold_lpo_sources(new_seq,nfolded);
+
+    LOOPF (ibatch,nbatch) {
+      cluster_j=(ibatch>0) ? batch_cluster[ibatch] : cluster_j;
+      if (consensus_only) {
+	free_lpo_sourceinfo(all_seqs[cluster_j]->nsource_seq, /* COPIED TO */
+			    all_seqs[cluster_j]->source_seq,TRUE); /* new_seq */
+	all_seqs[cluster_j]->source_seq=NULL;
+	all_seqs[cluster_j]->nsource_seq=0;
+      }
 
-    LOOP (i,nseq) {  /* APPEND ALL MEMBERS OF cluster_j TO cluster_i */
-      if (seq_cluster[i] == cluster_j) {
-	seq_cluster[i] = cluster_i;
-      	seq_id_in_cluster[i] += cluster_size[cluster_i];
+      LOOP (i,nseq) {  /* APPEND ALL MEMBERS OF cluster_j TO cluster_i */
+	if (seq_cluster[i] == cluster_j) {
+	  seq_cluster[i] = cluster_i;
+	  seq_id_in_cluster[i] += cluster_size[cluster_i];
+	}
       }
+      cluster_size[cluster_i] += cluster_size[cluster_j];
+      cluster_size[cluster_j] = 0;
+
+      nfusion++;
     }
-    cluster_size[cluster_i] += cluster_size[cluster_j];
-    cluster_size[cluster_j] = 0;
+    iscore+=nbatch-1; /* THE BATCH USED UP THIS MANY MORE PAIRS */
+    if (prune && prune->every>0 && nfusion%prune->every==0)
+      prune_lpo(new_seq,prune->min_weight, /* SPARE THE LATEST ADDITIONS */
+		new_seq->nsource_seq - prune->every);
+    if (checkpoint && checkpoint->filename && checkpoint->every>0
+	&& nfusion%checkpoint->every==0) /* SAVE PROGRESS: RESUME AT iscore+1 */
+      save_buildup_checkpoint(checkpoint->filename,nseq,all_seqs,nscore,score,
+			      iscore+1,nfusion,seq_cluster,seq_id_in_cluster,
+			      cluster_size,initial_nseq);
   }
 
   if (preserve_sequence_order) {  /* PUT SEQUENCES WITHIN LPO BACK IN THEIR ORIGINAL ORDER: */
-    int *perm;
+    int *perm, *seq_rank = NULL;
     CALLOC (perm, nseq_tot, int);
+    if (seq_order) { /* ORIGINAL ORDER IS THE INPUT ORDER, NOT THE ADDING ORDER */
+      CALLOC (seq_rank, nseq, int);
+      LOOP (i,nseq)
+	seq_rank[seq_order[i]] = i;
+    }
 
-    for (i=nseq_tot=0; i<nseq; i++) {
+    for (k=nseq_tot=0; k<nseq; k++) {
+      i = seq_rank ? seq_rank[k] : k;
       for (j=0; j<initial_nseq[i]; j++) {
 	perm[seq_id_in_cluster[i] + j] = (nseq_tot++);
       }
@@ -525,9 +1096,14 @@ LPOSequence_T *buildup_progressive_lpo(int nseq,LPOSequence_T **all_seqs,
 
     reindex_lpo_source_seqs (new_seq, perm);
     FREE (perm);
+    FREE (seq_rank);
   }
 
   free_and_exit:
+  FREE (batch_cluster);
+  FREE (batch_seq);
+  FREE (ordered_seqs);
+  FREE (seq_order);
   FREE (initial_nseq);
   FREE (seq_cluster);
   FREE (cluster_size);
@@ -562,8 +1138,368 @@ LPOSequence_T *buildup_pairwise_lpo(LPOSequence_T seq1[],LPOSequence_T seq2[],
   /* FREE LETTERS IN SECOND LPO */
   free_lpo_letters(seq2->length,seq2->letter,TRUE);
   seq2->letter=NULL; /*MARK AS FREED. DON'T LEAVE DANGLING POINTER*/
+  if (seq2->view) /* CAN BE RELOADED FROM ITS FASTA VIEW IF EVER NEEDED */
+    FREE(seq2->sequence);
   FREE(al1); /* DUMP TEMPORARY MAPPING ARRAYS */
   FREE(al2);
   return seq1; /* RETURN THE FINAL LPO */
 }
 
+
+
+/* SPECULATIVE BUILDUP: A BATCH OF SEQUENCES IS ALIGNED IN PARALLEL TO ONE
+   SNAPSHOT OF THE PARTIAL ORDER, THEN FUSED ONE BY ONE.  A SNAPSHOT
+   ALIGNMENT STAYS VALID AS EARLIER SEQUENCES OF THE BATCH ARE FUSED
+   (fuse_lpo_remap() CARRIES ITS INDICES OVER), BUT IT CAN'T USE THE
+   LETTERS THEY ADDED; SO A SEQUENCE THAT DEVIATES FROM THE SNAPSHOT
+   WHERE, AND AS, AN EARLIER ONE IN ITS BATCH DID IS REALIGNED FIRST. */
+
+/** ONE DEVIATION OF AN ALIGNED SEQUENCE FROM THE PARTIAL ORDER: LETTERS
+    THAT WON'T BE FUSED, OR A SKIPPED STRETCH OF THE PARTIAL ORDER,
+    BETWEEN TWO FUSED ANCHOR LETTERS */
+typedef struct {
+  LPOLetterRef_T lo,hi; /* THE ANCHORS, LOWER INDEX FIRST */
+  int start,length; /* ITS RESIDUE CODES, IN residue[] OF ITS LIST */
+} SpeculativeRun_T;
+
+typedef struct {
+  int nrun,max_run;
+  SpeculativeRun_T *run;
+  int nresidue,max_residue;
+  char *residue;
+} SpeculativeRunList_T;
+
+/** THE SNAPSHOT ALIGNMENTS OF ONE BATCH, SHARED BY THE THREADS THAT
+    FILL THEM; ONLY next AND ncell CHANGE, AND ONLY UNDER lock */
+typedef struct {
+  LPOSequence_T *new_seq,**seq;
+  int nseq,next;
+  LPOLetterRef_T **al1,**al2;
+  ResidueScoreMatrix_T *m;
+  LPOScore_T (*scoring_function)(int,int,LPOLetter_T [],LPOLetter_T [],
+				 ResidueScoreMatrix_T *);
+  int use_global_alignment;
+  double ncell; /* DP CELLS FILLED BY ALL THE THREADS */
+  pthread_mutex_t lock;
+} SpeculativeBatch_T;
+
+
+/** alignment thread: takes sequences of the batch until none are left,
+    aligning with its own copy of the score matrix (see
+    copy_score_matrix()) */
+static void *align_speculative_batch(void *arg)
+{
+  int k;
+  SpeculativeBatch_T *batch=arg;
+  ResidueScoreMatrix_T *m=copy_score_matrix(batch->m);
+  double ncell=get_lpo_dp_cell_count();
+
+  while (1) {
+    pthread_mutex_lock(&batch->lock);
+    k=batch->next++;
+    pthread_mutex_unlock(&batch->lock);
+    if (k>=batch->nseq)
+      break;
+    align_lpo_po(batch->new_seq,batch->seq[k],m,batch->al1+k,batch->al2+k,
+		 batch->scoring_function,batch->use_global_alignment);
+  }
+  pthread_mutex_lock(&batch->lock);
+  batch->ncell+=get_lpo_dp_cell_count()-ncell;
+  pthread_mutex_unlock(&batch->lock);
+  free_score_matrix_copy(m);
+  return NULL;
+}
+
+
+/** TRUE IF letter i OF THE PARTIAL ORDER LINKS RIGHT TO LETTER j */
+static int speculative_link(LPOLetter_T letter[],LPOLetterRef_T i,
+			    LPOLetterRef_T j)
+{
+  LPOLetterLink_T *link;
+
+  for (link= &letter[i].right;link && link->ipos>=0;link=link->more)
+    if (link->ipos==j)
+      return TRUE;
+  return FALSE;
+}
+
+
+/** appends the deviations of seq from new_seq under the alignment
+    y_to_x to list (see SpeculativeRun_T) */
+static void find_speculative_runs(LPOSequence_T *new_seq,LPOSequence_T *seq,
+				  LPOLetterRef_T y_to_x[],
+				  SpeculativeRunList_T *list)
+{
+  int y,run_start=0,fused;
+  LPOLetterRef_T prev= -1,x;
+  SpeculativeRun_T *run;
+
+  for (y=0;y<=seq->length;y++) { /* y==seq->length CLOSES THE LAST RUN */
+    x=(y<seq->length) ? y_to_x[y] : -1;
+    fused=(y<seq->length && x>=0
+	   && new_seq->letter[x].letter==seq->letter[y].letter);
+    if (y<seq->length && !fused)
+      continue;
+    if ((prev>=0 || x>=0) && (y>run_start || (prev>=0 && x>=0
+	&& !speculative_link(new_seq->letter,prev,x)))) {
+      if (list->nrun>=list->max_run) {
+	list->max_run=(list->max_run>0) ? 2*list->max_run : 64;
+	REALLOC(list->run,list->max_run,SpeculativeRun_T);
+      }
+      if (list->nresidue+y-run_start>=list->max_residue) {
+	list->max_residue=2*(list->nresidue+y-run_start)+64;
+	REALLOC(list->residue,list->max_residue,char);
+      }
+      run=list->run+list->nrun++;
+      run->lo=(prev<0 || (x>=0 && x<prev)) ? x : prev;
+      run->hi=(x<0 || (prev>=0 && prev>x)) ? prev : x;
+      run->start=list->nresidue;
+      run->length=y-run_start;
+      for (;run_start<y;run_start++)
+	list->residue[list->nresidue++]=seq->letter[run_start].letter;
+    }
+    prev=x;
+    run_start=y+1;
+  }
+}
+
+
+/** number of runs of own that repeat a run of changed: the same
+    residues between the same anchors */
+static int speculative_runs_meet(SpeculativeRunList_T *changed,
+				 SpeculativeRunList_T *own)
+{
+  int i,j,nmeet=0;
+  SpeculativeRun_T *a,*b;
+
+  LOOPF (i,own->nrun) {
+    a=own->run+i;
+    LOOPF (j,changed->nrun) {
+      b=changed->run+j;
+      if (a->lo==b->lo && a->hi==b->hi && a->length==b->length
+	  && memcmp(own->residue+a->start,changed->residue+b->start,
+		    a->length)==0) {
+	nmeet++;
+	break;
+      }
+    }
+  }
+  return nmeet;
+}
+
+
+/** fuses seq[0..nseq-1] into new_seq in order, like buildup_lpo(), but
+    first aligns all of them to new_seq as it stands, on nthread threads.
+    Before each sequence is fused, its alignment is carried over to the
+    partial order grown by the earlier ones; if it deviates from the
+    partial order in the way one of those did, it is realigned instead.
+    The letters of seq[] are freed after fusion.  Returns the number of
+    sequences that were realigned */
+int buildup_speculative_lpo(LPOSequence_T *new_seq,
+			    int nseq,LPOSequence_T *seq[],
+			    ResidueScoreMatrix_T *score_matrix,
+			    int use_aggressive_fusion,
+			    LPOScore_T (*scoring_function)
+			    (int,int,LPOLetter_T [],LPOLetter_T [],
+			     ResidueScoreMatrix_T *),
+			    int use_global_alignment,
+			    int nthread)
+{
+  int i,j,k,y,nremap,nrealigned=0;
+  double ncell;
+  LPOLetterRef_T *remap=NULL;
+  SpeculativeBatch_T batch;
+  SpeculativeRunList_T changed,own;
+  pthread_t *thread=NULL;
+
+  lpo_index_symbols(new_seq,score_matrix); /* MAKE SURE LPO IS TRANSLATED */
+  LOOPF (k,nseq) /* FASTA VIEWS ARE LOADED BEFORE THE THREADS START */
+    lpo_index_symbols(seq[k],score_matrix);
+
+  memset(&batch,0,sizeof(batch));
+  batch.new_seq=new_seq;
+  batch.seq=seq;
+  batch.nseq=nseq;
+  batch.m=score_matrix;
+  batch.scoring_function=scoring_function;
+  batch.use_global_alignment=use_global_alignment;
+  CALLOC(batch.al1,nseq,LPOLetterRef_T *);
+  CALLOC(batch.al2,nseq,LPOLetterRef_T *);
+  pthread_mutex_init(&batch.lock,NULL);
+  if (nthread>nseq)
+    nthread=nseq;
+  if (nthread<1)
+    nthread=1;
+  CALLOC(thread,nthread,pthread_t);
+  ncell=get_lpo_dp_cell_count();
+  for (i=1;i<nthread;i++) /* THIS THREAD IS WORKER 0 */
+    if (pthread_create(thread+i,NULL,align_speculative_batch,&batch)) {
+      WARN_MSG(TRAP,(ERRTXT,"Couldn't start alignment thread %d\n",i),"$Revision: 1.2.2.9 $");
+      nthread=i;
+    }
+  align_speculative_batch(&batch);
+  for (i=1;i<nthread;i++)
+    pthread_join(thread[i],NULL);
+  pthread_mutex_destroy(&batch.lock);
+  add_lpo_dp_cell_count(batch.ncell-(get_lpo_dp_cell_count()-ncell));
+
+  memset(&changed,0,sizeof(changed));
+  memset(&own,0,sizeof(own));
+  LOOPF (k,nseq) {
+    if (k>0) { /* THE PARTIAL ORDER HAS GROWN SINCE seq[k] WAS ALIGNED */
+      own.nrun=own.nresidue=0;
+      find_speculative_runs(new_seq,seq[k],batch.al2[k],&own);
+      if (speculative_runs_meet(&changed,&own)>0) {
+	FREE(batch.al1[k]);
+	FREE(batch.al2[k]);
+	align_lpo_po(new_seq,seq[k],score_matrix,batch.al1+k,batch.al2+k,
+		     scoring_function,use_global_alignment);
+	nrealigned++;
+      }
+      else { /* REBUILD x_to_y FOR THE GROWN PARTIAL ORDER */
+	REALLOC(batch.al1[k],new_seq->length,LPOLetterRef_T);
+	LOOPF (i,new_seq->length)
+	  batch.al1[k][i]=INVALID_LETTER_POSITION;
+	LOOPF (y,seq[k]->length)
+	  if (batch.al2[k][y]>=0)
+	    batch.al1[k][batch.al2[k][y]]=y;
+      }
+    }
+    if (use_aggressive_fusion)
+      fuse_ring_identities(new_seq->length,new_seq->letter,
+			   seq[k]->length,seq[k]->letter,batch.al1[k],batch.al2[k]);
+    if (k<nseq-1)
+      find_speculative_runs(new_seq,seq[k],batch.al2[k],&changed);
+
+    nremap=2*changed.nrun; /* INDICES TO CARRY OVER TO THE FUSED ORDER */
+    for (j=k+1;j<nseq;j++)
+      LOOPF (y,seq[j]->length)
+	if (batch.al2[j][y]>=0)
+	  nremap++;
+    REALLOC(remap,nremap+1,LPOLetterRef_T);
+    nremap=0;
+    LOOPF (i,changed.nrun) {
+      remap[nremap++]=changed.run[i].lo;
+      remap[nremap++]=changed.run[i].hi;
+    }
+    for (j=k+1;j<nseq;j++)
+      LOOPF (y,seq[j]->length)
+	if (batch.al2[j][y]>=0)
+	  remap[nremap++]=batch.al2[j][y];
+
+    fuse_lpo_remap(new_seq,seq[k],batch.al1[k],batch.al2[k],nremap,remap);
+
+    nremap=0;
+    LOOPF (i,changed.nrun) {
+      changed.run[i].lo=remap[nremap++];
+      changed.run[i].hi=remap[nremap++];
+    }
+    for (j=k+1;j<nseq;j++)
+      LOOPF (y,seq[j]->length)
+	if (batch.al2[j][y]>=0)
+	  batch.al2[j][y]=remap[nremap++];
+
+    free_lpo_letters(seq[k]->length,seq[k]->letter,TRUE);/*NO NEED TO KEEP*/
+    seq[k]->letter=NULL; /* MARK AS FREED... DON'T LEAVE DANGLING POINTER! */
+    if (seq[k]->view) /* CAN BE RELOADED FROM ITS FASTA VIEW IF EVER NEEDED */
+      FREE(seq[k]->sequence);
+    FREE(batch.al1[k]); /* DUMP TEMPORARY MAPPING ARRAYS */
+    FREE(batch.al2[k]);
+  }
+
+  FREE(remap);
+  FREE(changed.run);
+  FREE(changed.residue);
+  FREE(own.run);
+  FREE(own.residue);
+  FREE(thread);
+  FREE(batch.al1);
+  FREE(batch.al2);
+  return nrealigned;
+}
+
+
+
+/** builds the partial order of each of ncluster independent clusters of
+    linear sequences, seqs[c][0..nseq[c]-1], adding each cluster's
+    sequences to seqs[c][0] in order, as the iterative
+    buildup_progressive_lpo() does.  Clusters of similar shape share a
+    batch of LPO_BATCH_LANES, and each step aligns the next sequence of
+    every cluster in the batch at once (see align_lpo_po_batch()), then
+    fuses each alignment into its own cluster.  If consensus_only, every
+    fused sequence is folded into link weights right away (see
+    fold_lpo_sources()).  Each partial order is left in seqs[c][0];
+    returns the number of sequences fused. */
+int buildup_lpo_batch(int ncluster,int nseq[],LPOSequence_T *seqs[],
+		      ResidueScoreMatrix_T *score_matrix,
+		      int use_aggressive_fusion,
+		      int use_global_alignment,
+		      int consensus_only)
+{
+  int i,c,t,ibatch,nbatch,nprob,max_nseq,nfolded,nfused=0;
+  int *cluster_order=NULL;
+  double *key=NULL;
+  LPOSequence_T *seq_x[LPO_BATCH_LANES],*seq_y[LPO_BATCH_LANES];
+  LPOLetterRef_T *al1[LPO_BATCH_LANES],*al2[LPO_BATCH_LANES];
+
+  /* SIMILAR SHAPES SHARE A BATCH: MOST SEQUENCES, THEN LONGEST, FIRST */
+  CALLOC(cluster_order,ncluster,int);
+  CALLOC(key,ncluster,double);
+  LOOPF (c,ncluster)
+    key[c]=nseq[c]*1e9 + (seqs[c][0].letter ? seqs[c][0].length
+			  : seqs[c][0].view_length);
+  sort_buildup_order(ncluster,key,cluster_order);
+  FREE(key);
+
+  for (ibatch=0;ibatch<ncluster;ibatch+=LPO_BATCH_LANES) {
+    nbatch=(ncluster-ibatch<LPO_BATCH_LANES) ? ncluster-ibatch : LPO_BATCH_LANES;
+    max_nseq=0;
+    LOOPF (i,nbatch) {
+      c=cluster_order[ibatch+i];
+      if (nseq[c]>0)
+	lpo_index_symbols(&seqs[c][0],score_matrix); /* MAKE SURE LPO IS TRANSLATED */
+      if (nseq[c]>max_nseq)
+	max_nseq=nseq[c];
+    }
+
+    for (t=1;t<max_nseq;t++) { /* ADD THE t-TH SEQUENCE OF EVERY CLUSTER */
+      nprob=0;
+      LOOPF (i,nbatch) {
+	c=cluster_order[ibatch+i];
+	if (t<nseq[c]) {
+	  lpo_index_symbols(&seqs[c][t],score_matrix);
+	  seq_x[nprob]=&seqs[c][0];
+	  seq_y[nprob++]=&seqs[c][t];
+	}
+      }
+      align_lpo_po_batch(nprob,seq_x,seq_y,score_matrix,al1,al2,NULL,
+			 use_global_alignment);
+
+      LOOPF (i,nprob) { /* FUSE EACH LANE INTO ITS OWN CLUSTER */
+	nfolded=(t>1) ? seq_x[i]->nsource_seq : 0;
+	if (use_aggressive_fusion)
+	  fuse_ring_identities(seq_x[i]->length,seq_x[i]->letter,
+			       seq_y[i]->length,seq_y[i]->letter,al1[i],al2[i]);
+	fuse_lpo(seq_x[i],seq_y[i],al1[i],al2[i]);
+
+	free_lpo_letters(seq_y[i]->length,seq_y[i]->letter,TRUE);
+	seq_y[i]->letter=NULL; /*MARK AS FREED. DON'T LEAVE DANGLING POINTER*/
+	if (seq_y[i]->view) /* CAN BE RELOADED FROM ITS FASTA VIEW IF EVER NEEDED */
+	  FREE(seq_y[i]->sequence);
+	FREE(al1[i]);
+	FREE(al2[i]);
+
+	if (consensus_only) { /* KEEP ONLY LINK WEIGHTS, NOT PER-SEQUENCE PATHS */
+	  fold_lpo_sources(seq_x[i],nfolded);
+	  free_lpo_sourceinfo(seq_y[i]->nsource_seq,seq_y[i]->source_seq,TRUE);
+	  seq_y[i]->source_seq=NULL;
+	  seq_y[i]->nsource_seq=0;
+	}
+	nfused++;
+      }
+    }
+  }
+
+  FREE(cluster_order);
+  return nfused;
+}
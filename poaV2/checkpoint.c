@@ -0,0 +1,372 @@
+#include "default.h"
+#include "poa.h"
+#include "seq_util.h"
+#include "lpo.h"
+
+#include <unistd.h>
+
+
+/** FIRST BYTES OF EVERY CHECKPOINT FILE; BUMP THE DIGIT IF THE LAYOUT CHANGES */
+#define LPO_CHECKPOINT_MAGIC "POACKPT3"
+#define LPO_CHECKPOINT_MAGIC_LENGTH 8
+
+
+
+/* RAW BLOCK I/O: THE FILE IS ONLY EVER READ BACK BY THE SAME BINARY */
+
+static int write_block(FILE *ofile,const void *p,size_t size,int n)
+{
+  if (n<=0)
+    return 0;
+  return (fwrite(p,size,n,ofile)==(size_t)n) ? 0 : -1;
+}
+
+static int read_block(FILE *ifile,void *p,size_t size,int n)
+{
+  if (n<=0)
+    return 0;
+  return (fread(p,size,n,ifile)==(size_t)n) ? 0 : -1;
+}
+
+/** writes a string as its length followed by its bytes; NULL IS LENGTH -1 */
+static int write_string(FILE *ofile,const char s[])
+{
+  int len= s ? strlen(s) : -1;
+  if (write_block(ofile,&len,sizeof(int),1))
+    return -1;
+  return write_block(ofile,s,1,len);
+}
+
+/** reads a string saved by write_string() into a newly allocated buffer */
+static int read_string(FILE *ifile,char **p_s)
+{
+  int len;
+  *p_s=NULL;
+  if (read_block(ifile,&len,sizeof(int),1))
+    return -1;
+  if (len<0) /* SAVED AS NULL */
+    return 0;
+  CALLOC(*p_s,len+1,char);
+  return read_block(ifile,*p_s,1,len);
+}
+
+
+
+/** writes a link list, including its (embedded) head node, as a count
+ followed by (ipos,score,weight) entries in list order */
+static int write_link_list(FILE *ofile,LPOLetterLink_T *list)
+{
+  int n=0;
+  LPOLetterLink_T *link;
+  for (link=list;link;link=link->more)
+    n++;
+  if (write_block(ofile,&n,sizeof(int),1))
+    return -1;
+  for (link=list;link;link=link->more) {
+    if (write_block(ofile,&link->ipos,sizeof(LPOLetterRef_T),1))
+      return -1;
+#ifdef USE_WEIGHTED_LINKS
+    if (write_block(ofile,&link->score,sizeof(LPOScore_T),1))
+      return -1;
+#endif
+    if (write_block(ofile,&link->weight,sizeof(int),1))
+      return -1;
+  }
+  return 0;
+}
+
+static int read_link_list(FILE *ifile,LPOLetterLink_T *list)
+{
+  int i,n;
+  LPOLetterLink_T *link=list;
+  if (read_block(ifile,&n,sizeof(int),1))
+    return -1;
+  LOOPF (i,n) {
+    if (i>0) { /* HEAD IS EMBEDDED IN THE LETTER; THE REST ARE ALLOCATED */
+      CALLOC(link->more,1,LPOLetterLink_T);
+      link=link->more;
+    }
+    if (read_block(ifile,&link->ipos,sizeof(LPOLetterRef_T),1))
+      return -1;
+#ifdef USE_WEIGHTED_LINKS
+    if (read_block(ifile,&link->score,sizeof(LPOScore_T),1))
+      return -1;
+#endif
+    if (read_block(ifile,&link->weight,sizeof(int),1))
+      return -1;
+  }
+  return 0;
+}
+
+static int write_source_list(FILE *ofile,LPOLetterSource_T *list)
+{
+  int n=0;
+  LPOLetterSource_T *source;
+  for (source=list;source;source=source->more)
+    n++;
+  if (write_block(ofile,&n,sizeof(int),1))
+    return -1;
+  for (source=list;source;source=source->more)
+    if (write_block(ofile,&source->iseq,sizeof(int),1)
+	|| write_block(ofile,&source->ipos,sizeof(LPOLetterRef_T),1))
+      return -1;
+  return 0;
+}
+
+static int read_source_list(FILE *ifile,LPOLetterSource_T *list)
+{
+  int i,n;
+  LPOLetterSource_T *source=list;
+  if (read_block(ifile,&n,sizeof(int),1))
+    return -1;
+  LOOPF (i,n) {
+    if (i>0) { /* HEAD IS EMBEDDED IN THE LETTER; THE REST ARE ALLOCATED */
+      CALLOC(source->more,1,LPOLetterSource_T);
+      source=source->more;
+    }
+    if (read_block(ifile,&source->iseq,sizeof(int),1)
+	|| read_block(ifile,&source->ipos,sizeof(LPOLetterRef_T),1))
+      return -1;
+  }
+  return 0;
+}
+
+
+
+/** writes seq in a compact binary form that read_lpo_binary() restores
+ exactly, including the order of every link and source list.  The
+ seq_to_po[] and po_to_seq[] indexes are not saved: they are rebuilt on
+ demand by build_seq_to_po_index().  Returns 0 on success. */
+int write_lpo_binary(FILE *ofile,LPOSequence_T *seq)
+{
+  int i,j;
+  LPOSourceInfo_T *source_seq;
+
+  if (write_block(ofile,&seq->length,sizeof(int),1)
+      || write_block(ofile,seq->name,1,SEQUENCE_NAME_MAX)
+      || write_string(ofile,seq->title)
+      || write_string(ofile,seq->sequence)
+      || write_block(ofile,&seq->nsource_seq,sizeof(int),1))
+    return -1;
+
+  LOOPF (i,seq->nsource_seq) { /* SOURCE SEQUENCE INFO */
+    source_seq=seq->source_seq+i;
+    if (write_block(ofile,source_seq->name,1,SEQUENCE_NAME_MAX)
+	|| write_string(ofile,source_seq->title)
+	|| write_string(ofile,source_seq->sequence)
+	|| write_block(ofile,&source_seq->length,sizeof(int),1)
+	|| write_block(ofile,&source_seq->istart,sizeof(int),1)
+	|| write_block(ofile,&source_seq->weight,sizeof(int),1)
+	|| write_block(ofile,&source_seq->bundle_id,sizeof(int),1)
+	|| write_block(ofile,&source_seq->ndata,sizeof(int),1))
+      return -1;
+    LOOPF (j,source_seq->ndata)
+      if (write_block(ofile,source_seq->data[j].name,1,SEQUENCE_NAME_MAX)
+	  || write_string(ofile,source_seq->data[j].title)
+	  || write_block(ofile,source_seq->data[j].data,sizeof(double),
+			 source_seq->length))
+	return -1;
+  }
+
+  LOOPF (i,seq->length) { /* LETTERS, WITH ALL THEIR LINKED LISTS */
+    if (write_block(ofile,&seq->letter[i].letter,sizeof(char),1)
+	|| write_block(ofile,&seq->letter[i].score,sizeof(float),1)
+	|| write_block(ofile,&seq->letter[i].align_ring,sizeof(LPOLetterRef_T),1)
+	|| write_block(ofile,&seq->letter[i].ring_id,sizeof(LPOLetterRef_T),1)
+	|| write_link_list(ofile,&seq->letter[i].left)
+	|| write_link_list(ofile,&seq->letter[i].right)
+	|| write_source_list(ofile,&seq->letter[i].source))
+      return -1;
+  }
+  return write_lpo_tracks(ofile,seq); /* NUMERIC TRACKS, IF ANY */
+}
+
+
+/** reads an LPO saved by write_lpo_binary() into seq, which must be
+ empty (e.g. just cleared by free_lpo_sequence(seq,FALSE)).  The view
+ fields of seq are left untouched.  Returns 0 on success. */
+int read_lpo_binary(FILE *ifile,LPOSequence_T *seq)
+{
+  int i,j,ndata;
+  LPOSourceInfo_T *source_seq;
+  LPONumericData_T *data;
+
+  if (read_block(ifile,&seq->length,sizeof(int),1)
+      || read_block(ifile,seq->name,1,SEQUENCE_NAME_MAX)
+      || read_string(ifile,&seq->title)
+      || read_string(ifile,&seq->sequence)
+      || read_block(ifile,&seq->nsource_seq,sizeof(int),1))
+    return -1;
+
+  /* ROUND UP TO THE BUFFER CHUNK, SO save_lpo_source() CAN REBUFF IT */
+  CALLOC(seq->source_seq,(seq->nsource_seq/SOURCE_SEQ_BUFFER_CHUNK+1)
+	 *SOURCE_SEQ_BUFFER_CHUNK,LPOSourceInfo_T);
+  LOOPF (i,seq->nsource_seq) { /* SOURCE SEQUENCE INFO */
+    source_seq=seq->source_seq+i;
+    if (read_block(ifile,source_seq->name,1,SEQUENCE_NAME_MAX)
+	|| read_string(ifile,&source_seq->title)
+	|| read_string(ifile,&source_seq->sequence)
+	|| read_block(ifile,&source_seq->length,sizeof(int),1)
+	|| read_block(ifile,&source_seq->istart,sizeof(int),1)
+	|| read_block(ifile,&source_seq->weight,sizeof(int),1)
+	|| read_block(ifile,&source_seq->bundle_id,sizeof(int),1)
+	|| read_block(ifile,&ndata,sizeof(int),1))
+      return -1;
+    LOOPF (j,ndata) {
+      data=new_numeric_data(source_seq,"",NULL,0.);
+      if (read_block(ifile,data->name,1,SEQUENCE_NAME_MAX)
+	  || read_string(ifile,&data->title)
+	  || read_block(ifile,data->data,sizeof(double),source_seq->length))
+	return -1;
+    }
+  }
+
+  CALLOC(seq->letter,seq->length,LPOLetter_T);
+  LOOPF (i,seq->length) { /* LETTERS, WITH ALL THEIR LINKED LISTS */
+    if (read_block(ifile,&seq->letter[i].letter,sizeof(char),1)
+	|| read_block(ifile,&seq->letter[i].score,sizeof(float),1)
+	|| read_block(ifile,&seq->letter[i].align_ring,sizeof(LPOLetterRef_T),1)
+	|| read_block(ifile,&seq->letter[i].ring_id,sizeof(LPOLetterRef_T),1)
+	|| read_link_list(ifile,&seq->letter[i].left)
+	|| read_link_list(ifile,&seq->letter[i].right)
+	|| read_source_list(ifile,&seq->letter[i].source))
+      return -1;
+  }
+  return read_lpo_tracks(ifile,1,seq)<0 ? -1 : 0;
+}
+
+
+
+
+/** saves the state of buildup_progressive_lpo() after its first iscore
+ pair merges: the sorted pair list, the cluster tables, and every
+ cluster LPO that has absorbed other clusters.  Clusters still holding
+ only their input sequence are not saved; they are rebuilt from the input
+ on resume.  The file is written to FILE.tmp and renamed over FILE, so an
+ interrupted save never destroys the previous checkpoint.
+ Returns 0 on success. */
+int save_buildup_checkpoint(char filename[],int nseq,LPOSequence_T **all_seqs,
+			    int nscore,SeqPairScore_T score[],int iscore,
+			    int nfusion,int seq_cluster[],int seq_id_in_cluster[],
+			    int cluster_size[],int initial_nseq[])
+{
+  int i,nsaved=0,status=0;
+  char *tmp_filename=NULL;
+  FILE *ofile;
+
+  CALLOC(tmp_filename,strlen(filename)+5,char);
+  sprintf(tmp_filename,"%s.tmp",filename);
+  ofile=fopen(tmp_filename,"wb");
+  if (!ofile) {
+    WARN_MSG(USERR,(ERRTXT,"Can't write checkpoint file %s\n",tmp_filename),"$Revision: 1.1 $");
+    FREE(tmp_filename);
+    return -1;
+  }
+
+  LOOP (i,nseq) /* SAVE ONLY CLUSTERS THAT GREW BY FUSION */
+    if (cluster_size[i]>initial_nseq[i])
+      nsaved++;
+
+  if (write_block(ofile,LPO_CHECKPOINT_MAGIC,1,LPO_CHECKPOINT_MAGIC_LENGTH)
+      || write_block(ofile,&nseq,sizeof(int),1)
+      || write_block(ofile,&nscore,sizeof(int),1)
+      || write_block(ofile,&iscore,sizeof(int),1)
+      || write_block(ofile,&nfusion,sizeof(int),1)
+      || write_block(ofile,score,sizeof(SeqPairScore_T),nscore)
+      || write_block(ofile,seq_cluster,sizeof(int),nseq)
+      || write_block(ofile,seq_id_in_cluster,sizeof(int),nseq)
+      || write_block(ofile,cluster_size,sizeof(int),nseq)
+      || write_block(ofile,&nsaved,sizeof(int),1))
+    status= -1;
+  LOOP (i,nseq)
+    if (0==status && cluster_size[i]>initial_nseq[i])
+      if (write_block(ofile,&i,sizeof(int),1)
+	  || write_lpo_binary(ofile,all_seqs[i]))
+	status= -1;
+
+  if (fflush(ofile) || fsync(fileno(ofile)))
+    status= -1;
+  fclose(ofile);
+  if (0==status && rename(tmp_filename,filename))
+    status= -1;
+  if (status) {
+    WARN_MSG(USERR,(ERRTXT,"Error writing checkpoint file %s\n",filename),"$Revision: 1.1 $");
+    remove(tmp_filename);
+  }
+  FREE(tmp_filename);
+  return status;
+}
+/**@memo example: checkpoint after every 100 merges:
+      if (++nfusion%100==0)
+        save_buildup_checkpoint(filename,nseq,all_seqs,nscore,score,iscore+1,
+                                nfusion,seq_cluster,seq_id_in_cluster,
+                                cluster_size,initial_nseq);
+*/
+
+
+
+/** restores a checkpoint written by save_buildup_checkpoint() for the
+ same nseq inputs: returns the pair list in *p_score, the number of
+ pairs already merged in *p_iscore, and overwrites the cluster tables and
+ the fused cluster LPOs in all_seqs[].  Clusters that were absorbed are
+ released, as buildup_pairwise_lpo() would have done.
+ Returns 1 if restored, 0 if filename does not exist, -1 on error. */
+int load_buildup_checkpoint(char filename[],int nseq,LPOSequence_T **all_seqs,
+			    int *p_nscore,SeqPairScore_T **p_score,
+			    int *p_iscore,int *p_nfusion,int seq_cluster[],
+			    int seq_id_in_cluster[],int cluster_size[])
+{
+  int i,icluster,nsaved,saved_nseq;
+  char magic[LPO_CHECKPOINT_MAGIC_LENGTH];
+  FILE *ifile;
+
+  ifile=fopen(filename,"rb");
+  if (!ifile) /* NO CHECKPOINT YET: START FROM THE BEGINNING */
+    return 0;
+
+  if (read_block(ifile,magic,1,LPO_CHECKPOINT_MAGIC_LENGTH)
+      || memcmp(magic,LPO_CHECKPOINT_MAGIC,LPO_CHECKPOINT_MAGIC_LENGTH)
+      || read_block(ifile,&saved_nseq,sizeof(int),1)
+      || saved_nseq!=nseq) {
+    WARN_MSG(USERR,(ERRTXT,"%s is not a checkpoint for these %d input sequences\n",
+		    filename,nseq),"$Revision: 1.1 $");
+    fclose(ifile);
+    return -1;
+  }
+  if (read_block(ifile,p_nscore,sizeof(int),1)
+      || read_block(ifile,p_iscore,sizeof(int),1)
+      || read_block(ifile,p_nfusion,sizeof(int),1))
+    goto read_error;
+  CALLOC(*p_score,*p_nscore>0 ? *p_nscore : 1,SeqPairScore_T);
+  if (read_block(ifile,*p_score,sizeof(SeqPairScore_T),*p_nscore)
+      || read_block(ifile,seq_cluster,sizeof(int),nseq)
+      || read_block(ifile,seq_id_in_cluster,sizeof(int),nseq)
+      || read_block(ifile,cluster_size,sizeof(int),nseq)
+      || read_block(ifile,&nsaved,sizeof(int),1))
+    goto read_error;
+
+  LOOP (i,nsaved) { /* REPLACE FUSED CLUSTERS BY THEIR SAVED LPOs */
+    if (read_block(ifile,&icluster,sizeof(int),1) || icluster<0 || icluster>=nseq)
+      goto read_error;
+    free_lpo_sequence(all_seqs[icluster],FALSE);
+    all_seqs[icluster]->nsource_seq=0;
+    if (read_lpo_binary(ifile,all_seqs[icluster]))
+      goto read_error;
+  }
+  fclose(ifile);
+
+  LOOP (i,nseq) /* DROP CLUSTERS ALREADY MERGED INTO ANOTHER */
+    if (0==cluster_size[i] && all_seqs[i]->letter) {
+      free_lpo_letters(all_seqs[i]->length,all_seqs[i]->letter,TRUE);
+      all_seqs[i]->letter=NULL; /* MARK AS FREED. DON'T LEAVE DANGLING POINTER */
+      if (all_seqs[i]->view)
+	FREE(all_seqs[i]->sequence);
+    }
+  return 1;
+
+ read_error:
+  WARN_MSG(USERR,(ERRTXT,"Truncated or corrupt checkpoint file %s\n",filename),"$Revision: 1.1 $");
+  fclose(ifile);
+  FREE(*p_score);
+  return -1;
+}
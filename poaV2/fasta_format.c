@@ -2,6 +2,11 @@
 #include "default.h"
 #include "seq_util.h"
 
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 
 
 /** reads FASTA formatted sequence file, and saves the sequences to
@@ -75,6 +80,166 @@ int read_fasta(FILE *seq_file,Sequence_T **seq,
 
 
 
+/** maps the file filename read-only into memory, returning a pointer to
+  its text and storing its size in *p_size; returns NULL if the file
+  cannot be mapped (e.g. it is empty or not a regular file), in which
+  case the caller should fall back to read_fasta() */
+char *map_fasta_file(char filename[],size_t *p_size)
+{
+  int fd;
+  struct stat st;
+  char *text;
+
+  if ((fd=open(filename,O_RDONLY))<0)
+    return NULL;
+  if (fstat(fd,&st)<0 || !S_ISREG(st.st_mode) || st.st_size<=0) {
+    close(fd);
+    return NULL;
+  }
+  text=mmap(NULL,(size_t)st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+  close(fd); /* THE MAPPING STAYS VALID AFTER THE DESCRIPTOR IS CLOSED */
+  if (text==MAP_FAILED)
+    return NULL;
+  *p_size=(size_t)st.st_size;
+  return text;
+}
+
+
+void unmap_fasta_file(char *text,size_t size)
+{
+  if (text)
+    munmap(text,size);
+}
+
+
+
+
+/** counts the residues in a FASTA view, or copies them into out[] if
+  non-NULL, skipping whitespace and '#' or '*' lines like read_fasta() */
+static int scan_fasta_view(const char view[],int view_length,char out[],
+			   int do_switch_case)
+{
+  int i,len=0,line_start=1,skip_line=0;
+
+  LOOPF (i,view_length) {
+    if (line_start) /* COMMENT LINES ARE NOT SEQUENCE DATA */
+      skip_line=(view[i]=='#' || view[i]=='*');
+    line_start=(view[i]=='\n');
+    if (skip_line || isspace(view[i]))
+      continue;
+    if (out)
+      switch (do_switch_case) {
+      case switch_case_to_lower: out[len]=tolower(view[i]); break;
+      case switch_case_to_upper: out[len]=toupper(view[i]); break;
+      default: out[len]=view[i];
+      }
+    len++;
+  }
+  return len;
+}
+
+
+/** builds seq->sequence from its FASTA view; the residues are only
+  copied out of the mapped file when a sequence is about to be used.
+  Views flagged by -auto_strand come out reverse complemented */
+char *load_fasta_view(Sequence_T *seq)
+{
+  if (seq->sequence || !seq->view) /* ALREADY LOADED, OR NOTHING TO LOAD */
+    return seq->sequence;
+  CALLOC(seq->sequence,seq->length+1,char);
+  scan_fasta_view(seq->view,seq->view_length,seq->sequence,
+		  seq->view_switch_case);
+  if (seq->view_reverse_complement)
+    reverse_complement(seq->sequence);
+  return seq->sequence;
+}
+
+
+/** parses FASTA text (typically from map_fasta_file()) into seq[] just
+  like read_fasta(), except that no residues are copied: each sequence
+  only records its name, title, length and a view of its text, which
+  load_fasta_view() expands on demand.  text must stay mapped for as
+  long as seq[] is in use */
+int read_fasta_view(const char text[],size_t size,Sequence_T **seq,
+		    int do_switch_case,char **comment)
+{
+  int nseq=0,view_length;
+  size_t pos=0,line_end,header_len;
+  const char *view=NULL;
+  char seq_name[FASTA_NAME_MAX]="",line[SEQ_LENGTH_MAX],
+    seq_title[FASTA_NAME_MAX]="";
+  Sequence_T *new_seq;
+
+  while (pos<size) {
+    for (line_end=pos;line_end<size && text[line_end]!='\n';line_end++);
+    switch (text[pos]) {
+    case '#':  /* SEQUENCE COMMENT, SAVE IT */
+      if (nseq>0) /* UNIGENE CLUSTER TERMINATOR, SO DONE!*/
+	goto save_last_sequence;
+      if (comment) { /* SAVE COMMENT FOR CALLER TO USE */
+	header_len=line_end-pos-1 < sizeof(line)-1 ? line_end-pos-1 : sizeof(line)-1;
+	memcpy(line,text+pos+1,header_len);
+	line[header_len]='\0';
+	*comment = strdup(line);
+      }
+      break;
+
+    case '>':  /* SEQUENCE HEADER LINE */
+      if (seq_name[0] && view) { /* WE HAVE A SEQUENCE, SO SAVE IT! */
+	REBUFF(*seq,nseq,SEQUENCE_BUFFER_CHUNK,Sequence_T);
+	new_seq= (*seq)+nseq;
+	save_sequence_fields(new_seq,seq_name,seq_title,
+			     scan_fasta_view(view,view_length,NULL,0));
+	new_seq->view=view;
+	new_seq->view_length=view_length;
+	new_seq->view_switch_case=do_switch_case;
+	nseq++;
+      }
+      header_len=line_end-pos < sizeof(line)-1 ? line_end-pos : sizeof(line)-1;
+      memcpy(line,text+pos,header_len);
+      line[header_len]='\0';
+      seq_name[0]='\0';
+      if (sscanf(line+1,"%s %[^\n]",  /* SKIP PAST > TO READ SEQ NAME*/
+	     seq_name,seq_title)<2)
+	strcpy(seq_title,"untitled"); /* PROTECT AGAINST MISSING NAME */
+      view=NULL; /* RESET TO EMPTY SEQUENCE */
+      break;
+
+    case '*': /* IGNORE LINES STARTING WITH *... DON'T TREAT AS SEQUENCE! */
+      break;
+
+    default:  /* SEQUENCE DATA: EXTEND THE VIEW OF OUR SEQUENCE TO COVER IT */
+      if (seq_name[0] && line_end>pos) {
+	if (!view)
+	  view=text+pos;
+	view_length=(text+line_end)-view;
+      }
+    }
+    pos=line_end+1;
+  }
+ save_last_sequence:
+  if (seq_name[0] && view) { /* WE HAVE A SEQUENCE, SO SAVE IT! */
+    REBUFF(*seq,nseq,SEQUENCE_BUFFER_CHUNK,Sequence_T);
+    new_seq= (*seq)+nseq;
+    save_sequence_fields(new_seq,seq_name,seq_title,
+			 scan_fasta_view(view,view_length,NULL,0));
+    new_seq->view=view;
+    new_seq->view_length=view_length;
+    new_seq->view_switch_case=do_switch_case;
+    nseq++;
+  }
+  return nseq; /* TOTAL NUMBER OF SEQUENCES CREATED */
+}
+
+/**@memo example: reading a FASTA file without copying its sequences:
+    if (text=map_fasta_file(seq_filename,&size))
+      nseq=read_fasta_view(text,size,&seq,do_switch_case,&comment);
+    ...
+    unmap_fasta_file(text,size);
+*/
+
+
+
 /** writes a FASTA formatted file, saving the sequence given in seq[] */
 void write_fasta(FILE *ifile,char name[],char title[],char seq[])
 {
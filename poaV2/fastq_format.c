@@ -0,0 +1,90 @@
+#include "default.h"
+#include "poa.h"
+#include "seq_util.h"
+#include "lpo.h"
+
+
+
+/** reads FASTQ formatted sequences from ifile into the array seq[],
+  like read_fasta(), keeping each sequence's base qualities (Phred+33)
+  as a lpo_track_uint8 track named LPO_QUALITY_TRACK.  The track feeds
+  the link weights built by lpo_init() (see add_lpo_track_link_weights())
+  and is used by generate_lpo_bundles().  Sequence and quality may each
+  span several lines.  Returns the number of sequences read, or -1 if a
+  record is malformed. */
+int read_fastq(FILE *ifile,Sequence_T **seq,int do_switch_case)
+{
+  int i,nseq=0,length,nqual,itrack;
+  char *line=NULL,seq_name[FASTA_NAME_MAX],seq_title[FASTA_NAME_MAX];
+  size_t line_size=0;
+  ssize_t n;
+  unsigned char *qual=NULL;
+  stringptr tmp_seq=STRINGPTR_EMPTY_INIT;
+  Sequence_T *s;
+
+  while ((n=getline(&line,&line_size,ifile))>0) {
+    if ('\n'==line[0]) /* TOLERATE BLANK LINES BETWEEN RECORDS */
+      continue;
+    if ('@'!=line[0])
+      goto bad_record;
+    if (line[n-1]=='\n')
+      line[n-1]='\0';
+    seq_name[0]='\0';
+    if (sscanf(line+1,"%s %[^\n]",seq_name,seq_title)<2)
+      strcpy(seq_title,"untitled"); /* PROTECT AGAINST MISSING NAME */
+    if (!seq_name[0])
+      goto bad_record;
+
+    length=0; /* SEQUENCE LINES, UP TO THE '+' SEPARATOR */
+    if (tmp_seq.p)
+      tmp_seq.p[0]='\0';
+    while ((n=getline(&line,&line_size,ifile))>0 && '+'!=line[0]) {
+      if (line[n-1]=='\n')
+	line[n-1]='\0';
+      stringptr_cat_pos(&tmp_seq,line,&length);
+    }
+    if (n<=0)
+      goto bad_record;
+    for (i=0;tmp_seq.p && tmp_seq.p[i] && isspace(tmp_seq.p[i]);i++);
+    if (!tmp_seq.p || !tmp_seq.p[i]) { /* EMPTY RECORD: SKIP IT, AS read_fasta() DOES */
+      if (getline(&line,&line_size,ifile)>0 && '@'==line[0])
+	goto bad_record; /* NOT EVEN AN EMPTY QUALITY LINE */
+      continue;
+    }
+    if (!create_seq(nseq,seq,seq_name,seq_title,tmp_seq.p,do_switch_case))
+      continue;
+    s= (*seq)+nseq++;
+
+    itrack=new_lpo_track(s,LPO_QUALITY_TRACK,lpo_track_uint8);
+    s->track[itrack].link_weight_scale=1.;
+    qual=set_lpo_track_values(s,itrack,0,s->length);
+    for (nqual=0;nqual<s->length;) { /* AS MANY QUALITIES AS RESIDUES */
+      if ((n=getline(&line,&line_size,ifile))<=0)
+	goto bad_record;
+      for (i=0;i<n && nqual<s->length;i++)
+	if (!isspace(line[i])) /* PHRED+33 */
+	  qual[nqual++]= line[i]>'!' ? line[i]-'!' : 0;
+    }
+  }
+  FREE(line);
+  stringptr_free(&tmp_seq);
+  return nseq; /* TOTAL NUMBER OF SEQUENCES CREATED */
+
+ bad_record:
+  WARN_MSG(USERR,(ERRTXT,"Error: malformed FASTQ record after %d sequences (%s).\n",
+		  nseq,nseq>0 ? (*seq)[nseq-1].name : "none"),"$Revision: 1.2 $");
+  LOOP (i,nseq) /* DON'T HAND BACK HALF A FILE */
+    free_lpo_sequence((*seq)+i,FALSE);
+  FREE(*seq);
+  FREE(line);
+  stringptr_free(&tmp_seq);
+  return -1;
+}
+
+/**@memo example: reading FASTQ format file:
+    seq_ifile=fopen(seq_filename,"r");
+    if (seq_ifile) {
+      nseq=read_fastq(seq_ifile,&seq,do_switch_case);
+      fclose(seq_ifile);
+    }
+*/
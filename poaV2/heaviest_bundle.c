@@ -16,6 +16,23 @@
 LPOLetterRef_T *heaviest_bundle(int len,LPOLetter_T seq[],
 				int nsource_seq,LPOSourceInfo_T source_seq[],
 				int *p_best_len)
+{
+  return heaviest_bundle_quality(len,seq,nsource_seq,source_seq,NULL,
+				 p_best_len);
+}
+
+
+
+/** heaviest_bundle(), with each source seq's support for a step weighted
+  by its base qualities: if quality is non-NULL, a step from position
+  ipos-1 to ipos counts the source weight times the smaller of the two
+  quality values (LPO_DEFAULT_QUALITY where the track has none), so a
+  few confident reads can outvote many error-prone ones */
+LPOLetterRef_T *heaviest_bundle_quality(int len,LPOLetter_T seq[],
+					int nsource_seq,
+					LPOSourceInfo_T source_seq[],
+					LPONumericTrack_T *quality,
+					int *p_best_len)
 {
   int i,j,best_right,iright,ibest= -1,best_len=0;
   LPOLetterRef_T *best_path=NULL,*path=NULL;
@@ -23,6 +40,7 @@ LPOLetterRef_T *heaviest_bundle(int len,LPOLetter_T seq[],
   LPOLetterSource_T *source;
   LPOScore_T *score=NULL,best_score= -999999,right_score;
   int *contains_pos=NULL,my_overlap,right_overlap;
+  double q,q_left;
 
   CALLOC(path,len,LPOLetterRef_T); /* GET MEMORY FOR DYNAMIC PROGRAMMING */
   CALLOC(score,len,LPOScore_T);
@@ -44,8 +62,18 @@ LPOLetterRef_T *heaviest_bundle(int len,LPOLetter_T seq[],
       my_overlap=0; /* OVERLAP CALCULATION */
       source= &seq[right->ipos].source;/*COUNT SEQS SHARED IN i AND right*/
       do /* BIAS OVERLAP CALCULATION BY SEQUENCE WEIGHTING */
-	if (contains_pos[source->iseq]==source->ipos) /* YES, ADJACENT! */
-	  my_overlap += source_seq[source->iseq].weight;
+	if (contains_pos[source->iseq]==source->ipos) { /* YES, ADJACENT! */
+	  if (quality) { /* ... AND BY THE QUALITY OF THE STEP */
+	    q_left=lpo_track_value(quality,source->iseq,source->ipos-1,
+				   LPO_DEFAULT_QUALITY);
+	    q=lpo_track_value(quality,source->iseq,source->ipos,
+			      LPO_DEFAULT_QUALITY);
+	    my_overlap += source_seq[source->iseq].weight
+	      * (int)(q<q_left ? q : q_left);
+	  }
+	  else
+	    my_overlap += source_seq[source->iseq].weight;
+	}
       while (source=source->more); /* KEEP COUNTING TILL NO more */
 
       if (my_overlap>right_overlap /* FIND BEST RIGHT MOVE: BEST OVERLAP */
@@ -80,6 +108,66 @@ LPOLetterRef_T *heaviest_bundle(int len,LPOLetter_T seq[],
 
 
 
+/** like heaviest_bundle(), but for an LPO whose sources were folded into
+  link weights by fold_lpo_sources(): each step weighs the weight stored
+  on its link instead of the source sequences shared by the two letters.
+  As in heaviest_bundle(), a sequence that starts on the right letter
+  counts towards every link into it, so both give the same path */
+LPOLetterRef_T *heaviest_link_path(int len,LPOLetter_T seq[],
+				   LPOSourceInfo_T source_seq[],
+				   int *p_best_len)
+{
+  int i,best_right,ibest= -1,best_len=0,*start_weight=NULL,my_overlap;
+  LPOLetterRef_T *best_path=NULL,*path=NULL;
+  LPOLetterLink_T *right;
+  LPOLetterSource_T *source;
+  LPOScore_T *score=NULL,best_score= -999999,right_score,right_overlap;
+
+  CALLOC(path,len,LPOLetterRef_T); /* GET MEMORY FOR DYNAMIC PROGRAMMING */
+  CALLOC(score,len,LPOScore_T);
+  CALLOC(start_weight,len,int);
+  LOOP (i,len) /* WEIGHT OF THE SEQUENCES STARTING ON EACH LETTER */
+    for (source= &seq[i].source;source && source->ipos>=0;source=source->more)
+      if (source->ipos==0 && source_seq[source->iseq].weight>0)
+	start_weight[i]+=source_seq[source->iseq].weight;
+
+  LOOPB (i,len) { /* FIND HEAVIEST PATH BY DYNAMIC PROGRAMMING */
+    right_score=right_overlap=0;  /*DEFAULT MOVE: NOTHING TO THE RIGHT*/
+    best_right= INVALID_LETTER_POSITION;
+    for (right= &seq[i].right;right && right->ipos>=0;right=right->more) {
+      my_overlap=right->weight+start_weight[right->ipos];
+      if (my_overlap>right_overlap /* FIND BEST RIGHT MOVE: HEAVIEST LINK */
+	  || (my_overlap==right_overlap && score[right->ipos]>right_score)) {
+	right_overlap=my_overlap;
+	right_score=score[right->ipos];
+	best_right=right->ipos;
+      }
+    }
+
+    path[i]=best_right; /* SAVE THE BEST PATH FOUND */
+    score[i]=right_score+right_overlap; /* SAVE THE SCORE */
+    if (score[i]>best_score) { /* RECORD BEST SCORE IN WHOLE LPO */
+      ibest=i;
+      best_score=score[i];
+    }
+  }
+
+  CALLOC(best_path,len,LPOLetterRef_T); /* MEMORY FOR STORING BEST PATH */
+  for (;ibest>=0;ibest=path[ibest])  /* BACK TRACK THE BEST PATH */
+    best_path[best_len++]=ibest;
+
+  FREE(path); /* DUMP SCRATCH MEMORY */
+  FREE(score);
+  FREE(start_weight);
+
+  if (p_best_len) /* RETURN best_path AND ITS LENGTH */
+    *p_best_len = best_len;
+  return best_path;
+}
+
+
+
+
 int assign_sequence_bundle_id(int path_length,LPOLetterRef_T path[],
 			      LPOSequence_T *seq,int bundle_id,
 			      float minimum_fraction)
@@ -143,14 +231,17 @@ void assign_hb_weights(int nsource_seq,LPOSourceInfo_T source_seq[])
 ------------------------------------------------------------*/
 void generate_lpo_bundles(LPOSequence_T *seq,float minimum_fraction)
 {
-  int nbundled=0,ibundle=0,path_length,iseq,count;
+  int nbundled=0,ibundle=0,path_length,iseq,count,itrack;
   LPOLetterRef_T *path=NULL;
   char name[256],title[1024];
 
   /*  assign_hb_weights(seq->nsource_seq,seq->source_seq); TURN THIS ON!!*/
+  itrack=find_lpo_track(seq,LPO_QUALITY_TRACK); /* e.g. READ FROM FASTQ */
   while (nbundled < seq->nsource_seq) {/* PULL OUT BUNDLES ONE BY ONE */
-    path=heaviest_bundle(seq->length,seq->letter,/*GET NEXT HEAVIEST BUNDLE*/
-			 seq->nsource_seq,seq->source_seq,&path_length);
+    path=heaviest_bundle_quality(seq->length,seq->letter,/*NEXT HEAVIEST*/
+				 seq->nsource_seq,seq->source_seq,
+				 itrack>=0 ? seq->track+itrack : NULL,
+				 &path_length);
     if (!path || path_length<10) /* ??!? FAILED TO FIND A BUNDLE ??? */
       goto premature_warning;
     sprintf(name,"CONSENS%d",ibundle);
@@ -0,0 +1,610 @@
+#include "default.h"
+#include "poa.h"
+#include "seq_util.h"
+#include "lpo.h"
+
+
+/* DIFFERENTIAL TEST OF THE ALIGNMENT KERNELS (make kernel_check): ALIGNS
+   RANDOM AND ADVERSARIAL SEQUENCE SETS WITH A REFERENCE KERNEL AND AN
+   ALTERNATE ONE (SEE set_lpo_kernel(), OR align_lpo_po_batch()), STEP BY
+   STEP AS buildup_lpo() DOES, AND REQUIRES THE SAME SCORE, THE SAME
+   x_to_y AND y_to_x AT EVERY STEP, AND THE SAME FINAL PO FILE.  WITH
+   -allow_ties, A STEP WHERE THE KERNELS FIND THE SAME SCORE BUT DIFFERENT
+   ALIGNMENTS IS COUNTED AS A TIE (BOTH ARE OPTIMAL), NOT A FAILURE, AND
+   THE FINAL PO FILES ARE NOT COMPARED.  WITH -po_y, THE SECOND HALF OF
+   EACH CASE IS FIRST BUILT INTO A GRAPH OF ITS OWN, WHICH IS THEN ALIGNED
+   TO THE GRAPH OF THE FIRST HALF, SO y IS A PARTIAL ORDER WITH SEVERAL
+   ROOTS.  THE FIRST FAILING CASE IS SHRUNK TO A MINIMAL REPRODUCTION AND
+   WRITTEN AS FASTA, WHICH -fasta REPLAYS. */
+
+
+#define KERNEL_BATCH (-1) /* ALTERNATE: align_lpo_po_batch() */
+#define KERNEL_DIFF_NKIND 7
+
+/** ONE TEST CASE: SEQUENCES ALIGNED IN ORDER, EACH TO THE GRAPH OF THE
+    ONES BEFORE IT */
+typedef struct {
+  int nseq;
+  char **residues;
+} KernelCase_T;
+
+/** WHAT RUNS AND HOW ITS RESULTS ARE JUDGED */
+typedef struct {
+  int reference,alternate,use_global_alignment,allow_ties,po_y;
+  int nstep,ntie; /* RUNNING COUNTS OVER PASSING CASES */
+  char message[1024]; /* WHY THE LAST FAILING CASE FAILED */
+} KernelDiff_T;
+
+static const char *Kernel_names[]={"auto","scalar","profile","packed","affine"};
+
+static unsigned long long Rng_state=1;
+
+
+/** next value of a 64-bit LCG, uniform in 0..n-1 */
+static int rng_below(int n)
+{
+  Rng_state=Rng_state*6364136223846793005ULL+1442695040888963407ULL;
+  return n>0 ? (int)((Rng_state>>33)%n) : 0;
+}
+
+
+/** uniform in 0..1 */
+static double rng_unit(void)
+{
+  return rng_below(1<<30)/(double)(1<<30);
+}
+
+
+/** kernel code of name, or KERNEL_BATCH for "batch"; -2 if unknown */
+static int kernel_code(char name[])
+{
+  int i;
+
+  if (0==strcmp(name,"batch"))
+    return KERNEL_BATCH;
+  LOOPF (i,sizeof(Kernel_names)/sizeof(Kernel_names[0]))
+    if (0==strcmp(name,Kernel_names[i]))
+      return i;
+  return -2;
+}
+
+
+static const char *kernel_name(int kernel)
+{
+  return kernel==KERNEL_BATCH ? "batch" : Kernel_names[kernel];
+}
+
+
+/** appends a copy of residues[0..length-1] to kc */
+static void add_case_seq(KernelCase_T *kc,char residues[],int length)
+{
+  REALLOC(kc->residues,kc->nseq+1,char *);
+  CALLOC(kc->residues[kc->nseq],length+1,char);
+  memcpy(kc->residues[kc->nseq],residues,length);
+  kc->nseq++;
+}
+
+
+static void free_case(KernelCase_T *kc)
+{
+  int i;
+
+  LOOP (i,kc->nseq)
+    FREE(kc->residues[i]);
+  FREE(kc->residues);
+  kc->nseq=0;
+}
+
+
+static void copy_case(KernelCase_T *to,KernelCase_T *from)
+{
+  int i;
+
+  to->nseq=0;
+  to->residues=NULL;
+  LOOPF (i,from->nseq)
+    add_case_seq(to,from->residues[i],strlen(from->residues[i]));
+}
+
+
+/** random residues from alphabet, repeating a random unit of up to
+    unit_max residues (1 = NO REPEATS); caller frees */
+static char *random_residues(char alphabet[],int length,int unit_max)
+{
+  int i,unit=1+rng_below(unit_max),nsymbol=strlen(alphabet);
+  char *s;
+
+  CALLOC(s,length+1,char);
+  LOOPF (i,length)
+    s[i]= i<unit ? alphabet[rng_below(nsymbol)] : s[i-unit];
+  return s;
+}
+
+
+/** appends to kc a copy of ancestor with substitutions, insertions and
+    deletions at the given rates per residue; never empty */
+static void add_mutant(KernelCase_T *kc,char ancestor[],char alphabet[],
+		       double sub,double ins,double del)
+{
+  int i,n=0,length=strlen(ancestor),nsymbol=strlen(alphabet);
+  double r;
+  char *s;
+
+  CALLOC(s,2*length+2,char);
+  LOOPF (i,length) {
+    r=rng_unit();
+    if (r<del)
+      continue;
+    s[n++]= r<del+sub ? alphabet[rng_below(nsymbol)] : ancestor[i];
+    if (rng_unit()<ins && n<2*length)
+      s[n++]=alphabet[rng_below(nsymbol)];
+  }
+  if (n==0)
+    s[n++]=ancestor[0];
+  add_case_seq(kc,s,n);
+  FREE(s);
+}
+
+
+/** fills kc with case number kind (mod KERNEL_DIFF_NKIND) */
+static void make_case(KernelCase_T *kc,int kind,char alphabet[],int max_gap_length)
+{
+  int i,j,nseq,length,gap,at;
+  char *ancestor,*s;
+
+  kc->nseq=0;
+  kc->residues=NULL;
+  switch (kind%KERNEL_DIFF_NKIND) {
+  case 0: /* A FAMILY OF MUTATED COPIES */
+    ancestor=random_residues(alphabet,1+rng_below(200),1);
+    nseq=2+rng_below(7);
+    LOOP (i,nseq)
+      add_mutant(kc,ancestor,alphabet,0.2*rng_unit(),0.1*rng_unit(),0.1*rng_unit());
+    break;
+  case 1: /* HOMOPOLYMERS AND TANDEM REPEATS */
+    ancestor=random_residues(alphabet,1+rng_below(120),4);
+    nseq=2+rng_below(6);
+    LOOP (i,nseq)
+      add_mutant(kc,ancestor,alphabet,0.03,0.05,0.05);
+    break;
+  case 2: /* SINGLE RESIDUES AND VERY SHORT SEQUENCES */
+    ancestor=NULL;
+    nseq=2+rng_below(5);
+    LOOP (i,nseq) {
+      s=random_residues(alphabet,1+rng_below(3),1);
+      add_case_seq(kc,s,strlen(s));
+      FREE(s);
+    }
+    break;
+  case 3: /* UNRELATED SEQUENCES */
+    ancestor=NULL;
+    nseq=2+rng_below(4);
+    LOOP (i,nseq) {
+      s=random_residues(alphabet,1+rng_below(100),1);
+      add_case_seq(kc,s,strlen(s));
+      FREE(s);
+    }
+    break;
+  case 4: /* GAPS LONGER THAN max_gap_length */
+    length=100+rng_below(200);
+    ancestor=random_residues(alphabet,length,1);
+    add_case_seq(kc,ancestor,length);
+    nseq=1+rng_below(4);
+    LOOP (i,nseq) {
+      gap=max_gap_length+1+rng_below(20);
+      if (gap>length/2)
+	gap=length/2;
+      at=rng_below(length-gap);
+      CALLOC(s,length+gap+1,char);
+      if (i%2) { /* INSERTION OF gap RANDOM RESIDUES */
+	memcpy(s,ancestor,at);
+	LOOP (j,gap)
+	  s[at+j]=alphabet[rng_below(strlen(alphabet))];
+	strcpy(s+at+gap,ancestor+at);
+      }
+      else { /* DELETION OF gap RESIDUES */
+	memcpy(s,ancestor,at);
+	strcpy(s+at,ancestor+at+gap);
+      }
+      add_case_seq(kc,s,strlen(s));
+      FREE(s);
+    }
+    break;
+  case 5: /* HIGHLY BRANCHED GRAPH: MANY NOISY COPIES OF A SHORT ANCESTOR */
+    ancestor=random_residues(alphabet,20+rng_below(40),1);
+    nseq=8+rng_below(9);
+    LOOP (i,nseq)
+      add_mutant(kc,ancestor,alphabet,0.2,0.1,0.1);
+    break;
+  default: /* A LONG SEQUENCE AND SHORT PIECES OF IT */
+    length=500+rng_below(1000);
+    ancestor=random_residues(alphabet,length,1);
+    add_case_seq(kc,ancestor,length);
+    nseq=1+rng_below(4);
+    LOOP (i,nseq) {
+      gap=1+rng_below(10);
+      add_case_seq(kc,ancestor+rng_below(length-gap),gap);
+    }
+    if (rng_below(2)) { /* ALSO WITH THE LONG ONE LAST */
+      add_case_seq(kc,ancestor,length);
+      s=kc->residues[0];
+      kc->residues[0]=kc->residues[kc->nseq-1];
+      kc->residues[kc->nseq-1]=s;
+    }
+  }
+  FREE(ancestor);
+}
+
+
+/** builds kc as single-sequence partial orders */
+static Sequence_T *case_as_lpo(KernelCase_T *kc,ResidueScoreMatrix_T *m)
+{
+  int i;
+  char name[SEQUENCE_NAME_MAX];
+  Sequence_T *seq;
+
+  CALLOC(seq,kc->nseq,Sequence_T);
+  LOOP (i,kc->nseq) {
+    seq[i].sequence=strdup(kc->residues[i]);
+    sprintf(name,"s%d",i);
+    save_sequence_fields(seq+i,name,NULL,strlen(kc->residues[i]));
+  }
+  initialize_seqs_as_lpo(kc->nseq,seq,m);
+  return seq;
+}
+
+
+static void free_case_lpo(int nseq,Sequence_T seq[])
+{
+  int i;
+
+  LOOP (i,nseq)
+    free_lpo_sequence(seq+i,FALSE);
+  FREE(seq);
+}
+
+
+/** aligns y to x with kernel, as the buildup does */
+static LPOScore_T align_with_kernel(int kernel,LPOSequence_T *x,LPOSequence_T *y,
+				    ResidueScoreMatrix_T *m,
+				    LPOLetterRef_T **x_to_y,LPOLetterRef_T **y_to_x,
+				    int use_global_alignment)
+{
+  LPOScore_T score;
+
+  if (kernel==KERNEL_BATCH) {
+    set_lpo_kernel(lpo_kernel_auto);
+    align_lpo_po_batch(1,&x,&y,m,x_to_y,y_to_x,&score,use_global_alignment);
+    return score;
+  }
+  set_lpo_kernel(kernel);
+  score=align_lpo_po(x,y,m,x_to_y,y_to_x,NULL,use_global_alignment);
+  set_lpo_kernel(lpo_kernel_auto);
+  return score;
+}
+
+
+/** index of the first difference between a[0..n-1] and b[0..n-1], or -1 */
+static int first_difference(int n,LPOLetterRef_T a[],LPOLetterRef_T b[])
+{
+  int i;
+
+  LOOPF (i,n)
+    if (a[i]!=b[i])
+      return i;
+  return -1;
+}
+
+
+/** step istep of building kc: aligns seq[from[istep]] to the graph in
+    seq[into[istep]].  Without po_y, each sequence goes into seq[0]; with
+    it, the last nseq/2 sequences are built into a graph of their own
+    first, which is aligned to the graph of the rest last.  Returns the number of steps. */
+static int case_steps(int nseq,int po_y,int into[],int from[])
+{
+  int i,ny=po_y ? nseq/2 : 0,nstep=0;
+
+  if (ny<2) /* A ONE-SEQUENCE y IS NO PARTIAL ORDER */
+    ny=0;
+  for (i=1;i<nseq-ny;i++,nstep++) {
+    into[nstep]=0;
+    from[nstep]=i;
+  }
+  if (ny>0) {
+    for (i=nseq-ny+1;i<nseq;i++,nstep++) {
+      into[nstep]=nseq-ny;
+      from[nstep]=i;
+    }
+    into[nstep]=0;
+    from[nstep++]=nseq-ny;
+  }
+  return nstep;
+}
+
+
+/** aligns and fuses kc with one kernel only, returning the PO file it
+    makes; caller frees */
+static char *build_po_text(KernelCase_T *kc,int kernel,ResidueScoreMatrix_T *m,
+			   int use_global_alignment,int po_y)
+{
+  int i,j,istep,nstep,*into=NULL,*from=NULL;
+  char *text=NULL;
+  size_t size=0;
+  Sequence_T *seq;
+  LPOLetterRef_T *al1=NULL,*al2=NULL;
+  FILE *ofile;
+
+  CALLOC(into,kc->nseq,int);
+  CALLOC(from,kc->nseq,int);
+  nstep=case_steps(kc->nseq,po_y,into,from);
+  seq=case_as_lpo(kc,m);
+  LOOPF (istep,nstep) {
+    j=into[istep];
+    i=from[istep];
+    align_with_kernel(kernel,seq+j,seq+i,m,&al1,&al2,use_global_alignment);
+    fuse_lpo(seq+j,seq+i,al1,al2);
+    free_lpo_letters(seq[i].length,seq[i].letter,TRUE);
+    seq[i].letter=NULL;
+    FREE(al1);
+    FREE(al2);
+  }
+  if ((ofile=open_memstream(&text,&size))) {
+    write_lpo(ofile,seq,m);
+    fclose(ofile);
+  }
+  free_case_lpo(kc->nseq,seq);
+  FREE(into);
+  FREE(from);
+  return text;
+}
+
+
+/** runs kc through both kernels; returns TRUE if they agree, else FALSE
+    with the reason in kd->message */
+static int run_case(KernelCase_T *kc,KernelDiff_T *kd,ResidueScoreMatrix_T *m)
+{
+  int i,j,at,istep,nstep,ntie=0,ok=TRUE,*into=NULL,*from=NULL;
+  LPOScore_T ref_score,alt_score;
+  LPOLetterRef_T *ref_x=NULL,*ref_y=NULL,*alt_x=NULL,*alt_y=NULL;
+  Sequence_T *seq;
+  char *ref_text,*alt_text;
+
+  CALLOC(into,kc->nseq,int);
+  CALLOC(from,kc->nseq,int);
+  nstep=case_steps(kc->nseq,kd->po_y,into,from);
+  seq=case_as_lpo(kc,m);
+  for (istep=0;ok && istep<nstep;istep++) {
+    j=into[istep];
+    i=from[istep];
+    ref_score=align_with_kernel(kd->reference,seq+j,seq+i,m,&ref_x,&ref_y,
+				kd->use_global_alignment);
+    alt_score=align_with_kernel(kd->alternate,seq+j,seq+i,m,&alt_x,&alt_y,
+				kd->use_global_alignment);
+    if (ref_score!=alt_score) {
+      sprintf(kd->message,"sequence %d: score %d (%s) != %d (%s)",i,
+	      (int)ref_score,kernel_name(kd->reference),
+	      (int)alt_score,kernel_name(kd->alternate));
+      ok=FALSE;
+    }
+    else if ((at=first_difference(seq[j].length,ref_x,alt_x))>=0
+	     || (at=first_difference(seq[i].length,ref_y,alt_y))>=0) {
+      if (kd->allow_ties)
+	ntie++;
+      else {
+	sprintf(kd->message,"sequence %d: same score %d, but the alignments"
+		" differ (x_to_y[%d] %d/%d, y_to_x %d/%d at %d)",i,(int)ref_score,
+		at,at<seq[j].length ? ref_x[at] : 0,at<seq[j].length ? alt_x[at] : 0,
+		at<seq[i].length ? ref_y[at] : 0,at<seq[i].length ? alt_y[at] : 0,at);
+	ok=FALSE;
+      }
+    }
+    if (ok) /* GO ON FROM THE REFERENCE GRAPH */
+      fuse_lpo(seq+j,seq+i,ref_x,ref_y);
+    free_lpo_letters(seq[i].length,seq[i].letter,TRUE);
+    seq[i].letter=NULL;
+    FREE(ref_x);
+    FREE(ref_y);
+    FREE(alt_x);
+    FREE(alt_y);
+  }
+  free_case_lpo(kc->nseq,seq);
+  FREE(into);
+  FREE(from);
+
+  if (ok && !kd->allow_ties) { /* SAME FINAL GRAPH FROM EACH KERNEL ALONE */
+    ref_text=build_po_text(kc,kd->reference,m,kd->use_global_alignment,kd->po_y);
+    alt_text=build_po_text(kc,kd->alternate,m,kd->use_global_alignment,kd->po_y);
+    if (!ref_text || !alt_text || strcmp(ref_text,alt_text)) {
+      sprintf(kd->message,"the final PO files differ");
+      ok=FALSE;
+    }
+    FREE(ref_text);
+    FREE(alt_text);
+  }
+  if (ok) {
+    kd->nstep+=nstep;
+    kd->ntie+=ntie;
+  }
+  return ok;
+}
+
+
+/** tries kc without sequence i and, with halving chunk sizes, without
+    each chunk of each sequence, keeping every cut that still fails,
+    until no cut does; kc ends up a minimal failing case */
+static void shrink_case(KernelCase_T *kc,KernelDiff_T *kd,ResidueScoreMatrix_T *m)
+{
+  int i,j,at,chunk,length,changed=TRUE,nstep=kd->nstep,ntie=kd->ntie;
+  char saved_message[sizeof(kd->message)];
+  KernelCase_T trial;
+
+  strcpy(saved_message,kd->message);
+  while (changed) {
+    changed=FALSE;
+    for (i=kc->nseq-1;kc->nseq>2 && i>=0;i--) { /* DROP WHOLE SEQUENCES */
+      trial.nseq=0;
+      trial.residues=NULL;
+      LOOPF (j,kc->nseq)
+	if (j!=i)
+	  add_case_seq(&trial,kc->residues[j],strlen(kc->residues[j]));
+      if (!run_case(&trial,kd,m)) {
+	free_case(kc);
+	*kc=trial;
+	strcpy(saved_message,kd->message);
+	changed=TRUE;
+      }
+      else
+	free_case(&trial);
+    }
+    LOOP (i,kc->nseq) /* CUT CHUNKS OUT OF EACH SEQUENCE */
+      for (chunk=strlen(kc->residues[i])/2;chunk>0;chunk/=2)
+	for (at=0;at+chunk<=(length=strlen(kc->residues[i])) && length>chunk;) {
+	  copy_case(&trial,kc);
+	  memmove(trial.residues[i]+at,trial.residues[i]+at+chunk,length-at-chunk+1);
+	  if (!run_case(&trial,kd,m)) {
+	    free_case(kc);
+	    *kc=trial;
+	    strcpy(saved_message,kd->message);
+	    changed=TRUE;
+	  }
+	  else {
+	    free_case(&trial);
+	    at+=chunk;
+	  }
+	}
+  }
+  strcpy(kd->message,saved_message);
+  kd->nstep=nstep; /* PASSING TRIAL CUTS DON'T COUNT */
+  kd->ntie=ntie;
+}
+
+
+static void write_case_fasta(FILE *ofile,KernelCase_T *kc)
+{
+  int i;
+
+  LOOPF (i,kc->nseq)
+    fprintf(ofile,">s%d\n%s\n",i,kc->residues[i]);
+}
+
+
+/** reads a case (e.g. a saved repro) from a FASTA file */
+static int read_case_fasta(char filename[],KernelCase_T *kc)
+{
+  int i,nseq=0;
+  Sequence_T *seq=NULL;
+  FILE *ifile;
+
+  kc->nseq=0;
+  kc->residues=NULL;
+  if (!(ifile=fopen(filename,"r")))
+    return 0;
+  nseq=read_fasta(ifile,&seq,dont_switch_case,NULL);
+  fclose(ifile);
+  LOOPF (i,nseq) {
+    add_case_seq(kc,seq[i].sequence,seq[i].length);
+    FREE(seq[i].sequence);
+    FREE(seq[i].title);
+  }
+  FREE(seq);
+  return kc->nseq;
+}
+
+
+int main(int argc,char *argv[])
+{
+  int i,ntrial=1000;
+  char *kernel="profile",*reference="scalar",*alphabet="ACGT";
+  char *trials=NULL,*seed=NULL,*xdrop=NULL,*tile_columns=NULL;
+  char *repro_filename="kernel_diff_repro.fa",*fasta_filename=NULL;
+  char *matrix_filename=NULL;
+  ResidueScoreMatrix_T m;
+  KernelDiff_T kd;
+  KernelCase_T kc;
+  FILE *ofile;
+
+  memset(&kd,0,sizeof(kd));
+  for (i=1;i<argc;i++) {
+    ARGGET("-kernel",kernel); /* ALTERNATE: profile|packed|affine|batch */
+    ARGGET("-reference",reference);
+    ARGGET("-alphabet",alphabet);
+    ARGGET("-repro",repro_filename);
+    ARGGET("-fasta",fasta_filename); /* REPLAY ONE CASE */
+    ARGGET("-trials",trials);
+    ARGGET("-seed",seed);
+    ARGGET("-xdrop",xdrop); /* LOCAL ALIGNMENT X-DROP CUTOFF */
+    ARGGET("-tile_columns",tile_columns); /* SMALL TILES FOR affine */
+    ARGMATCH("-do_global",kd.use_global_alignment);
+    ARGMATCH("-allow_ties",kd.allow_ties);
+    ARGMATCH("-po_y",kd.po_y); /* ALIGN PARTIAL ORDERS TO EACH OTHER */
+    NEXTARG(matrix_filename);
+  }
+  kd.alternate=kernel_code(kernel);
+  kd.reference=kernel_code(reference);
+  if (!matrix_filename || kd.alternate< -1 || kd.reference<0 || !*alphabet) {
+    fprintf(stderr,"\nUsage: %s [OPTIONS] MATRIXFILE\n"
+"Aligns random and adversarial sequence sets with two kernels and checks\n"
+"that they find the same scores, alignments and final PO file.\n"
+"  -kernel NAME      kernel under test: profile, packed, affine or batch\n"
+"                    (default profile)\n"
+"  -reference NAME   kernel it must match (default scalar)\n"
+"  -trials N         random cases (default 1000)\n"
+"  -seed S           random seed (default 1)\n"
+"  -alphabet LETTERS residues to draw from (default ACGT)\n"
+"  -do_global        global alignment\n"
+"  -xdrop N          local alignment X-drop cutoff\n"
+"  -tile_columns N   affine kernel tile width (default 4096), so that\n"
+"                    short cases span several tiles\n"
+"  -allow_ties       accept equal scores with different alignments\n"
+"  -po_y             build the second half of each case into a graph of\n"
+"                    its own and align that to the first half's graph\n"
+"  -fasta FILE       check the one case in FILE instead\n"
+"  -repro FILE       where to save a failing case, shrunk\n"
+"                    (default kernel_diff_repro.fa)\n\n",argv[0]);
+    exit(2);
+  }
+  if (read_score_matrix(matrix_filename,&m)<=0) {
+    fprintf(stderr,"%s: can't read matrix %s\n",argv[0],matrix_filename);
+    exit(1);
+  }
+  if (xdrop)
+    m.drop_score=atoi(xdrop);
+  if (tile_columns)
+    set_lpo_tile_columns(atoi(tile_columns));
+  if (trials)
+    ntrial=atoi(trials);
+  Rng_state=seed ? atoi(seed) : 1;
+
+  if (fasta_filename) {
+    if (read_case_fasta(fasta_filename,&kc)<=0) {
+      fprintf(stderr,"%s: no sequences in %s\n",argv[0],fasta_filename);
+      exit(1);
+    }
+    i=run_case(&kc,&kd,&m);
+    printf("%s: %s %s %s%s%s\n",fasta_filename,kernel,i ? "matches" : "differs from",
+	   reference,i ? "" : ": ",i ? "" : kd.message);
+    free_case(&kc);
+    return i ? 0 : 1;
+  }
+
+  LOOPF (i,ntrial) {
+    make_case(&kc,i,alphabet,m.max_gap_length);
+    if (!run_case(&kc,&kd,&m)) {
+      fprintf(stderr,"%s: trial %d: %s differs from %s: %s\n",argv[0],i,kernel,
+	      reference,kd.message);
+      shrink_case(&kc,&kd,&m);
+      if ((ofile=fopen(repro_filename,"w"))) {
+	write_case_fasta(ofile,&kc);
+	fclose(ofile);
+      }
+      fprintf(stderr,"%s: shrunk to %d sequences (%s), saved in %s\n",argv[0],
+	      kc.nseq,kd.message,repro_filename);
+      free_case(&kc);
+      return 1;
+    }
+    free_case(&kc);
+  }
+  printf("%s matches %s: %d cases, %d alignment steps, %d ties\n",kernel,reference,
+	 ntrial,kd.nstep,kd.ntie);
+  return 0;
+}
@@ -28,6 +28,8 @@ void lpo_init(LPOSequence_T *seq)
   /* BECAUSE PO CAN CONTAIN MULTIPLE SEQUENCES, WE ALSO KEEP A SOURCE LIST.
      FOR PURE LINEAR SEQUENCE, THE LIST IS JUST OUR STARTING SEQUENCE */
   save_lpo_source(seq,seq->name,seq->title,seq->length,1,NO_BUNDLE,0,NULL);
+  if (seq->ntrack>0) /* FEED WEIGHTED TRACKS INTO THE LINKS */
+    add_lpo_track_link_weights(seq);
   return;
 }
 
@@ -37,17 +39,22 @@ void lpo_init(LPOSequence_T *seq)
 
 /**@memo initialize one or more regular sequences (linear orders) to LPO form.
   This step is REQUIRED before running partial order alignment.  
-  This routine processes each sequence with limit_residues() and 
-  index_symbols(), then builds a linear LPO using lpo_init(). */
+  This routine translates each sequence with build_matrix_symbol_index()
+  (i.e. limit_residues() and index_symbols()), then builds a linear LPO
+  using lpo_init(). */
   
 void initialize_seqs_as_lpo(int nseq, Sequence_T seq[],ResidueScoreMatrix_T *m)
 {
-  int i;
-  LOOP (i,nseq) {/* EXCLUDE LETTERS THAT AREN'T IN MATRIX */
-    limit_residues(seq[i].sequence,m->symbol);
-    /* TRANSLATE FROM ASCII LETTERS TO COMPACTED NUMBERICAL INDEX*/
-    index_symbols(seq[i].length,seq[i].sequence,seq[i].sequence,
-		  m->nsymbol,m->symbol);
+  int i,j;
+  char symbol_index[256];
+
+  build_matrix_symbol_index(m,symbol_index);
+  LOOP (i,nseq) {
+    load_fasta_view(seq+i); /* NO-OP UNLESS STILL AN UNLOADED FASTA VIEW */
+    /* EXCLUDE LETTERS THAT AREN'T IN MATRIX, AND TRANSLATE FROM ASCII
+       LETTERS TO COMPACTED NUMBERICAL INDEX */
+    LOOP (j,seq[i].length)
+      seq[i].sequence[j]=symbol_index[(unsigned char)seq[i].sequence[j]];
     lpo_init(seq+i); /* CREATE TRIVIAL, LINEAR SEQUENCE LPO */
   }
 }
@@ -58,6 +65,7 @@ void initialize_seqs_as_lpo(int nseq, Sequence_T seq[],ResidueScoreMatrix_T *m)
 void lpo_index_symbols(Sequence_T *lpo,ResidueScoreMatrix_T *m)
 {
   int i;
+  char symbol_index[256];
 
   if (lpo->letter == NULL) { /* HMM.  HASN'T BEEN INITIALIZED AT ALL YET */
     initialize_seqs_as_lpo(1,lpo,m);
@@ -65,9 +73,9 @@ void lpo_index_symbols(Sequence_T *lpo,ResidueScoreMatrix_T *m)
   }
   if (lpo->letter[0].letter < m->nsymbol)
     return; /* LOOKS LIKE IT'S ALREADY TRANSLATED TO INDEXES */
+  build_matrix_symbol_index(m,symbol_index);
   LOOP (i,lpo->length) /* READ FROM FILE, MAY NOT BE TRANSLATED YET */
-    index_symbols(1,&lpo->letter[i].letter,&lpo->letter[i].letter,
-		  m->nsymbol,m->symbol);
+    lpo->letter[i].letter=symbol_index[(unsigned char)lpo->letter[i].letter];
 }
 
 
@@ -299,6 +307,7 @@ void reindex_lpo_source_seqs (LPOSequence_T *seq, int *perm)
     invmap[map[i]] = j;
     map[i] = invmap[i] = i;
   }
+  permute_lpo_tracks (seq, perm);
   
   FREE (map);
   FREE (invmap);
@@ -313,9 +322,9 @@ void copy_lpo_letter(LPOLetter_T *new,LPOLetter_T *old,
   new->letter=old->letter; /* SAVE ITS SEQUENCE LETTER */
   add_lpo_sources(&new->source,&old->source,iseq_new); /* SAVE SOURCES */
   for (link= &old->left;link && link->ipos>=0;link=link->more) /*SAVE left*/
-    add_lpo_link(&new->left,old_to_new[link->ipos]);
+    add_lpo_link(&new->left,old_to_new[link->ipos])->weight += link->weight;
   for (link= &old->right;link && link->ipos>=0;link=link->more)/*SAVE right*/
-    add_lpo_link(&new->right,old_to_new[link->ipos]);
+    add_lpo_link(&new->right,old_to_new[link->ipos])->weight += link->weight;
   return;
 }
 
@@ -515,11 +524,13 @@ LPOSequence_T *copy_fuse_lpo_remap(LPOSequence_T *holder_x, /*FUSES TWO LPOs*/
 				holder_x->source_seq);
   LOOP (i_x,len_x) /* COPY LETTER DATA TO CORRESPONDING LETTERS OF NEW LPO */
     copy_lpo_letter(new_lpo+new_x[i_x],seq_x+i_x,new_x,iseq_new);
+  copy_lpo_tracks(new_seq,holder_x,iseq_new);
   FREE(iseq_new);
   iseq_new=save_lpo_source_list(new_seq,holder_y->nsource_seq,/*COPY y SOURCE*/
 				holder_y->source_seq);
   LOOP (i_y,len_y)
     copy_lpo_letter(new_lpo+new_y[i_y],seq_y+i_y,new_y,iseq_new);
+  copy_lpo_tracks(new_seq,holder_y,iseq_new);
   FREE(iseq_new);
 
   LOOP (i_x,len_x) /* COPY OLD ALIGNMENT RINGS TO THE NEW LPO */
@@ -639,6 +650,7 @@ LPOSequence_T *fuse_lpo_remap(LPOSequence_T *holder_x,
 				holder_y->source_seq);
   LOOP (i_y,len_y) /* COPY LETTER DATA TO CORRESPONDING LETTERS OF NEW LPO */
     copy_lpo_letter(new_lpo+new_y[i_y],seq_y+i_y,new_y,iseq_new);
+  copy_lpo_tracks(holder_x,holder_y,iseq_new); /* AND y's TRACK VALUES */
   FREE(iseq_new);
 
   LOOP (i_y,len_y) /* COPY OLD ALIGNMENT RINGS TO THE NEW LPO */
@@ -732,6 +744,81 @@ void free_lpo_sourceinfo(int nsource_seq,LPOSourceInfo_T *source_seq,
 
 
 
+/** adds the weight of every source sequence numbered first_iseq or
+ higher that steps directly between two letters to the weight of the
+ links joining them, then frees the letter source lists and the text of
+ those sequences.  Only the first and last letter of each sequence keep
+ its source entry (the aligner uses them to find initial and final
+ letters, heaviest_link_path() to find starts), and each source_seq[]
+ keeps just its name, length and weight.  Call it again with the old
+ nsource_seq after fusing more sequences in.  The consensus can then be
+ found by heaviest_link_path(), but nothing that follows individual
+ sequences (MSA output, bundling, anchoring, pruning) works on seq
+ afterwards. */
+void fold_lpo_sources(LPOSequence_T *seq,int first_iseq)
+{
+  int i,weight,*contains_pos=NULL;
+  LPOLetterLink_T *right,*left;
+  LPOLetterSource_T *source,*kept;
+
+  CALLOC(contains_pos,seq->nsource_seq+1,int);
+  LOOPF (i,seq->length) { /* i'S SOURCES ARE NOT NEEDED ONCE i IS DONE */
+    if (seq->letter[i].source.ipos<0) /* NOTHING TO FOLD */
+      continue;
+    for (source= &seq->letter[i].source;source;source=source->more)
+      if (source->iseq>=first_iseq) /* NOT YET FOLDED */
+	contains_pos[source->iseq]=source->ipos+2; /* right MUST BE ADJACENT */
+    for (right= &seq->letter[i].right;right && right->ipos>=0;right=right->more){
+      weight=0;
+      for (source= &seq->letter[right->ipos].source;source && source->ipos>=0;
+	   source=source->more)
+	if (contains_pos[source->iseq]==source->ipos+1) /* YES, ADJACENT! */
+	  weight+=seq->source_seq[source->iseq].weight;
+      if (weight==0)
+	continue;
+      right->weight+=weight;
+      for (left= &seq->letter[right->ipos].left;left;left=left->more)
+	if (left->ipos==i) { /* KEEP THE REVERSE LINK IN STEP */
+	  left->weight+=weight;
+	  break;
+	}
+    }
+    for (source= &seq->letter[i].source;source;source=source->more)
+      contains_pos[source->iseq]=0; /* ERASE FOR THE NEXT LETTER */
+
+    /* KEEP ONLY SEQUENCE ENDS, PACKED INTO THE FRONT OF THE LIST */
+    for (kept=NULL,source= &seq->letter[i].source;source;source=source->more)
+      if (source->ipos==0
+	  || source->ipos==seq->source_seq[source->iseq].length-1) {
+	kept= kept ? kept->more : &seq->letter[i].source;
+	kept->iseq=source->iseq;
+	kept->ipos=source->ipos;
+      }
+    if (!kept) { /* NOTHING KEPT: BLANK THE HEAD */
+      kept= &seq->letter[i].source;
+      kept->ipos= INVALID_LETTER_POSITION;
+    }
+    if (kept->more) /* DUMP THE REST OF THE LIST */
+      free_lpo_source_list(kept->more);
+    kept->more=NULL;
+  }
+  FREE(contains_pos);
+
+  for (i=first_iseq;i<seq->nsource_seq;i++) { /* KEEP A MINIMAL RECORD */
+    FREE(seq->source_seq[i].title);
+    FREE(seq->source_seq[i].sequence);
+    FREE(seq->source_seq[i].seq_to_po);
+    FREE(seq->source_seq[i].po_to_seq);
+    free_lpo_numeric_data(seq->source_seq[i].ndata,seq->source_seq[i].data,
+			  TRUE);
+    seq->source_seq[i].data=NULL; /* DON'T LEAVE DANGLING POINTER! */
+    seq->source_seq[i].ndata=0;
+  }
+}
+
+
+
+
 /** FREES ALL DATA FROM seq, AND OPTIONALLY seq ITSELF */
 void free_lpo_sequence(LPOSequence_T *seq,int please_free_holder)
 {
@@ -746,6 +833,11 @@ void free_lpo_sequence(LPOSequence_T *seq,int please_free_holder)
     free_lpo_sourceinfo(seq->nsource_seq,seq->source_seq,TRUE);
     seq->source_seq=NULL; /* MARK AS FREED... DON'T LEAVE DANGLING POINTER! */
   }
+  if (seq->track) {
+    free_lpo_tracks(seq->ntrack,seq->track);
+    seq->track=NULL; /* MARK AS FREED... DON'T LEAVE DANGLING POINTER! */
+    seq->ntrack=0;
+  }
   if (please_free_holder) /*DON'T ALWAYS WANT TO FREE... MIGHT BE IN AN ARRAY*/
     free(seq);
 }
@@ -50,10 +50,26 @@ LPOSequence_T *fuse_lpo(LPOSequence_T *holder_x,
 			LPOLetterRef_T x_to_y[],
 			LPOLetterRef_T y_to_x[]);
 
+LPOSequence_T *fuse_lpo_remap(LPOSequence_T *holder_x,
+			      LPOSequence_T *holder_y,
+			      LPOLetterRef_T x_to_y[],
+			      LPOLetterRef_T y_to_x[],
+			      int nremap_x,
+			      LPOLetterRef_T remap_x[]);
+
+void free_lpo_link_list(LPOLetterLink_T *link);
+
+void free_lpo_source_list(LPOLetterSource_T *source);
+
 void free_lpo_letters(int nletter,LPOLetter_T *letter,int please_free_block);
 
+void free_lpo_sourceinfo(int nsource_seq,LPOSourceInfo_T *source_seq,
+			int please_free_block);
+
 void free_lpo_sequence(LPOSequence_T *seq,int please_free_holder);
 
+void fold_lpo_sources(LPOSequence_T *seq,int first_iseq);
+
 int add_path_sequence(int path_length,
 		      LPOLetterRef_T path[],
 		      LPOSequence_T *seq,
@@ -82,6 +98,46 @@ LPOScore_T align_lpo_po(LPOSequence_T *lposeq_x,
 			  ResidueScoreMatrix_T *),
 			int use_global_alignment);
 
+int find_lpo_region(LPOSequence_T *lposeq,int iseq,int start,int end,
+		    int *window_start,int *window_end);
+
+LPOScore_T align_lpo_po_window(LPOSequence_T *lposeq_x,
+			       int window_start,int window_end,
+			       LPOSequence_T *lposeq_y,
+			       ResidueScoreMatrix_T *m,
+			       LPOLetterRef_T **x_to_y,
+			       LPOLetterRef_T **y_to_x,
+			       LPOScore_T (*scoring_function)
+			       (int,int,LPOLetter_T [],LPOLetter_T [],
+				ResidueScoreMatrix_T *),
+			       int use_global_alignment);
+
+int set_lpo_kernel(int kernel);
+
+int set_lpo_tile_columns(int ncolumns);
+
+double get_lpo_dp_cell_count(void);
+void add_lpo_dp_cell_count(double ncell);
+
+void align_lpo_po_batch(int nprob,
+			LPOSequence_T *lposeq_x[],
+			LPOSequence_T *lposeq_y[],
+			ResidueScoreMatrix_T *m,
+			LPOLetterRef_T *x_to_y[],
+			LPOLetterRef_T *y_to_x[],
+			LPOScore_T score[],
+			int use_global_alignment);
+
+
+/************************************************** FROM anchor_lpo.c */
+int hash_kmer_windows(int n,int code[],int k,LPOKmer_T kmer[],int nkmer);
+
+int find_lpo_anchor_bands(LPOSequence_T *lposeq_x,
+			  LPOSequence_T *lposeq_y,
+			  int kmer_length,
+			  int **p_band_lo,
+			  int **p_band_hi);
+
 
 /************************************************** FROM buildup_lpo.c */
 LPOSequence_T *buildup_lpo(LPOSequence_T *new_seq,
@@ -95,6 +151,12 @@ LPOSequence_T *buildup_clipped_lpo(LPOSequence_T *new_seq,
 				  ResidueScoreMatrix_T *score_matrix,
 				   int use_global_alignment);
 
+int *order_buildup_seqs(int nseq,LPOSequence_T **seq,
+			ResidueScoreMatrix_T *score_matrix,int buildup_order);
+
+int orient_buildup_seqs(int nseq,LPOSequence_T **seq,
+			ResidueScoreMatrix_T *score_matrix);
+
 LPOSequence_T *buildup_progressive_lpo(int nseq, LPOSequence_T **seqs,
 				       ResidueScoreMatrix_T *score_matrix,
 				       int use_aggressive_fusion,
@@ -104,8 +166,29 @@ LPOSequence_T *buildup_progressive_lpo(int nseq, LPOSequence_T **seqs,
 				       (int,int,LPOLetter_T [],LPOLetter_T [],
 					ResidueScoreMatrix_T *),
                                        int use_global_alignment,
-				       int preserve_sequence_order);
+				       int preserve_sequence_order,
+				       int consensus_only,
+				       int buildup_order,
+				       LPOPrune_T *prune,
+				       LPOCheckpoint_T *checkpoint,
+				       LPOSpeculate_T *speculate);
 				       
+int buildup_speculative_lpo(LPOSequence_T *new_seq,
+			    int nseq,LPOSequence_T *seq[],
+			    ResidueScoreMatrix_T *score_matrix,
+			    int use_aggressive_fusion,
+			    LPOScore_T (*scoring_function)
+			    (int,int,LPOLetter_T [],LPOLetter_T [],
+			     ResidueScoreMatrix_T *),
+			    int use_global_alignment,
+			    int nthread);
+
+int buildup_lpo_batch(int ncluster,int nseq[],LPOSequence_T *seqs[],
+		      ResidueScoreMatrix_T *score_matrix,
+		      int use_aggressive_fusion,
+		      int use_global_alignment,
+		      int consensus_only);
+
 LPOSequence_T *buildup_pairwise_lpo(LPOSequence_T seq1[],LPOSequence_T seq2[],
 				    ResidueScoreMatrix_T *score_matrix,
 				    int use_aggressive_fusion,
@@ -114,6 +197,35 @@ LPOSequence_T *buildup_pairwise_lpo(LPOSequence_T seq1[],LPOSequence_T seq2[],
 				     ResidueScoreMatrix_T *),
                                     int use_global_alignment);
 				    
+/****************************************************** lpo_move.c */
+void init_lpo_move_row(LPOMoveRow_T *row,int col_lo,int col_hi);
+int add_lpo_move_side(LPOMoveRow_T *row,int col,int x,int y);
+void get_lpo_move(LPOMoveRow_T *row,int col,int *p_x,int *p_y);
+void free_lpo_move_rows(int nrow,LPOMoveRow_T row[],int please_free_code);
+
+/****************************************************** polish_lpo.c */
+int polish_lpo_windows(LPOPolish_T *polish,int nread,Sequence_T read[],
+		       ResidueScoreMatrix_T *m,int use_aggressive_fusion,
+		       int use_global_alignment,int do_switch_case,
+		       char consensus_out[]);
+
+/******************************************************* serve_lpo.c */
+int serve_lpo_requests(LPOServe_T *serve,ResidueScoreMatrix_T *m,
+		       int do_switch_case);
+
+/**************************************************** checkpoint.c */
+int write_lpo_binary(FILE *ofile,LPOSequence_T *seq);
+int read_lpo_binary(FILE *ifile,LPOSequence_T *seq);
+
+int save_buildup_checkpoint(char filename[],int nseq,LPOSequence_T **all_seqs,
+			    int nscore,SeqPairScore_T score[],int iscore,
+			    int nfusion,int seq_cluster[],int seq_id_in_cluster[],
+			    int cluster_size[],int initial_nseq[]);
+int load_buildup_checkpoint(char filename[],int nseq,LPOSequence_T **all_seqs,
+			    int *p_nscore,SeqPairScore_T **p_score,
+			    int *p_iscore,int *p_nfusion,int seq_cluster[],
+			    int seq_id_in_cluster[],int cluster_size[]);
+
 /**************************************************** lpo_format.c */
 void write_lpo(FILE *ifile,LPOSequence_T *seq,
 	       ResidueScoreMatrix_T *score_matrix);
@@ -122,6 +234,12 @@ LPOSequence_T *read_lpo(FILE *ifile);
 LPOSequence_T *read_lpo_select(FILE *ifile,FILE *select_ifile,
 			       int keep_all_links,int remove_listed_sequences);
 
+void init_lpo_column_cursor(LPOColumnCursor_T *cursor,LPOSequence_T *seq,
+			    int nsymbol,char symbol[],char gap_character);
+int next_lpo_column(LPOColumnCursor_T *cursor);
+void rewind_lpo_column_cursor(LPOColumnCursor_T *cursor);
+void free_lpo_column_cursor(LPOColumnCursor_T *cursor);
+
 void write_lpo_as_fasta(FILE *ifile,LPOSequence_T *seq,
 			int nsymbol,char symbol[]);
 
@@ -134,6 +252,15 @@ void export_clustal_seqal(FILE *ifile,
 
 /****************************************************** heaviest_bundle.c */
 void generate_lpo_bundles(LPOSequence_T *seq,float minimum_fraction);
+LPOLetterRef_T *heaviest_bundle(int len,LPOLetter_T seq[],int nsource_seq,LPOSourceInfo_T source_seq[],int *p_best_len);
+LPOLetterRef_T *heaviest_bundle_quality(int len,LPOLetter_T seq[],
+					int nsource_seq,
+					LPOSourceInfo_T source_seq[],
+					LPONumericTrack_T *quality,
+					int *p_best_len);
+LPOLetterRef_T *heaviest_link_path(int len,LPOLetter_T seq[],
+				   LPOSourceInfo_T source_seq[],
+				   int *p_best_len);
 
 
 /****************************************************** make_frame.c */
@@ -150,6 +277,7 @@ LPOSequence_T *map_protein_to_dna(char dna_name[],
 
 /****************************************************** remove_bundle.c */
 int remove_bundle(LPOSequence_T *seq,int ibundle,int delete_all_others);
+int prune_lpo(LPOSequence_T *seq,int min_weight,int protect_from);
 
 
 
@@ -176,6 +304,23 @@ void read_numeric_data(int nsource_seq,
 LPONumericData_T *cp_numeric_data(LPOSourceInfo_T *source_seq,
 				  LPONumericData_T *data);
 
+int new_lpo_track(LPOSequence_T *seq,char name[],int type);
+int find_lpo_track(LPOSequence_T *seq,char name[]);
+void *set_lpo_track_values(LPOSequence_T *seq,int itrack,int iseq,int n);
+double lpo_track_value(LPONumericTrack_T *track,int iseq,int ipos,
+		       double missing);
+void free_lpo_tracks(int ntrack,LPONumericTrack_T *track);
+void copy_lpo_tracks(LPOSequence_T *to,LPOSequence_T *from,int iseq_new[]);
+void permute_lpo_tracks(LPOSequence_T *seq,int perm[]);
+int add_lpo_track_link_weights(LPOSequence_T *seq);
+int write_lpo_tracks(FILE *ofile,LPOSequence_T *seq);
+int read_lpo_tracks(FILE *ifile,int nseq,LPOSequence_T seq[]);
+int read_lpo_tracks_text(FILE *ifile,int nseq,LPOSequence_T seq[],int type);
+void reverse_lpo_track_values(LPOSequence_T *seq,int iseq);
+
+/******************************************************* fastq_format.c */
+int read_fastq(FILE *ifile,Sequence_T **seq,int do_switch_case);
+
 /******************************************************* balance_matrix.c */
 int read_aa_frequencies(char filename[],ResidueScoreMatrix_T *score_matrix)
      ;
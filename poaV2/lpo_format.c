@@ -47,6 +47,23 @@ void write_lpo(FILE *ifile,LPOSequence_T *seq,
 
 
 
+/** appends source (iseq,ipos) to a letter's source list, whose last
+ entry is *tail (NULL: THE LIST IS EMPTY), without walking the list */
+static void append_lpo_source(LPOLetterSource_T *source,
+			      LPOLetterSource_T **tail,int iseq,int ipos)
+{
+  if (*tail) { /* ALREADY A SOURCE HERE, SO CREATE NEW ENTRY */
+    CALLOC((*tail)->more,1,LPOLetterSource_T);
+    source=(*tail)->more;
+  }
+  source->iseq=iseq;
+  source->ipos=ipos;
+  *tail=source;
+}
+
+
+
+
 /** reads an LPO from the stream ifile, dynamically allocates memory for
 it, and returns a pointer to the LPO */
 LPOSequence_T *read_lpo(FILE *ifile)
@@ -55,7 +72,7 @@ LPOSequence_T *read_lpo(FILE *ifile)
   int weight,bundle_id,last_alloc=0;
   LPOSequence_T *seq=NULL;
   char c,name[1024]="",title[4096]="",version[256]="";
-  LPOLetterSource_T save_source={0,0,NULL};
+  LPOLetterSource_T *source_tail;
 
   CALLOC(seq,1,LPOSequence_T);
   fscanf(ifile,"VERSION=%s",version);
@@ -98,6 +115,7 @@ LPOSequence_T *read_lpo(FILE *ifile)
     if (fscanf(ifile," %c:",&c)!=1) /* READ SEQUENCE LETTER */
       return NULL;
     seq->letter[i].letter=c;
+    source_tail=NULL;
     while ((field_id=getc(ifile))!=EOF && '\n'!=field_id) {/* READ FIELDS*/
       if (1!=fscanf(ifile,"%d",&value))
 	return NULL;
@@ -107,8 +125,8 @@ LPOSequence_T *read_lpo(FILE *ifile)
 	add_lpo_link(&seq->letter[value].right,i);
 	break;
       case 'S':  /* SAVE THE SOURCE ID */
-	save_source.ipos=pos_count[value]++;
-	add_lpo_sources(&seq->letter[i].source,&save_source,&value);
+	append_lpo_source(&seq->letter[i].source,&source_tail,value,
+			  pos_count[value]++);
 	break;
       case 'A': /* SAVE THE ALIGN RING POINTER */
 	seq->letter[i].align_ring=value;
@@ -138,6 +156,37 @@ enum {
   default_no_retention_mode
 };
 
+
+/** ORDERS SOURCES BY NAME, THEN BY INDEX */
+static int source_name_cmp(const void *void_a,const void *void_b)
+{
+  const LPOSourceInfo_T *a= *(LPOSourceInfo_T * const *)void_a;
+  const LPOSourceInfo_T *b= *(LPOSourceInfo_T * const *)void_b;
+  int cmp=strcmp(a->name,b->name);
+
+  return cmp ? cmp : (a<b ? -1 : a>b);
+}
+
+
+/** index of the last source named name in by_name[] (SORTED BY
+ source_name_cmp()), or -1 if there is none */
+static int find_source_name(int nsource_seq,LPOSourceInfo_T *by_name[],
+			    LPOSourceInfo_T source_seq[],char name[])
+{
+  int low=0,high=nsource_seq,mid;
+
+  while (low<high) { /* FIRST ENTRY SORTING AFTER name */
+    mid=(low+high)/2;
+    if (strcmp(by_name[mid]->name,name)<=0)
+      low=mid+1;
+    else
+      high=mid;
+  }
+  if (low>0 && 0==strcmp(by_name[low-1]->name,name))
+    return by_name[low-1]-source_seq;
+  return -1;
+}
+
 /** reads an LPO from the stream ifile, dynamically allocates memory for
 it, and returns a pointer to the LPO */
 LPOSequence_T *read_lpo_select(FILE *ifile,FILE *select_file,
@@ -149,7 +198,8 @@ LPOSequence_T *read_lpo_select(FILE *ifile,FILE *select_file,
   int *pos_compact=NULL,npos_compact=0,keep_this_letter,retention_mode;
   LPOSequence_T *seq=NULL;
   char c,name[1024]="",title[4096]="",version[256]="";
-  LPOLetterSource_T save_source={0,0,NULL},*source=NULL;
+  LPOLetterSource_T *source=NULL,*source_tail;
+  LPOSourceInfo_T **by_name=NULL;
 
   if (remove_listed_sequences)
     retention_mode=default_retention_mode;/*KEEP SEQS AS DFLT, SKIP IF LISTED*/
@@ -196,16 +246,18 @@ LPOSequence_T *read_lpo_select(FILE *ifile,FILE *select_file,
   CALLOC(iseq_compact,nsource_seq,int);
   CALLOC(last_pos,nsource_seq,int);
   CALLOC(match_pos,nsource_seq,int);
-  if (select_file) {
-    LOOP (i,nsource_seq) /* DEFAULT: MARKED AS INVALID */
+  if (select_file && nsource_seq>0) {
+    CALLOC(by_name,nsource_seq,LPOSourceInfo_T *);
+    LOOP (i,nsource_seq) { /* DEFAULT: MARKED AS INVALID */
       iseq_compact[i]= -retention_mode;
-    while (fscanf(select_file,"SOURCENAME=%[^\n]\n",name)==1) {
-      LOOP (i,nsource_seq)
-	if (strcmp(seq->source_seq[i].name,name)==0) {
-	  iseq_compact[i]= retention_mode-1;
-	  break;
-	}
+      by_name[i]=seq->source_seq+i;
     }
+    /* LOOK NAMES UP IN SORTED ORDER, SO A LONG LIST COSTS n log n, NOT n^2 */
+    qsort(by_name,nsource_seq,sizeof(LPOSourceInfo_T *),source_name_cmp);
+    while (fscanf(select_file,"SOURCENAME=%[^\n]\n",name)==1)
+      if ((i=find_source_name(nsource_seq,by_name,seq->source_seq,name))>=0)
+	iseq_compact[i]= retention_mode-1;
+    FREE(by_name);
   }
 
   j=0;
@@ -235,6 +287,7 @@ LPOSequence_T *read_lpo_select(FILE *ifile,FILE *select_file,
     if (fscanf(ifile," %c:",&c)!=1) /* READ SEQUENCE LETTER */
       return NULL;
     seq->letter[npos_compact].letter=c;
+    source_tail=NULL;
     nlink=0;
     keep_this_letter=0; /*DEFAULT */
     while ((field_id=getc(ifile))!=EOF && '\n'!=field_id) {/* READ FIELDS*/
@@ -258,9 +311,8 @@ LPOSequence_T *read_lpo_select(FILE *ifile,FILE *select_file,
 	    }
 	  }
 	  last_pos[value]=npos_compact; /* THIS SEQ POS IS AT THIS NODE */
-	  save_source.ipos=pos_count[value]++;/* COUNT LENGTH OF THIS SEQ */
-	  add_lpo_sources(&seq->letter[npos_compact].source,
-			  &save_source,&value);
+	  append_lpo_source(&seq->letter[npos_compact].source,&source_tail,
+			    value,pos_count[value]++);/* COUNT LENGTH OF THIS SEQ */
 	  seq->letter[npos_compact].ring_id= INVALID_LETTER_POSITION;
 	  seq->letter[npos_compact].align_ring=i;
 	  ring_old[i]=i; /* DEFAULT: SELF-RING OF ONE LETTER*/
@@ -334,89 +386,134 @@ LPOSequence_T *read_lpo(FILE *ifile)
 
 
 #define FASTA_GAP_CHARACTER '-'
-int xlate_lpo_to_al(LPOSequence_T *seq,
-		    int nsymbol,char symbol[],int ibundle,
-		    char gap_character,
-		    char ***p_seq_pos,char **p_p,char **p_include)
+
+/** prepares cursor for streaming the LPO seq as RC-MSA columns, one
+ alignment ring at a time.  Only a single column of seq->nsource_seq
+ characters is kept, so memory does not grow with the alignment width */
+void init_lpo_column_cursor(LPOColumnCursor_T *cursor,LPOSequence_T *seq,
+			    int nsymbol,char symbol[],char gap_character)
 {
-  int i,j,iring=0,nring=0,current_ring=0,iprint;
-  char **seq_pos=NULL,*p=NULL,*include_in_save=NULL;
-  LPOLetterSource_T *source;
+  int i;
+
+  memset(cursor,0,sizeof(LPOColumnCursor_T));
+  cursor->seq=seq;
+  cursor->nsymbol=nsymbol;
+  cursor->symbol=symbol;
+  cursor->gap_character=gap_character;
+  cursor->icol= -1; /* NO COLUMN DELIVERED YET */
+  CALLOC(cursor->column,seq->nsource_seq+1,char);
+  memset(cursor->column,gap_character,seq->nsource_seq);
 
   LOOPF (i,seq->length) /* COUNT TOTAL #ALIGNMENT RINGS IN THE LPO */
-    if (seq->letter[i].ring_id != current_ring) { /* NEXT RING */
-      current_ring=seq->letter[i].ring_id;
-      nring++;
-    }
-  nring++; /* DON'T FORGET TO COUNT THE LAST RING!!! */
-
-  CALLOC(seq_pos,seq->nsource_seq,char *); /* ALLOCATE MAP ARRAY*/
-  CALLOC(p,seq->nsource_seq*nring,char);
-  LOOP (i,seq->nsource_seq) /* BUILD POINTER ARRAY INTO MAP ARRAY */
-    seq_pos[i]=p+i*nring;
-  memset(p,gap_character,seq->nsource_seq*nring);
-  /* DEFAULT IS NO SEQUENCE PRESENT AT THIS POSITION */
-
-  current_ring=0; /* RESET TO BEGINNING */
-  LOOPF (i,seq->length) { /* NOW MAP THE LPO TO A FLAT LINEAR ORDER */
-    if (seq->letter[i].ring_id != current_ring) { /* NEXT RING */
-      current_ring=seq->letter[i].ring_id;
-      iring++;
-    } /* MAP EACH SOURCE SEQ ONTO LINEAR ORDER INDEXED BY iring */
+    if (0==i || seq->letter[i].ring_id != seq->letter[i-1].ring_id)
+      cursor->ncol++;
+}
+
+
+/** advances cursor to the next alignment ring, leaving the residue of
+ each source sequence (or the gap character) in cursor->column[iseq].
+ Returns FALSE when all columns have been delivered */
+int next_lpo_column(LPOColumnCursor_T *cursor)
+{
+  int i;
+  LPOSequence_T *seq=cursor->seq;
+  LPOLetterSource_T *source;
+  char c;
+
+  for (i=cursor->col_start;i<cursor->col_end;i++) /* RESET LAST COLUMN */
+    for (source= &seq->letter[i].source;source;source=source->more)
+      if (source->iseq>=0)
+	cursor->column[source->iseq]=cursor->gap_character;
+
+  if (cursor->col_end>=seq->length) /* NO MORE RINGS */
+    return FALSE;
+  cursor->col_start=cursor->col_end; /* RING IS ONE CONTIGUOUS BLOCK */
+  for (i=cursor->col_start;i<seq->length
+	 && seq->letter[i].ring_id==seq->letter[cursor->col_start].ring_id;i++) {
+    if (cursor->symbol && seq->letter[i].letter<cursor->nsymbol)
+      c=cursor->symbol[seq->letter[i].letter]; /* TRANSLATE TO symbol */
+    else /* NO NEED TO TRANSLATE */
+      c=seq->letter[i].letter;
     for (source= &seq->letter[i].source;source;source=source->more)
-      if (symbol && seq->letter[i].letter<nsymbol)  /* TRANSLATE TO symbol */
-	seq_pos[source->iseq][iring]= symbol[seq->letter[i].letter];
-      else  /* NO NEED TO TRANSLATE */
-	seq_pos[source->iseq][iring]= seq->letter[i].letter;
+      if (source->iseq>=0)
+	cursor->column[source->iseq]=c;
   }
+  cursor->col_end=i;
+  cursor->icol++;
+  return TRUE;
+}
 
-  if (ibundle>=0) { /* ONLY SAVE SEQS THAT ARE IN THIS BUNDLE */
-    CALLOC(include_in_save,nring,char); /* BLANK FLAGS: WHAT RINGS TO SHOW*/
-    LOOP (iring,nring) { /* CHECK EACH RING TO SEE IF IT'S IN BUNDLE */
-      LOOP (i,seq->nsource_seq) {
-	if (seq_pos[i][iring]!=gap_character /* ALIGNED HERE! */
-	    && seq->source_seq[i].bundle_id == ibundle) { /* PART OF BUNDLE!*/
-	  include_in_save[iring]=1; /* SO INCLUDE THIS RING */
-	  break;
-	}
-      }
-    }
-  }
-  if (p_seq_pos)
-    *p_seq_pos = seq_pos;
-  return nring;
+
+/** restarts cursor at the first column; column[] is already all gaps
+ once next_lpo_column() has returned FALSE */
+void rewind_lpo_column_cursor(LPOColumnCursor_T *cursor)
+{
+  LPOLetterSource_T *source;
+  int i;
+
+  for (i=cursor->col_start;i<cursor->col_end;i++) /* RESET LAST COLUMN */
+    for (source= &cursor->seq->letter[i].source;source;source=source->more)
+      if (source->iseq>=0)
+	cursor->column[source->iseq]=cursor->gap_character;
+  cursor->col_start=cursor->col_end=0;
+  cursor->icol= -1;
+}
+
+
+void free_lpo_column_cursor(LPOColumnCursor_T *cursor)
+{
+  FREE(cursor->column);
 }
 
 
+
+
 /** writes the LPO in FASTA format, including all sequences in the
-  specified bundle */
+  specified bundle.  Rows are gathered in blocks of at most
+  LPO_EXPORT_BUFFER_SIZE bytes, with one streaming pass over the LPO
+  per block, instead of building the full RC-MSA matrix */
 void write_lpo_bundle_as_fasta(FILE *ifile,LPOSequence_T *seq,
 			       int nsymbol,char symbol[],int ibundle)
 {
-  int i,j,nring=0,iprint;
-  char **seq_pos=NULL,*p=NULL,*include_in_save=NULL;
+  int i,j,nrow=0,row_start,row_end,rows_per_pass,*row_of_seq=NULL;
+  char *block=NULL;
+  LPOColumnCursor_T cursor;
 
-  nring=xlate_lpo_to_al(seq,nsymbol,symbol,ibundle, /* TRANSLATE TO */
-			FASTA_GAP_CHARACTER,        /* RC-MSA FMT */
-			&seq_pos,&p,&include_in_save);
-  LOOPF (i,seq->nsource_seq) { /* NOW WRITE OUT FASTA FORMAT */
+  init_lpo_column_cursor(&cursor,seq,nsymbol,symbol,FASTA_GAP_CHARACTER);
+  CALLOC(row_of_seq,seq->nsource_seq,int);
+  LOOPF (i,seq->nsource_seq) /* WHICH SEQS GET PRINTED, IN WHAT ORDER */
     if (ibundle<0 /* PRINT ALL BUNDLES */
-	|| seq->source_seq[i].bundle_id == ibundle) { /* OR JUST THIS BUNDLE*/
-      fprintf(ifile,">%s",seq->source_seq[i].name);
-      iprint=0;
-      LOOPF (j,nring) { /* WRITE OUT 60 CHARACTER SEQUENCE LINES */
-	if (NULL==include_in_save || include_in_save[j]) {
-	  fprintf(ifile,"%s%c",iprint%60? "":"\n", seq_pos[i][j]);
-	  iprint++; /* KEEP COUNT OF PRINTED CHARACTERS */
-	}
-      }
+	|| seq->source_seq[i].bundle_id == ibundle) /* OR JUST THIS BUNDLE*/
+      row_of_seq[nrow++]=i;
+
+  rows_per_pass=(cursor.ncol>0) ? LPO_EXPORT_BUFFER_SIZE/cursor.ncol : nrow;
+  if (rows_per_pass<1)
+    rows_per_pass=1;
+  if (rows_per_pass>nrow)
+    rows_per_pass=nrow;
+  CALLOC(block,rows_per_pass*cursor.ncol,char);
+
+  for (row_start=0;row_start<nrow;row_start=row_end) {
+    row_end=row_start+rows_per_pass;
+    if (row_end>nrow)
+      row_end=nrow;
+    rewind_lpo_column_cursor(&cursor); /* ONE PASS OVER THE LPO PER BLOCK */
+    while (next_lpo_column(&cursor)) /* SCATTER COLUMN INTO OUR ROW BLOCK */
+      for (i=row_start;i<row_end;i++)
+	block[(i-row_start)*cursor.ncol+cursor.icol]
+	  =cursor.column[row_of_seq[i]];
+
+    for (i=row_start;i<row_end;i++) { /* NOW WRITE OUT FASTA FORMAT */
+      fprintf(ifile,">%s",seq->source_seq[row_of_seq[i]].name);
+      LOOPF (j,cursor.ncol) /* WRITE OUT 60 CHARACTER SEQUENCE LINES */
+	fprintf(ifile,"%s%c",j%60? "":"\n",block[(i-row_start)*cursor.ncol+j]);
       fputc('\n',ifile);
     }
   }
 
-  FREE(p); /* DUMP TEMPORARY MEMORY */
-  FREE(include_in_save);
-  FREE(seq_pos);
+  free_lpo_column_cursor(&cursor); /* DUMP TEMPORARY MEMORY */
+  FREE(block);
+  FREE(row_of_seq);
 }
 /**@memo example: writing FASTA format file:
     if (seq_ifile=fopen(fasta_out,"w")) {
@@ -446,7 +543,9 @@ void write_lpo_as_fasta(FILE *ifile,LPOSequence_T *seq,
   *
   *     This function writes out sequences.  Each line of sequnces
   *     will be written out in blocks with spacing in between
-  *     each block.
+  *     each block.  Columns are streamed from the LPO one paragraph
+  *     at a time, so only nsource_seq x paragraph width characters
+  *     are held in memory.
   *
   ***************************************************************/
 
@@ -461,19 +560,23 @@ int write_sequences(FILE *ifile,
 		    char gap_char,
 		    int nsymbol,char symbol[])
 {
-  int i,ip,ial,iseq,iblock,nparagraph,remainder,ipos,ipos_local,broken;
-  int len,nring;
-  char **seq_pos=NULL,*p=NULL,*include_in_save=NULL;
+  int i,ip,iseq,iblock,nparagraph,remainder,ipos,broken;
+  int len,width,nwidth;
+  char *paragraph=NULL;
+  LPOColumnCursor_T cursor;
 
-  nring=xlate_lpo_to_al(seq,nsymbol,symbol,ALL_BUNDLES, /* TRANSLATE TO */
-		        gap_char,                   /* RC-MSA FMT */
-			&seq_pos,&p,&include_in_save);
+  init_lpo_column_cursor(&cursor,seq,nsymbol,symbol,gap_char);
+  width=nblock*block_size; /* COLUMNS PER PARAGRAPH */
+  CALLOC(paragraph,seq->nsource_seq*width,char);
 
-  nparagraph = nring/(nblock*block_size);/*# OF FULL PARAGRAPHS */
-  remainder = nring%(nblock*block_size);
+  nparagraph = cursor.ncol/width;/*# OF FULL PARAGRAPHS */
+  remainder = cursor.ncol%width;
   if (remainder != 0)
     nparagraph++;
   LOOPF(ip,nparagraph){  /* FOR EACH PARAGRAPH */
+    for (nwidth=0;nwidth<width && next_lpo_column(&cursor);nwidth++)
+      LOOPF(iseq,seq->nsource_seq) /* GATHER THIS PARAGRAPH'S COLUMNS */
+	paragraph[iseq*width+nwidth]=cursor.column[iseq];
     LOOPF(iseq,seq->nsource_seq){ /* FOR EACH SEQUENCE */
       if (ip == 0 || names){
 	if ((len=strlen(seq->source_seq[iseq].name))>indent-1){ /*MUST WE TRUNCATE NAME? */
@@ -494,12 +597,12 @@ int write_sequences(FILE *ifile,
       LOOPF(iblock,nblock){ /* FOR EACH BLOCK */
 	broken=0;
 	LOOPF(i,block_size){
-	  ipos = i + (iblock*block_size) + (ip*nblock*block_size);
-	  if (ipos>=nring){
+	  ipos = i + (iblock*block_size);
+	  if (ipos>=nwidth){
 	    broken=1;
 	    break;
 	  }
-	  putc(seq_pos[iseq][ipos],ifile); /* APPROP SYMBOL FOR THIS POS*/
+	  putc(paragraph[iseq*width+ipos],ifile); /* APPROP SYMBOL FOR THIS POS*/
 	}
 	if (broken)
 	  break;
@@ -511,10 +614,9 @@ int write_sequences(FILE *ifile,
     LOOP(i,paragraph_spacing) /* ADD SPACING BETWEEN PARAGRAPHS */
       putc('\n',ifile);
   } /* END OF PARAGRAPH LOOP */
- done:
-  FREE(p); /* DUMP TEMPORARY MEMORY */
-  FREE(include_in_save);
-  FREE(seq_pos);
+
+  free_lpo_column_cursor(&cursor); /* DUMP TEMPORARY MEMORY */
+  FREE(paragraph);
   return 0;
 }
 
@@ -529,4 +631,3 @@ void export_clustal_seqal(FILE *ifile,
      SPACING, 2 LINES PARAGRAPH SPACING, PRINT NAMES ON ALL LINES. */
   write_sequences(ifile,seq,36,1,50,0,2,1,'-',nsymbol,symbol);
 }
-
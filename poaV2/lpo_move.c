@@ -0,0 +1,83 @@
+#include "default.h"
+#include "poa.h"
+#include "seq_util.h"
+#include "lpo.h"
+
+
+/* COMPRESSED DP TRACEBACK MATRICES: NEARLY EVERY CELL MOVES BACK ALONG
+   ONE OF ITS FIRST FEW x-PREDECESSORS AND ITS FIRST y-PREDECESSOR (OR
+   NONE), SO A CELL KEEPS ONLY A 4-BIT CODE; THE FEW MOVES ALONG ANY
+   OTHER PREDECESSOR ARE KEPT IN A SIDE TABLE PER ROW, WITH NO LIMIT ON
+   THE PREDECESSOR INDEX. */
+
+
+/** allocates zeroed move codes in row for cells col_lo..col_hi */
+void init_lpo_move_row(LPOMoveRow_T *row,int col_lo,int col_hi)
+{
+  int ncol=(col_hi>=col_lo) ? col_hi-col_lo+1 : 1;
+
+  CALLOC(row->code,(ncol+1)/2,unsigned char);
+  row->first= -col_lo;
+  row->stride=1;
+  row->nside=row->max_side=0;
+  row->side=NULL;
+}
+
+
+/** appends the move (x,y) of cell col to row's side table, and returns
+    the code that refers to it; called by LPO_MOVE_CODE() for moves that
+    do not fit in their code */
+int add_lpo_move_side(LPOMoveRow_T *row,int col,int x,int y)
+{
+  if (row->nside>=row->max_side) {
+    row->max_side=(row->max_side>0) ? 2*row->max_side : 8;
+    REALLOC(row->side,row->max_side,LPOMoveSide_T);
+  }
+  row->side[row->nside].col=col;
+  row->side[row->nside].x=x;
+  row->side[row->nside].y=y;
+  row->nside++;
+  return LPO_MOVE_SIDE;
+}
+
+
+/** reads back the move of cell col, stored by SET_LPO_MOVE(), into
+    *p_x and *p_y */
+void get_lpo_move(LPOMoveRow_T *row,int col,int *p_x,int *p_y)
+{
+  int nibble=col*row->stride+row->first,code,lo,hi,mid;
+
+  code=(row->code[nibble>>1] >> ((nibble&1)<<2)) & 15;
+  *p_x=code & 7;
+  *p_y=code >> 3;
+  if (*p_x<LPO_MOVE_SIDE)
+    return;
+
+  lo=0; /* BINARY SEARCH THE SIDE TABLE, WHICH IS IN col ORDER */
+  hi=row->nside-1;
+  while (lo<hi) {
+    mid=(lo+hi)/2;
+    if (row->side[mid].col<col)
+      lo=mid+1;
+    else
+      hi=mid;
+  }
+  IF_GUARD(row->nside==0 || row->side[lo].col!=col,1.1,(ERRTXT,"no side entry for traceback cell %d\n",col),CRASH);
+  *p_x=row->side[lo].x;
+  *p_y=row->side[lo].y;
+}
+
+
+/** frees the side tables of row[0..nrow-1], and their codes too if
+    please_free_code */
+void free_lpo_move_rows(int nrow,LPOMoveRow_T row[],int please_free_code)
+{
+  int i;
+
+  LOOPF (i,nrow) {
+    if (please_free_code)
+      FREE(row[i].code);
+    FREE(row[i].side);
+    row[i].nside=row[i].max_side=0;
+  }
+}
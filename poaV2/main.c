@@ -6,6 +6,8 @@
 
 
 static LPOSequence_T *read_partial_order_file (char *po_filename, char *subset_filename, int remove_listed_seqs, int keep_all_links, int do_switch_case, ResidueScoreMatrix_T *mat);
+static int align_fasta_batch (int nseq, LPOSequence_T seq[], ResidueScoreMatrix_T *m, int use_aggressive_fusion, int use_global_alignment, int auto_strand, char consensus_out[]);
+static int read_fasta_tracks (char *track_filename, char *track_weights, int nseq, LPOSequence_T seq[], FILE *errfile);
 
 int main(int argc,char *argv[])
 {
@@ -31,15 +33,29 @@ int main(int argc,char *argv[])
   int remove_listed_seqs=0,remove_listed_seqs2=0,please_report_similarity;
   int do_global=0, do_progressive=0, do_preserve_sequence_order=0;
   char *reference_seq_name="CONSENS%d",*clustal_out=NULL;
+  char *fasta_text=NULL,*checkpoint_every=NULL,*xdrop=NULL,*zdrop=NULL,
+    *anchor_kmer=NULL,*order_name=NULL,*prune_every=NULL,*prune_min=NULL,
+    *consensus_out=NULL,*polish_window=NULL,*nthread=NULL,*speculate_batch=NULL,
+    *region=NULL,*track_filename=NULL,*track_weights=NULL,*tracks_out=NULL;
+  int buildup_order=buildup_input_order,report_stats=0,do_batch=0;
+  size_t fasta_size=0;
+  LPOCheckpoint_T checkpoint={NULL,100,0};
+  LPOPrune_T prune={0,2};
+  LPOPolish_T polish={NULL,NULL,500,1};
+  LPOSpeculate_T speculate={0,1};
+  LPOServe_T serve={NULL,1};
 
   black_flag_init(argv[0],PROGRAM_VERSION);
 
   if (argc<2) {
     fprintf(stderr,"\nUsage: %s [OPTIONS] MATRIXFILE\n"
 "Align a set of sequences or alignments using the scores in MATRIXFILE.\n"
-"Example: %s -read_fasta multidom.seq -clustal m.aln blosum80.mat\n\n"
+"Example: %s -read_fasta multidom.seq -clustal m.aln blosum80.mat\n"
+"MATRIXFILE may also be builtin:dna or builtin:blosum80 (compiled in).\n\n"
 "INPUT:\n"
-"  -read_fasta FILE       Read in FASTA sequence file.\n"
+"  -read_fasta FILE       Read in FASTA sequence file.  A FASTQ file is\n"
+"                           read too: its base qualities weight each\n"
+"                           sequence's links and its -hb bundle support.\n"
 "  -read_msa FILE         Read in MSA alignment file.\n"
 "  -read_msa2 FILE        Read in second MSA file. \n"
 "  -subset FILE           Filter MSA to include list of seqs in file.\n"
@@ -47,6 +63,30 @@ int main(int argc,char *argv[])
 "  -remove FILE           Filter MSA to exclude list of seqs in file.\n"
 "  -remove2 FILE          Filter second MSA to exclude list of seqs in file.\n"
 "  -read_msa_list FILE    Read an MSA from each filename listed in file.\n"
+"  -batch                 Treat the -read_fasta file as many independent\n"
+"                           clusters (runs of records whose names agree up\n"
+"                           to the first '/'), aligned side by side; needs\n"
+"                           -consensus_only, which gets one consensus per\n"
+"                           cluster, named after the cluster.\n"
+"  -polish DRAFT          Polish the contigs of FASTA file DRAFT with the\n"
+"                           -read_fasta reads that -polish_map maps to them,\n"
+"                           one window at a time; needs -consensus_only,\n"
+"                           which gets the polished contigs.\n"
+"  -polish_map FILE       Read-to-draft mappings for -polish, in PAF (with\n"
+"                           or without cg:Z: CIGARs) or SAM format.\n"
+"  -polish_window N       Draft residues per -polish window (default 500).\n"
+"  -threads N             Polish N windows, align N -speculate sequences, or\n"
+"                           answer N -serve requests at a time (default 1).\n"
+"  -serve SOCKET          Instead of reading input files, answer alignment\n"
+"                           requests on the Unix domain socket SOCKET until\n"
+"                           a client sends QUIT (see serve_lpo.c and\n"
+"                           poa_client); the matrix is read only once.\n"
+"  -read_tracks FILE      Read per-position numeric tracks (e.g. base\n"
+"                           qualities) for the -read_fasta sequences, saved\n"
+"                           by -write_tracks or as NUMERIC_DATA text records.\n"
+"  -track_weights NAME[:SCALE]  Add SCALE (default 1) times the values of\n"
+"                           track NAME to the weight of each link a sequence\n"
+"                           steps along (seen by -consensus_only).\n"
 "  -tolower               Force FASTA/MSA sequences to lowercase\n"
 "                           (nucleotides in our matrix files)\n"
 "  -toupper               Force FASTA/MSA sequences to UPPERCASE\n"
@@ -56,10 +96,39 @@ int main(int argc,char *argv[])
 "  -do_progressive        Perform progressive alignment using a guide tree\n"
 "                           built by neighbor joining from a set of\n"
 "                           sequence-sequence similarity scores.\n"
+"  -speculate K           Align sequences K at a time to the same snapshot of\n"
+"                           the alignment (on -threads threads), then add them\n"
+"                           one by one, realigning any that deviate from it\n"
+"                           where an earlier one of the K did.\n"
 "  -read_pairscores FILE  Read tab-delimited file of similarity scores.\n"
 "                           (If not provided, scores are constructed\n"
 "                           using pairwise sequence alignment.)\n"
 "  -fuse_all              Fuse identical letters on align rings.\n"
+"  -xdrop N               Local alignment: stop extending cells that score\n"
+"                           more than N below the best score so far.\n"
+"  -zdrop N               Like -xdrop, but allow for the gap extension cost\n"
+"                           of drifting off the best diagonal.\n"
+"  -anchor_kmer K         Align each sequence only between the exact K-mer\n"
+"                           matches it shares with the alignment (long reads).\n"
+"  -region START-END      Align each sequence only to the part of the\n"
+"                           alignment spanning positions START..END (from 1)\n"
+"                           of the first sequence added (targeted reads).\n"
+"  -order STRATEGY        Order in which sequences are added (not with\n"
+"                           -do_progressive or -read_pairscores): input\n"
+"                           (default), length (longest first), centroid\n"
+"                           (most typical k-mer content first) or sketch\n"
+"                           (each next sequence is the one most similar to\n"
+"                           those already added).\n"
+"  -auto_strand           Reverse complement each nucleotide sequence whose\n"
+"                           k-mers match those before it better that way.\n"
+"  -prune_every N         Every N merges, remove letters supported by fewer\n"
+"                           than -prune_min sequences (default 2), sparing\n"
+"                           those of the last N sequences added.\n"
+"  -prune_min W           Support needed to survive -prune_every.\n"
+"  -checkpoint FILE       Periodically save alignment progress to FILE.\n"
+"  -checkpoint_every N    Save a checkpoint after every N merges (default 100).\n"
+"  -resume                Continue from the -checkpoint FILE, if it exists;\n"
+"                           use the same inputs and options as the first run.\n"
 "\nANALYSIS:\n"
 "  -hb                    Perform heaviest bundling to generate consensi.\n"
 "  -hbmin VALUE           Include in heaviest bundle sequences with\n"
@@ -68,10 +137,18 @@ int main(int argc,char *argv[])
 "  -pir FILE              Write out MSA in PIR format.\n"
 "  -clustal FILE          Write out MSA in CLUSTAL format.\n"
 "  -po FILE               Write out MSA in PO format.\n"
+"  -consensus_only FILE   Write only the heaviest-bundle consensus, in FASTA\n"
+"                           format; per-sequence alignment data is dropped\n"
+"                           while aligning, so MSA outputs, -prune_every and\n"
+"                           -anchor_kmer and -region are not available.\n"
+"  -write_tracks FILE     Save the numeric tracks of the alignment's\n"
+"                           sequences to FILE in binary (see -read_tracks).\n"
 "  -preserve_seqorder     Write out MSA with sequences in their input order.\n"
 "  -printmatrix LETTERS   Print score matrix to stdout.\n"
 "  -best                  Restrict MSA output to heaviest bundles (PIR only).\n"
 "  -v                     Run in verbose mode (e.g. output gap penalties).\n"
+"  -stats                 Report graph size, DP cells computed and peak RSS\n"
+"                         to stderr.\n"
 "  -silent                Silent mode (no debug info)\n\n"
 "  NOTE:  One of the -read_fasta, -read_msa, or -read_msa_list arguments\n"
 "         must be used, since a sequence or alignment file is required.\n\n"
@@ -91,19 +168,42 @@ int main(int argc,char *argv[])
     ARGGET("-read_msa",po_filename); /* READ A MSA FILE FOR ALIGNMENT/ANALYSIS*/
     ARGGET("-read_msa2",po2_filename); /* READ A SECOND MSA FILE FOR ALIGNMENT/ANALYSIS*/
     ARGGET("-read_msa_list",po_list_filename); /* READ A LIST OF MSAs FOR ALIGNMENT/ANALYSIS */
+    ARGMATCH("-batch",do_batch); /* FASTA FILE HOLDS MANY SMALL CLUSTERS */
+    ARGGET("-polish",polish.draft_filename); /* DRAFT TO POLISH BY WINDOWS */
+    ARGGET("-polish_map",polish.map_filename); /* PAF/SAM READS ON DRAFT */
+    ARGGET("-polish_window",polish_window); /* DRAFT RESIDUES PER WINDOW */
+    ARGGET("-threads",nthread); /* WINDOWS OR SEQS ALIGNED AT A TIME */
+    ARGGET("-serve",serve.socket_path); /* ANSWER REQUESTS ON A SOCKET */
+    ARGGET("-speculate",speculate_batch); /* SEQS ALIGNED TO ONE SNAPSHOT */
     ARGGET("-pir",fasta_out); /* SAVE FASTA-PIR FORMAT ALIGNMENT FILE */
     ARGGET("-clustal",clustal_out); /* SAVE CLUSTAL FORMAT ALIGNMENT FILE */
     ARGGET("-po",po_out); /* SAVE PO FORMAT ALIGNMENT FILE */
+    ARGGET("-consensus_only",consensus_out); /* JUST THE CONSENSUS, AS FASTA */
     ARGMATCH("-preserve_seqorder",do_preserve_sequence_order);  /* DO PRESERVE SEQUENCE ORDER */
     ARGGET("-hbmin",hbmin); /* SET THRESHOLD FOR BUNDLING */
     ARGMATCH("-fuse_all",use_aggressive_fusion);
     ARGMATCH("-do_global",do_global); /* DO GLOBAL */
+    ARGGET("-xdrop",xdrop); /* X-DROP CUTOFF FOR LOCAL ALIGNMENT */
+    ARGGET("-zdrop",zdrop); /* Z-DROP CUTOFF FOR LOCAL ALIGNMENT */
+    ARGGET("-anchor_kmer",anchor_kmer); /* k-MER ANCHORING OF LONG SEQS */
+    ARGGET("-region",region); /* ALIGN TO ONE STRETCH OF THE FIRST SEQ */
+    ARGGET("-order",order_name); /* ORDER OF ITERATIVE BUILDUP */
+    ARGMATCH("-auto_strand",use_reverse_complement); /* ORIENT READS BY k-MERS */
+    ARGMATCH("-stats",report_stats); /* REPORT GRAPH SIZE, DP CELLS */
     ARGGET("-read_pairscores",pair_score_file); /* FILENAME TO READ PAIR SCORES*/
     ARGMATCH("-do_progressive", do_progressive); /* DO PROGRESSIVE ALIGNMENT */
+    ARGGET("-prune_every",prune_every); /* MERGES BETWEEN GRAPH PRUNINGS */
+    ARGGET("-prune_min",prune_min); /* SUPPORT NEEDED TO SURVIVE PRUNING */
+    ARGGET("-checkpoint",checkpoint.filename); /* SAVE PROGRESS TO THIS FILE */
+    ARGGET("-checkpoint_every",checkpoint_every); /* MERGES BETWEEN SAVES */
+    ARGMATCH("-resume",checkpoint.resume); /* RESTART FROM CHECKPOINT */
     ARGGET("-subset",subset_file); /* FILENAME TO READ SEQ SUBSET LIST*/
     ARGGET("-subset2",subset2_file); /* FILENAME TO READ SEQ SUBSET LIST*/
     ARGGET("-remove",rm_subset_file); /* FILENAME TO READ SEQ REMOVAL LIST*/
     ARGGET("-remove2",rm_subset2_file); /* FILENAME TO READ SEQ REMOVAL LIST*/
+    ARGGET("-read_tracks",track_filename); /* NUMERIC TRACKS OF FASTA SEQS */
+    ARGGET("-track_weights",track_weights); /* TRACK FED INTO LINK WEIGHTS */
+    ARGGET("-write_tracks",tracks_out); /* SAVE TRACKS OF THE ALIGNMENT */
     ARGGET("-read_fasta",seq_filename); /* READ FASTA FILE FOR ALIGNMENT */
     NEXTARG(matrix_filename); /* NON-FLAG ARG SHOULD BE MATRIX FILE */
   }
@@ -141,6 +241,62 @@ int main(int argc,char *argv[])
   if (hbmin)
     bundling_threshold=atof(hbmin);
 
+  if (checkpoint_every)
+    checkpoint.every=atoi(checkpoint_every);
+
+  if (prune_every)
+    prune.every=atoi(prune_every);
+  if (prune_min)
+    prune.min_weight=atoi(prune_min);
+
+  if (consensus_out && (po_out || fasta_out || clustal_out || prune.every>0)) {
+    WARN_MSG(USERR,(ERRTXT, "Error: -consensus_only cannot be combined with -po, -pir, -clustal or -prune_every.\nExiting."),"$Revision: 1.2.2.9 $");
+    exit_code = 1;
+    goto free_memory_and_exit;
+  }
+
+  if (do_batch && (!consensus_out || !seq_filename || po_filename || po_list_filename
+		   || do_progressive || pair_score_file || checkpoint.filename)) {
+    WARN_MSG(USERR,(ERRTXT, "Error: -batch needs -read_fasta and -consensus_only, and cannot be combined with -read_msa, -read_msa_list, -do_progressive, -read_pairscores or -checkpoint.\nExiting."),"$Revision: 1.2.2.9 $");
+    exit_code = 1;
+    goto free_memory_and_exit;
+  }
+
+  if (polish_window)
+    polish.window_length=atoi(polish_window);
+  if (nthread)
+    polish.nthread=speculate.nthread=serve.nthread=atoi(nthread);
+  if (speculate_batch)
+    speculate.nbatch=atoi(speculate_batch);
+
+  if (polish.draft_filename && (!polish.map_filename || !consensus_out || !seq_filename
+				|| do_batch || po_filename || po_list_filename || do_progressive
+				|| pair_score_file || checkpoint.filename || use_reverse_complement
+				|| polish.window_length<=0)) {
+    WARN_MSG(USERR,(ERRTXT, "Error: -polish needs -polish_map, -read_fasta, -consensus_only and a positive -polish_window, and cannot be combined with -batch, -read_msa, -read_msa_list, -do_progressive, -read_pairscores, -checkpoint or -auto_strand.\nExiting."),"$Revision: 1.2.2.9 $");
+    exit_code = 1;
+    goto free_memory_and_exit;
+  }
+
+  if (serve.socket_path && (seq_filename || po_filename || po_list_filename
+			    || do_batch || polish.draft_filename || region)) {
+    WARN_MSG(USERR,(ERRTXT, "Error: -serve takes its sequences from requests, and cannot be combined with -read_fasta, -read_msa, -read_msa_list, -batch, -polish or -region.\nExiting."),"$Revision: 1.2.2.9 $");
+    exit_code = 1;
+    goto free_memory_and_exit;
+  }
+
+  if ((track_filename || track_weights) && (!seq_filename || polish.draft_filename)) {
+    WARN_MSG(USERR,(ERRTXT, "Error: -read_tracks and -track_weights need -read_fasta, and cannot be combined with -polish.\nExiting."),"$Revision: 1.2.2.9 $");
+    exit_code = 1;
+    goto free_memory_and_exit;
+  }
+
+  if (checkpoint.resume && !checkpoint.filename) {
+    WARN_MSG(USERR,(ERRTXT, "Error: The -resume flag requires -checkpoint FILE.\nExiting."),"$Revision: 1.2.2.9 $");
+    exit_code = 1;
+    goto free_memory_and_exit;
+  }
+
   if (!matrix_filename ||
       read_score_matrix(matrix_filename,&score_matrix)<=0){/* READ MATRIX */
     WARN_MSG(USERR,(ERRTXT,"Error reading matrix file %s.\nExiting",
@@ -149,6 +305,52 @@ int main(int argc,char *argv[])
     goto free_memory_and_exit;
   }
 
+  if (xdrop) { /* OVERRIDE ANY X-DROP/Z-DROP SET IN THE MATRIX FILE */
+    score_matrix.drop_score=atoi(xdrop);
+    score_matrix.use_zdrop=0;
+  }
+  if (zdrop) {
+    score_matrix.drop_score=atoi(zdrop);
+    score_matrix.use_zdrop=1;
+  }
+
+  if (anchor_kmer)
+    score_matrix.anchor_kmer_length=atoi(anchor_kmer);
+
+  if (region) {
+    if (2!=sscanf(region,"%d-%d",&score_matrix.region_start,
+		  &score_matrix.region_end)
+	|| score_matrix.region_start<1
+	|| score_matrix.region_end<score_matrix.region_start
+	|| do_progressive || do_batch || polish.draft_filename || consensus_out) {
+      WARN_MSG(USERR,(ERRTXT, "Error: -region needs START-END with 1 <= START <= END, and cannot be combined with -do_progressive, -batch, -polish or -consensus_only.\nExiting."),"$Revision: 1.2.2.9 $");
+      exit_code = 1;
+      goto free_memory_and_exit;
+    }
+    score_matrix.region_start--; /* TO 0-BASED HALF-OPEN POSITIONS */
+  }
+
+  if (order_name) {
+    if (0==strcmp(order_name,"input"))
+      buildup_order=buildup_input_order;
+    else if (0==strcmp(order_name,"length"))
+      buildup_order=buildup_length_order;
+    else if (0==strcmp(order_name,"centroid"))
+      buildup_order=buildup_centroid_order;
+    else if (0==strcmp(order_name,"sketch"))
+      buildup_order=buildup_sketch_order;
+    else {
+      WARN_MSG(USERR,(ERRTXT, "Error: unknown -order %s (use input, length, centroid or sketch).\nExiting.",order_name),"$Revision: 1.2.2.9 $");
+      exit_code = 1;
+      goto free_memory_and_exit;
+    }
+    if (buildup_order!=buildup_input_order && (do_progressive || pair_score_file)) {
+      WARN_MSG(USERR,(ERRTXT, "Error: -order cannot be combined with -do_progressive or -read_pairscores, whose guide tree sets the order.\nExiting."),"$Revision: 1.2.2.9 $");
+      exit_code = 1;
+      goto free_memory_and_exit;
+    }
+  }
+
   if (logfile) {
     fprintf(logfile,"X-Gap Penalties (Open, Aff1, Aff2; LTrunc, LDecay): %d %d %d %d %d\n",
 	    score_matrix.gap_penalty_set[0][0],
@@ -172,12 +374,23 @@ int main(int argc,char *argv[])
       fprintf (logfile, "%d ", score_matrix.gap_penalty_y[i]);
     }
     fprintf(logfile,"... \n");
+    if (score_matrix.drop_score>0)
+      fprintf(logfile,"%s cutoff for local alignment: %d\n",
+	      score_matrix.use_zdrop ? "Z-drop" : "X-drop",
+	      score_matrix.drop_score);
   }
 
   if (print_matrix_letters) /* USER WANTS US TO PRINT A MATRIX */
     print_score_matrix(stdout,&score_matrix,print_matrix_letters
 		       /*"ARNDCQEGHILKMFPSTWYV"*/);
 
+  if (serve.socket_path) { /* ANSWER REQUESTS UNTIL A CLIENT SENDS QUIT */
+    if (!is_silent)
+      fprintf(errfile,"...Serving requests on socket %s...\n",serve.socket_path);
+    if (serve_lpo_requests(&serve,&score_matrix,do_switch_case)<0)
+      exit_code=1; /* SIGNAL ERROR CONDITION */
+    goto free_memory_and_exit;
+  }
 
   /** READ INPUT FILES **/
 
@@ -244,9 +457,17 @@ int main(int argc,char *argv[])
       exit_code=1; /* SIGNAL ERROR CONDITION */
       goto free_memory_and_exit;
     }
-    nseq = read_fasta (seq_ifile, &seq, do_switch_case, &comment);
+    i = getc (seq_ifile); /* FASTQ RECORDS START WITH '@' */
+    ungetc (i, seq_ifile);
+    if (i == '@')
+      nseq = read_fastq (seq_ifile, &seq, do_switch_case);
+    else if (seq_ifile != stdin /* MAP FILE: SEQS ARE LOADED ONLY WHEN ALIGNED */
+	&& (fasta_text = map_fasta_file (seq_filename, &fasta_size)))
+      nseq = read_fasta_view (fasta_text, fasta_size, &seq, do_switch_case, &comment);
+    else
+      nseq = read_fasta (seq_ifile, &seq, do_switch_case, &comment);
     fclose (seq_ifile);
-    if (nseq == 0) {
+    if (nseq <= 0) {
       WARN_MSG(USERR,(ERRTXT,"Error reading sequence file %s.\nExiting",
 		      seq_filename),"$Revision: 1.2.2.9 $");
       exit_code=1; /* SIGNAL ERROR CONDITION */
@@ -254,9 +475,15 @@ int main(int argc,char *argv[])
     }
     if (!is_silent)
         fprintf(errfile,"...Read %d sequences from sequence file %s...\n",nseq,seq_filename);
+    if ((track_filename || track_weights) /* BEFORE lpo_init() USES THEM */
+	&& read_fasta_tracks (track_filename, track_weights, nseq, seq, is_silent ? NULL : errfile) < 0) {
+      exit_code=1; /* SIGNAL ERROR CONDITION */
+      goto free_memory_and_exit;
+    }
     for (i=0; i<nseq; i++) {
       input_seqs[n_input_seqs++] = &(seq[i]);
-      initialize_seqs_as_lpo(1,&(seq[i]),&score_matrix);
+      if (!seq[i].view && !polish.draft_filename) /* VIEWS ARE INITIALIZED LAZILY DURING BUILDUP */
+	initialize_seqs_as_lpo(1,&(seq[i]),&score_matrix);
       if (n_input_seqs == max_input_seqs) {
 	max_input_seqs *= 2;
 	REALLOC (input_seqs, max_input_seqs, LPOSequence_T *);
@@ -265,6 +492,28 @@ int main(int argc,char *argv[])
   }
 
 
+  if (do_batch) { /* EACH CLUSTER IN THE FASTA FILE IS ALIGNED ON ITS OWN */
+    i=align_fasta_batch(nseq,seq,&score_matrix,use_aggressive_fusion,do_global,
+			use_reverse_complement,consensus_out);
+    if (i<0)
+      exit_code=1; /* SIGNAL ERROR CONDITION */
+    else if (!is_silent)
+      fprintf(errfile,"...Wrote consensus of %d clusters to FASTA file %s...\n",i,consensus_out);
+    goto free_memory_and_exit;
+  }
+
+
+  if (polish.draft_filename) { /* READS ARE ONLY ALIGNED WINDOW BY WINDOW */
+    i=polish_lpo_windows(&polish,nseq,seq,&score_matrix,use_aggressive_fusion,
+			 do_global,do_switch_case,consensus_out);
+    if (i<0)
+      exit_code=1; /* SIGNAL ERROR CONDITION */
+    else if (!is_silent)
+      fprintf(errfile,"...Wrote %d polished contigs to FASTA file %s...\n",i,consensus_out);
+    goto free_memory_and_exit;
+  }
+
+
   /** BUILD AND ANALYZE OUTPUT PO-MSA **/
 
   if (n_input_seqs == 0) { /* HMM.. NO DATA. */
@@ -273,9 +522,32 @@ int main(int argc,char *argv[])
     goto free_memory_and_exit;
   }
   else {
+    if (use_reverse_complement) { /* -auto_strand: ORIENT BEFORE ANY DP */
+      i = orient_buildup_seqs (n_input_seqs, input_seqs, &score_matrix);
+      if (!is_silent)
+	fprintf(errfile,"...Reverse complemented %d of %d sequences...\n",i,n_input_seqs);
+    }
     lpo_out = buildup_progressive_lpo (n_input_seqs, input_seqs, &score_matrix,
 				       use_aggressive_fusion, do_progressive, pair_score_file,
-				       matrix_scoring_function, do_global, do_preserve_sequence_order);
+				       USE_BUILTIN_MATRIX_SCORING ? NULL : matrix_scoring_function,
+				       do_global, do_preserve_sequence_order,
+				       consensus_out!=NULL, buildup_order, &prune, &checkpoint,
+				       &speculate);
+    if (lpo_out == NULL) {
+      exit_code=1; /* SIGNAL ERROR CONDITION */
+      goto free_memory_and_exit;
+    }
+  }
+
+  if (report_stats || logfile) { /* SIZE OF THE GRAPH, AND WORK TO BUILD IT */
+    int nedge=0;
+    LPOLetterLink_T *link;
+    LOOP (i,lpo_out->length)
+      for (link= &lpo_out->letter[i].left;link && link->ipos>=0;link=link->more)
+	nedge++;
+    fprintf(report_stats ? errfile : logfile,
+	    "Graph: %d nodes, %d edges; DP cells computed: %.0f\n",
+	    lpo_out->length,nedge,get_lpo_dp_cell_count());
   }
 
   if (comment) { /* SAVE THE COMMENT LINE AS TITLE OF OUR LPO */
@@ -283,8 +555,52 @@ int main(int argc,char *argv[])
     lpo_out->title=strdup(comment);
   }
 
+  if (consensus_out) { /* HEAVIEST PATH BY LINK WEIGHT, WRITTEN AS FASTA */
+    int path_length=0;
+    LPOLetterRef_T *path=NULL;
+    char *consensus=NULL,title[1024];
+
+    if (n_input_seqs==1) /* NEVER MERGED, SO NOT FOLDED YET */
+      fold_lpo_sources(lpo_out,0);
+    path=heaviest_link_path(lpo_out->length,lpo_out->letter,
+			    lpo_out->source_seq,&path_length);
+    CALLOC(consensus,path_length+1,char);
+    LOOPF (i,path_length)
+      consensus[i]=score_matrix.symbol[(int)lpo_out->letter[path[i]].letter];
+    sprintf(title,"consensus produced by heaviest_bundle, from %d seqs",
+	    lpo_out->nsource_seq);
+    seq_ifile = (strcmp(consensus_out, "stdout") == 0) ? stdout: fopen(consensus_out,"w");
+    if (seq_ifile) {
+      write_fasta(seq_ifile,"CONSENS0",title,consensus);
+      fclose(seq_ifile);
+    if (!is_silent)
+      fprintf(errfile,"...Wrote consensus of %d sequences to FASTA file %s...\n",lpo_out->nsource_seq,consensus_out);
+    }
+    else {
+      WARN_MSG(USERR,(ERRTXT,"*** Could not save FASTA file %s.  Exiting.",
+		      consensus_out),"$Revision: 1.2.2.9 $");
+      exit_code=1; /* SIGNAL ERROR CONDITION */
+    }
+    FREE(consensus);
+    FREE(path);
+  }
+
+  if (tracks_out) { /* SAVE NUMERIC TRACKS OF THE FINAL ALIGNMENT */
+    if ((lpo_file_out=fopen(tracks_out, "wb"))
+	&& 0==write_lpo_tracks(lpo_file_out,lpo_out)
+	&& 0==fclose(lpo_file_out)) {
+      if (!is_silent)
+	fprintf(errfile,"...Wrote %d numeric tracks to file %s...\n",lpo_out->ntrack,tracks_out);
+    }
+    else {
+      WARN_MSG(USERR,(ERRTXT,"*** Could not save track file %s.  Exiting.",
+		      tracks_out),"$Revision: 1.2.2.9 $");
+      exit_code=1; /* SIGNAL ERROR CONDITION */
+    }
+  }
+
   /* DIVIDE INTO BUNDLES W/ CONSENSUS USING PERCENT ID */
-  if (do_analyze_bundles)
+  if (do_analyze_bundles && !consensus_out)
     generate_lpo_bundles(lpo_out,bundling_threshold);
 
   if (po_out) { /* WRITE FINAL PARTIAL ORDER ALIGNMENT TO OUTPUT */
@@ -337,6 +653,9 @@ int main(int argc,char *argv[])
 
  free_memory_and_exit: /* FREE ALL DYNAMICALLY ALLOCATED DATA!!!! */
 
+  if (report_stats) /* THIS PROCESS'S OWN PEAK, NOT ITS PARENT'S */
+    fprintf(errfile,"Peak RSS: %ld kB\n",get_peak_rss_kb());
+
   if (dna_lpo)
     free_lpo_sequence(dna_lpo,TRUE);
 
@@ -349,6 +668,7 @@ int main(int argc,char *argv[])
   }
   FREE (input_seqs);
   if (nseq>0) FREE (seq);
+  unmap_fasta_file (fasta_text, fasta_size);
 
   exit (exit_code);
 }
@@ -397,3 +717,138 @@ static LPOSequence_T *read_partial_order_file (char *po_filename, char *subset_f
 
   return lpo_in;
 }
+
+
+
+/** -batch CLUSTERS ARE ALIGNED IN WINDOWS OF THIS MANY, SO THAT ONLY ONE
+    WINDOW OF PARTIAL ORDERS IS HELD IN MEMORY AT A TIME */
+#define BATCH_WINDOW_CLUSTERS 4096
+
+/** LENGTH OF THE CLUSTER ID AT THE START OF A -batch SEQUENCE NAME */
+#define BATCH_CLUSTER_ID_LENGTH(NAME) strcspn ((NAME), "/")
+
+/** aligns each run of sequences in seq[] whose names share a cluster id
+    (see BATCH_CLUSTER_ID_LENGTH) as an independent cluster, with
+    buildup_lpo_batch(), and writes the heaviest-path consensus of every
+    cluster, named by its cluster id, to the FASTA file consensus_out.
+    Returns the number of clusters, or -1 if the file can't be written. */
+static int align_fasta_batch (int nseq, LPOSequence_T seq[], ResidueScoreMatrix_T *m, int use_aggressive_fusion, int use_global_alignment, int auto_strand, char consensus_out[])
+{
+  int i, j, c, nwindow, ncluster = 0, path_length, id_length;
+  int *cluster_nseq = NULL;
+  LPOSequence_T **cluster_seqs = NULL, *lpo, **members = NULL;
+  LPOLetterRef_T *path = NULL;
+  char *consensus = NULL, title[1024], name[SEQUENCE_NAME_MAX];
+  FILE *ofile;
+
+  ofile = (strcmp (consensus_out, "stdout") == 0) ? stdout : fopen (consensus_out, "w");
+  if (!ofile) {
+    WARN_MSG (USERR, (ERRTXT,"*** Could not save FASTA file %s.  Exiting.",consensus_out), "$Revision: 1.2.2.9 $");
+    return -1;
+  }
+
+  CALLOC (cluster_nseq, BATCH_WINDOW_CLUSTERS, int);
+  CALLOC (cluster_seqs, BATCH_WINDOW_CLUSTERS, LPOSequence_T *);
+  for (i=0; i<nseq; ) {
+
+    /* NEXT WINDOW OF CLUSTERS: RUNS OF RECORDS WITH THE SAME CLUSTER ID */
+    for (nwindow=0; nwindow<BATCH_WINDOW_CLUSTERS && i<nseq; nwindow++) {
+      id_length = BATCH_CLUSTER_ID_LENGTH (seq[i].name);
+      for (j=i+1; j<nseq && BATCH_CLUSTER_ID_LENGTH (seq[j].name) == id_length
+	     && strncmp (seq[i].name, seq[j].name, id_length) == 0; j++);
+      cluster_seqs[nwindow] = &seq[i];
+      cluster_nseq[nwindow] = j-i;
+      if (auto_strand && j-i > 1) { /* ORIENT THE CLUSTER'S READS */
+	REALLOC (members, j-i, LPOSequence_T *);
+	for (c=0; c<j-i; c++) {
+	  members[c] = &seq[i+c];
+	}
+	orient_buildup_seqs (j-i, members, m);
+      }
+      i = j;
+    }
+
+    buildup_lpo_batch (nwindow, cluster_nseq, cluster_seqs, m,
+		       use_aggressive_fusion, use_global_alignment, TRUE);
+
+    for (c=0; c<nwindow; c++) {
+      lpo = cluster_seqs[c];
+      if (cluster_nseq[c] == 1) { /* NEVER MERGED, SO NOT FOLDED YET */
+	fold_lpo_sources (lpo, 0);
+      }
+      path = heaviest_link_path (lpo->length, lpo->letter, lpo->source_seq, &path_length);
+      CALLOC (consensus, path_length+1, char);
+      for (j=0; j<path_length; j++) {
+	consensus[j] = m->symbol[(int) lpo->letter[path[j]].letter];
+      }
+      id_length = BATCH_CLUSTER_ID_LENGTH (lpo->name);
+      strncpy (name, lpo->name, id_length);
+      name[id_length] = '\0';
+      sprintf (title, "consensus produced by heaviest_bundle, from %d seqs", cluster_nseq[c]);
+      write_fasta (ofile, name, title, consensus);
+      FREE (consensus);
+      FREE (path);
+      for (j=0; j<cluster_nseq[c]; j++) { /* DONE WITH THIS CLUSTER */
+	free_lpo_sequence (&cluster_seqs[c][j], FALSE);
+      }
+      ncluster++;
+    }
+  }
+
+  FREE (cluster_nseq);
+  FREE (cluster_seqs);
+  FREE (members);
+  if (ofile != stdout) {
+    fclose (ofile);
+  }
+  return ncluster;
+}
+
+
+
+/** loads the numeric tracks of track_filename (written by -write_tracks,
+    or NUMERIC_DATA text records, read as float tracks) onto the FASTA
+    sequences seq[], and marks the track named by track_weights
+    ("NAME" or "NAME:SCALE") to be added to their link weights when
+    lpo_init() builds them.  Returns the number of tracks read, or -1. */
+static int read_fasta_tracks (char *track_filename, char *track_weights, int nseq, LPOSequence_T seq[], FILE *errfile)
+{
+  int c, k, itrack, ntrack = 0, nweighted = 0;
+  char name[SEQUENCE_NAME_MAX];
+  float scale = 1.;
+  FILE *ifile;
+
+  if (track_filename) {
+    if (!(ifile = fopen (track_filename, "rb"))) {
+      WARN_MSG (USERR, (ERRTXT,"Couldn't open track file %s.\nExiting.",track_filename), "$Revision: 1.2.2.9 $");
+      return -1;
+    }
+    c = getc (ifile); /* TEXT RECORDS START WITH '>' */
+    ungetc (c, ifile);
+    ntrack = (c == '>') ? read_lpo_tracks_text (ifile, nseq, seq, lpo_track_float)
+      : read_lpo_tracks (ifile, nseq, seq);
+    fclose (ifile);
+    if (ntrack < 0) {
+      WARN_MSG (USERR, (ERRTXT,"Track file %s is truncated or not a track file.\nExiting.",track_filename), "$Revision: 1.2.2.9 $");
+      return -1;
+    }
+    if (errfile)
+      fprintf (errfile, "...Read numeric tracks from file %s...\n", track_filename);
+  }
+
+  if (track_weights) {
+    if (sscanf (track_weights, "%127[^:]:%f", name, &scale) < 1) {
+      WARN_MSG (USERR, (ERRTXT,"Error: -track_weights needs NAME or NAME:SCALE.\nExiting."), "$Revision: 1.2.2.9 $");
+      return -1;
+    }
+    for (k=0; k<nseq; k++) {
+      if ((itrack = find_lpo_track (&seq[k], name)) >= 0) {
+	seq[k].track[itrack].link_weight_scale = scale;
+	nweighted++;
+      }
+    }
+    if (errfile)
+      fprintf (errfile, "...Track %s weights the links of %d of %d sequences...\n", name, nweighted, nseq);
+  }
+  return ntrack;
+}
@@ -27,17 +27,15 @@ static int is_gap_char (char ch);
 static int is_name_first_char (char ch);
 
 
-/** decide which sequences in an RC-MSA alignment to keep based on a filter file `select_ifile'.
-    remove discarded sequences and reindex the remaining ones.
-    returns the NEW number of sequences. */
-static int filter_sequence_set (int n_seqs, FILE *select_ifile, int remove_listed_sequences,
-				char **seq_names, char **seq_titles, char **aln_mat, int *aln_lengths);
+/** reads the names listed (as SOURCENAME=name lines) in `select_ifile'
+    into a sorted array, for keep_sequence().  returns the number of names. */
+static int read_select_names (FILE *select_ifile, char ***p_names);
 
+/** should sequence `name' be kept, given the names read from `select_ifile'? */
+static int keep_sequence (char name[], int n_select, char **select_names,
+			  FILE *select_ifile, int remove_listed_sequences);
 
-/** remove sequence bad_seq_id from each letter containing it.
-    ASSUMES THAT NO LETTER CONTAINS _ONLY_ bad_seq_id... e.g. bad_seq_id IS A CONSENSUS.
-    either keep or don't keep links present only in the removed sequence. */ 
-static void strip_seq_from_lpo (LPOSequence_T *lposeq, int bad_seq_id, int keep_all_links);
+static void free_select_names (int n_select, char **select_names);
 
 
 static LPOSequence_T *read_clustal (FILE *ifile, const char *first_line,
@@ -118,17 +116,22 @@ LPOSequence_T *read_msa (FILE *ifile, msa_file_format format,
 
 
 /** Reads a CLUSTAL-formatted alignment file.
+    Each block is added to the LPO as it is read, so only the sequence
+    names (to check the repeated blocks) are kept in memory.
  */
 LPOSequence_T *read_clustal (FILE *fp, const char *first_line,
 			     FILE *select_ifile, int remove_listed_sequences,
 			     int do_switch_case, ResidueScoreMatrix_T *score_matrix)
 {
-  int i, j, n_seqs=0, curr_seq=0, expect_repeats=0, expect_header=1, line_num=0;
-  char ch;  
-  char **seq_names=NULL, **seq_titles=NULL, **aln_mat=NULL;
-  int *aln_lengths=NULL;
+  int i, n_seqs=0, curr_seq=0, expect_repeats=0, expect_header=1, line_num=0;
+  int n_select=0, *seq_rows=NULL, is_bad_file=1;
+  char **seq_names=NULL, **select_names=NULL;
   char line[512]="", name[512]="", aln[512]="";
+  LPOMsaBuilder_T builder;
   LPOSequence_T *lposeq = NULL;
+
+  n_select = read_select_names (select_ifile, &select_names);
+  init_msa_builder (&builder, do_switch_case, score_matrix);
   
   while ((first_line!=NULL && line_num==0) || fgets (line, sizeof(line)-1, fp)) {
     if (first_line!=NULL && line_num==0) {
@@ -168,67 +171,55 @@ LPOSequence_T *read_clustal (FILE *fp, const char *first_line,
       
       REALLOC (seq_names, n_seqs, char *);
       seq_names[n_seqs-1] = strdup(name);
-      REALLOC (seq_titles, n_seqs, char *);
-      seq_titles[n_seqs-1] = strdup("");
-      
-      REALLOC (aln_mat, n_seqs, char *);
-      aln_mat[n_seqs-1] = strdup(" ");
-      REALLOC (aln_lengths, n_seqs, int);
-      aln_lengths[n_seqs-1] = 0;
+      REALLOC (seq_rows, n_seqs, int);
+      seq_rows[n_seqs-1] = (keep_sequence (name, n_select, select_names, select_ifile, remove_listed_sequences)
+			    ? add_msa_builder_row (&builder, name, "") : -1);
     }
     else if (curr_seq>=n_seqs || strcmp(name,seq_names[curr_seq])) {  /* NAME SHOULD BE A REPEAT */
-      WARN_MSG(USERR,(ERRTXT, "Error: Trouble reading CLUSTAL-formatted file at line %d: \n>>>\n%s<<<\nSequence name (%s) does not match expected sequence name (%s).  Bailing out.\n",line_num,line,name,seq_names[curr_seq]),
+      WARN_MSG(USERR,(ERRTXT, "Error: Trouble reading CLUSTAL-formatted file at line %d: \n>>>\n%s<<<\nSequence name (%s) does not match expected sequence name (%s).  Bailing out.\n",line_num,line,name,curr_seq<n_seqs ? seq_names[curr_seq] : ""),
 	       "$Revision: 1.1.2.3 $");
       goto free_memory_and_exit;
     }
     
-    REALLOC (aln_mat[curr_seq], aln_lengths[curr_seq] + strlen(aln), char);
-    for (i=0; i<strlen(aln); i++) {
-      ch = aln[i];
-      if (is_residue_char(ch) || is_gap_char(ch)) {
-	aln_mat[curr_seq][aln_lengths[curr_seq]++] = aln[i];
-      }
+    if (seq_rows[curr_seq] >= 0) {  /* ADD THIS BLOCK OF THE ROW TO THE LPO */
+      add_msa_builder_text (&builder, seq_rows[curr_seq], aln);
     }
     curr_seq++;
   }
+  is_bad_file = 0;
 
-  n_seqs = filter_sequence_set (n_seqs, select_ifile, remove_listed_sequences, seq_names, seq_titles, aln_mat, aln_lengths);
-  
-  lposeq = lpo_from_aln_mat (n_seqs, seq_names, seq_titles, aln_mat, aln_lengths, do_switch_case, score_matrix);
-  
  free_memory_and_exit:
+  lposeq = finish_msa_builder (&builder);
+  if (is_bad_file) {
+    free_lpo_sequence (lposeq, 1);
+    lposeq = NULL;
+  }
   for (i=0; i<n_seqs; i++) {
     FREE (seq_names[i]);
-    FREE (seq_titles[i]);
-    FREE (aln_mat[i]);
   }
   FREE (seq_names);
-  FREE (seq_titles);
-  FREE (aln_mat);
-  FREE (aln_lengths);
-  
-  if (n_seqs>0) {
-    strcpy (lposeq->name, lposeq->source_seq[0].name);
-    FREE (lposeq->title);
-    lposeq->title = strdup (lposeq->source_seq[0].title);
-  }
+  FREE (seq_rows);
+  free_select_names (n_select, select_names);
   
   return lposeq;
 }
 
 /** Reads a FASTA-PIR-formatted alignment file.
+    Each row is added to the LPO as it is read.
  */
 LPOSequence_T *read_pir (FILE *fp, const char *first_line,
 			 FILE *select_ifile, int remove_listed_sequences,
 			 int do_switch_case, ResidueScoreMatrix_T *score_matrix)
 {
-  int i, j, n_seqs=0, curr_seq=0, line_num=0;
-  char ch;  
-  char **seq_names=NULL, **seq_titles=NULL, **aln_mat=NULL;
-  int *aln_lengths=NULL, *keep_seq=NULL;
+  int n_seqs=0, curr_row=-1, line_num=0, n_select=0, is_bad_file=1;
+  char **select_names=NULL;
   char line[512]="", name[512]="", title[512]="", aln[512]="";
+  LPOMsaBuilder_T builder;
   LPOSequence_T *lposeq = NULL;
   
+  n_select = read_select_names (select_ifile, &select_names);
+  init_msa_builder (&builder, do_switch_case, score_matrix);
+
   while ((first_line!=NULL && line_num==0) || fgets (line, sizeof(line)-1, fp)) {
     if (first_line!=NULL && line_num==0) {
       strcpy (line, first_line);
@@ -244,20 +235,14 @@ LPOSequence_T *read_pir (FILE *fp, const char *first_line,
       }
       
       n_seqs++;
-      curr_seq=n_seqs-1;
-      REALLOC (seq_names, n_seqs, char *);
-      seq_names[n_seqs-1] = strdup(name);
-      REALLOC (seq_titles, n_seqs, char *);
-      seq_titles[n_seqs-1] = strdup(title);
-      REALLOC (aln_mat, n_seqs, char *);
-      aln_mat[n_seqs-1] = strdup(" ");
-      REALLOC (aln_lengths, n_seqs, int);
-      aln_lengths[n_seqs-1] = 0;
+      curr_row = (keep_sequence (name, n_select, select_names, select_ifile, remove_listed_sequences)
+		  ? add_msa_builder_row (&builder, name, title) : -1);
     }
     else if (line[0]=='#' || line[0]=='*') {  /* COMMENT LINE */
       continue;
     }
     else {  /* ALIGNMENT ROW FOR CURRENT SEQUENCE */
+      aln[0] = '\0';
       sscanf (line, "%[^\n\r]", aln);
       if (n_seqs==0) {
 	WARN_MSG(USERR,(ERRTXT, "Error: Trouble reading PIR-formatted file near line %d (no preceding '>seqname' line?):\n>>>\n%s<<<\nBailing out.\n",line_num,line),
@@ -265,37 +250,20 @@ LPOSequence_T *read_pir (FILE *fp, const char *first_line,
 	goto free_memory_and_exit;
       }
       
-      REALLOC (aln_mat[curr_seq], aln_lengths[curr_seq] + strlen(aln), char);
-      for (i=0; i<strlen(aln); i++) {
-	ch = aln[i];
-	if (is_residue_char(ch) || is_gap_char(ch)) {
-	  aln_mat[curr_seq][aln_lengths[curr_seq]++] = aln[i];
-	}
+      if (curr_row >= 0) {
+	add_msa_builder_text (&builder, curr_row, aln);
       }
     }
   }
+  is_bad_file = 0;
 
-  n_seqs = filter_sequence_set (n_seqs, select_ifile, remove_listed_sequences, seq_names, seq_titles, aln_mat, aln_lengths);  
-
-  lposeq = lpo_from_aln_mat (n_seqs, seq_names, seq_titles, aln_mat, aln_lengths, do_switch_case, score_matrix);
-  
  free_memory_and_exit:
-  for (i=0; i<n_seqs; i++) {
-    FREE (seq_names[i]);
-    FREE (seq_titles[i]);
-    FREE (aln_mat[i]);
+  lposeq = finish_msa_builder (&builder);
+  if (is_bad_file) {
+    free_lpo_sequence (lposeq, 1);
+    lposeq = NULL;
   }
-  FREE (seq_names);
-  FREE (seq_titles);
-  FREE (aln_mat);
-  FREE (aln_lengths);
-  
-  if (n_seqs>0) {
-    strcpy (lposeq->name, lposeq->source_seq[0].name);
-    FREE (lposeq->title);
-    lposeq->title = strdup (lposeq->source_seq[0].title);
-  }
-  
+  free_select_names (n_select, select_names);
   return lposeq;
 }
 
@@ -303,156 +271,211 @@ LPOSequence_T *read_pir (FILE *fp, const char *first_line,
  */
 LPOSequence_T *lpo_from_aln_mat (int n_seqs, char **seq_names, char **seq_titles, char **aln_mat, int *aln_lengths, int do_switch_case, ResidueScoreMatrix_T *score_matrix)
 {
-  int i, j, k, len, col, res_id, letter_id;
-  char ch;
-  LPOSequence_T *curr_seq, *lposeq;
-  int **column_ids; /** which column contains each residue */
-  int **res_ids; /** which residue is in each column */
-  int *al_x, *al_y;
-  int max_aln_length = 0;
-  char *consens_row;
-
-  if (n_seqs==0)
-    return NULL;
-  
-  CALLOC (column_ids, n_seqs+1, int *);
-  CALLOC (res_ids, n_seqs+1, int *);
+  int i, irow;
+  char *row;
+  LPOMsaBuilder_T builder;
+
+  init_msa_builder (&builder, do_switch_case, score_matrix);
   for (i=0; i<n_seqs; i++) {
-    if (aln_lengths[i] > max_aln_length) {
-      max_aln_length = aln_lengths[i];
-    }
+    irow = add_msa_builder_row (&builder, seq_names[i], seq_titles[i]);
+    CALLOC (row, aln_lengths[i]+1, char);  /* aln_mat ROWS NEED NOT BE TERMINATED */
+    memcpy (row, aln_mat[i], aln_lengths[i]);
+    add_msa_builder_text (&builder, irow, row);
+    FREE (row);
   }
-  for (i=0; i<n_seqs+1; i++) {
-    CALLOC (column_ids[i], max_aln_length, int);
-    CALLOC (res_ids[i], max_aln_length, int);
+  return finish_msa_builder (&builder);
+}
+
+
+
+void init_msa_builder (LPOMsaBuilder_T *builder, int do_switch_case, ResidueScoreMatrix_T *score_matrix)
+{
+  memset (builder, 0, sizeof(LPOMsaBuilder_T));
+  builder->do_switch_case = do_switch_case;
+  CALLOC (builder->lposeq, 1, LPOSequence_T);
+
+  /* SAME TRANSLATION AS limit_residues() FOLLOWED BY index_symbols() */
+  build_matrix_symbol_index (score_matrix, builder->symbol_index);
+}
+
+
+int add_msa_builder_row (LPOMsaBuilder_T *builder, char name[], char title[])
+{
+  int irow;
+
+  irow = save_lpo_source (builder->lposeq, name, title, 0, 1, NO_BUNDLE, 0, NULL);
+  if (irow == builder->max_row) {
+    builder->max_row = (builder->max_row ? 2*builder->max_row : 16);
+    REALLOC (builder->row_col, builder->max_row, int);
+    REALLOC (builder->row_length, builder->max_row, int);
   }
+  builder->row_col[irow] = 0;
+  builder->row_length[irow] = 0;
+  return irow;
+}
 
-  /* GET CONSENSUS ROW THAT ALIGNS TO SOME OTHER ROW IN EACH COLUMN */
-  /* CONSENSUS ROW IS _NECESSARY_ TO DEAL WITH THE POSSIBILITY THAT, e.g., UNORDERED RESIDUES
-     IN seqs 0 & 1 ARE ORDERED BY ALIGNMENT WITH seq 2. */
+
+/** returns the letter for residue code `letter' in column `col',
+    creating it if this column has no such letter yet */
+static LPOLetterRef_T msa_builder_letter (LPOMsaBuilder_T *builder, int col, char letter)
+{
+  int i;
+  LPOSequence_T *lposeq = builder->lposeq;
+  LPOLetterRef_T ipos, last = INVALID_LETTER_POSITION;
+
+  if (col >= builder->max_col) {  /* NEW COLUMNS START EMPTY */
+    i = builder->max_col;
+    builder->max_col = (col+1 > 2*builder->max_col ? col+1 : 2*builder->max_col);
+    REALLOC (builder->col_first, builder->max_col, LPOLetterRef_T);
+    for (; i<builder->max_col; i++) {
+      builder->col_first[i] = INVALID_LETTER_POSITION;
+    }
+  }
+  if (col >= builder->ncol) {
+    builder->ncol = col+1;
+  }
   
-  CALLOC (consens_row, max_aln_length, char);
-  for (col=0; col<max_aln_length; col++) {
-    consens_row[col] = '-';
-    for (i=0; i<n_seqs; i++) {
-      if (col < aln_lengths[i] && is_residue_char(aln_mat[i][col])) {
-	consens_row[col] = aln_mat[i][col];
-	break;
-      }
+  for (ipos=builder->col_first[col]; ipos>=0; ipos=lposeq->letter[ipos].align_ring) {
+    if (lposeq->letter[ipos].letter == letter) {  /* IDENTICAL RESIDUES SHARE ONE LETTER */
+      return ipos;
     }
+    last = ipos;
   }
 
-  /* MAKE SEQUENCE FROM CONSENSUS ROW */
+  if (lposeq->length == builder->max_letter) {
+    builder->max_letter = (builder->max_letter ? 2*builder->max_letter : LPO_LETTER_BUFFER_CHUNK);
+    REALLOC (lposeq->letter, builder->max_letter, LPOLetter_T);
+    REALLOC (builder->source_tail, builder->max_letter, LPOLetterSource_T *);
+  }
+  ipos = lposeq->length++;
+  builder->source_tail[ipos] = NULL;
+  memset (lposeq->letter+ipos, 0, sizeof(LPOLetter_T));
+  lposeq->letter[ipos].left.ipos = lposeq->letter[ipos].right.ipos = INVALID_LETTER_POSITION;
+  lposeq->letter[ipos].source.iseq = lposeq->letter[ipos].source.ipos = INVALID_LETTER_POSITION;
+  lposeq->letter[ipos].align_ring = INVALID_LETTER_POSITION;  /* END OF THIS COLUMN'S CHAIN */
+  lposeq->letter[ipos].letter = letter;
+  if (last >= 0) {
+    lposeq->letter[last].align_ring = ipos;
+  }
+  else {
+    builder->col_first[col] = ipos;
+  }
+  return ipos;
+}
 
-  CALLOC (lposeq, 1, LPOSequence_T);
-  strcpy (lposeq->name, "consens_row");
-  lposeq->title = strdup ("");
-  
-  CALLOC (lposeq->sequence, max_aln_length+1, char);
-  for (len=col=0; col<max_aln_length; col++) {
-    ch = consens_row[col];
-    if (do_switch_case == switch_case_to_lower) {
+
+void add_msa_builder_text (LPOMsaBuilder_T *builder, int irow, const char aln[])
+{
+  int i;
+  char ch;
+  LPOLetterRef_T ipos;
+  LPOLetterSource_T *source, save_source;
+
+  for (i=0; aln[i]; i++) {
+    ch = aln[i];
+    if (is_gap_char(ch)) {
+      builder->row_col[irow]++;
+      continue;
+    }
+    if (!is_residue_char(ch)) {  /* e.g. TRAILING RESIDUE COUNT */
+      continue;
+    }
+    if (builder->do_switch_case == switch_case_to_lower) {
       ch = tolower(ch);
     }
-    else if (do_switch_case == switch_case_to_upper) {
+    else if (builder->do_switch_case == switch_case_to_upper) {
       ch = toupper(ch);
     }
-    if (is_residue_char(ch)) {
-      lposeq->sequence[len] = ch;
-      column_ids[0][len] = col;
-      res_ids[0][col] = len;
-      len++;
+    ipos = msa_builder_letter (builder, builder->row_col[irow]++,
+			       builder->symbol_index[(unsigned char)ch]);
+    
+    /* ROWS ARRIVE IN ORDER FOR EACH COLUMN, SO THIS KEEPS SOURCES SORTED BY ROW */
+    save_source.iseq = irow;
+    save_source.ipos = builder->row_length[irow]++;
+    save_source.more = NULL;
+    source = &(builder->lposeq->letter[ipos].source);
+    if (source->ipos >= 0) {
+      if (builder->source_tail[ipos]) {
+	source = builder->source_tail[ipos];
+      }
+      CALLOC (source->more, 1, LPOLetterSource_T);
+      source = builder->source_tail[ipos] = source->more;
     }
+    *source = save_source;
   }
-  lposeq->length = len;
-  lposeq->sequence[col] = '\0';
-  REALLOC (lposeq->sequence, len+1, char);
-    
-  initialize_seqs_as_lpo (1, lposeq, score_matrix);
-  
-  for (i=0; i<n_seqs; i++) {
+}
 
-    CALLOC (curr_seq, 1, LPOSequence_T);
-    strcpy (curr_seq->name, seq_names[i]);
-    curr_seq->title = strdup (seq_titles[i]);
 
-    /* READ CHARACTERS FROM ALIGNMENT ROW INTO SEQUENCE: */
-    CALLOC (curr_seq->sequence, aln_lengths[i]+1, char);
-    for (len=col=0; col<aln_lengths[i]; col++) {
-      ch = aln_mat[i][col];
-      if (do_switch_case == switch_case_to_lower) {
-	ch = tolower(ch);
-      }
-      else if (do_switch_case == switch_case_to_upper) {
-	ch = toupper(ch);
+LPOSequence_T *finish_msa_builder (LPOMsaBuilder_T *builder)
+{
+  int i, j, col, *row_start=NULL, *row_letter=NULL;
+  LPOLetterRef_T ipos;
+  LPOLetterSource_T *source;
+  LPOLetter_T *letter=NULL;
+  LPOSequence_T *lposeq = builder->lposeq;
+
+  if (lposeq->nsource_seq == 0) {  /* NOTHING KEPT */
+    free_lpo_sequence (lposeq, 1);
+    lposeq = NULL;
+    goto free_memory_and_exit;
+  }
+
+  /* PUT LETTERS IN COLUMN ORDER; EVERY LINK POINTS TO A LATER COLUMN, SO
+     THIS IS A TOPOLOGICAL ORDER, AND EACH COLUMN IS ONE CONTIGUOUS RING */
+  if (lposeq->length > 0) {
+    CALLOC (letter, lposeq->length, LPOLetter_T);
+    for (i=col=0; col<builder->ncol; col++) {
+      j = i;  /* START OF THIS COLUMN'S RING */
+      for (ipos=builder->col_first[col]; ipos>=0; ipos=lposeq->letter[ipos].align_ring) {
+	letter[i] = lposeq->letter[ipos];
+	letter[i].ring_id = j;
+	i++;
       }
-      if (is_residue_char(ch)) {
-	curr_seq->sequence[len] = ch;
-	column_ids[i+1][len] = col;
-	res_ids[i+1][col] = len;
-	len++;
+      for (; j<i; j++) {
+	letter[j].align_ring = (j+1<i ? j+1 : letter[j].ring_id);
       }
     }
-    curr_seq->length = len;
-    curr_seq->sequence[len] = '\0';
-    REALLOC (curr_seq->sequence, len+1, char);
-    
-    initialize_seqs_as_lpo (1, curr_seq, score_matrix);
-    
-    /* ALIGN THIS SEQUENCE TO EXISTING ALIGNMENT USING CONSENSUS ROW */
+    FREE (lposeq->letter);
+    lposeq->letter = letter;
+  }
 
-    build_seq_to_po_index (lposeq);
-    
-    CALLOC (al_x, len, int);
-    CALLOC (al_y, lposeq->length, int);
-    
-    for (j=0; j<lposeq->length; j++) {
-      al_y[j] = INVALID_LETTER_POSITION;
-    }
-    
-    /* FOR EACH RESIDUE IN THIS SEQUENCE: */
-    for (j=0; j<len; j++) {
-      col = column_ids[i+1][j];
-      
-      /* GET AN OLD NODE IN CONSENSUS ROW ALIGNED TO THIS ONE: */
-      res_id = res_ids[0][col];
-      
-      /* STORE INFO IN al_x,al_y: */
-      letter_id = lposeq->source_seq[0].seq_to_po[res_id];
-      al_x[j] = letter_id;
-      al_y[letter_id] = j;
+  /* LINK EACH ROW'S CONSECUTIVE RESIDUES, ROW BY ROW */
+  CALLOC (row_start, lposeq->nsource_seq+1, int);
+  for (i=0; i<lposeq->nsource_seq; i++) {
+    lposeq->source_seq[i].length = builder->row_length[i];
+    row_start[i+1] = row_start[i] + builder->row_length[i];
+  }
+  if (row_start[lposeq->nsource_seq] > 0) {
+    CALLOC (row_letter, row_start[lposeq->nsource_seq], int);
+  }
+  for (i=0; i<lposeq->length; i++) {
+    for (source = &(lposeq->letter[i].source); source && source->iseq>=0; source=source->more) {
+      row_letter[row_start[source->iseq] + source->ipos] = i;
     }
-        
-    /* DO THE FUSION-BASED BUILDUP */
-    
-    fuse_ring_identities (lposeq->length, lposeq->letter,
-			  curr_seq->length, curr_seq->letter,
-			  al_y, al_x);
-    
-    fuse_lpo (lposeq, curr_seq, al_y, al_x);
-    
-    free_lpo_sequence (curr_seq, 0);
-    FREE (al_x);
-    FREE (al_y);
-    FREE (curr_seq);
   }
-  
-  /* STRIP OUT CONSENSUS SEQUENCE */
-  
-  strip_seq_from_lpo (lposeq, /*remove #*/ 0, /*0=don't keep all links*/ 0);
-  
-  for (i=0; i<n_seqs+1; i++) {
-    FREE (column_ids[i]);
-    FREE (res_ids[i]);
+  for (i=0; i<lposeq->nsource_seq; i++) {
+    for (j=row_start[i]; j+1<row_start[i+1]; j++) {
+      add_lpo_link (&(lposeq->letter[row_letter[j]].right), row_letter[j+1]);
+      add_lpo_link (&(lposeq->letter[row_letter[j+1]].left), row_letter[j]);
+    }
   }
-  FREE (column_ids);
-  FREE (res_ids);
-  FREE (consens_row);
-  
+
+  strcpy (lposeq->name, lposeq->source_seq[0].name);
+  lposeq->title = strdup (lposeq->source_seq[0].title);
+
+ free_memory_and_exit:
+  FREE (row_start);
+  FREE (row_letter);
+  FREE (builder->row_col);
+  FREE (builder->row_length);
+  FREE (builder->col_first);
+  FREE (builder->source_tail);
+  builder->lposeq = NULL;
   return lposeq;
 }
 
 
+
 static int is_residue_char (char ch)
 {
   if (ch>='a' && ch<='z') return 1;
@@ -473,147 +496,49 @@ static int is_name_first_char (char ch)
   return 1;
 }
 
-static int filter_sequence_set (int n_seqs, FILE *select_ifile, int remove_listed_sequences,
-				char **seq_names, char **seq_titles, char **aln_mat, int *aln_lengths)
+
+static int select_name_qsort_cmp (const void *void_a, const void *void_b)
+{
+  return strcmp (*(char * const *)void_a, *(char * const *)void_b);
+}
+
+static int read_select_names (FILE *select_ifile, char ***p_names)
 {
-  int i, j;
-  int *keep_seq;
+  int n_select=0, max_select=0;
   char name[512]="";
-  
-  /* DECIDE WHICH SEQUENCES TO KEEP: */
-  
-  CALLOC (keep_seq, n_seqs, int);
-  
-  for (i=0; i<n_seqs; i++) {
-    keep_seq[i] = ((!select_ifile || remove_listed_sequences) ? 1 : 0);
-  }
-  
+
+  *p_names = NULL;
   while (select_ifile && fscanf (select_ifile, "SOURCENAME=%[^\r\n]%*[\r\n]", name) >= 1) {
-    for (i=0; i<n_seqs; i++) {
-      if (0 == strcmp(seq_names[i],name)) {
-	keep_seq[i] = (remove_listed_sequences ? 0 : 1);
-      }
+    if (n_select == max_select) {
+      max_select = (max_select ? 2*max_select : 64);
+      REALLOC (*p_names, max_select, char *);
     }
+    (*p_names)[n_select++] = strdup (name);
   }
-  
-  /* FREE MEM FOR DISCARDED SEQUENCES: */
-  for (i=0; i<n_seqs; i++) if (keep_seq[i]==0) {
-    FREE (seq_names[i]);
-    FREE (seq_titles[i]);
-    FREE (aln_mat[i]);
-  }
-
-  /* COMPACT SEQUENCE LIST (MOVE i<--j): */
-  for (i=j=0; j<n_seqs; i++, j++) {
-    while (j<n_seqs && keep_seq[j]==0)
-      j++;
-    if (j==n_seqs)
-      break;
-    if (j<n_seqs && i!=j) {
-      seq_names[i] = seq_names[j];
-      seq_titles[i] = seq_titles[j];
-      aln_mat[i] = aln_mat[j];
-      aln_lengths[i] = aln_lengths[j];
-    }
+  if (n_select > 0) {
+    qsort (*p_names, n_select, sizeof(char *), select_name_qsort_cmp);
   }
-  
-  FREE (keep_seq);
-  
-  return i;
+  return n_select;
 }
 
-
-
-void strip_seq_from_lpo (LPOSequence_T *lposeq, int bad_seq_id, int keep_all_links)
+static int keep_sequence (char name[], int n_select, char **select_names,
+			  FILE *select_ifile, int remove_listed_sequences)
 {
-  int i, j, id_left, id_right, len, n_seqs;
-  LPOLetterLink_T *lnk, *tmp_lnk;
-  LPOLetterSource_T *src, *prev, *tmp_src;
-  LPOLetter_T *lett;
-  
-  n_seqs = lposeq->nsource_seq - 1;
-  
-  /* FREE MEM ASSOCIATED WITH BAD SEQ */
-  FREE (lposeq->source_seq[bad_seq_id].title);
-  FREE (lposeq->source_seq[bad_seq_id].sequence);
-  FREE (lposeq->source_seq[bad_seq_id].seq_to_po);
-  FREE (lposeq->source_seq[bad_seq_id].po_to_seq);
-
-  /* COMPACT SOURCE LIST */
-  for (i=0; i<n_seqs; i++) if (i>=bad_seq_id) {
-    lposeq->source_seq[i] = lposeq->source_seq[i+1];
-  }
-  /* This de-allocation causes a bug in conjunction with
-     later REBUFF calls: */
-  /* REALLOC (lposeq->source_seq, n_seqs, LPOSourceInfo_T); */
-  lposeq->nsource_seq = n_seqs;
-  
-  
-  /* RENUMBER SOURCES IN EACH LETTER */
-  for (i=0; i<lposeq->length; i++) {
-    lett = &(lposeq->letter[i]);
-    prev = NULL;
-    src = &(lett->source);
-    while (src != NULL && src->iseq >= 0) {
-      if (src->iseq == bad_seq_id) {
-	if (prev) {  /* NOT IN LIST HEAD, SO RELINK FROM PREV AND FREE */
-	  prev->more = src->more;
-	  FREE (src);
-	  src = prev->more;
-	}
-	else {  /* IN LIST HEAD, SO REASSIGN HEAD DATA, RELINK, FREE */
-	  if (src->more) {
-	    tmp_src = src->more;
-	    src->ipos = tmp_src->ipos;
-	    src->iseq = tmp_src->iseq;
-	    src->more = tmp_src->more;
-	    FREE (tmp_src);
-	  }
-	  else {
-	    src->ipos = -1;
-	    src->iseq = -1;
-	  }
-	}
-      }
-      else {
-	if (src->iseq>=bad_seq_id)
-	  src->iseq--;
-	prev = src;
-	src = src->more;
-      }
-    }
+  int is_listed;
+
+  if (!select_ifile) {  /* NO FILTER: KEEP EVERYTHING */
+    return 1;
   }
-  
-  if (0==keep_all_links) {
+  is_listed = (n_select > 0
+	       && NULL != bsearch (&name, select_names, n_select, sizeof(char *), select_name_qsort_cmp));
+  return (remove_listed_sequences ? !is_listed : is_listed);
+}
 
-    build_seq_to_po_index (lposeq);
-    
-    /* FREE ALL LINK INFO */
-    for (i=0; i<lposeq->length; i++) {
-      lett = &(lposeq->letter[i]);
-      for (lnk = &(lett->left); lnk->more != NULL; ) {
-	tmp_lnk = lnk->more;
-	lnk->more = tmp_lnk->more;
-	FREE (tmp_lnk);
-      }
-      lnk->ipos = -1;
-      for (lnk = &(lett->right); lnk->more != NULL; ) {
-	tmp_lnk = lnk->more;
-	lnk->more = tmp_lnk->more;
-	FREE (tmp_lnk);
-      }
-      lnk->ipos = -1;
-    }
-    
-    /* REBUILD LINK INFO FROM REMAINING SEQS */
-    for (i=0; i<n_seqs; i++) {
-      len = lposeq->source_seq[i].length;
-      for (j=0; j<len-1; j++) {
-	id_left = lposeq->source_seq[i].seq_to_po[j];
-	id_right = lposeq->source_seq[i].seq_to_po[j+1];
-	add_lpo_link (&(lposeq->letter[id_left].right), id_right);
-	add_lpo_link (&(lposeq->letter[id_right].left), id_left);
-      }
-    }
+static void free_select_names (int n_select, char **select_names)
+{
+  int i;
+  for (i=0; i<n_select; i++) {
+    FREE (select_names[i]);
   }
+  FREE (select_names);
 }
@@ -48,5 +48,50 @@ LPOSequence_T *lpo_from_aln_mat (int n_seqs, char **seq_names, char **seq_titles
 				 int do_switch_case, ResidueScoreMatrix_T *score_matrix);
 
 
+/** state for building an LPO from an RC-MSA one piece at a time:
+    each row's alignment text may arrive in any number of chunks (e.g.
+    the interleaved blocks of a CLUSTAL file), as long as each row's
+    chunks arrive in column order.  Memory is proportional to the graph
+    built so far, plus one counter per row and one entry per column. */
+typedef struct {
+  LPOSequence_T *lposeq;
+  /** TRANSLATES ALIGNMENT CHARACTERS TO MATRIX INDEXES */
+  char symbol_index[256];
+  int do_switch_case;
+  /** NEXT COLUMN AND NEXT RESIDUE POSITION OF EACH ROW */
+  int *row_col, *row_length;
+  int max_row;
+  /** FIRST LETTER OF EACH COLUMN; REST OF THE COLUMN CHAINED BY align_ring */
+  LPOLetterRef_T *col_first;
+  int ncol, max_col;
+  /** ALLOCATED SIZE OF lposeq->letter */
+  int max_letter;
+  /** LAST ENTRY OF EACH LETTER'S SOURCE LIST, SO THAT A ROW IS APPENDED
+      WITHOUT WALKING THE ROWS BEFORE IT; NULL WHILE THE LIST IS JUST THE
+      source FIELD ITSELF (WHICH MOVES WHEN lposeq->letter GROWS) */
+  LPOLetterSource_T **source_tail;
+}
+LPOMsaBuilder_T;
+
+
+/** Starts building an LPO from an RC-MSA (cf. LPOMsaBuilder_T).
+ */
+void init_msa_builder (LPOMsaBuilder_T *builder, int do_switch_case, ResidueScoreMatrix_T *score_matrix);
+
+/** Adds a new, empty row named `name'; returns its index.
+ */
+int add_msa_builder_row (LPOMsaBuilder_T *builder, char name[], char title[]);
+
+/** Appends the next chunk of alignment text for row `irow'; characters
+    other than residues and gaps are ignored.
+ */
+void add_msa_builder_text (LPOMsaBuilder_T *builder, int irow, const char aln[]);
+
+/** Sorts the letters into column order, links each row's residues and
+    returns the finished LPO (NULL if no rows were added).
+ */
+LPOSequence_T *finish_msa_builder (LPOMsaBuilder_T *builder);
+
+
 
 #endif  /* MSA_FORMAT_HEADER_INCLUDED */
@@ -143,3 +143,570 @@ void read_numeric_data(int nsource_seq,
 }
 
 
+
+
+
+
+
+/********************************************************************
+ COLUMNAR NUMERIC TRACKS: ONE CONTIGUOUS VALUE ARRAY PER TRACK, HELD
+ BY THE LPOSequence_T AND SHARED BY ALL ITS SOURCE SEQS
+*********************************************************************/
+
+/** magic string opening a file written by write_lpo_tracks() */
+#define LPO_TRACK_MAGIC "POATRK01"
+#define LPO_TRACK_MAGIC_LENGTH 8
+
+
+/** bytes per value of a track of the given type */
+static size_t track_value_size(int type)
+{
+  return (type==lpo_track_uint8) ? sizeof(unsigned char) : sizeof(float);
+}
+
+
+/**@memo adds an empty track called name, holding values of the given
+ type (lpo_track_float OR lpo_track_uint8) to seq, and returns its
+ track id, the index in seq->track[] used by every other track call. */
+int new_lpo_track(LPOSequence_T *seq,char name[],int type)
+{
+  LPONumericTrack_T *track;
+
+  REBUFF(seq->track,seq->ntrack,TRACK_BUFFER_CHUNK,LPONumericTrack_T);
+  track=seq->track+seq->ntrack;
+  memset(track,0,sizeof(LPONumericTrack_T));
+  STRNCPY(track->name,name,SEQUENCE_NAME_MAX);
+  track->type=type;
+  return seq->ntrack++;
+}
+
+
+/**@memo finds the id of seq's track called name, or -1 if there is
+ none.  Look ids up once, then use them in per-position loops. */
+int find_lpo_track(LPOSequence_T *seq,char name[])
+{
+  int i;
+  LOOPF (i,seq->ntrack)
+    if (0==strcmp(seq->track[i].name,name))
+      return i;
+  return -1;
+}
+
+
+/** makes track's per-source tables hold at least nsource_seq entries;
+ NEW ENTRIES HAVE NO VALUES */
+static void reserve_track_sources(LPONumericTrack_T *track,int nsource_seq)
+{
+  int n=track->max_source_seq;
+
+  if (nsource_seq>n) {
+    track->max_source_seq= (nsource_seq > 2*n) ? nsource_seq : 2*n;
+    REALLOC(track->start,track->max_source_seq,size_t);
+    REALLOC(track->count,track->max_source_seq,int);
+    memset(track->start+n,0,(track->max_source_seq-n)*sizeof(size_t));
+    memset(track->count+n,0,(track->max_source_seq-n)*sizeof(int));
+  }
+  if (nsource_seq>track->nsource_seq)
+    track->nsource_seq=nsource_seq;
+}
+
+
+/**@memo reserves storage for n values of source seq iseq on track itrack
+ of seq, and returns a pointer to it (float * OR unsigned char *,
+ depending on the track type) for the caller to fill.  Any values
+ iseq already had are abandoned: storage only ever grows at the end. */
+void *set_lpo_track_values(LPOSequence_T *seq,int itrack,int iseq,int n)
+{
+  LPONumericTrack_T *track=seq->track+itrack;
+
+  reserve_track_sources(track,iseq+1);
+  if (track->nvalue+n>track->max_value) { /* GROW THE VALUE ARRAY */
+    track->max_value= (track->nvalue+n > 2*track->max_value) ?
+      track->nvalue+n : 2*track->max_value;
+    if (track->type==lpo_track_uint8) {
+      REALLOC(track->bvalue,track->max_value,unsigned char);
+    }
+    else {
+      REALLOC(track->fvalue,track->max_value,float);
+    }
+  }
+  track->start[iseq]=track->nvalue;
+  track->count[iseq]=n;
+  track->nvalue+=n;
+  if (track->type==lpo_track_uint8)
+    return track->bvalue+track->start[iseq];
+  return track->fvalue+track->start[iseq];
+}
+
+
+/**@memo value of track at position ipos of source seq iseq, or missing
+ if the track holds no value there.  O(1): no searching. */
+double lpo_track_value(LPONumericTrack_T *track,int iseq,int ipos,
+		       double missing)
+{
+  size_t i;
+  if (iseq<0 || iseq>=track->nsource_seq || ipos<0
+      || ipos>=track->count[iseq])
+    return missing;
+  i=track->start[iseq]+ipos;
+  return (track->type==lpo_track_uint8) ? track->bvalue[i]
+    : track->fvalue[i];
+}
+
+
+/**@memo frees the ntrack tracks in track[], and the block itself. */
+void free_lpo_tracks(int ntrack,LPONumericTrack_T *track)
+{
+  int i;
+  LOOP (i,ntrack) {
+    FREE(track[i].start);
+    FREE(track[i].count);
+    FREE(track[i].fvalue);
+    FREE(track[i].bvalue);
+  }
+  if (track)
+    free(track);
+}
+
+
+/**@memo copies every track of from to the track of the same name in to
+ (created if need be), renumbering from's source seq i as iseq_new[i],
+ the way save_lpo_source_list() renumbers the sources themselves.
+ Called by fuse_lpo() and copy_fuse_lpo(). */
+void copy_lpo_tracks(LPOSequence_T *to,LPOSequence_T *from,int iseq_new[])
+{
+  int i,itrack,ito;
+  size_t size;
+  LPONumericTrack_T *track;
+
+  LOOPF (itrack,from->ntrack) {
+    track=from->track+itrack;
+    if ((ito=find_lpo_track(to,track->name))<0) {
+      ito=new_lpo_track(to,track->name,track->type);
+      to->track[ito].link_weight_scale=track->link_weight_scale;
+    }
+    if (to->track[ito].type!=track->type) {
+      WARN_MSG(USERR,(ERRTXT,"track %s has different value types in %s and %s; not copied\n",
+		      track->name,to->name,from->name),"$Revision: 1.2 $");
+      continue;
+    }
+    size=track_value_size(track->type);
+    LOOPF (i,track->nsource_seq)
+      if (track->count[i]>0)
+	memcpy(set_lpo_track_values(to,ito,iseq_new[i],track->count[i]),
+	       (track->type==lpo_track_uint8) ?
+	       (void *)(track->bvalue+track->start[i])
+	       : (void *)(track->fvalue+track->start[i]),
+	       track->count[i]*size);
+  }
+}
+
+
+/**@memo renumbers the source seqs of every track of seq, source seq i
+ becoming perm[i], to follow reindex_lpo_source_seqs().  Only the
+ per-source tables move; the values stay where they are. */
+void permute_lpo_tracks(LPOSequence_T *seq,int perm[])
+{
+  int i,itrack,*count=NULL;
+  size_t *start=NULL;
+  LPONumericTrack_T *track;
+
+  LOOPF (itrack,seq->ntrack) {
+    track=seq->track+itrack;
+    if (track->nsource_seq<=0)
+      continue;
+    reserve_track_sources(track,seq->nsource_seq);
+    CALLOC(start,seq->nsource_seq,size_t);
+    CALLOC(count,seq->nsource_seq,int);
+    LOOPF (i,seq->nsource_seq) {
+      start[perm[i]]=track->start[i];
+      count[perm[i]]=track->count[i];
+    }
+    memcpy(track->start,start,seq->nsource_seq*sizeof(size_t));
+    memcpy(track->count,count,seq->nsource_seq*sizeof(int));
+    FREE(start);
+    FREE(count);
+  }
+}
+
+
+/**@memo reverses the order of source seq iseq's values on every track
+ of seq, to follow its sequence being reverse complemented. */
+void reverse_lpo_track_values(LPOSequence_T *seq,int iseq)
+{
+  int itrack,i,n;
+  float f;
+  unsigned char b,*bvalue;
+  float *fvalue;
+  LPONumericTrack_T *track;
+
+  LOOPF (itrack,seq->ntrack) {
+    track=seq->track+itrack;
+    if (iseq>=track->nsource_seq || (n=track->count[iseq])<2)
+      continue;
+    if (track->type==lpo_track_uint8) {
+      bvalue=track->bvalue+track->start[iseq];
+      for (i=0;i<n-1-i;i++) {
+	b=bvalue[i];
+	bvalue[i]=bvalue[n-1-i];
+	bvalue[n-1-i]=b;
+      }
+    }
+    else {
+      fvalue=track->fvalue+track->start[iseq];
+      for (i=0;i<n-1-i;i++) {
+	f=fvalue[i];
+	fvalue[i]=fvalue[n-1-i];
+	fvalue[n-1-i]=f;
+      }
+    }
+  }
+}
+
+
+/**@memo adds each weighted track's values to the links of seq: every
+ step of a source seq from position ipos-1 to ipos adds
+ link_weight_scale times the smaller of the two values to the weight
+ of the link it takes (the step is only as reliable as its weaker
+ end).  fuse_lpo() then carries these weights over with the links, so
+ a track fed in here counts in every later fusion.  lpo_init() calls
+ this on each input sequence; returns the number of steps weighted. */
+int add_lpo_track_link_weights(LPOSequence_T *seq)
+{
+  int i,itrack,nstep=0,*last_letter=NULL;
+  double v,prev;
+  LPONumericTrack_T *track;
+  LPOLetterSource_T *source;
+  LPOLetterLink_T *link;
+
+  LOOPF (itrack,seq->ntrack) {
+    track=seq->track+itrack;
+    if (track->link_weight_scale==0. || track->nsource_seq<=0)
+      continue;
+    if (!last_letter) {
+      CALLOC(last_letter,seq->nsource_seq,int);
+    }
+    LOOPF (i,seq->nsource_seq)
+      last_letter[i]= INVALID_LETTER_POSITION;
+    LOOPF (i,seq->length) /* LETTERS ARE IN TOPOLOGICAL ORDER */
+      for (source= &seq->letter[i].source;source && source->ipos>=0;
+	   source=source->more) {
+	if (source->ipos>0 && last_letter[source->iseq]>=0) {
+	  prev=lpo_track_value(track,source->iseq,source->ipos-1,-1.);
+	  v=lpo_track_value(track,source->iseq,source->ipos,-1.);
+	  if (prev>=0. && v>=0.) {
+	    v=track->link_weight_scale*(prev<v ? prev : v);
+	    for (link= &seq->letter[last_letter[source->iseq]].right;
+		 link && link->ipos>=0;link=link->more)
+	      if (link->ipos==i) {
+		link->weight+= (int)(v+0.5);
+		break;
+	      }
+	    for (link= &seq->letter[i].left;link && link->ipos>=0;
+		 link=link->more)
+	      if (link->ipos==last_letter[source->iseq]) {
+		link->weight+= (int)(v+0.5);
+		break;
+	      }
+	    nstep++;
+	  }
+	}
+	last_letter[source->iseq]=i;
+      }
+  }
+  FREE(last_letter);
+  return nstep;
+}
+
+
+
+
+/** ONE SOURCE SEQ THAT TRACK VALUES CAN BE LOADED INTO: SEQ seq[k],
+ SOURCE iseq.  A SEQ NOT YET INITIALIZED BY lpo_init() (NO SOURCES)
+ COUNTS AS ITS OWN SOURCE 0 */
+typedef struct {
+  const char *name;
+  int k,iseq;
+} TrackTarget_T;
+
+static int track_target_cmp(const void *void_a,const void *void_b)
+{
+  const TrackTarget_T *a=void_a,*b=void_b;
+  int cmp=strcmp(a->name,b->name);
+
+  if (cmp)
+    return cmp;
+  return (a->k!=b->k) ? a->k-b->k : a->iseq-b->iseq;
+}
+
+/** lists the sources of seq[0..nseq-1], sorted by name */
+static TrackTarget_T *index_track_targets(int nseq,LPOSequence_T seq[],
+					  int *p_ntarget)
+{
+  int i,k,n=0;
+  TrackTarget_T *target=NULL;
+
+  LOOPF (k,nseq)
+    n+= seq[k].nsource_seq>0 ? seq[k].nsource_seq : 1;
+  CALLOC(target,n+1,TrackTarget_T);
+  n=0;
+  LOOPF (k,nseq)
+    if (seq[k].nsource_seq>0)
+      LOOPF (i,seq[k].nsource_seq) {
+	target[n].name=seq[k].source_seq[i].name;
+	target[n].k=k;
+	target[n++].iseq=i;
+      }
+    else {
+      target[n].name=seq[k].name;
+      target[n].k=k;
+      target[n++].iseq=0;
+    }
+  qsort(target,n,sizeof(TrackTarget_T),track_target_cmp);
+  *p_ntarget=n;
+  return target;
+}
+
+/** the last source named name in target[] (SORTED), or NULL */
+static TrackTarget_T *find_track_target(int ntarget,TrackTarget_T target[],
+					const char name[])
+{
+  int low=0,high=ntarget,mid;
+
+  while (low<high) { /* FIRST ENTRY SORTING AFTER name */
+    mid=(low+high)/2;
+    if (strcmp(target[mid].name,name)<=0)
+      low=mid+1;
+    else
+      high=mid;
+  }
+  if (low>0 && 0==strcmp(target[low-1].name,name))
+    return target+low-1;
+  return NULL;
+}
+
+/** track id of the track called name on seq, created if need be;
+ -1 (WITH A WARNING) IF seq HAS ONE OF ANOTHER TYPE */
+static int get_lpo_track(LPOSequence_T *seq,char name[],int type)
+{
+  int itrack=find_lpo_track(seq,name);
+
+  if (itrack<0)
+    return new_lpo_track(seq,name,type);
+  if (seq->track[itrack].type==type)
+    return itrack;
+  WARN_MSG(USERR,(ERRTXT,"track %s of %s already holds values of another type.  Skipping.\n",
+		  name,seq->name),"$Revision: 1.2 $");
+  return -1;
+}
+
+
+
+
+/**@memo writes all the tracks of seq to ofile in the bulk binary form
+ read_lpo_tracks() loads: a magic string, the source seq names, then
+ per track its name, type, per-source value counts, and all its values
+ as one block per source.  The file is meant to be read back on the
+ same kind of machine.  Returns 0 on success, -1 on a write error. */
+int write_lpo_tracks(FILE *ofile,LPOSequence_T *seq)
+{
+  int i,itrack,n;
+  size_t size;
+  LPONumericTrack_T *track;
+
+  if (fwrite(LPO_TRACK_MAGIC,1,LPO_TRACK_MAGIC_LENGTH,ofile)
+      !=LPO_TRACK_MAGIC_LENGTH
+      || fwrite(&seq->ntrack,sizeof(int),1,ofile)!=1
+      || fwrite(&seq->nsource_seq,sizeof(int),1,ofile)!=1)
+    return -1;
+  LOOPF (i,seq->nsource_seq)
+    if (fwrite(seq->source_seq[i].name,1,SEQUENCE_NAME_MAX,ofile)
+	!=SEQUENCE_NAME_MAX)
+      return -1;
+  LOOPF (itrack,seq->ntrack) {
+    track=seq->track+itrack;
+    size=track_value_size(track->type);
+    if (fwrite(track->name,1,SEQUENCE_NAME_MAX,ofile)!=SEQUENCE_NAME_MAX
+	|| fwrite(&track->type,sizeof(int),1,ofile)!=1
+	|| fwrite(&track->link_weight_scale,sizeof(float),1,ofile)!=1)
+      return -1;
+    LOOPF (i,seq->nsource_seq) {
+      n= i<track->nsource_seq ? track->count[i] : 0;
+      if (fwrite(&n,sizeof(int),1,ofile)!=1)
+	return -1;
+    }
+    LOOPF (i,track->nsource_seq) /* VALUE BLOCKS, IN SOURCE ORDER */
+      if (track->count[i]>0
+	  && fwrite((track->type==lpo_track_uint8) ?
+		    (void *)(track->bvalue+track->start[i])
+		    : (void *)(track->fvalue+track->start[i]),
+		    size,track->count[i],ofile)!=(size_t)track->count[i])
+	return -1;
+  }
+  return 0;
+}
+
+
+/**@memo loads tracks saved by write_lpo_tracks() from ifile into the
+ sequences seq[0..nseq-1], matching source seqs by name (a sequence
+ not yet turned into an LPO matches by its own name).  Values of
+ sources found nowhere are skipped.  When nseq is 1 and the file lists
+ exactly seq's sources in order, as for a checkpoint, no name lookup
+ is done at all.  Returns the number of tracks read, or -1 on a
+ read error or bad file. */
+int read_lpo_tracks(FILE *ifile,int nseq,LPOSequence_T seq[])
+{
+  int i,k,ntrack,nsource_seq,itrack,type,*count=NULL,*itrack_seq=NULL;
+  int ntarget=0,in_order,status= -1;
+  char magic[LPO_TRACK_MAGIC_LENGTH],name[SEQUENCE_NAME_MAX];
+  char *source_name=NULL;
+  float link_weight_scale;
+  size_t size,nscratch=0;
+  void *p,*scratch=NULL;
+  TrackTarget_T *target=NULL,**source_target=NULL;
+
+  if (fread(magic,1,LPO_TRACK_MAGIC_LENGTH,ifile)!=LPO_TRACK_MAGIC_LENGTH
+      || memcmp(magic,LPO_TRACK_MAGIC,LPO_TRACK_MAGIC_LENGTH)
+      || fread(&ntrack,sizeof(int),1,ifile)!=1
+      || fread(&nsource_seq,sizeof(int),1,ifile)!=1
+      || ntrack<0 || nsource_seq<0)
+    return -1;
+  CALLOC(source_name,(nsource_seq+1)*SEQUENCE_NAME_MAX,char);
+  if (nsource_seq>0
+      && fread(source_name,SEQUENCE_NAME_MAX,nsource_seq,ifile)
+      !=(size_t)nsource_seq)
+    goto done;
+
+  in_order= (nseq==1 && seq->nsource_seq==nsource_seq);
+  for (i=0;in_order && i<nsource_seq;i++)
+    in_order= !strncmp(seq->source_seq[i].name,
+		       source_name+i*SEQUENCE_NAME_MAX,SEQUENCE_NAME_MAX);
+  CALLOC(source_target,nsource_seq+1,TrackTarget_T *);
+  if (in_order) { /* SAME SOURCES, SAME ORDER: NO LOOKUP NEEDED */
+    CALLOC(target,nsource_seq+1,TrackTarget_T);
+    LOOPF (i,nsource_seq) {
+      target[i].iseq=i;
+      source_target[i]=target+i;
+    }
+  }
+  else {
+    target=index_track_targets(nseq,seq,&ntarget);
+    LOOPF (i,nsource_seq) {
+      source_name[(i+1)*SEQUENCE_NAME_MAX-1]='\0';
+      source_target[i]=find_track_target(ntarget,target,
+					 source_name+i*SEQUENCE_NAME_MAX);
+    }
+  }
+
+  CALLOC(count,nsource_seq+1,int);
+  CALLOC(itrack_seq,nseq,int);
+  LOOPF (itrack,ntrack) {
+    if (fread(name,1,SEQUENCE_NAME_MAX,ifile)!=SEQUENCE_NAME_MAX
+	|| fread(&type,sizeof(int),1,ifile)!=1
+	|| fread(&link_weight_scale,sizeof(float),1,ifile)!=1
+	|| (type!=lpo_track_float && type!=lpo_track_uint8)
+	|| (nsource_seq>0
+	    && fread(count,sizeof(int),nsource_seq,ifile)!=(size_t)nsource_seq))
+      goto done;
+    name[SEQUENCE_NAME_MAX-1]='\0';
+    size=track_value_size(type);
+    LOOPF (k,nseq) /* CREATED ON FIRST USE, SO UNMATCHED SEQS STAY BARE */
+      itrack_seq[k]= -2;
+    LOOPF (i,nsource_seq) {
+      if (count[i]<0)
+	goto done;
+      p=NULL;
+      if (count[i]>0 && source_target[i]) {
+	k=source_target[i]->k;
+	if (itrack_seq[k]== -2) {
+	  itrack_seq[k]=get_lpo_track(seq+k,name,type);
+	  if (itrack_seq[k]>=0)
+	    seq[k].track[itrack_seq[k]].link_weight_scale=link_weight_scale;
+	}
+	if (itrack_seq[k]>=0)
+	  p=set_lpo_track_values(seq+k,itrack_seq[k],source_target[i]->iseq,
+				 count[i]);
+      }
+      if (!p && count[i]>0) { /* NOBODY WANTS THESE: READ THEM AWAY */
+	if (count[i]*size>nscratch) {
+	  nscratch=count[i]*size;
+	  REALLOC(scratch,nscratch,char);
+	}
+	p=scratch;
+      }
+      if (count[i]>0 && fread(p,size,count[i],ifile)!=(size_t)count[i])
+	goto done;
+    }
+  }
+  status=ntrack;
+
+ done:
+  FREE(source_name);
+  FREE(source_target);
+  FREE(target);
+  FREE(count);
+  FREE(itrack_seq);
+  FREE(scratch);
+  return status;
+}
+
+
+/**@memo reads FASTA-formatted numeric data in the text format of
+ read_numeric_data() (a ">SEQNAME NUMERIC_DATA=TRACK" line, then one
+ value per position of the sequence) into tracks of the given type
+ on seq[0..nseq-1], matching sequences by name as read_lpo_tracks()
+ does.  Whole lines are read and parsed with strtod(), and names are
+ found by binary search, so this is linear in the size of the input.
+ Returns the number of value sets read. */
+int read_lpo_tracks_text(FILE *ifile,int nseq,LPOSequence_T seq[],int type)
+{
+  int j,n,ntarget=0,nread=0,itrack,length=0,in_record=0;
+  char *line=NULL,*p,*end,seq_name[SEQUENCE_NAME_MAX],data_name[1024];
+  size_t line_size=0;
+  float *fvalue=NULL;
+  unsigned char *bvalue=NULL;
+  void *values;
+  double v;
+  TrackTarget_T *target,*t;
+
+  target=index_track_targets(nseq,seq,&ntarget);
+  while (getline(&line,&line_size,ifile)>0) {
+    if ('>'==line[0]) { /* NEW VALUE SET */
+      in_record=0;
+      if (sscanf(line,">%127s NUMERIC_DATA=%1023s",seq_name,data_name)!=2)
+	continue;
+      if (!(t=find_track_target(ntarget,target,seq_name))) {
+	WARN_MSG(USERR,(ERRTXT,"Error! NUMERIC_DATA %s, sequence %s does not exist.  Skipping.\n\n",data_name,seq_name),"$Revision: 1.2 $");
+	continue;
+      }
+      if ((itrack=get_lpo_track(seq+t->k,data_name,type))<0)
+	continue;
+      length= seq[t->k].nsource_seq>0 ?
+	seq[t->k].source_seq[t->iseq].length : seq[t->k].length;
+      values=set_lpo_track_values(seq+t->k,itrack,t->iseq,length);
+      memset(values,0,length*track_value_size(type)); /* MISSING VALUES: 0 */
+      fvalue= (type==lpo_track_float) ? values : NULL;
+      bvalue= (type==lpo_track_uint8) ? values : NULL;
+      j=0;
+      in_record=1;
+      nread++;
+      continue;
+    }
+    if (!in_record)
+      continue;
+    for (p=line;j<length;j++,p=end) { /* ALL THE VALUES ON THIS LINE */
+      v=strtod(p,&end);
+      if (end==p)
+	break;
+      if (fvalue)
+	fvalue[j]=v;
+      else {
+	n=(int)(v+0.5);
+	bvalue[j]= n<0 ? 0 : (n>255 ? 255 : n);
+      }
+    }
+  }
+  FREE(line);
+  FREE(target);
+  return nread;
+}
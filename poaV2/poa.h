@@ -3,6 +3,7 @@
 #ifndef POA_HEADER_INCLUDED
 #define POA_HEADER_INCLUDED
 
+#include <stdint.h>
 
 
 
@@ -57,6 +58,10 @@ struct LPOLetterLink_S {
  /** transition cost for traversing this link */
   LPOScore_T score;
 #endif
+ /** extra weight of this link: the sequences folded into it by
+     fold_lpo_sources(), plus the scaled track values (e.g. FASTQ base
+     qualities) added by add_lpo_track_link_weights() */
+  int weight;
  /** next node in the linked list */
   struct LPOLetterLink_S *more;
 } ;
@@ -112,6 +117,48 @@ struct LPONumericData_S { /** */
 typedef struct LPONumericData_S LPONumericData_T;
 
 
+/** value types of an LPONumericTrack_T */
+enum {
+  lpo_track_float,
+  lpo_track_uint8
+};
+
+/** name of the track of base qualities read by read_fastq() */
+#define LPO_QUALITY_TRACK "quality"
+/** Phred quality assumed for a step of a source seq with no qualities,
+ when heaviest_bundle_quality() weighs the others by theirs */
+#define LPO_DEFAULT_QUALITY 20
+
+/** buffer chunk size for expanding an LPOSequence_T track[] array */
+#define TRACK_BUFFER_CHUNK 4
+
+/** one numeric track (e.g. base quality or coverage) over all the source
+ seqs of an LPO, stored column-wise: the values of every source seq sit
+ in one contiguous array of the track's type, source seq iseq's values
+ being value[start[iseq]] .. value[start[iseq]+count[iseq]-1].  Tracks
+ are numbered by their index in LPOSequence_T.track[], so fetching a
+ value takes no name lookup (see lpo_track_value()). */
+struct LPONumericTrack_S { /** */
+  char name[SEQUENCE_NAME_MAX];
+ /** lpo_track_float OR lpo_track_uint8 */
+  int type;
+ /** IF NON-ZERO, lpo_init() ADDS scale TIMES EACH STEP'S VALUE TO THE
+     WEIGHT OF THE LINK IT TAKES (SEE add_lpo_track_link_weights()) */
+  float link_weight_scale;
+ /** SOURCE SEQS WITH AN ENTRY IN start[] AND count[]; count 0 = NO VALUES */
+  int nsource_seq; /** */
+  int max_source_seq; /** */
+  size_t *start; /** */
+  int *count; /** */
+  size_t nvalue; /** */
+  size_t max_value;
+ /** THE VALUES: fvalue FOR lpo_track_float, bvalue FOR lpo_track_uint8 */
+  float *fvalue; /** */
+  unsigned char *bvalue;
+};
+typedef struct LPONumericTrack_S LPONumericTrack_T;
+
+
 /** Structure for storing individual source sequence information,
  stuff like name, title etc. */
 struct LPOSourceInfo_S { /** */
@@ -149,6 +196,16 @@ struct LPOSequence_S {/** */
   char name[SEQUENCE_NAME_MAX];/** */
   int nsource_seq;/** */
   LPOSourceInfo_T *source_seq;
+ /** UNPARSED FASTA TEXT (e.g. IN AN mmap'd FILE) FROM WHICH sequence
+     IS BUILT ON DEMAND BY load_fasta_view(); NOT OWNED BY THIS HOLDER */
+  const char *view;/** */
+  int view_length;/** */
+  int view_switch_case;
+ /** IF SET, load_fasta_view() REVERSE COMPLEMENTS THE VIEW (-auto_strand) */
+  int view_reverse_complement;
+ /** PER-POSITION NUMERIC TRACKS OF THE SOURCE SEQS (SEE numeric_data.c) */
+  int ntrack;/** */
+  LPONumericTrack_T *track;
 };
 
 typedef struct LPOSequence_S LPOSequence_T;
@@ -163,6 +220,183 @@ typedef LPOSequence_T Sequence_T;
 
 
 
+/**@memo cursor for streaming an LPO as RC-MSA columns, one
+ alignment ring at a time (see next_lpo_column()) */
+struct LPOColumnCursor_S {
+  LPOSequence_T *seq; /** */
+  int nsymbol; /** */
+  char *symbol; /** */
+  char gap_character;
+ /** TOTAL NUMBER OF COLUMNS (ALIGNMENT RINGS) IN seq */
+  int ncol;
+ /** INDEX OF THE COLUMN CURRENTLY HELD IN column[] */
+  int icol;
+ /** letter[] RANGE OF THE CURRENT RING */
+  LPOLetterRef_T col_start,col_end;
+ /** RESIDUE OR GAP FOR EACH SOURCE SEQ IN THE CURRENT COLUMN */
+  char *column;
+};
+
+typedef struct LPOColumnCursor_S LPOColumnCursor_T;
+
+/** NUMBER OF INDEPENDENT PROBLEMS align_lpo_po_batch() FILLS AT ONCE */
+#ifndef LPO_BATCH_LANES
+#define LPO_BATCH_LANES 16
+#endif
+
+/** MAXIMUM ROW-BLOCK BUFFER USED WHEN WRITING ROW-ORDERED MSA FORMATS */
+#ifndef LPO_EXPORT_BUFFER_SIZE
+#define LPO_EXPORT_BUFFER_SIZE 16777216
+#endif
+
+
+
+/** one candidate merge for buildup_progressive_lpo(): clusters of
+ sequences i and j, merged in order of decreasing score */
+typedef struct {
+  double score;
+  int i;
+  int j;
+}
+SeqPairScore_T;
+
+
+/** one k-mer occurrence: hash of its residue codes, and the offset of its
+    last residue in the code[] array it was read from */
+typedef struct {
+  uint64_t key;
+  int end;
+}
+LPOKmer_T;
+
+
+/** a DP traceback move that does not fit its 4-bit code: cell col goes
+    back along x-predecessor x and y-predecessor y (1-based indices into
+    the letters' left links, 0 for no move on that axis) */
+typedef struct {
+  int col;
+  int x;
+  int y;
+}
+LPOMoveSide_T;
+
+/**@memo one row of a compressed DP traceback matrix (see lpo_move.c) */
+struct LPOMoveRow_S {
+ /** 4-BIT MOVE CODES, TWO CELLS PER BYTE: CELL col IS NIBBLE
+     col*stride+first, HOLDING ITS x-PREDECESSOR INDEX IN 3 BITS AND ITS
+     y-PREDECESSOR INDEX IN 1; AN x FIELD OF LPO_MOVE_SIDE MEANS THE MOVE
+     DID NOT FIT, AND IS LOOKED UP IN side[] */
+  unsigned char *code;
+  int first,stride;
+ /** MOVES CODED LPO_MOVE_SIDE, IN INCREASING col ORDER */
+  int nside,max_side;
+  LPOMoveSide_T *side;
+};
+
+typedef struct LPOMoveRow_S LPOMoveRow_T;
+
+#define LPO_MOVE_SIDE 7
+#define LPO_MOVE_FITS(X,Y) ((X) < LPO_MOVE_SIDE && (Y) < 2)
+
+/** 4-BIT CODE OF MOVE (X,Y) OF CELL COL IN LPOMoveRow_T *ROW; A MOVE
+    THAT DOES NOT FIT IS APPENDED TO ROW'S SIDE TABLE, SO CELLS OF A ROW
+    MUST BE CODED IN INCREASING COL ORDER */
+#define LPO_MOVE_CODE(ROW,COL,X,Y) \
+  (LPO_MOVE_FITS(X,Y) ? (X) | ((Y) << 3) : add_lpo_move_side(ROW,COL,X,Y))
+
+/** STORES MOVE (X,Y) OF CELL COL IN ROW, WHOSE CODES START ZEROED */
+#define SET_LPO_MOVE(ROW,COL,X,Y) { \
+  int lpo_move_nibble = (COL)*(ROW)->stride + (ROW)->first; \
+  (ROW)->code[lpo_move_nibble>>1] |= LPO_MOVE_CODE(ROW,COL,X,Y) << ((lpo_move_nibble&1)<<2); \
+}
+
+
+/** DP KERNELS OF align_lpo_po(), FORCED BY set_lpo_kernel() SO THAT ONE
+    CAN BE TESTED AGAINST ANOTHER; EACH IS ONLY USED WHERE IT APPLIES */
+enum {
+  lpo_kernel_auto, /* FASTEST KERNEL THAT APPLIES (THE DEFAULT) */
+  lpo_kernel_scalar, /* MATCH SCORES LOOKED UP CELL BY CELL */
+  lpo_kernel_profile, /* ONE MATCH SCORE PROFILE PER y ROW */
+  lpo_kernel_packed, /* 4-SYMBOL ROWS PACKED IN A WORD (NUCLEOTIDES) */
+  lpo_kernel_affine /* FIXED AFFINE RECURRENCE, TILED (fill_lpo_po_affine()) */
+};
+
+
+/** order in which iterative buildup adds its input sequences */
+enum {
+  buildup_input_order,
+  buildup_length_order,
+  buildup_centroid_order,
+  buildup_sketch_order
+};
+
+
+/**@memo periodic checkpointing of buildup_progressive_lpo() */
+struct LPOCheckpoint_S {
+ /** CHECKPOINT FILE; NULL DISABLES CHECKPOINTING */
+  char *filename;
+ /** SAVE AFTER EVERY every MERGES */
+  int every;
+ /** RESTORE FROM filename (IF IT EXISTS) BEFORE MERGING */
+  int resume;
+};
+
+typedef struct LPOCheckpoint_S LPOCheckpoint_T;
+
+
+/**@memo periodic pruning of weakly supported letters during
+ buildup_progressive_lpo() (see prune_lpo()) */
+struct LPOPrune_S {
+ /** PRUNE AFTER EVERY every MERGES; 0 DISABLES PRUNING */
+  int every;
+ /** REMOVE LETTERS SUPPORTED BY LESS THAN THIS SUMMED SEQUENCE WEIGHT */
+  int min_weight;
+};
+
+typedef struct LPOPrune_S LPOPrune_T;
+
+
+/**@memo windowed consensus polishing of a draft with reads mapped to it
+ (see polish_lpo_windows()) */
+struct LPOPolish_S {
+ /** DRAFT FASTA FILE; NULL DISABLES POLISHING */
+  char *draft_filename;
+ /** READ-TO-DRAFT MAPPINGS, IN PAF OR SAM FORMAT */
+  char *map_filename;
+ /** DRAFT RESIDUES PER WINDOW */
+  int window_length;
+ /** WINDOWS ARE POLISHED BY THIS MANY THREADS AT A TIME */
+  int nthread;
+};
+
+typedef struct LPOPolish_S LPOPolish_T;
+
+
+/**@memo speculative iterative buildup: sequences are aligned in batches
+ to one snapshot of the partial order (see buildup_speculative_lpo()) */
+struct LPOSpeculate_S {
+ /** SEQUENCES ALIGNED TO EACH SNAPSHOT; 1 OR LESS DISABLES SPECULATION */
+  int nbatch;
+ /** THREADS ALIGNING A BATCH */
+  int nthread;
+};
+
+typedef struct LPOSpeculate_S LPOSpeculate_T;
+
+
+/**@memo persistent alignment server on a Unix domain socket
+ (see serve_lpo_requests()) */
+struct LPOServe_S {
+ /** SOCKET TO LISTEN ON; NULL DISABLES THE SERVER */
+  char *socket_path;
+ /** REQUESTS ARE ANSWERED BY THIS MANY THREADS AT A TIME */
+  int nthread;
+};
+
+typedef struct LPOServe_S LPOServe_T;
+
+
+
 /**@memo Data structure for analyzing sequence differences in MSA*/
 struct LPOLetterCount_S {
   unsigned int is_error:2;
@@ -0,0 +1,104 @@
+#include "default.h"
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+
+/* MINIMAL CLIENT FOR poa -serve: SENDS THE FASTA TEXT ON stdin AS ONE
+   REQUEST (SEE serve_lpo.c FOR THE PROTOCOL) AND COPIES THE REPLY TO
+   stdout, OR ITS ERROR MESSAGE TO stderr. */
+
+
+/** writes all of buf[0..size-1] to fd; returns FALSE on failure */
+static int write_all(int fd,const char buf[],size_t size)
+{
+  ssize_t n;
+
+  while (size>0) {
+    n=write(fd,buf,size);
+    if (n<0 && errno==EINTR)
+      continue;
+    if (n<=0)
+      return FALSE;
+    buf+=n;
+    size-=n;
+  }
+  return TRUE;
+}
+
+
+int main(int argc,char *argv[])
+{
+  int i,fd,is_quit;
+  size_t size=0,alloc=0,n,nbytes;
+  unsigned long reply_size;
+  char *text=NULL,header[1024],status[16],buf[65536];
+  struct sockaddr_un addr;
+  FILE *ifile;
+
+  if (argc<2) {
+    fprintf(stderr,"\nUsage: %s SOCKET [OPTIONS] < FASTA\n"
+"Align the sequences in FASTA with the poa -serve server on SOCKET and\n"
+"print the result.  OPTIONS are passed on with the request:\n"
+"  -consensus_only (default), -pir, -clustal or -po  Output format.\n"
+"  -do_global, -fuse_all, -hb, -hbmin VALUE, -best   As for poa.\n"
+"Usage: %s SOCKET QUIT   stops the server.\n\n",argv[0],argv[0]);
+    exit(2);
+  }
+
+  memset(&addr,0,sizeof(addr));
+  addr.sun_family=AF_UNIX;
+  STRNCPY(addr.sun_path,argv[1],sizeof(addr.sun_path));
+  if ((fd=socket(AF_UNIX,SOCK_STREAM,0))<0
+      || connect(fd,(struct sockaddr *)&addr,sizeof(addr))) {
+    fprintf(stderr,"%s: couldn't connect to %s: %s\n",argv[0],argv[1],
+	    strerror(errno));
+    exit(1);
+  }
+
+  is_quit=(argc==3 && 0==strcmp(argv[2],"QUIT"));
+  if (!is_quit) {
+    do { /* THE WHOLE REQUEST PAYLOAD */
+      if (size+sizeof(buf)>alloc) {
+	alloc=2*alloc+sizeof(buf);
+	REALLOC(text,alloc,char);
+      }
+      n=fread(text+size,1,alloc-size,stdin);
+      size+=n;
+    } while (n>0);
+  }
+
+  if (is_quit)
+    strcpy(header,"QUIT\n");
+  else {
+    sprintf(header,"POA %lu",(unsigned long)size);
+    for (i=2;i<argc;i++)
+      if (strlen(header)+strlen(argv[i])+2<sizeof(header)) {
+	strcat(header," ");
+	strcat(header,argv[i]);
+      }
+    strcat(header,"\n");
+  }
+  if (!write_all(fd,header,strlen(header)) || !write_all(fd,text ? text : "",size)) {
+    fprintf(stderr,"%s: lost connection to %s\n",argv[0],argv[1]);
+    exit(1);
+  }
+  FREE(text);
+
+  ifile=fdopen(fd,"r");
+  if (!ifile || !fgets(header,sizeof(header),ifile)
+      || 2!=sscanf(header,"%15s %lu",status,&reply_size)) {
+    fprintf(stderr,"%s: no reply from %s\n",argv[0],argv[1]);
+    exit(1);
+  }
+  for (nbytes=reply_size;nbytes>0;nbytes-=n) { /* COPY THE REPLY BODY */
+    n=fread(buf,1,nbytes<sizeof(buf) ? nbytes : sizeof(buf),ifile);
+    if (n==0)
+      break;
+    fwrite(buf,1,n,strcmp(status,"OK") ? stderr : stdout);
+  }
+  fclose(ifile);
+  exit(strcmp(status,"OK") || nbytes>0 ? 1 : 0);
+}
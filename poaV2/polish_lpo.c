@@ -0,0 +1,531 @@
+#include "default.h"
+#include "poa.h"
+#include "seq_util.h"
+#include "lpo.h"
+
+#include <pthread.h>
+
+
+/* WINDOWED CONSENSUS POLISHING (-polish): THE DRAFT IS CUT INTO FIXED
+   WINDOWS, THE READ SEGMENTS MAPPED TO EACH WINDOW ARE ALIGNED TO THE
+   DRAFT WINDOW BY buildup_lpo(), AND THE WINDOW'S HEAVIEST BUNDLE TAKES
+   ITS PLACE.  WINDOWS ARE INDEPENDENT, SO A POOL OF THREADS TAKES THEM
+   ONE AT A TIME; READ RESIDUES ARE ONLY COPIED WHEN A SEGMENT IS BUILT. */
+
+
+/** MOST TAB-SEPARATED FIELDS READ FROM ONE MAPPING LINE */
+#define POLISH_MAX_FIELDS 64
+
+/** ONE READ-TO-DRAFT MAPPING FROM A PAF OR SAM LINE; READ COORDINATES ARE
+    ON THE READ STRAND THAT ALIGNS TO THE DRAFT */
+typedef struct {
+  int iread,icontig;
+  int reverse; /* READ ALIGNS AS ITS REVERSE COMPLEMENT */
+  int qstart,qend,qlen; /* ALIGNED READ INTERVAL, AND READ LENGTH */
+  int tstart,tend; /* ALIGNED DRAFT INTERVAL */
+  char *cigar; /* NULL IF UNKNOWN: READ POSITIONS ARE INTERPOLATED */
+} PolishHit_T;
+
+/** SEQUENCE NAME, FOR LOOKING UP MAPPING LINES BY NAME */
+typedef struct {
+  const char *name;
+  int index;
+} PolishName_T;
+
+/** EVERYTHING THE POLISHING THREADS SHARE; ONLY next_window CHANGES, AND
+    ONLY UNDER lock */
+typedef struct {
+  ResidueScoreMatrix_T *m;
+  int use_aggressive_fusion,use_global_alignment;
+  Sequence_T *draft,*read;
+  const char **read_text; /* RESIDUES OF EACH READ, NOT NUL-TERMINATED */
+  int *read_switch_case; /* CASE SWITCH STILL TO APPLY TO read_text */
+  PolishHit_T *hit;
+  int window_length,nwindow,*window_contig,*window_start;
+  int *window_first,*window_hit; /* window_hit[window_first[w]..window_first[w+1]-1] */
+  char **consensus; /* POLISHED RESIDUES OF EACH WINDOW */
+  int next_window;
+  pthread_mutex_t lock;
+} PolishJob_T;
+
+
+
+static int cmp_polish_names(const void *a,const void *b)
+{
+  return strcmp(((const PolishName_T *)a)->name,((const PolishName_T *)b)->name);
+}
+
+
+/** sorted name index of seq[0..nseq-1], for find_polish_name() */
+static PolishName_T *index_polish_names(int nseq,Sequence_T seq[])
+{
+  int i;
+  PolishName_T *names=NULL;
+
+  CALLOC(names,nseq+1,PolishName_T);
+  LOOPF (i,nseq) {
+    names[i].name=seq[i].name;
+    names[i].index=i;
+  }
+  qsort(names,nseq,sizeof(PolishName_T),cmp_polish_names);
+  return names;
+}
+
+
+/** index of the sequence called name, or -1; names are cut to
+    SEQUENCE_NAME_MAX like the sequences' own */
+static int find_polish_name(int nseq,PolishName_T names[],char name[])
+{
+  char short_name[SEQUENCE_NAME_MAX];
+  PolishName_T key,*found;
+
+  STRNCPY(short_name,name,SEQUENCE_NAME_MAX);
+  key.name=short_name;
+  found=bsearch(&key,names,nseq,sizeof(PolishName_T),cmp_polish_names);
+  return found ? found->index : -1;
+}
+
+
+/** splits line at tabs into field[], dropping the newline; returns the
+    number of fields */
+static int split_polish_fields(char line[],char *field[])
+{
+  int nfield=0;
+  char *p=line;
+
+  p[strcspn(p,"\r\n")]='\0';
+  while (nfield<POLISH_MAX_FIELDS) {
+    field[nfield++]=p;
+    if (!(p=strchr(p,'\t')))
+      break;
+    *p++='\0';
+  }
+  return nfield;
+}
+
+
+/** reads the PAF fields of one line into hit; the read interval is
+    flipped onto the reverse strand for '-' mappings, which is the
+    strand a cg:Z: CIGAR refers to */
+static int parse_paf_hit(int nfield,char *field[],PolishHit_T *hit)
+{
+  int i,qs,qe;
+
+  hit->qlen=atoi(field[1]);
+  qs=atoi(field[2]);
+  qe=atoi(field[3]);
+  hit->reverse=(field[4][0]=='-');
+  hit->qstart=hit->reverse ? hit->qlen-qe : qs;
+  hit->qend=hit->reverse ? hit->qlen-qs : qe;
+  hit->tstart=atoi(field[7]);
+  hit->tend=atoi(field[8]);
+  for (i=12;i<nfield;i++)
+    if (strncmp(field[i],"cg:Z:",5)==0)
+      hit->cigar=strdup(field[i]+5);
+  return 1;
+}
+
+
+/** reads the SAM fields of one line into hit, taking the read interval
+    from the CIGAR's clips; unmapped and secondary records are skipped */
+static int parse_sam_hit(int nfield,char *field[],PolishHit_T *hit)
+{
+  int n,flag=atoi(field[1]),aligned=0,clip_left=0,clip_right=0,tlen=0;
+  char *p;
+
+  if ((flag & 0x4) || (flag & 0x100) || field[5][0]=='*')
+    return 0;
+  for (p=field[5];*p;p++) {
+    n=strtol(p,&p,10);
+    switch (*p) {
+    case 'M': case '=': case 'X': aligned+=n; tlen+=n; break;
+    case 'I': aligned+=n; break;
+    case 'D': case 'N': tlen+=n; break;
+    case 'S': case 'H':
+      if (aligned>0)
+	clip_right+=n;
+      else
+	clip_left+=n;
+      break;
+    }
+    if (!*p)
+      break;
+  }
+  hit->reverse=(flag & 0x10)!=0;
+  hit->qstart=clip_left;
+  hit->qend=clip_left+aligned;
+  hit->qlen=hit->qend+clip_right;
+  hit->tstart=atoi(field[3])-1;
+  hit->tend=hit->tstart+tlen;
+  hit->cigar=strdup(field[5]);
+  return 1;
+}
+
+
+/** reads the mappings in map_filename, PAF or SAM line by line, keeping
+    those whose read and contig are known and whose coordinates fit
+    them.  Returns the number of hits saved in *p_hit, or -1 if the file
+    can't be read */
+static int read_polish_hits(char map_filename[],
+			    int nread,Sequence_T read[],PolishName_T read_names[],
+			    int ncontig,Sequence_T draft[],PolishName_T contig_names[],
+			    PolishHit_T **p_hit)
+{
+  int nfield,nhit=0,max_hit=0,ok;
+  char *line=NULL,*field[POLISH_MAX_FIELDS];
+  size_t line_size=0;
+  FILE *ifile;
+  PolishHit_T hit,*hits=NULL;
+
+  if (!(ifile=fopen(map_filename,"r"))) {
+    WARN_MSG(USERR,(ERRTXT,"Couldn't open mapping file %s.\nExiting",
+		    map_filename),"$Revision: 1.2.2.9 $");
+    return -1;
+  }
+  while (getline(&line,&line_size,ifile)>0) {
+    if (line[0]=='@' || line[0]=='#') /* SAM HEADER */
+      continue;
+    nfield=split_polish_fields(line,field);
+    memset(&hit,0,sizeof(hit));
+    if (nfield>=12 && (field[4][0]=='+' || field[4][0]=='-') && !field[4][1]) {
+      ok=parse_paf_hit(nfield,field,&hit); /* PAF: STRAND IS FIELD 5 */
+      hit.icontig=find_polish_name(ncontig,contig_names,field[5]);
+    }
+    else if (nfield>=11) {
+      ok=parse_sam_hit(nfield,field,&hit);
+      hit.icontig=ok ? find_polish_name(ncontig,contig_names,field[2]) : -1;
+    }
+    else
+      ok=0;
+    if (ok)
+      hit.iread=find_polish_name(nread,read_names,field[0]);
+    if (!ok || hit.iread<0 || hit.icontig<0
+	|| hit.qlen!=read[hit.iread].length
+	|| hit.qstart<0 || hit.qstart>hit.qend || hit.qend>hit.qlen
+	|| hit.tstart<0 || hit.tstart>=hit.tend
+	|| hit.tend>draft[hit.icontig].length) {
+      FREE(hit.cigar);
+      continue;
+    }
+    if (nhit>=max_hit) {
+      max_hit=(max_hit>0) ? 2*max_hit : 1024;
+      REALLOC(hits,max_hit,PolishHit_T);
+    }
+    hits[nhit++]=hit;
+  }
+  free(line);
+  fclose(ifile);
+  *p_hit=hits;
+  return nhit;
+}
+
+
+/** read position, on the aligned strand, that hit aligns to draft
+    position t; between two CIGAR operations, or without a CIGAR, it is
+    found by walking or interpolating from the start of the hit */
+static int polish_hit_read_position(PolishHit_T *hit,int t)
+{
+  int n,q=hit->qstart,pos=hit->tstart;
+  char *p;
+
+  if (t<=hit->tstart)
+    return hit->qstart;
+  if (t>=hit->tend)
+    return hit->qend;
+  if (!hit->cigar)
+    return hit->qstart+(int)((double)(t-hit->tstart)*(hit->qend-hit->qstart)
+			     /(hit->tend-hit->tstart));
+  for (p=hit->cigar;*p;p++) {
+    n=strtol(p,&p,10);
+    switch (*p) {
+    case 'M': case '=': case 'X':
+      if (t<pos+n)
+	return q+t-pos;
+      pos+=n;
+      q+=n;
+      break;
+    case 'D': case 'N':
+      if (t<pos+n)
+	return q;
+      pos+=n;
+      break;
+    case 'I':
+      q+=n;
+      break;
+    }
+    if (!*p)
+      break;
+  }
+  return hit->qend;
+}
+
+
+/** builds the draft window w and its read segments as seqs[0..nseq],
+    and polishes it; returns the window's new residues.  The heaviest
+    bundle is clipped to its first and last letters that are, or are
+    aligned to, draft letters: a read segment whose ends were
+    interpolated (no CIGAR) can run past the window, and that overhang
+    is polished by the neighbouring window */
+static char *polish_window(PolishJob_T *job,int w,ResidueScoreMatrix_T *m)
+{
+  int i,k,qs,qe,nseg=0,path_length,first,last,start=job->window_start[w],end;
+  Sequence_T *draft=job->draft+job->window_contig[w];
+  LPOSequence_T *seqs=NULL,*s;
+  LPOLetterRef_T *path;
+  LPOLetterSource_T *src;
+  PolishHit_T *hit;
+  const char *text;
+  char *consensus=NULL,*on_draft=NULL;
+
+  end=start+job->window_length<draft->length ? start+job->window_length : draft->length;
+  CALLOC(seqs,job->window_first[w+1]-job->window_first[w]+1,LPOSequence_T);
+  CALLOC(seqs[0].sequence,end-start+1,char); /* THE DRAFT IS THE BACKBONE */
+  memcpy(seqs[0].sequence,draft->sequence+start,end-start);
+  save_sequence_fields(seqs,draft->name,NULL,end-start);
+
+  for (k=job->window_first[w];k<job->window_first[w+1];k++) {
+    hit=job->hit+job->window_hit[k];
+    qs=polish_hit_read_position(hit,start);
+    qe=polish_hit_read_position(hit,end);
+    if (qe<=qs) /* NOTHING OF THIS READ IS ALIGNED HERE */
+      continue;
+    s=seqs+(++nseg);
+    text=job->read_text[hit->iread]
+      +(hit->reverse ? hit->qlen-qe : qs); /* FORWARD-STRAND START */
+    CALLOC(s->sequence,qe-qs+1,char);
+    LOOPF (i,qe-qs)
+      switch (job->read_switch_case[hit->iread]) {
+      case switch_case_to_lower: s->sequence[i]=tolower(text[i]); break;
+      case switch_case_to_upper: s->sequence[i]=toupper(text[i]); break;
+      default: s->sequence[i]=text[i];
+      }
+    if (hit->reverse)
+      reverse_complement(s->sequence);
+    save_sequence_fields(s,job->read[hit->iread].name,NULL,qe-qs);
+  }
+
+  if (nseg==0) { /* NO READ SUPPORT: KEEP THE DRAFT */
+    consensus=seqs[0].sequence;
+    seqs[0].sequence=NULL;
+  }
+  else {
+    initialize_seqs_as_lpo(1,seqs,m);
+    buildup_lpo(seqs,nseg,seqs+1,m,job->use_aggressive_fusion,
+		job->use_global_alignment);
+    path=heaviest_bundle(seqs[0].length,seqs[0].letter,seqs[0].nsource_seq,
+			 seqs[0].source_seq,&path_length);
+    CALLOC(on_draft,seqs[0].length,char); /* RINGS HOLDING A DRAFT LETTER */
+    LOOPF (i,seqs[0].length)
+      for (src= &seqs[0].letter[i].source;src && src->iseq>=0;src=src->more)
+	if (src->iseq==0) {
+	  on_draft[seqs[0].letter[i].ring_id]=1;
+	  break;
+	}
+    for (first=0;first<path_length
+	   && !on_draft[seqs[0].letter[path[first]].ring_id];first++);
+    for (last=path_length-1;last>=first
+	   && !on_draft[seqs[0].letter[path[last]].ring_id];last--);
+    if (last>=first) {
+      CALLOC(consensus,last-first+2,char);
+      for (i=first;i<=last;i++)
+	consensus[i-first]=m->symbol[(int)seqs[0].letter[path[i]].letter];
+    }
+    else { /* NOTHING OF THE BUNDLE IS ON THE DRAFT: KEEP THE DRAFT */
+      CALLOC(consensus,end-start+1,char);
+      memcpy(consensus,draft->sequence+start,end-start);
+    }
+    FREE(on_draft);
+    FREE(path);
+  }
+  LOOPF (i,nseg+1)
+    free_lpo_sequence(seqs+i,FALSE);
+  FREE(seqs);
+  return consensus;
+}
+
+
+/** polishing thread: takes windows until none are left, aligning with
+    its own copy of the score matrix (see copy_score_matrix()) */
+static void *polish_window_worker(void *arg)
+{
+  int w;
+  PolishJob_T *job=arg;
+  ResidueScoreMatrix_T *m=copy_score_matrix(job->m);
+
+  while (1) {
+    pthread_mutex_lock(&job->lock);
+    w=job->next_window++;
+    pthread_mutex_unlock(&job->lock);
+    if (w>=job->nwindow)
+      break;
+    job->consensus[w]=polish_window(job,w,m);
+  }
+
+  free_score_matrix_copy(m);
+  return NULL;
+}
+
+
+/** residues of read, without copying them if its FASTA view holds them
+    on a single line; *p_switch_case gets the case switch still due */
+static const char *polish_read_text(Sequence_T *read,int *p_switch_case)
+{
+  int i;
+
+  *p_switch_case=dont_switch_case;
+  if (read->sequence || !read->view)
+    return read->sequence;
+  for (i=0;i<read->length && i<read->view_length && !isspace(read->view[i]);i++);
+  if (i==read->length && !read->view_reverse_complement
+      && read->view[0]!='#' && read->view[0]!='*') {
+    *p_switch_case=read->view_switch_case;
+    return read->view;
+  }
+  return load_fasta_view(read); /* BEFORE THE THREADS START */
+}
+
+
+/** polishes each contig of polish->draft_filename with the reads in
+    read[] that polish->map_filename maps to it: every window of
+    polish->window_length draft residues is replaced by the heaviest
+    bundle of the draft window and its read segments, aligned with
+    buildup_lpo() on polish->nthread threads, and the polished contigs
+    are written to the FASTA file consensus_out.  Returns the number of
+    contigs, or -1 on error */
+int polish_lpo_windows(LPOPolish_T *polish,int nread,Sequence_T read[],
+		       ResidueScoreMatrix_T *m,int use_aggressive_fusion,
+		       int use_global_alignment,int do_switch_case,
+		       char consensus_out[])
+{
+  int i,j,w,c,nhit,ncontig=0,status,length,nthread,nsegment=0;
+  int *contig_window=NULL,*used=NULL;
+  PolishName_T *read_names=NULL,*contig_names=NULL;
+  PolishJob_T job;
+  pthread_t *thread=NULL;
+  char *polished,title[1024];
+  FILE *ifile,*ofile=NULL;
+
+  memset(&job,0,sizeof(job));
+  if (!(ifile=fopen(polish->draft_filename,"r"))
+      || (ncontig=read_fasta(ifile,&job.draft,do_switch_case,NULL))<=0) {
+    WARN_MSG(USERR,(ERRTXT,"Error reading draft file %s.\nExiting",
+		    polish->draft_filename),"$Revision: 1.2.2.9 $");
+    if (ifile)
+      fclose(ifile);
+    return -1;
+  }
+  fclose(ifile);
+  status=ncontig;
+  read_names=index_polish_names(nread,read);
+  contig_names=index_polish_names(ncontig,job.draft);
+  nhit=read_polish_hits(polish->map_filename,nread,read,read_names,
+			ncontig,job.draft,contig_names,&job.hit);
+  if (nhit<0) {
+    status= -1;
+    goto free_polish_data;
+  }
+
+  job.m=m;
+  job.use_aggressive_fusion=use_aggressive_fusion;
+  job.use_global_alignment=use_global_alignment;
+  job.read=read;
+  job.window_length=polish->window_length>0 ? polish->window_length : 500;
+
+  CALLOC(contig_window,ncontig+1,int); /* WINDOWS OF CONTIG c START HERE */
+  LOOPF (c,ncontig)
+    contig_window[c+1]=contig_window[c]
+      +(job.draft[c].length+job.window_length-1)/job.window_length;
+  job.nwindow=contig_window[ncontig];
+  CALLOC(job.window_contig,job.nwindow+1,int);
+  CALLOC(job.window_start,job.nwindow+1,int);
+  LOOPF (c,ncontig)
+    for (w=contig_window[c];w<contig_window[c+1];w++) {
+      job.window_contig[w]=c;
+      job.window_start[w]=(w-contig_window[c])*job.window_length;
+    }
+
+  CALLOC(job.window_first,job.nwindow+2,int); /* BUCKET HITS BY WINDOW */
+  LOOPF (i,nhit)
+    for (w=job.hit[i].tstart/job.window_length;
+	 w<=(job.hit[i].tend-1)/job.window_length;w++)
+      job.window_first[contig_window[job.hit[i].icontig]+w+2]++;
+  LOOPF (w,job.nwindow)
+    job.window_first[w+2]+=job.window_first[w+1];
+  nsegment=job.window_first[job.nwindow+1];
+  CALLOC(job.window_hit,nsegment+1,int);
+  LOOPF (i,nhit)
+    for (w=job.hit[i].tstart/job.window_length;
+	 w<=(job.hit[i].tend-1)/job.window_length;w++)
+      job.window_hit[job.window_first[contig_window[job.hit[i].icontig]+w+1]++]=i;
+
+  CALLOC(job.read_text,nread+1,const char *);
+  CALLOC(job.read_switch_case,nread+1,int);
+  CALLOC(used,nread+1,int);
+  LOOPF (i,nhit)
+    if (!used[job.hit[i].iread]++)
+      job.read_text[job.hit[i].iread]=
+	polish_read_text(read+job.hit[i].iread,job.read_switch_case+job.hit[i].iread);
+
+  CALLOC(job.consensus,job.nwindow+1,char *);
+  pthread_mutex_init(&job.lock,NULL);
+  nthread=polish->nthread>1 ? polish->nthread : 1;
+  CALLOC(thread,nthread,pthread_t);
+  for (i=1;i<nthread;i++) /* THIS THREAD IS WORKER 0 */
+    if (pthread_create(thread+i,NULL,polish_window_worker,&job)) {
+      WARN_MSG(TRAP,(ERRTXT,"Couldn't start polishing thread %d\n",i),"$Revision: 1.2.2.9 $");
+      nthread=i;
+    }
+  polish_window_worker(&job);
+  for (i=1;i<nthread;i++)
+    pthread_join(thread[i],NULL);
+  pthread_mutex_destroy(&job.lock);
+
+  ofile=(strcmp(consensus_out,"stdout")==0) ? stdout : fopen(consensus_out,"w");
+  if (!ofile) {
+    WARN_MSG(USERR,(ERRTXT,"*** Could not save FASTA file %s.  Exiting.",consensus_out),"$Revision: 1.2.2.9 $");
+    status= -1;
+    goto free_polish_data;
+  }
+  LOOPF (c,ncontig) { /* STITCH EACH CONTIG'S WINDOWS BACK TOGETHER */
+    length=0;
+    for (w=contig_window[c];w<contig_window[c+1];w++)
+      length+=strlen(job.consensus[w]);
+    CALLOC(polished,length+1,char);
+    length=0;
+    for (w=contig_window[c];w<contig_window[c+1];w++) {
+      j=strlen(job.consensus[w]);
+      memcpy(polished+length,job.consensus[w],j);
+      length+=j;
+    }
+    sprintf(title,"polished by heaviest_bundle in %d windows",
+	    contig_window[c+1]-contig_window[c]);
+    write_fasta(ofile,job.draft[c].name,title,polished);
+    FREE(polished);
+  }
+  if (ofile!=stdout)
+    fclose(ofile);
+
+ free_polish_data:
+  if (job.consensus)
+    LOOPF (w,job.nwindow)
+      FREE(job.consensus[w]);
+  LOOPF (i,nhit)
+    FREE(job.hit[i].cigar);
+  FREE(job.consensus);
+  FREE(thread);
+  FREE(used);
+  FREE(job.read_text);
+  FREE(job.read_switch_case);
+  FREE(job.window_hit);
+  FREE(job.window_first);
+  FREE(job.window_start);
+  FREE(job.window_contig);
+  FREE(contig_window);
+  FREE(job.hit);
+  FREE(read_names);
+  FREE(contig_names);
+  LOOPF (c,ncontig)
+    free_lpo_sequence(job.draft+c,FALSE);
+  FREE(job.draft);
+  return status;
+}
@@ -9,40 +9,43 @@
 
 
 
+/** removes from the link list every link to a deleted position
+ (old_to_new[ipos]<0) and remaps the rest to their new positions, in one
+ walk and without allocating: kept nodes are relinked, deleted ones freed
+ as they are passed, and the first kept link is moved into the list head
+ itself if the head's own link was deleted.  Returns 1 if the list is
+ non-empty afterwards, else 0 */
 int compact_links(LPOLetterLink_T *list,int old_to_new[])
 {
-  LPOLetterLink_T *link=NULL,*link_last=NULL,*next_link,*link_head=NULL;
-
-  CALLOC(link,1,LPOLetterLink_T);
-  memcpy(link,list,sizeof(LPOLetterLink_T));
-
-  for (;link && link->ipos>=0;link=next_link){
-    next_link=link->more;
-    if (old_to_new[link->ipos]<0) /* THIS POSITION NO LONGER EXISTS! */
-      free(link); /* DELETE THIS LINK ENTRY */
-    else { /* COPY THIS BACK TO PREVIOUS LINK ENTRY: COMPACT THE LIST*/
-      link->ipos = old_to_new[link->ipos]; /* REMAP TO NEW INDEX SYSTEM */
-      if (link_last) /* CONNECT TO PREVIOUS NODE IN LIST */
-	link_last->more=link;
-      else /* THIS IS THE NEW HEAD OF THE LIST */
-	link_head=link;
-      link_last=link;
+  LPOLetterLink_T *link,*next,*last=NULL;
+
+  for (link=list;link && link->ipos>=0;link=next) {
+    next=link->more;
+    if (old_to_new[link->ipos]<0) { /* THIS POSITION NO LONGER EXISTS! */
+      if (link!=list)
+	free(link); /* DELETE THIS LINK ENTRY */
+      continue;
+    }
+    link->ipos = old_to_new[link->ipos]; /* REMAP TO NEW INDEX SYSTEM */
+    if (last) /* CONNECT TO PREVIOUS NODE IN LIST */
+      last=last->more=link;
+    else { /* THIS IS THE NEW HEAD OF THE LIST */
+      if (link!=list) { /* MOVE IT INTO THE HEAD */
+	*list= *link;
+	free(link);
+      }
+      last=list;
     }
   }
-  if (link) /* AN EMPTY LINK I.E. link->ipos<0 ... JUNK IT */
-    free(link);
-  if (link_last) /* TERMINATE LAST NODE IN LIST */
-    link_last->more=NULL;
-  if (link_head) {
-    memcpy(list,link_head,sizeof(LPOLetterLink_T));
-    free(link_head);
+  if (link && link!=list) /* EMPTY LINK ENTRIES I.E. link->ipos<0 ... JUNK THEM */
+    free_lpo_link_list(link);
+  if (last) { /* TERMINATE LAST NODE IN LIST */
+    last->more=NULL;
     return 1; /* COMPACTED LINK LIST IS NON-EMPTY */
   }
-  else { /* NOTHING LEFT IN LIST, SO BLANK IT */
-    list->more=NULL;
-    list->ipos= INVALID_LETTER_POSITION;
-    return 0; /* COMPACTED LINK LIST IS EMPTY */
-  }
+  list->more=NULL; /* NOTHING LEFT IN LIST, SO BLANK IT */
+  list->ipos= INVALID_LETTER_POSITION;
+  return 0; /* COMPACTED LINK LIST IS EMPTY */
 }
 
 
@@ -51,38 +54,38 @@ int compact_links(LPOLetterLink_T *list,int old_to_new[])
 
 
 
+/** removes from the source list every source whose sequence belongs to
+ bundle ibundle_delete, in one walk like compact_links().  Returns 1 if
+ the list is non-empty afterwards, else 0 */
 int compact_sources(LPOLetterSource_T *list,int ibundle_delete,
 		    LPOSourceInfo_T source_seq[])
 {
-  LPOLetterSource_T *source=NULL,*source_last=NULL,*next_source,*source_head=NULL;
-
-  CALLOC(source,1,LPOLetterSource_T);
-  memcpy(source,list,sizeof(LPOLetterSource_T));
-
-  for (;source;source=next_source){
-    next_source=source->more;
-    if (source_seq[source->iseq].bundle_id == ibundle_delete)
-      free(source); /* DELETE THIS SOURCE ENTRY */
-    else { /* COPY THIS BACK TO PREVIOUS SOURCE ENTRY: COMPACT THE LIST*/
-      if (source_last) /* CONNECT TO PREVIOUS NODE IN LIST */
-	source_last->more=source;
-      else /* THIS IS THE NEW HEAD OF THE LIST */
-	source_head=source;
-      source_last=source;
+  LPOLetterSource_T *source,*next,*last=NULL;
+
+  for (source=list;source;source=next) {
+    next=source->more;
+    if (source_seq[source->iseq].bundle_id == ibundle_delete) {
+      if (source!=list)
+	free(source); /* DELETE THIS SOURCE ENTRY */
+      continue;
+    }
+    if (last) /* CONNECT TO PREVIOUS NODE IN LIST */
+      last=last->more=source;
+    else { /* THIS IS THE NEW HEAD OF THE LIST */
+      if (source!=list) { /* MOVE IT INTO THE HEAD */
+	*list= *source;
+	free(source);
+      }
+      last=list;
     }
   }
-  if (source_last) /* TERMINATE LAST NODE IN LIST */
-    source_last->more=NULL;
-  if (source_head) {
-    memcpy(list,source_head,sizeof(LPOLetterSource_T));
-    free(source_head);
+  if (last) { /* TERMINATE LAST NODE IN LIST */
+    last->more=NULL;
     return 1; /* COMPACTED SOURCE LIST IS NON-EMPTY */
   }
-  else { /* NOTHING LEFT IN LIST, SO BLANK IT */
-    list->more=NULL;
-    list->ipos= INVALID_LETTER_POSITION;
-    return 0; /* COMPACTED SOURCE LIST IS EMPTY */
-  }
+  list->more=NULL; /* NOTHING LEFT IN LIST, SO BLANK IT */
+  list->ipos= INVALID_LETTER_POSITION;
+  return 0; /* COMPACTED SOURCE LIST IS EMPTY */
 }
 
 
@@ -156,3 +159,92 @@ int remove_bundle(LPOSequence_T *seq,int ibundle,int delete_all_others)
 
 
 
+/** removes, in place, every letter of seq whose support (the summed
+    weight of the source sequences passing through it) is below
+    min_weight, unless it is on the path of a protected source sequence
+    (iseq>=protect_from).  Each source sequence that passed through a
+    removed letter is linked straight from its previous kept letter to
+    its next one, so its path stays connected.  Returns the number of
+    letters removed */
+int prune_lpo(LPOSequence_T *seq,int min_weight,int protect_from)
+{
+  int i,j,p,weight,nremove=0,npath=0,last,skipped,new_length;
+  int *old_to_new=NULL,*path_start=NULL,*path=NULL;
+  LPOLetterSource_T *source;
+
+  if (min_weight<=0 || seq->length<=0)
+    return 0;
+  CALLOC(old_to_new,seq->length,int); /* CREATE MAPPING ARRAY */
+  LOOPF (i,seq->length) {
+    for (weight=0,source= &seq->letter[i].source;source && weight<min_weight;
+	 source=source->more)
+      if (source->iseq>=protect_from) /* ON A PROTECTED PATH: KEEP */
+	weight=min_weight;
+      else
+	weight+=seq->source_seq[source->iseq].weight;
+    if (weight<min_weight) {
+      old_to_new[i]= INVALID_LETTER_POSITION;
+      nremove++;
+    }
+  }
+  if (nremove==0) { /* NOTHING TO DO */
+    FREE(old_to_new);
+    return 0;
+  }
+
+  /* LAY OUT THE LETTER PATH OF EVERY SOURCE SEQ TO BRIDGE THE REMOVALS */
+  CALLOC(path_start,seq->nsource_seq+1,int);
+  LOOPF (i,seq->nsource_seq) {
+    path_start[i]=npath;
+    npath+=seq->source_seq[i].length;
+  }
+  path_start[seq->nsource_seq]=npath;
+  CALLOC(path,npath+1,int);
+  LOOP (i,npath)
+    path[i]= INVALID_LETTER_POSITION;
+  LOOPF (i,seq->length)
+    for (source= &seq->letter[i].source;source;source=source->more)
+      if (source->ipos>=0 && source->ipos<seq->source_seq[source->iseq].length)
+	path[path_start[source->iseq]+source->ipos]=i;
+  LOOPF (i,seq->nsource_seq) {
+    for (last= -1,skipped=FALSE,p=path_start[i];p<path_start[i+1];p++) {
+      if ((j=path[p])<0) /* ALREADY REMOVED BY AN EARLIER PRUNING */
+	continue;
+      if (old_to_new[j]<0) /* REMOVED NOW */
+	skipped=TRUE;
+      else {
+	if (skipped && last>=0) { /* BRIDGE last --> j (OLD INDEXES) */
+	  add_lpo_link(&seq->letter[last].right,j);
+	  add_lpo_link(&seq->letter[j].left,last);
+	}
+	last=j;
+	skipped=FALSE;
+      }
+    }
+  }
+  FREE(path_start);
+  FREE(path);
+
+  j=0;
+  LOOPF (i,seq->length) { /* COMPACT THE KEPT LETTERS IN PLACE */
+    if (old_to_new[i]>=0) {
+      if (i>j) /* COPY LETTER TO COMPACTED POSITION */
+	memcpy(seq->letter+j,seq->letter+i,sizeof(LPOLetter_T));
+      old_to_new[i]=j++; /* SAVE MAPPING FROM OLD TO NEW, COMPACTED POSITION*/
+    }
+    else
+      free_lpo_letters(1,seq->letter+i,FALSE); /* DUMP DATA FOR THIS LETTER */
+  }
+  new_length=j;
+  memset(seq->letter+new_length,0,(seq->length - new_length)*sizeof(LPOLetter_T));
+
+  LOOP (i,new_length) { /* REMOVE ALL LINKS TO OLD, DELETED POSITIONS */
+    compact_links(&seq->letter[i].left,old_to_new);
+    compact_links(&seq->letter[i].right,old_to_new);
+  }
+  seq->length=new_length;
+  reindex_compact_rings(seq);
+
+  FREE(old_to_new);
+  return nremove;
+}
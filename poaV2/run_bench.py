@@ -0,0 +1,284 @@
+#!/usr/bin/env python3
+"""poa benchmark suite (make bench).
+
+Simulates a fixed set of datasets with simulate_clusters.py and measures:
+
+  * each stage of a buildup (FASTA reader, align_lpo_po, fuse_lpo,
+    heaviest_bundle, PO/PIR writers and readers), with bench_lpo;
+  * end-to-end poa runs, for wall time and peak RSS;
+  * consensus accuracy on shallow FASTQ clusters with known quality
+    profiles, with and without the base qualities, i.e. how far the
+    reads per cluster can be cut when the qualities weight the graph.
+
+The results go to one JSON file: per dataset, DP cell updates per second
+(GCUPS), the time of every stage, peak RSS and graph size.  Seeds are
+fixed, so two result files from different commits can be compared:
+
+    make bench                            # writes bench.json
+    ./run_bench.py --compare old.json bench.json
+"""
+
+import argparse
+import json
+import os
+import platform
+import subprocess
+import sys
+import tempfile
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+# name, simulate_clusters.py arguments, matrix, extra poa arguments;
+# --scale multiplies each dataset's depth and the -batch cluster count
+DATASETS = [
+    ("dna_1k_clean", "--length 1000 --depth 30 --sub 0.005 --ins 0.0025 --del 0.0025",
+     "builtin:dna", []),
+    ("dna_2k_noisy", "--length 2000 --depth 20 --sub 0.05 --ins 0.025 --del 0.025",
+     "builtin:dna", []),
+    ("dna_1k_diverged", "--length 1000 --depth 30 --sub 0.01 --ins 0.005 --del 0.005"
+     " --divergence 0.03 --haplotypes 3", "builtin:dna", []),
+    ("dna_1k_global", "--length 1000 --depth 30 --sub 0.02 --ins 0.01 --del 0.01",
+     "builtin:dna", ["-do_global"]),
+    ("protein_family", "--protein --length 300 --depth 40 --divergence 0.25",
+     "blosum80.mat", []),
+]
+
+# many small clusters, aligned end to end with -batch
+BATCH_DATASET = ("dna_batch_300x10", "--length 300 --depth 10 --sub 0.02 --ins 0.01"
+                 " --del 0.01 --clusters %d", "builtin:dna")
+
+# simulate_clusters.py --fastq profile and the reads per cluster to try;
+# each cluster's consensus is compared with its true ancestor, from the
+# FASTQ (qualities weighting links and -hb bundles) and from the same
+# reads as FASTA
+QUALITY_DATASETS = [("long", [3, 4, 6, 8]), ("mixed", [3, 4, 6, 8])]
+QUALITY_CLUSTERS = 20
+QUALITY_LENGTH = 300
+
+
+def simulate(path, args, seed, scale):
+    args = args.split()
+    if "--depth" in args:
+        i = args.index("--depth") + 1
+        args[i] = str(int(args[i]) * scale)
+    with open(path, "w") as f:
+        subprocess.run([sys.executable, os.path.join(HERE, "simulate_clusters.py"),
+                        "--seed", str(seed)] + args, stdout=f, check=True)
+
+
+def run_timed(command):
+    """Runs poa command with -stats, returning its wall time and peak RSS in
+    kB.  The peak is the VmHWM poa reports itself: a forked child's
+    ru_maxrss starts from this (much bigger) Python process's, so it is
+    only the fallback if poa reports none."""
+    command = command[:1] + ["-stats"] + command[1:]
+    start = time.perf_counter()
+    proc = subprocess.Popen(command, stdout=subprocess.DEVNULL,
+                            stderr=subprocess.PIPE, text=True)
+    report = proc.stderr.read()
+    _, status, usage = os.wait4(proc.pid, 0)
+    elapsed = time.perf_counter() - start
+    proc.stderr.close()
+    proc.returncode = os.waitstatus_to_exitcode(status)
+    if proc.returncode:
+        sys.stderr.write(report)
+        raise subprocess.CalledProcessError(proc.returncode, command)
+    peak_rss = usage.ru_maxrss
+    for line in report.splitlines():
+        if line.startswith("Peak RSS:"):
+            peak_rss = int(line.split()[2])
+    return elapsed, peak_rss
+
+
+def read_records(path):
+    """(name, sequence, qualities or None) of each FASTA or FASTQ record."""
+    records = []
+    with open(path) as f:
+        lines = f.read().split("\n")
+    if lines and lines[0].startswith("@"):  # one-line FASTQ records
+        for i in range(0, len(lines) - 3, 4):
+            records.append((lines[i][1:].split()[0], lines[i + 1], lines[i + 3]))
+        return records
+    for line in lines:
+        if line.startswith(">"):
+            records.append([line[1:].split()[0], "", None])
+        elif records:
+            records[-1][1] += line.strip()
+    return [tuple(r) for r in records]
+
+
+def edit_distance(a, b, band=50):
+    """Levenshtein distance of a and b, within a diagonal band."""
+    band = max(band, abs(len(a) - len(b)) + 1)
+    inf = len(a) + len(b)
+    prev = [j if j <= band else inf for j in range(len(b) + 1)]
+    for i in range(1, len(a) + 1):
+        cur = [inf] * (len(b) + 1)
+        if i <= band:
+            cur[0] = i
+        for j in range(max(1, i - band), min(len(b), i + band) + 1):
+            cur[j] = min(prev[j] + 1, cur[j - 1] + 1,
+                         prev[j - 1] + (a[i - 1] != b[j - 1]))
+        prev = cur
+    return prev[-1]
+
+
+def consensus_errors(truth, consensus):
+    """Total edits between each cluster's ancestor and its consensus;
+    a missing consensus counts as the whole ancestor."""
+    return sum(edit_distance(seq.upper(), consensus.get(name, "").upper())
+               for name, seq in truth.items())
+
+
+def run_quality(args, tmp):
+    """Consensus accuracy of shallow FASTQ clusters, with and without
+    their base qualities, by -batch -consensus_only (heaviest link path)
+    and by -hb on each cluster (heaviest_bundle())."""
+    results = []
+    for seed, (profile, depths) in enumerate(QUALITY_DATASETS, 100):
+        for depth in depths:
+            name = "quality_%s_depth%d" % (profile, depth)
+            fastq = os.path.join(tmp, name + ".fq")
+            truth_path = os.path.join(tmp, name + ".truth.fa")
+            with open(fastq, "w") as f:
+                subprocess.run([sys.executable, os.path.join(HERE, "simulate_clusters.py"),
+                                "--seed", str(seed), "--length", str(QUALITY_LENGTH),
+                                "--depth", str(depth), "--clusters", str(QUALITY_CLUSTERS),
+                                "--fastq", profile, "--truth", truth_path],
+                               stdout=f, check=True)
+            truth = {n: s for n, s, _ in read_records(truth_path)}
+            reads = read_records(fastq)
+            fasta = os.path.join(tmp, name + ".fa")
+            with open(fasta, "w") as f:
+                for n, s, _ in reads:
+                    f.write(">%s\n%s\n" % (n, s))
+            record = {"name": name, "profile": profile, "depth": depth,
+                      "clusters": QUALITY_CLUSTERS}
+            for kind, path in (("fasta", fasta), ("fastq", fastq)):
+                out = os.path.join(tmp, "consensus.fa")
+                record["end_to_end_s_" + kind] = run_timed(
+                    [args.poa, "-read_fasta", path, "-silent", "-batch",
+                     "-consensus_only", out, "builtin:dna"])[0]
+                record["consensus_errors_" + kind] = consensus_errors(
+                    truth, {n: s for n, s, _ in read_records(out)})
+                hb = {}
+                for cluster in truth:  # -hb needs one cluster per run
+                    one = os.path.join(tmp, "cluster" + os.path.splitext(path)[1])
+                    with open(one, "w") as f:
+                        for n, s, q in reads:
+                            if n.split("/")[0] == cluster:
+                                f.write("@%s\n%s\n+\n%s\n" % (n, s, q) if kind == "fastq"
+                                        else ">%s\n%s\n" % (n, s))
+                    pir = os.path.join(tmp, "cluster.pir")
+                    subprocess.run([args.poa, "-read_fasta", one, "-silent", "-hb",
+                                    "-pir", pir, "builtin:dna"], check=True)
+                    bundles = {n: s for n, s, _ in read_records(pir)}
+                    hb[cluster] = "".join(c for c in bundles.get("CONSENS0", "")
+                                          if c.isalpha())
+                record["hb_consensus_errors_" + kind] = consensus_errors(truth, hb)
+            results.append(record)
+            print("%-22s consensus edits: FASTA %5d  FASTQ %5d   -hb: FASTA %5d  FASTQ %5d"
+                  % (name, record["consensus_errors_fasta"], record["consensus_errors_fastq"],
+                     record["hb_consensus_errors_fasta"], record["hb_consensus_errors_fastq"]),
+                  file=sys.stderr)
+    return results
+
+
+def git_commit():
+    try:
+        return subprocess.run(["git", "rev-parse", "--short", "HEAD"], cwd=HERE,
+                              capture_output=True, text=True).stdout.strip() or None
+    except OSError:
+        return None
+
+
+def run_suite(args):
+    results = []
+    with tempfile.TemporaryDirectory() as tmp:
+        for seed, (name, sim_args, matrix, poa_args) in enumerate(DATASETS, 1):
+            fasta = os.path.join(tmp, name + ".fa")
+            simulate(fasta, sim_args, seed, args.scale)
+            matrix_path = matrix if matrix.startswith("builtin:") \
+                else os.path.join(HERE, matrix)
+            best = None
+            for _ in range(args.repeat):  # keep the fastest of --repeat runs
+                out = subprocess.run([args.harness, "-name", name] + poa_args
+                                     + [matrix_path, fasta],
+                                     capture_output=True, text=True, check=True).stdout
+                record = json.loads(out)
+                if best is None or record["align_s"] < best["align_s"]:
+                    best = record
+            e2e = min(run_timed([args.poa, "-read_fasta", fasta, "-silent", "-hb",
+                                 "-pir", os.devnull] + poa_args + [matrix_path])
+                      for _ in range(args.repeat))
+            best["end_to_end_s"], best["end_to_end_peak_rss_kb"] = e2e
+            results.append(best)
+            print("%-18s %8.3f GCUPS  align %7.3fs  fuse %7.3fs  e2e %7.3fs  "
+                  "%6d nodes  %7d kB" % (name, best["gcups"], best["align_s"],
+                                         best["fuse_s"], e2e[0], best["nodes"], e2e[1]),
+                  file=sys.stderr)
+
+        name, sim_args, matrix = BATCH_DATASET
+        fasta = os.path.join(tmp, name + ".fa")
+        simulate(fasta, sim_args % (200 * args.scale), len(DATASETS) + 1, 1)
+        e2e = min(run_timed([args.poa, "-read_fasta", fasta, "-silent", "-batch",
+                             "-consensus_only", os.devnull, matrix])
+                  for _ in range(args.repeat))
+        results.append({"name": name, "clusters": 200 * args.scale,
+                        "end_to_end_s": e2e[0], "end_to_end_peak_rss_kb": e2e[1]})
+        print("%-18s end to end %7.3fs  %7d kB" % (name, e2e[0], e2e[1]), file=sys.stderr)
+
+        results += run_quality(args, tmp)
+
+    return {"commit": git_commit(), "date": time.strftime("%Y-%m-%dT%H:%M:%S"),
+            "host": platform.node(), "machine": platform.machine(),
+            "scale": args.scale, "results": results}
+
+
+def compare(old_path, new_path):
+    """Prints new/old ratios of the main metrics of two result files."""
+    old = {r["name"]: r for r in json.load(open(old_path))["results"]}
+    new = {r["name"]: r for r in json.load(open(new_path))["results"]}
+    metrics = ["gcups", "align_s", "fuse_s", "heaviest_bundle_s", "end_to_end_s",
+               "end_to_end_peak_rss_kb", "nodes", "consensus_errors_fastq",
+               "hb_consensus_errors_fastq"]
+    print("%-18s %s" % ("new/old", " ".join("%12s" % m[:12] for m in metrics)))
+    for name in new:
+        if name not in old:
+            continue
+        cells = []
+        for m in metrics:
+            a, b = old[name].get(m), new[name].get(m)
+            cells.append("%12.3f" % (b / a) if a and b is not None else "%12s" % "-")
+        print("%-18s %s" % (name, " ".join(cells)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--poa", default=os.path.join(HERE, "poa"), help="poa binary")
+    parser.add_argument("--harness", default=os.path.join(HERE, "bench_lpo"),
+                        help="bench_lpo binary")
+    parser.add_argument("--out", default="bench.json", help="results file (default bench.json)")
+    parser.add_argument("--scale", type=int, default=1,
+                        help="multiply dataset depth and batch clusters (default 1)")
+    parser.add_argument("--repeat", type=int, default=3,
+                        help="runs per measurement, fastest kept (default 3)")
+    parser.add_argument("--compare", nargs=2, metavar=("OLD", "NEW"),
+                        help="compare two result files instead of running")
+    args = parser.parse_args()
+
+    if args.compare:
+        compare(*args.compare)
+        return 0
+    report = run_suite(args)
+    with open(args.out, "w") as f:
+        json.dump(report, f, indent=1)
+        f.write("\n")
+    print("wrote %s" % args.out, file=sys.stderr)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -2,6 +2,8 @@
 #include "default.h"
 #include "seq_util.h"
 
+#include <sys/resource.h>
+
 
 
 /** randomizes seq[] by shuffling, and places the result in randseq[];
@@ -37,21 +39,56 @@ void shuffle_seq(int len,
 void index_symbols(int nseq,char seq[],char out[],
 		   int nsymbs,char symbols[])
 {
-  int i,j,k;
-  LOOP (i,nseq) {
-    k=nsymbs-1; /* DEFAULT: UNMATCHABLE SYMBOL */
-    LOOP (j,nsymbs) {  /* FIND MATCHING SYMBOL */
-      if (symbols[j]==seq[i]) {  /* FOUND IT! */
-	k=j;
-	break;
-      }
-    }
-    out[i]=k; /* SAVE THE TRANSLATED CODE */
-  }
+  int i;
+  char symbol_index[256];
+
+  build_symbol_index(nsymbs,symbols,symbol_index);
+  LOOP (i,nseq) /* ONE TABLE LOOKUP PER LETTER */
+    out[i]=symbol_index[(unsigned char)seq[i]]; /* SAVE THE TRANSLATED CODE */
   return;
 }
 
 
+/** fills symbol_index[256] with the INDEX in symbols[] of every character,
+ so that index_symbols() needs only one lookup per letter.  The first
+ occurrence of a symbol wins; characters not in symbols[] map to the
+ unmatchable symbol nsymbs-1 */
+void build_symbol_index(int nsymbs,char symbols[],char symbol_index[256])
+{
+  int i;
+  LOOP (i,256) /* DEFAULT: UNMATCHABLE SYMBOL */
+    symbol_index[i]=nsymbs-1;
+  for (i=nsymbs-1;i>=0;i--) /* BACKWARDS, SO FIRST OCCURRENCE WINS */
+    symbol_index[(unsigned char)symbols[i]]=i;
+}
+
+
+/** fills symbol_index[256] with the code of every character under matrix
+ m: the same translation as limit_residues() followed by index_symbols(),
+ i.e. characters that are not matrix symbols get the code of symbol[0].
+ If m->fold_case, a letter whose other case is a symbol gets its code */
+void build_matrix_symbol_index(ResidueScoreMatrix_T *m,char symbol_index[256])
+{
+  int i,c;
+
+  LOOP (i,256) /* DEFAULT: NOT A MATRIX SYMBOL YET */
+    symbol_index[i]= -1;
+  for (i=m->nsymbol-1;i>=0;i--) /* BACKWARDS, SO FIRST OCCURRENCE WINS */
+    symbol_index[(unsigned char)m->symbol[i]]=i;
+  if (m->fold_case)
+    for (i=m->nsymbol-1;i>=0;i--) {
+      c=(unsigned char)m->symbol[i];
+      c= islower(c) ? toupper(c) : tolower(c);
+      if (symbol_index[c]<0 || m->symbol[(int)symbol_index[c]]!=c)
+	symbol_index[c]=i; /* OTHER CASE IS NOT A SYMBOL OF ITS OWN */
+    }
+  symbol_index[0]= -1; /* NUL IS NEVER A RESIDUE */
+  LOOP (i,256)
+    if (symbol_index[i]<0)
+      symbol_index[i]=symbol_index[(unsigned char)m->symbol[0]];
+}
+
+
 
 
 
@@ -78,19 +115,186 @@ char DNA_symbols[1024];
 float DNA_rescale_score;
 #endif
 
-/** reads an alignment scoring matrix in the pam format */
-int read_score_matrix(char filename[],ResidueScoreMatrix_T *m)
+/** sets the gap penalties used when a matrix does not specify them */
+static void set_gap_penalty_defaults(ResidueScoreMatrix_T *m)
 {
-  int i,j,k,nsymb=0,found_symbol_line=0,isymb;
-  char line[1024],dna_codes[256];
-  FILE *ifile;
-
    /* GAP PENALTY DEFAULTS */
   m->gap_penalty_set[0][0]=m->gap_penalty_set[1][0]=12; /*SAVE PENALTIES*/
   m->gap_penalty_set[0][1]=m->gap_penalty_set[1][1]=2;
   m->gap_penalty_set[0][2]=m->gap_penalty_set[1][2]=0;
   m->trunc_gap_length = TRUNCATE_GAP_LENGTH;
   m->decay_gap_length = DECAY_GAP_LENGTH;
+  m->drop_score = 0; /* NO EARLY TERMINATION OF LOCAL ALIGNMENT */
+  m->use_zdrop = 0;
+  m->anchor_kmer_length = 0; /* FULL DP FOR EVERY ALIGNMENT */
+  m->region_start = m->region_end = 0; /* ALL OF x */
+  m->region_hint_start = m->region_hint_end = 0;
+  m->fold_case = 0; /* CASE MATTERS, AS IN blosum80.mat */
+}
+
+
+
+/** builds the gap penalty arrays and best_match[] tables of a matrix
+ whose symbols and scores have been filled in; returns nsymb */
+static int finish_score_matrix(ResidueScoreMatrix_T *m,int nsymb)
+{
+  int i,j;
+
+  /* CONSTRUCT GAP PENALTY ARRAYS FROM GAP PARAMETERS: */
+  m->max_gap_length = m->trunc_gap_length + m->decay_gap_length;
+  CALLOC (m->gap_penalty_x, m->max_gap_length+2, LPOScore_T);
+  CALLOC (m->gap_penalty_y, m->max_gap_length+2, LPOScore_T);
+
+  /*** GAP OPENING PENALTY @ L=0->1 */
+  m->gap_penalty_x[0] = m->gap_penalty_set[0][0];
+  m->gap_penalty_y[0] = m->gap_penalty_set[1][0];
+  
+  /*** 1st AFFINE EXTENSION PENALTY (A1) @ L=1->2,2->3,...T-1->T */
+  for (i=1;i<m->trunc_gap_length;i++) {
+    m->gap_penalty_x[i] = m->gap_penalty_set[0][1];
+    m->gap_penalty_y[i] = m->gap_penalty_set[1][1];
+  }
+  
+  /*** DECAYING EXTENSION PENALTY (A1-->A2; skipped if D=0) @ L=T->T+1,...T+D-1->T+D */
+  for (i=0;i<m->decay_gap_length;i++) {
+    double dec_x = (m->gap_penalty_set[0][1] - m->gap_penalty_set[0][2]) / ((double)(m->decay_gap_length + 1));
+    double dec_y = (m->gap_penalty_set[1][1] - m->gap_penalty_set[1][2]) / ((double)(m->decay_gap_length + 1));
+    m->gap_penalty_x[i+m->trunc_gap_length] = m->gap_penalty_set[0][1] - (i+1) * dec_x;
+    m->gap_penalty_y[i+m->trunc_gap_length] = m->gap_penalty_set[1][1] - (i+1) * dec_y;
+  }
+  
+  /*** 2nd AFFINE EXTENSION PENALTY (A2) @ L>=T+D */
+  m->gap_penalty_x[m->max_gap_length] = m->gap_penalty_set[0][2];
+  m->gap_penalty_y[m->max_gap_length] = m->gap_penalty_set[1][2];
+  
+  m->gap_penalty_x[m->max_gap_length+1] = 0;  /* DON'T REMOVE THIS!... SPECIAL STATE USED IN align_lpo. */
+  m->gap_penalty_y[m->max_gap_length+1] = 0;  /* DON'T REMOVE THIS!... SPECIAL STATE USED IN align_lpo. */
+  
+  
+  LOOPF (i,nsymb) {
+    Score_matrix_row= m->score[i]; /* ROW TO USE FOR SORTING best_match */
+    LOOP (j,nsymb)
+      m->best_match[i][j] = j;
+    qsort(m->best_match[i],nsymb,sizeof(m->best_match[0][0]),
+	  best_match_qsort_cmp);
+#ifdef SOURCE_EXCLUDED
+    printf("%c SORT",m->symbol[i]); /* TEST: PRINT OUT SORTED TABLE */
+    LOOPF (j,nsymb)
+      printf("\t%c:%d",m->symbol[m->best_match[i][j]],
+	     m->score[i][m->best_match[i][j]]);
+    printf("\n");
+#endif
+  }
+
+  m->symbol[nsymb]='\0'; /* TERMINATE THE SYMBOL STRING */
+  m->nsymbol=nsymb;
+  return nsymb;
+}
+
+
+
+/** BUILT-IN COPY OF blosum80.mat (GAP-PENALTIES=12 6 6); ITS 31 SYMBOLS
+ GET CODES 0..30, ALREADY A 5-BIT ENCODING */
+static const char Builtin_blosum80_symbols[]="ARNDCQEGHILKMFPSTWYVBZX?agtcu]n";
+static const signed char Builtin_blosum80_score[31][31]={
+  /* A */ {  7, -3, -3, -3, -1, -2, -2,  0, -3, -3, -3, -1, -2, -4, -1,  2,  0, -5, -4, -1, -3, -2, -1, -9, -9, -9, -9, -9, -9, -9, -9},
+  /* R */ { -3,  9, -1, -3, -6,  1, -1, -4,  0, -5, -4,  3, -3, -5, -3, -2, -2, -5, -4, -4, -2,  0, -2, -9, -9, -9, -9, -9, -9, -9, -9},
+  /* N */ { -3, -1,  9,  2, -5,  0, -1, -1,  1, -6, -6,  0, -4, -6, -4,  1,  0, -7, -4, -5,  5, -1, -2, -9, -9, -9, -9, -9, -9, -9, -9},
+  /* D */ { -3, -3,  2, 10, -7, -1,  2, -3, -2, -7, -7, -2, -6, -6, -3, -1, -2, -8, -6, -6,  6,  1, -3, -9, -9, -9, -9, -9, -9, -9, -9},
+  /* C */ { -1, -6, -5, -7, 13, -5, -7, -6, -7, -2, -3, -6, -3, -4, -6, -2, -2, -5, -5, -2, -6, -7, -4, -9, -9, -9, -9, -9, -9, -9, -9},
+  /* Q */ { -2,  1,  0, -1, -5,  9,  3, -4,  1, -5, -4,  2, -1, -5, -3, -1, -1, -4, -3, -4, -1,  5, -2, -9, -9, -9, -9, -9, -9, -9, -9},
+  /* E */ { -2, -1, -1,  2, -7,  3,  8, -4,  0, -6, -6,  1, -4, -6, -2, -1, -2, -6, -5, -4,  1,  6, -2, -9, -9, -9, -9, -9, -9, -9, -9},
+  /* G */ {  0, -4, -1, -3, -6, -4, -4,  9, -4, -7, -7, -3, -5, -6, -5, -1, -3, -6, -6, -6, -2, -4, -3, -9, -9, -9, -9, -9, -9, -9, -9},
+  /* H */ { -3,  0,  1, -2, -7,  1,  0, -4, 12, -6, -5, -1, -4, -2, -4, -2, -3, -4,  3, -5, -1,  0, -2, -9, -9, -9, -9, -9, -9, -9, -9},
+  /* I */ { -3, -5, -6, -7, -2, -5, -6, -7, -6,  7,  2, -5,  2, -1, -5, -4, -2, -5, -3,  4, -6, -6, -2, -9, -9, -9, -9, -9, -9, -9, -9},
+  /* L */ { -3, -4, -6, -7, -3, -4, -6, -7, -5,  2,  6, -4,  3,  0, -5, -4, -3, -4, -2,  1, -7, -5, -2, -9, -9, -9, -9, -9, -9, -9, -9},
+  /* K */ { -1,  3,  0, -2, -6,  2,  1, -3, -1, -5, -4,  8, -3, -5, -2, -1, -1, -6, -4, -4, -1,  1, -2, -9, -9, -9, -9, -9, -9, -9, -9},
+  /* M */ { -2, -3, -4, -6, -3, -1, -4, -5, -4,  2,  3, -3,  9,  0, -4, -3, -1, -3, -3,  1, -5, -3, -2, -9, -9, -9, -9, -9, -9, -9, -9},
+  /* F */ { -4, -5, -6, -6, -4, -5, -6, -6, -2, -1,  0, -5,  0, 10, -6, -4, -4,  0,  4, -2, -6, -6, -3, -9, -9, -9, -9, -9, -9, -9, -9},
+  /* P */ { -1, -3, -4, -3, -6, -3, -2, -5, -4, -5, -5, -2, -4, -6, 12, -2, -3, -7, -6, -4, -4, -2, -3, -9, -9, -9, -9, -9, -9, -9, -9},
+  /* S */ {  2, -2,  1, -1, -2, -1, -1, -1, -2, -4, -4, -1, -3, -4, -2,  7,  2, -6, -3, -3,  0, -1, -1, -9, -9, -9, -9, -9, -9, -9, -9},
+  /* T */ {  0, -2,  0, -2, -2, -1, -2, -3, -3, -2, -3, -1, -1, -4, -3,  2,  8, -5, -3,  0, -1, -2, -1, -9, -9, -9, -9, -9, -9, -9, -9},
+  /* W */ { -5, -5, -7, -8, -5, -4, -6, -6, -4, -5, -4, -6, -3,  0, -7, -6, -5, 16,  3, -5, -8, -5, -5, -9, -9, -9, -9, -9, -9, -9, -9},
+  /* Y */ { -4, -4, -4, -6, -5, -3, -5, -6,  3, -3, -2, -4, -3,  4, -6, -3, -3,  3, 11, -3, -5, -4, -3, -9, -9, -9, -9, -9, -9, -9, -9},
+  /* V */ { -1, -4, -5, -6, -2, -4, -4, -6, -5,  4,  1, -4,  1, -2, -4, -3,  0, -5, -3,  7, -6, -4, -2, -9, -9, -9, -9, -9, -9, -9, -9},
+  /* B */ { -3, -2,  5,  6, -6, -1,  1, -2, -1, -6, -7, -1, -5, -6, -4,  0, -1, -8, -5, -6,  6,  0, -3, -9, -9, -9, -9, -9, -9, -9, -9},
+  /* Z */ { -2,  0, -1,  1, -7,  5,  6, -4,  0, -6, -5,  1, -3, -6, -2, -1, -2, -5, -4, -4,  0,  6, -1, -9, -9, -9, -9, -9, -9, -9, -9},
+  /* X */ { -1, -2, -2, -3, -4, -2, -2, -3, -2, -2, -2, -2, -2, -3, -3, -1, -1, -5, -3, -2, -3, -1, -2, -9, -9, -9, -9, -9, -9, -9, -9},
+  /* ? */ { -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9},
+  /* a */ { -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9,  4, -2, -2, -2, -2, -9,  0},
+  /* g */ { -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -2,  4, -2, -2, -2, -9,  0},
+  /* t */ { -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -2, -2,  4, -2,  4, -9,  0},
+  /* c */ { -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -2, -2, -2,  4, -2, -9,  0},
+  /* u */ { -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -2, -2,  4, -2,  4, -9,  0},
+  /* ] */ { -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9},
+  /* n */ { -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9,  0,  0,  0,  0,  0, -9,  0}
+};
+
+/** BUILT-IN NUCLEOTIDE MATRIX: ACGT COME FIRST, SO THEIR CODES 0..3 ARE
+ A 2-BIT PACKED ENCODING; LOWER CASE LETTERS GET THE SAME CODES (fold_case) */
+static const char Builtin_dna_symbols[]="ACGTUN";
+static const signed char Builtin_dna_score[6][6]={
+  /* A */ { 4,-2,-2,-2,-2, 0},
+  /* C */ {-2, 4,-2,-2,-2, 0},
+  /* G */ {-2,-2, 4,-2,-2, 0},
+  /* T */ {-2,-2,-2, 4, 4, 0},
+  /* U */ {-2,-2,-2, 4, 4, 0},
+  /* N */ { 0, 0, 0, 0, 0, 0}
+};
+
+/**@memo example: use a compiled-in matrix instead of a matrix file:
+    read_score_matrix("builtin:dna",&score_matrix);
+*/
+/** loads one of the compiled-in scoring matrices ("dna" or "blosum80")
+ into m, without touching the filesystem; returns nsymb, or -2 if
+ name is not a built-in matrix */
+int read_builtin_score_matrix(char name[],ResidueScoreMatrix_T *m)
+{
+  int i,j,nsymb;
+
+  set_gap_penalty_defaults(m);
+  m->gap_penalty_set[0][0]=m->gap_penalty_set[1][0]=12; /*SAME AS blosum80.mat*/
+  m->gap_penalty_set[0][1]=m->gap_penalty_set[1][1]=6;
+  m->gap_penalty_set[0][2]=m->gap_penalty_set[1][2]=6;
+
+  if (0==strcmp(name,"dna")) {
+    nsymb=strlen(Builtin_dna_symbols);
+    LOOP (i,nsymb) {
+      m->symbol[i]=Builtin_dna_symbols[i];
+      LOOP (j,nsymb)
+	m->score[i][j]=Builtin_dna_score[i][j];
+    }
+    m->fold_case=1; /* SO MIXED-CASE READS STILL USE ONLY FOUR CODES */
+  }
+  else if (0==strcmp(name,"blosum80")) {
+    nsymb=strlen(Builtin_blosum80_symbols);
+    LOOP (i,nsymb) {
+      m->symbol[i]=Builtin_blosum80_symbols[i];
+      LOOP (j,nsymb)
+	m->score[i][j]=Builtin_blosum80_score[i][j];
+    }
+  }
+  else {
+    WARN_MSG(USERR,(ERRTXT,"Unknown built-in matrix %s (use dna or blosum80)\n",name),"$Revision: 1.2.2.2 $");
+    return -2;
+  }
+  return finish_score_matrix(m,nsymb);
+}
+
+
+
+/** reads an alignment scoring matrix in the pam format; a filename of
+ the form builtin:NAME selects a compiled-in matrix instead */
+int read_score_matrix(char filename[],ResidueScoreMatrix_T *m)
+{
+  int i,j,k,nsymb=0,found_symbol_line=0,isymb;
+  char line[1024],dna_codes[256];
+  FILE *ifile;
+
+  if (0==strncmp(filename,BUILTIN_MATRIX_PREFIX,strlen(BUILTIN_MATRIX_PREFIX)))
+    return read_builtin_score_matrix(filename+strlen(BUILTIN_MATRIX_PREFIX),m);
+
+  set_gap_penalty_defaults(m);
   
   ifile=fopen(filename,"r");
   if (!ifile) {
@@ -116,6 +320,16 @@ int read_score_matrix(char filename[],ResidueScoreMatrix_T *m)
       m->gap_penalty_set[0][2]=m->gap_penalty_set[1][2]=k;
     }
 
+    else if (1==sscanf(line,"X-DROP=%d",&i)) {
+      m->drop_score = i;
+      m->use_zdrop = 0;
+    }
+
+    else if (1==sscanf(line,"Z-DROP=%d",&i)) {
+      m->drop_score = i;
+      m->use_zdrop = 1;
+    }
+
     else if (3==sscanf(line,"GAP-PENALTIES-X=%d %d %d",&i,&j,&k)) {
       m->gap_penalty_set[1][0]=i; /*SAVE PENALTIES ONLY FOR X DIRECTION*/
       m->gap_penalty_set[1][1]=j;
@@ -165,55 +379,34 @@ int read_score_matrix(char filename[],ResidueScoreMatrix_T *m)
   }
   fclose(ifile);
 
-  /* CONSTRUCT GAP PENALTY ARRAYS FROM GAP PARAMETERS: */
-  m->max_gap_length = m->trunc_gap_length + m->decay_gap_length;
-  CALLOC (m->gap_penalty_x, m->max_gap_length+2, LPOScore_T);
-  CALLOC (m->gap_penalty_y, m->max_gap_length+2, LPOScore_T);
+  return finish_score_matrix(m,nsymb);
+}
 
-  /*** GAP OPENING PENALTY @ L=0->1 */
-  m->gap_penalty_x[0] = m->gap_penalty_set[0][0];
-  m->gap_penalty_y[0] = m->gap_penalty_set[1][0];
-  
-  /*** 1st AFFINE EXTENSION PENALTY (A1) @ L=1->2,2->3,...T-1->T */
-  for (i=1;i<m->trunc_gap_length;i++) {
-    m->gap_penalty_x[i] = m->gap_penalty_set[0][1];
-    m->gap_penalty_y[i] = m->gap_penalty_set[1][1];
-  }
-  
-  /*** DECAYING EXTENSION PENALTY (A1-->A2; skipped if D=0) @ L=T->T+1,...T+D-1->T+D */
-  for (i=0;i<m->decay_gap_length;i++) {
-    double dec_x = (m->gap_penalty_set[0][1] - m->gap_penalty_set[0][2]) / ((double)(m->decay_gap_length + 1));
-    double dec_y = (m->gap_penalty_set[1][1] - m->gap_penalty_set[1][2]) / ((double)(m->decay_gap_length + 1));
-    m->gap_penalty_x[i+m->trunc_gap_length] = m->gap_penalty_set[0][1] - (i+1) * dec_x;
-    m->gap_penalty_y[i+m->trunc_gap_length] = m->gap_penalty_set[1][1] - (i+1) * dec_y;
-  }
-  
-  /*** 2nd AFFINE EXTENSION PENALTY (A2) @ L>=T+D */
-  m->gap_penalty_x[m->max_gap_length] = m->gap_penalty_set[0][2];
-  m->gap_penalty_y[m->max_gap_length] = m->gap_penalty_set[1][2];
-  
-  m->gap_penalty_x[m->max_gap_length+1] = 0;  /* DON'T REMOVE THIS!... SPECIAL STATE USED IN align_lpo. */
-  m->gap_penalty_y[m->max_gap_length+1] = 0;  /* DON'T REMOVE THIS!... SPECIAL STATE USED IN align_lpo. */
-  
-  
-  LOOPF (i,nsymb) {
-    Score_matrix_row= m->score[i]; /* ROW TO USE FOR SORTING best_match */
-    LOOP (j,nsymb)
-      m->best_match[i][j] = j;
-    qsort(m->best_match[i],nsymb,sizeof(m->best_match[0][0]),
-	  best_match_qsort_cmp);
-#ifdef SOURCE_EXCLUDED
-    printf("%c SORT",m->symbol[i]); /* TEST: PRINT OUT SORTED TABLE */
-    LOOPF (j,nsymb)
-      printf("\t%c:%d",m->symbol[m->best_match[i][j]],
-	     m->score[i][m->best_match[i][j]]);
-    printf("\n");
-#endif
-  }
 
-  m->symbol[nsymb]='\0'; /* TERMINATE THE SYMBOL STRING */
-  m->nsymbol=nsymb;
-  return nsymb;
+
+/** returns a newly allocated copy of m with its own gap penalty arrays,
+ for a thread that aligns at the same time as others (align_lpo_po()
+ writes the initial gap state into those arrays); release it with
+ free_score_matrix_copy() */
+ResidueScoreMatrix_T *copy_score_matrix(ResidueScoreMatrix_T *m)
+{
+  ResidueScoreMatrix_T *copy=NULL;
+
+  CALLOC(copy,1,ResidueScoreMatrix_T);
+  *copy= *m;
+  CALLOC(copy->gap_penalty_x,m->max_gap_length+2,ResidueScore_T);
+  CALLOC(copy->gap_penalty_y,m->max_gap_length+2,ResidueScore_T);
+  memcpy(copy->gap_penalty_x,m->gap_penalty_x,(m->max_gap_length+2)*sizeof(ResidueScore_T));
+  memcpy(copy->gap_penalty_y,m->gap_penalty_y,(m->max_gap_length+2)*sizeof(ResidueScore_T));
+  return copy;
+}
+
+
+void free_score_matrix_copy(ResidueScoreMatrix_T *m)
+{
+  FREE(m->gap_penalty_x);
+  FREE(m->gap_penalty_y);
+  free(m);
 }
 
 
@@ -278,7 +471,9 @@ char complementary_base(char base)
   }
 }
 
-/** REVERSE COMPLEMENTS seq[] IN PLACE, AND RETURNS POINTER TO seq  
+/** REVERSE COMPLEMENTS seq[] IN PLACE, AND RETURNS POINTER TO seq.
+ EACH BASE KEEPS ITS CASE, SO THE RESULT STILL MATCHES THE SAME MATRIX
+ SYMBOLS AS THE INPUT
 ---------------------------------------------------------------
 -----------------------------------------------------------
 */
@@ -288,9 +483,39 @@ char *reverse_complement(char seq[])
   char c;
   for ((i=0),(j=strlen(seq)-1);i<=j;i++,j--) {/* SWAP FROM ENDS TO CENTER*/
     c=complementary_base(seq[i]); /* SWAP ENDS AND COMPLEMENT */
+    if (isupper(seq[i]))
+      c=toupper(c);
     seq[i]=complementary_base(seq[j]);
+    if (isupper(seq[j]))
+      seq[i]=toupper(seq[i]);
     seq[j]=c;
   }
   return seq;
 }
 
+
+
+/** peak resident set size of this process in kB: VmHWM from
+ /proc/self/status, which exec() resets, so a process started from a big
+ parent reports only its own peak.  Falls back to getrusage()'s
+ ru_maxrss (which a fork()+exec() child inherits from its parent) where
+ /proc is missing */
+long get_peak_rss_kb(void)
+{
+  long kb= -1;
+  char line[256];
+  struct rusage usage;
+  FILE *ifile;
+
+  if ((ifile=fopen("/proc/self/status","r"))) {
+    while (fgets(line,sizeof(line),ifile))
+      if (1==sscanf(line,"VmHWM: %ld",&kb))
+	break;
+    fclose(ifile);
+  }
+  if (kb<0) {
+    getrusage(RUSAGE_SELF,&usage);
+    kb=usage.ru_maxrss;
+  }
+  return kb;
+}
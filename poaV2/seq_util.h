@@ -30,6 +30,9 @@ enum {
 
 
 #define MATRIX_SYMBOL_MAX 128
+
+/** MATRIX FILENAME PREFIX SELECTING A COMPILED-IN MATRIX, e.g. builtin:dna */
+#define BUILTIN_MATRIX_PREFIX "builtin:"
 typedef struct {
   int nsymbol;
   char symbol[MATRIX_SYMBOL_MAX];
@@ -42,6 +45,13 @@ typedef struct {
   
   ResidueScore_T *gap_penalty_x, *gap_penalty_y;
   int max_gap_length;
+
+  ResidueScore_T drop_score; /* LOCAL ALIGNMENT X-DROP CUTOFF; 0 = OFF */
+  int use_zdrop; /* IF SET, CUTOFF GROWS WITH DISTANCE FROM BEST DIAGONAL */
+  int anchor_kmer_length; /* k FOR ANCHORING SINGLE SEQUENCES; 0 = OFF */
+  int region_start, region_end; /* ALIGN ONLY TO THESE POSITIONS OF x'S FIRST SEQ; 0,0 = OFF */
+  int region_hint_start, region_hint_end; /* LETTERS WHERE find_lpo_region() LAST FOUND IT */
+  int fold_case; /* IF SET, a AND A GET THE SAME CODE (builtin:dna) */
   
   int nfreq; /* STORE FREQUENCIES OF AMINO ACIDS FOR BALANCING MATRIX...*/
   char freq_symbol[MATRIX_SYMBOL_MAX];
@@ -56,22 +66,48 @@ void shuffle_seq(int len,
 void index_symbols(int nseq,char seq[],char out[],
 		   int nsymbs,char symbols[]);
 
+void build_symbol_index(int nsymbs,char symbols[],char symbol_index[256]);
+
+void build_matrix_symbol_index(ResidueScoreMatrix_T *m,char symbol_index[256]);
+
 int read_score_matrix(char filename[],ResidueScoreMatrix_T *m);
 
+int read_builtin_score_matrix(char name[],ResidueScoreMatrix_T *m);
+
+ResidueScoreMatrix_T *copy_score_matrix(ResidueScoreMatrix_T *m);
+
+void free_score_matrix_copy(ResidueScoreMatrix_T *m);
+
 void print_score_matrix(FILE *ifile,ResidueScoreMatrix_T *m,char subset[]);
 
 int limit_residues(char seq[],char symbol[]);
 
 int create_seq(int nseq,Sequence_T **seq,char seq_name[],char seq_title[],char tmp_seq[],int do_switch_case);
 
+void save_sequence_fields(Sequence_T *seq,
+			  char seq_name[],char seq_title[],int length);
+
+char complementary_base(char base);
+
 char *reverse_complement(char seq[]);
 
+long get_peak_rss_kb(void);
+
 
 
 /******************************************************* fasta_format.c */
 int read_fasta(FILE *seq_file,Sequence_T **seq,
 	       int do_switch_case,char **comment);
 
+char *map_fasta_file(char filename[],size_t *p_size);
+
+void unmap_fasta_file(char *text,size_t size);
+
+int read_fasta_view(const char text[],size_t size,Sequence_T **seq,
+		    int do_switch_case,char **comment);
+
+char *load_fasta_view(Sequence_T *seq);
+
 void write_fasta(FILE *ifile,char name[],char title[],char seq[]);
 
 #endif
@@ -0,0 +1,115 @@
+#!/usr/bin/env python3
+"""Load test for poa -serve.
+
+Opens CLIENTS connections to a running server and sends REQUESTS requests
+on each, every one carrying the same FASTA file, then reports throughput
+and latency percentiles.  With --compare POA MATRIX, the same number of
+jobs is also run by starting a fresh poa process per job, which shows the
+per-job setup cost the server saves.
+
+    poa -serve /tmp/poa.sock -threads 4 blosum80.mat &
+    ./serve_load.py /tmp/poa.sock multidom.seq -c 4 -n 50 \\
+        --compare ./poa blosum80.mat
+    ./poa_client /tmp/poa.sock QUIT
+"""
+
+import argparse
+import socket
+import subprocess
+import sys
+import threading
+import time
+
+
+def recv_exactly(f, n):
+    data = f.read(n)
+    if len(data) != n:
+        raise IOError("connection closed mid-reply")
+    return data
+
+
+def run_client(path, payload, options, nrequest, latencies, errors):
+    """Sends nrequest requests over one connection, recording latencies."""
+    sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    sock.connect(path)
+    f = sock.makefile("rb")
+    header = ("POA %d %s\n" % (len(payload), " ".join(options))).encode()
+    for _ in range(nrequest):
+        start = time.perf_counter()
+        sock.sendall(header + payload)
+        status, size = f.readline().split()
+        body = recv_exactly(f, int(size))
+        latencies.append(time.perf_counter() - start)
+        if status != b"OK":
+            errors.append(body.decode(errors="replace"))
+    f.close()
+    sock.close()
+
+
+def percentile(values, p):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(p / 100.0 * len(values)))]
+
+
+def report(label, latencies, elapsed):
+    print("%-8s %6d jobs  %8.1f jobs/s  latency ms: p50 %.3f  p90 %.3f  p99 %.3f"
+          % (label, len(latencies), len(latencies) / elapsed,
+             1e3 * percentile(latencies, 50), 1e3 * percentile(latencies, 90),
+             1e3 * percentile(latencies, 99)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("socket", help="socket of a running poa -serve")
+    parser.add_argument("fasta", help="FASTA file sent with every request")
+    parser.add_argument("-c", "--clients", type=int, default=1,
+                        help="concurrent connections (default 1)")
+    parser.add_argument("-n", "--requests", type=int, default=100,
+                        help="requests per connection (default 100)")
+    parser.add_argument("-o", "--options", default="-consensus_only",
+                        help="request options, e.g. -o=-pir or -o \"-pir -hb\" (default -consensus_only)")
+    parser.add_argument("--compare", nargs=2, metavar=("POA", "MATRIX"),
+                        help="also run each job as its own poa process")
+    args = parser.parse_args()
+
+    payload = open(args.fasta, "rb").read()
+    options = args.options.split()
+    latencies, errors = [], []
+    threads = [threading.Thread(target=run_client,
+                                args=(args.socket, payload, options, args.requests,
+                                      latencies, errors))
+               for _ in range(args.clients)]
+    start = time.perf_counter()
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    report("server", latencies, time.perf_counter() - start)
+    if errors:
+        print("%d requests failed, e.g.: %s" % (len(errors), errors[0].strip()))
+
+    if args.compare:
+        poa, matrix = args.compare
+        output = {"-pir": "stdout", "-clustal": "stdout", "-po": "/dev/null",
+                  "-consensus_only": "stdout"}
+        command = [poa, "-read_fasta", args.fasta, "-silent"]
+        for opt in options:  # output flags need a file on the command line
+            command.append(opt)
+            if opt in output:
+                command.append(output[opt])
+        if not any(opt in output for opt in options):
+            command += ["-consensus_only", "stdout"]
+        command.append(matrix)
+        latencies = []
+        start = time.perf_counter()
+        for _ in range(args.clients * args.requests):
+            t = time.perf_counter()
+            subprocess.run(command, stdout=subprocess.DEVNULL, check=True)
+            latencies.append(time.perf_counter() - t)
+        report("process", latencies, time.perf_counter() - start)
+    return 1 if errors else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,353 @@
+#include "default.h"
+#include "poa.h"
+#include "seq_util.h"
+#include "lpo.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+
+/* PERSISTENT ALIGNMENT SERVER (-serve): THE MATRIX IS READ ONCE, AND A
+   POOL OF THREADS, EACH WITH ITS OWN COPY OF IT, ANSWERS REQUESTS ON A
+   UNIX DOMAIN SOCKET.  A CONNECTION MAY CARRY ANY NUMBER OF REQUESTS:
+
+     request:  POA <nbytes> [OPTIONS]\n<nbytes of FASTA text>
+     reply:    OK <nbytes>\n<nbytes of output>
+          or:  ERR <nbytes>\n<nbytes of message>
+
+   OPTIONS ARE THOSE OF THE COMMAND LINE THAT APPLY TO ONE ALIGNMENT:
+   -consensus_only (THE DEFAULT), -pir, -clustal OR -po SELECT THE OUTPUT,
+   AND -do_global, -fuse_all, -hb, -hbmin F AND -best WORK AS THEY DO ON
+   THE COMMAND LINE.  A REQUEST LINE READING QUIT STOPS THE SERVER. */
+
+
+/** LONGEST REQUEST LINE */
+#define SERVE_HEADER_MAX 1024
+
+/** LARGEST FASTA PAYLOAD ACCEPTED IN ONE REQUEST */
+#define SERVE_REQUEST_MAX (1<<30)
+
+/** PENDING CONNECTIONS QUEUED BY listen() */
+#define SERVE_BACKLOG 128
+
+enum {
+  serve_consensus_output,
+  serve_pir_output,
+  serve_clustal_output,
+  serve_po_output
+};
+
+/** OPTIONS OF ONE REQUEST */
+typedef struct {
+  int output;
+  int use_global_alignment,use_aggressive_fusion;
+  int do_analyze_bundles,ibundle;
+  float bundling_threshold;
+} ServeRequest_T;
+
+/** EVERYTHING THE SERVER THREADS SHARE; ONLY stopping CHANGES */
+typedef struct {
+  int listen_fd;
+  ResidueScoreMatrix_T *m;
+  int do_switch_case;
+  volatile int stopping;
+} ServeJob_T;
+
+
+
+/** parses the options after the payload size on a request line into
+    req; returns FALSE, with a message in errmsg[], on an unknown one */
+static int parse_serve_options(char options[],ServeRequest_T *req,
+			       char errmsg[])
+{
+  char *p,*save=NULL;
+
+  memset(req,0,sizeof(*req));
+  req->output=serve_consensus_output;
+  req->ibundle=ALL_BUNDLES;
+  req->bundling_threshold=0.9;
+  for (p=strtok_r(options," \t\r\n",&save);p;p=strtok_r(NULL," \t\r\n",&save)) {
+    if (0==strcmp(p,"-consensus_only"))
+      req->output=serve_consensus_output;
+    else if (0==strcmp(p,"-pir"))
+      req->output=serve_pir_output;
+    else if (0==strcmp(p,"-clustal"))
+      req->output=serve_clustal_output;
+    else if (0==strcmp(p,"-po"))
+      req->output=serve_po_output;
+    else if (0==strcmp(p,"-do_global"))
+      req->use_global_alignment=1;
+    else if (0==strcmp(p,"-fuse_all"))
+      req->use_aggressive_fusion=1;
+    else if (0==strcmp(p,"-hb"))
+      req->do_analyze_bundles=1;
+    else if (0==strcmp(p,"-best"))
+      req->ibundle=0;
+    else if (0==strcmp(p,"-hbmin") && (p=strtok_r(NULL," \t\r\n",&save)))
+      req->bundling_threshold=atof(p);
+    else {
+      sprintf(errmsg,"unknown request option %.64s\n",p);
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+
+/** aligns the FASTA text[0..size-1] as the command line would with the
+    options req, writing the result to ofile; returns FALSE, with a
+    message in errmsg[], if there is nothing to align */
+static int run_serve_request(char text[],size_t size,ServeRequest_T *req,
+			     ResidueScoreMatrix_T *m,int do_switch_case,
+			     FILE *ofile,char errmsg[])
+{
+  int i,nseq=0,path_length=0;
+  LPOSequence_T *seq=NULL,**input_seqs=NULL,*lpo_out;
+  LPOLetterRef_T *path=NULL;
+  LPOPrune_T prune={0,2};
+  LPOCheckpoint_T checkpoint={NULL,100,0};
+  LPOSpeculate_T speculate={0,1};
+  char *comment=NULL,*consensus=NULL,title[1024];
+
+  nseq=read_fasta_view(text,size,&seq,do_switch_case,&comment);
+  if (nseq==0) {
+    strcpy(errmsg,"no sequences in request\n");
+    FREE(comment);
+    return FALSE;
+  }
+  CALLOC(input_seqs,nseq,LPOSequence_T *);
+  LOOPF (i,nseq) /* VIEWS ARE INITIALIZED LAZILY DURING BUILDUP */
+    input_seqs[i]=seq+i;
+  lpo_out=buildup_progressive_lpo(nseq,input_seqs,m,req->use_aggressive_fusion,
+				  FALSE,NULL,NULL,req->use_global_alignment,FALSE,
+				  req->output==serve_consensus_output,
+				  buildup_input_order,&prune,&checkpoint,&speculate);
+  if (!lpo_out) {
+    strcpy(errmsg,"alignment exceeded the memory bound\n");
+    FREE(comment);
+    goto free_request_data;
+  }
+  if (comment) { /* SAVE THE COMMENT LINE AS TITLE OF OUR LPO */
+    FREE(lpo_out->title);
+    lpo_out->title=comment;
+  }
+
+  switch (req->output) {
+  case serve_consensus_output: /* HEAVIEST PATH BY LINK WEIGHT */
+    if (nseq==1) /* NEVER MERGED, SO NOT FOLDED YET */
+      fold_lpo_sources(lpo_out,0);
+    path=heaviest_link_path(lpo_out->length,lpo_out->letter,
+			    lpo_out->source_seq,&path_length);
+    CALLOC(consensus,path_length+1,char);
+    LOOPF (i,path_length)
+      consensus[i]=m->symbol[(int)lpo_out->letter[path[i]].letter];
+    sprintf(title,"consensus produced by heaviest_bundle, from %d seqs",
+	    lpo_out->nsource_seq);
+    write_fasta(ofile,"CONSENS0",title,consensus);
+    FREE(consensus);
+    FREE(path);
+    break;
+  default:
+    if (req->do_analyze_bundles)
+      generate_lpo_bundles(lpo_out,req->bundling_threshold);
+    if (req->output==serve_pir_output)
+      write_lpo_bundle_as_fasta(ofile,lpo_out,m->nsymbol,m->symbol,req->ibundle);
+    else if (req->output==serve_clustal_output)
+      export_clustal_seqal(ofile,lpo_out,m->nsymbol,m->symbol);
+    else
+      write_lpo(ofile,lpo_out,m);
+  }
+
+ free_request_data:
+  LOOPF (i,nseq)
+    free_lpo_sequence(seq+i,FALSE);
+  FREE(seq);
+  FREE(input_seqs);
+  return lpo_out!=NULL;
+}
+
+
+/** writes all of buf[0..size-1] to fd; returns FALSE if the client has
+    gone away */
+static int write_serve_reply(int fd,const char buf[],size_t size)
+{
+  ssize_t n;
+
+  while (size>0) {
+    n=write(fd,buf,size);
+    if (n<0 && errno==EINTR)
+      continue;
+    if (n<=0)
+      return FALSE;
+    buf+=n;
+    size-=n;
+  }
+  return TRUE;
+}
+
+
+/** sends an OK or ERR reply carrying body[0..size-1] */
+static int send_serve_reply(int fd,const char status[],const char body[],
+			    size_t size)
+{
+  char header[64];
+
+  sprintf(header,"%s %lu\n",status,(unsigned long)size);
+  return write_serve_reply(fd,header,strlen(header))
+    && write_serve_reply(fd,body,size);
+}
+
+
+/** answers requests on the connection fd until the client closes it;
+    *p_text is the thread's payload buffer, kept from one request to the
+    next.  Returns TRUE if the client asked the server to stop */
+static int serve_connection(int fd,ServeJob_T *job,ResidueScoreMatrix_T *m,
+			    char **p_text,size_t *p_text_alloc)
+{
+  int ok,quit=FALSE;
+  unsigned long nbytes;
+  size_t reply_size=0;
+  char header[SERVE_HEADER_MAX],errmsg[256],*options,*reply=NULL;
+  ServeRequest_T req;
+  FILE *ifile,*ofile;
+
+  if (!(ifile=fdopen(fd,"r"))) {
+    close(fd);
+    return FALSE;
+  }
+  while (fgets(header,sizeof(header),ifile)) {
+    if (0==strncmp(header,"QUIT",4)) {
+      quit=TRUE;
+      send_serve_reply(fd,"OK","",0);
+      break;
+    }
+    if (1!=sscanf(header,"POA %lu",&nbytes) || nbytes>SERVE_REQUEST_MAX) {
+      strcpy(errmsg,"bad request line, expected POA <nbytes> [OPTIONS]\n");
+      send_serve_reply(fd,"ERR",errmsg,strlen(errmsg));
+      break; /* FRAMING IS LOST: HANG UP */
+    }
+    options=header+3+strspn(header+3," ");
+    options+=strcspn(options," \t\r\n"); /* SKIP PAST nbytes */
+    if (nbytes+1>*p_text_alloc) { /* GROW THE THREAD'S PAYLOAD BUFFER */
+      *p_text_alloc=nbytes+1;
+      REALLOC(*p_text,*p_text_alloc,char);
+    }
+    if (nbytes>0 && fread(*p_text,1,nbytes,ifile)!=nbytes)
+      break; /* CLIENT WENT AWAY MID-REQUEST */
+    (*p_text)[nbytes]='\0';
+
+    if (!parse_serve_options(options,&req,errmsg))
+      ok=FALSE;
+    else if (!(ofile=open_memstream(&reply,&reply_size))) {
+      strcpy(errmsg,"out of memory\n");
+      ok=FALSE;
+    }
+    else {
+      ok=run_serve_request(*p_text,nbytes,&req,m,job->do_switch_case,
+			   ofile,errmsg);
+      fclose(ofile);
+    }
+    if (ok)
+      ok=send_serve_reply(fd,"OK",reply,reply_size);
+    else
+      ok=send_serve_reply(fd,"ERR",errmsg,strlen(errmsg));
+    FREE(reply);
+    reply_size=0;
+    if (!ok) /* CLIENT WENT AWAY */
+      break;
+  }
+  fclose(ifile); /* ALSO CLOSES fd */
+  return quit;
+}
+
+
+/** server thread: takes connections until the server stops, aligning
+    with its own copy of the score matrix (see copy_score_matrix()) */
+static void *serve_worker(void *arg)
+{
+  int fd;
+  ServeJob_T *job=arg;
+  ResidueScoreMatrix_T *m=copy_score_matrix(job->m);
+  char *text=NULL;
+  size_t text_alloc=0;
+
+  while (!job->stopping) {
+    fd=accept(job->listen_fd,NULL,NULL);
+    if (fd<0) {
+      if (errno==EINTR || errno==ECONNABORTED)
+	continue;
+      break; /* LISTENING SOCKET SHUT DOWN BY QUIT */
+    }
+    if (serve_connection(fd,job,m,&text,&text_alloc)) {
+      job->stopping=TRUE; /* WAKE THE OTHER THREADS OUT OF accept() */
+      shutdown(job->listen_fd,SHUT_RDWR);
+    }
+  }
+
+  FREE(text);
+  free_score_matrix_copy(m);
+  return NULL;
+}
+
+
+/** answers alignment requests (see the top of serve_lpo.c) on the Unix
+    domain socket serve->socket_path, with serve->nthread threads, until
+    a client sends QUIT; the matrix m and the case switch apply to every
+    request.  A stale socket left at that path by an earlier server is
+    replaced.  Returns the number of threads that served, or -1 if the
+    socket can't be set up */
+int serve_lpo_requests(LPOServe_T *serve,ResidueScoreMatrix_T *m,
+		       int do_switch_case)
+{
+  int i,nthread;
+  struct sockaddr_un addr;
+  struct stat st;
+  ServeJob_T job;
+  pthread_t *thread=NULL;
+
+  memset(&addr,0,sizeof(addr));
+  addr.sun_family=AF_UNIX;
+  if (strlen(serve->socket_path)>=sizeof(addr.sun_path)) {
+    WARN_MSG(USERR,(ERRTXT,"Socket path too long: %s\nExiting",
+		    serve->socket_path),"$Revision: 1.2.2.9 $");
+    return -1;
+  }
+  strcpy(addr.sun_path,serve->socket_path);
+  if (0==stat(serve->socket_path,&st) && S_ISSOCK(st.st_mode))
+    unlink(serve->socket_path); /* LEFT BY A SERVER THAT WAS KILLED */
+
+  memset(&job,0,sizeof(job));
+  job.m=m;
+  job.do_switch_case=do_switch_case;
+  if ((job.listen_fd=socket(AF_UNIX,SOCK_STREAM,0))<0
+      || bind(job.listen_fd,(struct sockaddr *)&addr,sizeof(addr))
+      || listen(job.listen_fd,SERVE_BACKLOG)) {
+    WARN_MSG(USERR,(ERRTXT,"Couldn't listen on socket %s: %s\nExiting",
+		    serve->socket_path,strerror(errno)),"$Revision: 1.2.2.9 $");
+    if (job.listen_fd>=0)
+      close(job.listen_fd);
+    return -1;
+  }
+  signal(SIGPIPE,SIG_IGN); /* A CLIENT HANGING UP MUST NOT KILL US */
+
+  nthread=serve->nthread>1 ? serve->nthread : 1;
+  CALLOC(thread,nthread,pthread_t);
+  for (i=1;i<nthread;i++) /* THIS THREAD IS WORKER 0 */
+    if (pthread_create(thread+i,NULL,serve_worker,&job)) {
+      WARN_MSG(TRAP,(ERRTXT,"Couldn't start server thread %d\n",i),"$Revision: 1.2.2.9 $");
+      nthread=i;
+    }
+  serve_worker(&job);
+  for (i=1;i<nthread;i++)
+    pthread_join(thread[i],NULL);
+
+  close(job.listen_fd);
+  unlink(serve->socket_path);
+  FREE(thread);
+  return nthread;
+}
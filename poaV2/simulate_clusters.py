@@ -0,0 +1,163 @@
+#!/usr/bin/env python3
+"""Simulated read clusters and protein families for benchmarking poa.
+
+Each cluster starts from a random ancestor.  With --divergence D, the
+cluster holds --haplotypes variants of the ancestor, each D diverged from
+it (substitutions and indels); every read copies one haplotype and then
+picks up sequencing errors at the --sub, --ins and --del rates.  With
+--protein, the ancestor is a protein drawn from background amino acid
+frequencies, and members diverge from it by D with no further errors
+unless the error rates are set.
+
+Reads are named CLUSTER/READ, so a multi-cluster file can be fed to
+poa -batch.  --truth FILE saves each cluster's ancestor, the consensus
+poa should recover.
+
+With --fastq PROFILE, reads are written as FASTQ with calibrated base
+qualities: each base draws a Phred quality Q from the profile and is
+then miscalled with probability 10^(-Q/10) (60% substitutions, 20%
+insertions, 20% deletions), on top of any --sub/--ins/--del errors,
+whose qualities tell nothing.  Profiles:
+
+  short  high quality (Q36 falling to Q26 along the read), with 2% of
+         bases dipping to Q2-10
+  long   noisy, Q12 +- 4 per base (about 7% errors)
+  mixed  half the reads good (Q30 +- 3), half bad (Q7 +- 2)
+
+    ./simulate_clusters.py --length 1000 --depth 30 --sub 0.02 > reads.fa
+    ./simulate_clusters.py --protein --length 300 --depth 40 \\
+        --divergence 0.25 --clusters 5 > family.fa
+    ./simulate_clusters.py --length 1000 --depth 8 --fastq long \\
+        --truth truth.fa > reads.fq
+"""
+
+import argparse
+import random
+import sys
+
+DNA = "ACGT"
+# background amino acid frequencies (Robinson & Robinson 1991), percent
+AMINO_ACIDS = "ARNDCQEGHILKMFPSTWYV"
+AMINO_FREQ = [7.8, 5.1, 4.5, 5.4, 1.9, 4.3, 6.3, 7.4, 2.3, 5.3,
+              9.1, 5.7, 2.2, 3.9, 5.2, 7.1, 5.8, 1.3, 3.2, 6.4]
+
+
+def random_residues(rng, alphabet, weights, n):
+    return rng.choices(alphabet, weights=weights, k=n)
+
+
+def mutate(rng, seq, alphabet, weights, sub, ins, dele):
+    """Copies seq with substitutions, insertions and deletions per residue."""
+    out = []
+    for c in seq:
+        r = rng.random()
+        if r < dele:
+            continue
+        if r < dele + sub:
+            others = [(a, w) for a, w in zip(alphabet, weights) if a != c]
+            c = rng.choices([a for a, _ in others], weights=[w for _, w in others])[0]
+        out.append(c)
+        while rng.random() < ins:
+            out.extend(random_residues(rng, alphabet, weights, 1))
+    return out
+
+
+def read_qualities(rng, profile, n):
+    """Phred qualities for the n bases of one read."""
+    if profile == "short":
+        return [rng.randint(2, 10) if rng.random() < 0.02
+                else round(36 - 10.0 * i / max(n - 1, 1) + rng.gauss(0, 1.5))
+                for i in range(n)]
+    if profile == "long":
+        return [round(rng.gauss(12, 4)) for _ in range(n)]
+    mean, sd = (30, 3) if rng.random() < 0.5 else (7, 2)  # mixed
+    return [round(rng.gauss(mean, sd)) for _ in range(n)]
+
+
+def miscall(rng, seq, alphabet, weights, profile):
+    """Copies seq with errors drawn from per-base qualities; returns the
+    read and its qualities, the qualities of inserted bases being those
+    of the base they follow."""
+    quals = [min(max(q, 2), 41) for q in read_qualities(rng, profile, len(seq))]
+    out, out_quals = [], []
+    for c, q in zip(seq, quals):
+        if rng.random() < 10 ** (-q / 10.0):
+            r = rng.random()
+            if r < 0.2:  # deletion
+                continue
+            if r < 0.8:  # substitution
+                others = [(a, w) for a, w in zip(alphabet, weights) if a != c]
+                c = rng.choices([a for a, _ in others], weights=[w for _, w in others])[0]
+            else:  # insertion after the base
+                out.append(c)
+                out_quals.append(q)
+                c = random_residues(rng, alphabet, weights, 1)[0]
+        out.append(c)
+        out_quals.append(q)
+    return out, out_quals
+
+
+def write_fastq(f, name, seq, quals):
+    f.write("@%s\n%s\n+\n%s\n" % (name, "".join(seq),
+                                   "".join(chr(33 + q) for q in quals)))
+
+
+def write_fasta(f, name, seq, width=60):
+    f.write(">%s\n" % name)
+    for i in range(0, len(seq), width):
+        f.write("".join(seq[i:i + width]) + "\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--clusters", type=int, default=1, help="clusters (default 1)")
+    parser.add_argument("--length", type=int, default=1000,
+                        help="ancestor length (default 1000)")
+    parser.add_argument("--depth", type=int, default=20, help="reads per cluster (default 20)")
+    parser.add_argument("--sub", type=float, default=0.0, help="substitution rate per residue")
+    parser.add_argument("--ins", type=float, default=0.0, help="insertion rate per residue")
+    parser.add_argument("--del", dest="dele", type=float, default=0.0,
+                        help="deletion rate per residue")
+    parser.add_argument("--divergence", type=float, default=0.0,
+                        help="haplotype (or family member) divergence from the ancestor")
+    parser.add_argument("--haplotypes", type=int, default=2,
+                        help="haplotypes per cluster with --divergence (default 2)")
+    parser.add_argument("--protein", action="store_true", help="protein families, not DNA")
+    parser.add_argument("--seed", type=int, default=1, help="random seed (default 1)")
+    parser.add_argument("--truth", help="also write each cluster's ancestor to this FASTA")
+    parser.add_argument("--fastq", choices=["short", "long", "mixed"],
+                        help="write FASTQ, with errors from this quality profile")
+    args = parser.parse_args()
+
+    rng = random.Random(args.seed)
+    alphabet, weights = (AMINO_ACIDS, AMINO_FREQ) if args.protein else (DNA, [1] * 4)
+    truth = open(args.truth, "w") if args.truth else None
+    out = sys.stdout
+    for c in range(args.clusters):
+        ancestor = random_residues(rng, alphabet, weights, args.length)
+        if truth:
+            write_fasta(truth, "c%d" % c, ancestor)
+        if args.protein:  # every family member is its own diverged copy
+            nvariant = args.depth
+        else:
+            nvariant = args.haplotypes if args.divergence > 0 else 1
+        variants = [mutate(rng, ancestor, alphabet, weights, args.divergence * 0.8,
+                           args.divergence * 0.1, args.divergence * 0.1)
+                    if args.divergence > 0 else ancestor
+                    for _ in range(nvariant)]
+        for r in range(args.depth):
+            source = variants[r % nvariant]
+            read = mutate(rng, source, alphabet, weights, args.sub, args.ins, args.dele)
+            if args.fastq:
+                read, quals = miscall(rng, read, alphabet, weights, args.fastq)
+                write_fastq(out, "c%d/r%d" % (c, r), read, quals)
+            else:
+                write_fasta(out, "c%d/r%d" % (c, r), read)
+    if truth:
+        truth.close()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())